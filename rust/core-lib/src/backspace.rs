@@ -55,17 +55,16 @@ pub fn offset_for_delete_backwards(region: &SelRegion, text: &Rope, config: &Buf
                 Finished,
             }
             let mut state = State::Start;
-            let mut tmp_offset = region.end;
+            // A single cursor walks back over the codepoints, rather than
+            // seeking from the root of the rope for each one.
+            let mut cursor = Cursor::new(&text, region.end);
 
             let mut delete_code_point_count = 0;
             let mut last_seen_vs_code_point_count = 0;
 
-            while state != State::Finished && tmp_offset > 0 {
-                let mut cursor = Cursor::new(&text, tmp_offset);
+            while state != State::Finished && cursor.pos() > 0 {
                 let code_point = cursor.prev_codepoint().unwrap_or('0');
 
-                tmp_offset = text.prev_codepoint_offset(tmp_offset).unwrap_or(0);
-
                 match state {
                     State::Start => {
                         delete_code_point_count = 1;
@@ -203,12 +202,11 @@ pub fn offset_for_delete_backwards(region: &SelRegion, text: &Rope, config: &Buf
                 }
             }
 
-            let mut start = region.end;
-            while delete_code_point_count > 0 {
-                start = text.prev_codepoint_offset(start).unwrap_or(0);
+            let mut cursor = Cursor::new(&text, region.end);
+            while delete_code_point_count > 0 && cursor.prev_codepoint().is_some() {
                 delete_code_point_count -= 1;
             }
-            start
+            cursor.pos()
         }
     }
 }
@@ -16,7 +16,7 @@
 
 use std::time::Instant;
 
-use serde_json::{self, Value};
+use serde_json::Value;
 use xi_rpc::{self, RpcPeer};
 
 use crate::config::Table;
@@ -36,13 +36,13 @@ impl Client {
     }
 
     pub fn update_view(&self, view_id: ViewId, update: &Update) {
-        self.0.send_rpc_notification(
-            "update",
-            &json!({
-                "view_id": view_id,
-                "update": update,
-            }),
-        );
+        // sent typed, as this is the bulk of the traffic to the frontend
+        #[derive(Serialize)]
+        struct UpdateParams<'a> {
+            view_id: ViewId,
+            update: &'a Update,
+        }
+        self.0.send_rpc_notification_typed("update", &UpdateParams { view_id, update });
     }
 
     pub fn scroll_to(&self, view_id: ViewId, line: usize, col: usize) {
@@ -167,9 +167,8 @@ impl Client {
 
     /// Ask front-end to measure widths of strings.
     pub fn measure_width(&self, reqs: &[WidthReq]) -> Result<WidthResponse, xi_rpc::Error> {
-        let req_json = serde_json::to_value(reqs).expect("failed to serialize width req");
-        let resp = self.0.send_rpc_request("measure_width", &req_json)?;
-        Ok(serde_json::from_value(resp).expect("failed to deserialize width response"))
+        let resp = self.0.send_rpc_request_typed("measure_width", &reqs)?;
+        Ok(resp.parse().expect("failed to deserialize width response"))
     }
 
     pub fn alert<S: AsRef<str>>(&self, msg: S) {
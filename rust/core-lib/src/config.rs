@@ -22,6 +22,7 @@ use std::sync::Arc;
 
 use serde::de::{self, Deserialize};
 use serde_json::{self, Value};
+use xi_unicode::LineBreakStrictness;
 
 use crate::syntax::{LanguageId, Languages};
 use crate::tabs::{BufferId, ViewId};
@@ -169,6 +170,26 @@ where
     }
 }
 
+/// How strictly lines are wrapped around small kana, iteration marks and
+/// other non-starters; see `xi_unicode::LineBreakStrictness`.
+#[derive(Debug, Clone, Copy, Deserialize, Serialize, PartialEq, Eq)]
+#[serde(rename_all = "lowercase")]
+pub enum LineBreak {
+    Strict,
+    Normal,
+    Loose,
+}
+
+impl From<LineBreak> for LineBreakStrictness {
+    fn from(line_break: LineBreak) -> LineBreakStrictness {
+        match line_break {
+            LineBreak::Strict => LineBreakStrictness::Strict,
+            LineBreak::Normal => LineBreakStrictness::Normal,
+            LineBreak::Loose => LineBreakStrictness::Loose,
+        }
+    }
+}
+
 /// The concrete type for buffer-related settings.
 #[derive(Debug, Clone, Deserialize, Serialize, PartialEq)]
 pub struct BufferItems {
@@ -183,6 +204,8 @@ pub struct BufferItems {
     pub scroll_past_end: bool,
     pub wrap_width: usize,
     pub word_wrap: bool,
+    pub wrap_dictionary: String,
+    pub line_break: LineBreak,
     pub autodetect_whitespace: bool,
     pub surrounding_pairs: Vec<(String, String)>,
     pub save_with_newline: bool,
@@ -37,6 +37,7 @@ use crate::edit_types::{EventDomain, SpecialEvent};
 use crate::editor::Editor;
 use crate::file::FileInfo;
 use crate::line_offset::LineOffset;
+use crate::linewrap::WrapDictionaries;
 use crate::plugins::Plugin;
 use crate::recorder::Recorder;
 use crate::selection::InsertDrift;
@@ -76,6 +77,7 @@ pub struct EventContext<'a> {
     pub(crate) client: &'a Client,
     pub(crate) style_map: &'a RefCell<ThemeStyleMap>,
     pub(crate) width_cache: &'a RefCell<WidthCache>,
+    pub(crate) wrap_dictionaries: &'a RefCell<WrapDictionaries>,
     pub(crate) kill_ring: &'a RefCell<Rope>,
     pub(crate) weak_core: &'a WeakXiCore,
 }
@@ -388,8 +390,15 @@ impl<'a> EventContext<'a> {
     pub(crate) fn view_init(&mut self) {
         let wrap_width = self.config.wrap_width;
         let word_wrap = self.config.word_wrap;
-
-        self.with_view(|view, text| view.update_wrap_settings(text, wrap_width, word_wrap));
+        let wrap_dictionary = &self.config.wrap_dictionary;
+        let wrap_dictionaries = self.wrap_dictionaries;
+        let line_break = self.config.line_break;
+
+        self.with_view(|view, text| {
+            view.set_wrap_dictionary(wrap_dictionary, &mut wrap_dictionaries.borrow_mut());
+            view.set_line_break(line_break.into());
+            view.update_wrap_settings(text, wrap_width, word_wrap)
+        });
     }
 
     pub(crate) fn finish_init(&mut self, config: &Table) {
@@ -443,7 +452,11 @@ impl<'a> EventContext<'a> {
     }
 
     pub(crate) fn config_changed(&mut self, changes: &Table) {
-        if changes.contains_key("wrap_width") || changes.contains_key("word_wrap") {
+        if changes.contains_key("wrap_width")
+            || changes.contains_key("word_wrap")
+            || changes.contains_key("wrap_dictionary")
+            || changes.contains_key("line_break")
+        {
             // FIXME: if switching from measurement-based widths to columnar widths,
             // we need to reset the cache, since we're using different coordinate spaces
             // for the same IDs. The long-term solution would be to include font
@@ -451,8 +464,10 @@ impl<'a> EventContext<'a> {
             // case, getting the unit width for a typeface and multiplying that by
             // a string's unicode width.
             if changes.contains_key("word_wrap") {
-                debug!("clearing {} items from width cache", self.width_cache.borrow().len());
-                self.width_cache.replace(WidthCache::new());
+                let mut width_cache = self.width_cache.borrow_mut();
+                debug!("clearing {} items from width cache", width_cache.len());
+                debug!("width cache stats: {:?}", width_cache.stats());
+                width_cache.clear();
             }
             self.update_wrap_settings(true);
         }
@@ -548,6 +563,13 @@ impl<'a> EventContext<'a> {
         rope
     }
 
+    /// Rewraps after the way widths are measured has changed, such as when
+    /// the front-end reports a fixed pitch font.
+    pub(crate) fn widths_changed(&mut self) {
+        self.update_wrap_settings(true);
+        self.render_if_needed();
+    }
+
     /// Called after anything changes that effects word wrap, such as the size of
     /// the window or the user's wrap settings. `rewrap_immediately` should be `true`
     /// except in the resize case; during live resize we want to delay recalculation
@@ -555,7 +577,14 @@ impl<'a> EventContext<'a> {
     fn update_wrap_settings(&mut self, rewrap_immediately: bool) {
         let wrap_width = self.config.wrap_width;
         let word_wrap = self.config.word_wrap;
-        self.with_view(|view, text| view.update_wrap_settings(text, wrap_width, word_wrap));
+        let wrap_dictionary = &self.config.wrap_dictionary;
+        let wrap_dictionaries = self.wrap_dictionaries;
+        let line_break = self.config.line_break;
+        self.with_view(|view, text| {
+            view.set_wrap_dictionary(wrap_dictionary, &mut wrap_dictionaries.borrow_mut());
+            view.set_line_break(line_break.into());
+            view.update_wrap_settings(text, wrap_width, word_wrap)
+        });
         if rewrap_immediately {
             self.rewrap();
             self.with_view(|view, text| view.set_dirty(text));
@@ -725,6 +754,7 @@ mod tests {
         kill_ring: RefCell<Rope>,
         style_map: RefCell<ThemeStyleMap>,
         width_cache: RefCell<WidthCache>,
+        wrap_dictionaries: RefCell<WrapDictionaries>,
         config_manager: ConfigManager,
         recorder: RefCell<Recorder>,
     }
@@ -744,9 +774,11 @@ mod tests {
             let kill_ring = RefCell::new(Rope::from(""));
             let style_map = RefCell::new(ThemeStyleMap::new(None));
             let width_cache = RefCell::new(WidthCache::new());
+            let wrap_dictionaries = RefCell::new(WrapDictionaries::default());
             let recorder = RefCell::new(Recorder::new());
             let harness = ContextHarness { view, editor, client, core_ref, kill_ring,
-                             style_map, width_cache, config_manager, recorder };
+                             style_map, width_cache, wrap_dictionaries, config_manager,
+                             recorder };
             harness.make_context().view_init();
             harness.make_context().finish_init(&config);
             harness
@@ -793,6 +825,7 @@ mod tests {
                 kill_ring: &self.kill_ring,
                 style_map: &self.style_map,
                 width_cache: &self.width_cache,
+                wrap_dictionaries: &self.wrap_dictionaries,
                 weak_core: &self.core_ref,
             }
         }
@@ -20,7 +20,7 @@ use std::fmt;
 use std::fs::{self, File};
 use std::io::{self, Read, Write};
 use std::path::{Path, PathBuf};
-use std::str;
+use std::thread;
 use std::time::SystemTime;
 
 use xi_rope::Rope;
@@ -180,13 +180,13 @@ where
 {
     // TODO: support for non-utf8
     // it's arguable that the rope crate should have file loading functionality
-    let mut f =
-        File::open(path.as_ref()).map_err(|e| FileError::Io(e, path.as_ref().to_owned()))?;
-    let mut bytes = Vec::new();
-    f.read_to_end(&mut bytes).map_err(|e| FileError::Io(e, path.as_ref().to_owned()))?;
-
+    let io_err = |e| FileError::Io(e, path.as_ref().to_owned());
+    let mut f = File::open(path.as_ref()).map_err(io_err)?;
+    let len = f.metadata().map_err(io_err)?.len();
+    let mut bytes = Vec::with_capacity(len as usize);
+    f.read_to_end(&mut bytes).map_err(io_err)?;
     let encoding = CharacterEncoding::guess(&bytes);
-    let rope = try_decode(bytes, encoding, path.as_ref())?;
+    let rope = try_decode(&bytes, encoding, path.as_ref())?;
     let info = FileInfo {
         encoding,
         mod_time: get_mod_time(&path),
@@ -240,17 +240,18 @@ fn try_save(
     Ok(())
 }
 
-fn try_decode(bytes: Vec<u8>, encoding: CharacterEncoding, path: &Path) -> Result<Rope, FileError> {
-    match encoding {
-        CharacterEncoding::Utf8 => Ok(Rope::from(
-            str::from_utf8(&bytes).map_err(|_e| FileError::UnknownEncoding(path.to_owned()))?,
-        )),
-        CharacterEncoding::Utf8WithBom => {
-            let s = String::from_utf8(bytes)
-                .map_err(|_e| FileError::UnknownEncoding(path.to_owned()))?;
-            Ok(Rope::from(&s[UTF8_BOM.len()..]))
-        }
-    }
+/// The number of threads to build the rope of a file on.
+fn load_threads() -> usize {
+    thread::available_parallelism().map(|n| n.get()).unwrap_or(1)
+}
+
+fn try_decode(bytes: &[u8], encoding: CharacterEncoding, path: &Path) -> Result<Rope, FileError> {
+    let bytes = match encoding {
+        CharacterEncoding::Utf8 => bytes,
+        CharacterEncoding::Utf8WithBom => &bytes[UTF8_BOM.len()..],
+    };
+    Rope::from_utf8_parallel(bytes, load_threads())
+        .map_err(|_e| FileError::UnknownEncoding(path.to_owned()))
 }
 
 impl CharacterEncoding {
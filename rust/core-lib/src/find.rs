@@ -24,7 +24,7 @@ use crate::view::View;
 use crate::word_boundaries::WordCursor;
 use regex::{Regex, RegexBuilder};
 use xi_rope::delta::DeltaRegion;
-use xi_rope::find::{find, is_multiline_regex, CaseMatching};
+use xi_rope::find::{find, is_multiline_regex, CaseMatching, MultiFinder};
 use xi_rope::{Cursor, Interval, LinesMetric, Metric, Rope, RopeDelta};
 
 const REGEX_SIZE_LIMIT: usize = 1000000;
@@ -136,56 +136,69 @@ impl Find {
     }
 
     pub fn update_highlights(&mut self, text: &Rope, delta: &RopeDelta) {
-        // update search highlights for changed regions
-        if self.search_string.is_some() {
-            // invalidate occurrences around deletion positions
-            for DeltaRegion { old_offset, len, .. } in delta.iter_deletions() {
-                self.occurrences.delete_range(old_offset, old_offset + len, false);
-            }
+        if let Some((start, end)) = self.invalidate_for_edit(text, delta) {
+            self.update_find(text, start, end, false);
+        }
+    }
 
-            self.occurrences = self.occurrences.apply_delta(delta, false, InsertDrift::Default);
-
-            // invalidate occurrences around insert positions
-            for DeltaRegion { new_offset, len, .. } in delta.iter_inserts() {
-                // also invalidate previous occurrence since it might expand after insertion
-                // eg. for regex .* every insertion after match will be part of match
-                self.occurrences.delete_range(
-                    new_offset.saturating_sub(1),
-                    new_offset + len,
-                    false,
-                );
-            }
+    /// Invalidates the occurrences affected by `delta`, and returns the range
+    /// that must be searched again to find them.
+    pub(crate) fn invalidate_for_edit(
+        &mut self,
+        text: &Rope,
+        delta: &RopeDelta,
+    ) -> Option<(usize, usize)> {
+        let search_string = self.search_string.as_ref()?;
 
-            // update find for the whole delta and everything after
-            let (iv, new_len) = delta.summary();
+        // invalidate occurrences around deletion positions
+        for DeltaRegion { old_offset, len, .. } in delta.iter_deletions() {
+            self.occurrences.delete_range(old_offset, old_offset + len, false);
+        }
 
-            // get last valid occurrence that was unaffected by the delta
-            let start = match self.occurrences.regions_in_range(0, iv.start()).last() {
-                Some(reg) => reg.end,
-                None => 0,
-            };
+        self.occurrences = self.occurrences.apply_delta(delta, false, InsertDrift::Default);
 
-            // invalidate all search results from the point of the last valid search result until ...
-            let is_multiline = LinesMetric::next(self.search_string.as_ref().unwrap(), 0).is_some();
+        // invalidate occurrences around insert positions
+        for DeltaRegion { new_offset, len, .. } in delta.iter_inserts() {
+            // also invalidate previous occurrence since it might expand after insertion
+            // eg. for regex .* every insertion after match will be part of match
+            self.occurrences.delete_range(new_offset.saturating_sub(1), new_offset + len, false);
+        }
 
-            if is_multiline || self.is_multiline_regex() {
-                // ... the end of the file
-                self.occurrences.delete_range(iv.start(), text.len(), false);
-                self.update_find(text, start, text.len(), false);
-            } else {
-                // ... the end of the line including line break
-                let mut cursor = Cursor::new(&text, iv.end() + new_len);
+        // update find for the whole delta and everything after
+        let (iv, new_len) = delta.summary();
+        let edit_end = iv.start() + new_len;
 
-                let end_of_line = match cursor.next::<LinesMetric>() {
-                    Some(end) => end,
-                    None if cursor.pos() == text.len() => cursor.pos(),
-                    _ => return,
-                };
+        // get last valid occurrence that was unaffected by the delta
+        let prev_end = match self.occurrences.regions_in_range(0, iv.start()).last() {
+            Some(reg) => reg.end,
+            None => 0,
+        };
 
-                self.occurrences.delete_range(iv.start(), end_of_line, false);
-                self.update_find(text, start, end_of_line, false);
-            }
-        }
+        // invalidate all search results from the point of the last valid search result until ...
+        let is_multiline = LinesMetric::next(search_string, 0).is_some();
+
+        let (start, end) = if self.regex.is_none() {
+            // ... twice the length of the query past the edit, as a literal
+            // occurrence can be no longer than that
+            let slop = search_string.len() * 2;
+            (max(prev_end, iv.start().saturating_sub(slop)), min(edit_end + slop, text.len()))
+        } else if is_multiline || self.is_multiline_regex() {
+            // ... the end of the file
+            (prev_end, text.len())
+        } else {
+            // ... the end of the line including line break
+            let mut cursor = Cursor::new(&text, edit_end);
+
+            let end_of_line = match cursor.next::<LinesMetric>() {
+                Some(end) => end,
+                None if cursor.pos() == text.len() => cursor.pos(),
+                _ => return None,
+            };
+            (prev_end, end_of_line)
+        };
+
+        self.occurrences.delete_range(iv.start(), end, false);
+        Some((start, end))
     }
 
     /// Returns `true` if the search query is a multi-line regex.
@@ -246,18 +259,30 @@ impl Find {
         true
     }
 
-    /// Execute the search on the provided text in the range provided by `start` and `end`.
-    pub fn update_find(&mut self, text: &Rope, start: usize, end: usize, include_slop: bool) {
-        if self.search_string.is_none() {
-            return;
+    /// Returns the literal query and its case matching, if it can be
+    /// found together with others by a `MultiFinder`.
+    fn literal_query(&self) -> Option<(&str, CaseMatching)> {
+        match self.search_string {
+            Some(ref s) if self.regex.is_none() && MultiFinder::supports(s, self.case_matching) => {
+                Some((s, self.case_matching))
+            }
+            _ => None,
         }
+    }
 
+    /// Returns the range in which occurrences start, `from..to`, and the
+    /// offset by which they end, when searching from `start` to `end`.
+    fn search_range(
+        &self,
+        text: &Rope,
+        start: usize,
+        end: usize,
+        include_slop: bool,
+    ) -> (usize, usize, usize) {
         // extend the search by twice the string length (twice, because case matching may increase
         // the length of an occurrence)
         let slop = if include_slop { self.search_string.as_ref().unwrap().len() * 2 } else { 0 };
 
-        let search_string = self.search_string.as_ref().unwrap();
-
         // expand region to be able to find occurrences around the region's edges
         let expanded_start = max(start, slop) - slop;
         let expanded_end = min(end + slop, text.len());
@@ -265,8 +290,32 @@ impl Find {
         let to = text.at_or_next_codepoint_boundary(expanded_end).unwrap_or(text.len());
         let mut to_cursor = Cursor::new(&text, to);
         let _ = to_cursor.next_leaf();
+        (from, to, to_cursor.pos())
+    }
+
+    /// Adds the occurrence from `start` to `end`, unless it is not a whole
+    /// word when it must be, or overlaps one found before. Returns the offset
+    /// from which to search for the next one.
+    fn add_occurrence(&mut self, text: &Rope, start: usize, end: usize) -> usize {
+        if self.whole_words && !self.is_matching_whole_words(text, start, end) {
+            return end;
+        }
+        // in case of ambiguous search results (e.g. search "aba" in "ababa"),
+        // the search result closer to the beginning of the file wins
+        let (_, e) = self.occurrences.add_range_distinct(SelRegion::new(start, end));
+        e
+    }
+
+    /// Execute the search on the provided text in the range provided by `start` and `end`.
+    pub fn update_find(&mut self, text: &Rope, start: usize, end: usize, include_slop: bool) {
+        if self.search_string.is_none() {
+            return;
+        }
 
-        let sub_text = text.subseq(Interval::new(0, to_cursor.pos()));
+        let (from, to, limit) = self.search_range(text, start, end, include_slop);
+        let search_string = self.search_string.as_ref().unwrap();
+
+        let sub_text = text.subseq(Interval::new(0, limit));
         let mut find_cursor = Cursor::new(&sub_text, from);
 
         let mut raw_lines = text.lines_raw(from..to);
@@ -408,6 +457,75 @@ impl Find {
     }
 }
 
+/// Executes the search of each of `finds` in its range of `ranges`, as
+/// `update_find` does. Literal queries are found in a single pass over the
+/// text.
+pub(crate) fn update_finds(
+    finds: &mut [Find],
+    text: &Rope,
+    ranges: &[Option<(usize, usize)>],
+    include_slop: bool,
+) {
+    let mut literals = Vec::new();
+    for (i, (find, range)) in finds.iter_mut().zip(ranges).enumerate() {
+        if let Some((start, end)) = *range {
+            if find.literal_query().is_some() {
+                literals.push((i, find.search_range(text, start, end, include_slop)));
+            } else {
+                find.update_find(text, start, end, include_slop);
+            }
+        }
+    }
+
+    // a single query is found as quickly on its own
+    if literals.len() < 2 {
+        for &(i, _) in &literals {
+            let (start, end) = ranges[i].unwrap();
+            finds[i].update_find(text, start, end, include_slop);
+        }
+        return;
+    }
+
+    let finder = {
+        let patterns: Vec<_> =
+            literals.iter().map(|&(i, _)| finds[i].literal_query().unwrap()).collect();
+        MultiFinder::new(&patterns)
+    };
+    let finder = match finder {
+        Some(finder) => finder,
+        None => {
+            for &(i, _) in &literals {
+                let (start, end) = ranges[i].unwrap();
+                finds[i].update_find(text, start, end, include_slop);
+            }
+            return;
+        }
+    };
+
+    let hull_start = literals.iter().map(|&(_, (from, _, _))| from).min().unwrap();
+    let hull_end = literals.iter().map(|&(_, (_, _, limit))| limit).max().unwrap();
+    let mut matches = vec![Vec::new(); literals.len()];
+    finder.find_all(text, Interval::new(hull_start, hull_end), |j, start, end| {
+        let (_, (from, to, limit)) = literals[j];
+        if start >= from && start < to && end <= limit {
+            matches[j].push((start, end));
+        }
+    });
+
+    for (&(i, (from, _, _)), matches) in literals.iter().zip(matches) {
+        let find = &mut finds[i];
+        // occurrences don't overlap, so those that start in the one just
+        // added are skipped, like `find` skips them
+        let mut resume = from;
+        for (start, end) in matches {
+            if start >= resume {
+                resume = find.add_occurrence(text, start, end);
+            }
+        }
+        find.hls_dirty = true;
+    }
+}
+
 /// Implementing the `ToAnnotation` trait allows to convert finds to annotations.
 impl ToAnnotation for Find {
     fn get_annotations(&self, interval: Interval, view: &View, text: &Rope) -> AnnotationSlice {
@@ -617,4 +735,83 @@ mod tests {
         assert_eq!(find.occurrences().first(), Some(&SelRegion::new(3, 4)));
         assert_eq!(find.occurrences().last(), Some(&SelRegion::new(9, 10)));
     }
+
+    fn make_finds(queries: &[(&str, bool, bool, bool)]) -> Vec<Find> {
+        queries
+            .iter()
+            .enumerate()
+            .map(|(i, &(s, case_sensitive, is_regex, whole_words))| {
+                let mut find = Find::new(i);
+                find.set_find(s, case_sensitive, is_regex, whole_words);
+                find
+            })
+            .collect()
+    }
+
+    fn occurrences(finds: &[Find]) -> Vec<Vec<SelRegion>> {
+        finds.iter().map(|find| find.occurrences().iter().cloned().collect()).collect()
+    }
+
+    const QUERIES: &[(&str, bool, bool, bool)] = &[
+        ("aba", true, false, false),
+        ("ABA", false, false, false),
+        ("world", false, false, true),
+        ("Hello", true, false, false),
+        ("o\nh", false, false, false),
+        ("w.r", false, true, false),
+        ("quick", false, false, false),
+    ];
+
+    #[test]
+    fn update_finds_matches_update_find() {
+        let mut s = String::new();
+        for i in 0..500 {
+            s.push_str(["ababa ", "hello ", "Hello\n", "worlds ", "world ", "Abab"][i % 6]);
+        }
+        let text = Rope::from(&s);
+        let ranges = [Some((0, text.len())), Some((1000, 2000)), None, Some((10, 3000))];
+        let ranges: Vec<_> = ranges.iter().cycle().cloned().take(QUERIES.len()).collect();
+
+        let mut expected = make_finds(QUERIES);
+        for (find, range) in expected.iter_mut().zip(&ranges) {
+            if let Some((start, end)) = *range {
+                find.update_find(&text, start, end, true);
+            }
+        }
+        let mut finds = make_finds(QUERIES);
+        update_finds(&mut finds, &text, &ranges, true);
+        assert!(occurrences(&finds).iter().all(|o| !o.is_empty() || ranges[2].is_none()));
+        assert_eq!(occurrences(&finds), occurrences(&expected));
+    }
+
+    #[test]
+    fn update_finds_edit() {
+        let mut s = String::new();
+        for i in 0..500 {
+            s.push_str(["ababa ", "hello ", "Hello\n", "worlds ", "world ", "x"][i % 6]);
+        }
+        let text = Rope::from(&s);
+        let mut finds = make_finds(QUERIES);
+        let ranges = vec![Some((0, text.len())); QUERIES.len()];
+        update_finds(&mut finds, &text, &ranges, false);
+
+        // edits far from any occurrence, and inside and across them
+        let edits = [(2500, 2500, "x"), (10, 12, "BA"), (12, 12, "quick"), (1990, 2010, "")];
+        let mut text = text;
+        for &(start, end, new) in &edits {
+            let mut builder = DeltaBuilder::new(text.len());
+            builder.replace(start..end, new.into());
+            let delta = builder.build();
+            text = delta.apply(&text);
+
+            let ranges: Vec<_> =
+                finds.iter_mut().map(|find| find.invalidate_for_edit(&text, &delta)).collect();
+            update_finds(&mut finds, &text, &ranges, false);
+
+            let mut expected = make_finds(QUERIES);
+            let ranges = vec![Some((0, text.len())); QUERIES.len()];
+            update_finds(&mut expected, &text, &ranges, false);
+            assert_eq!(occurrences(&finds), occurrences(&expected));
+        }
+    }
 }
@@ -14,14 +14,27 @@
 
 //! Compute line wrapping breaks for text.
 
+use std::borrow::Cow;
 use std::cmp::Ordering;
+use std::collections::{HashMap, VecDeque};
+use std::fs::File;
+use std::io;
 use std::ops::Range;
-
+use std::path::{Path, PathBuf};
+use std::str;
+use std::sync::mpsc;
+use std::sync::{Arc, Mutex, Weak};
+use std::thread;
+use std::time::{Duration, Instant};
+
+use memmap2::Mmap;
 use xi_rope::breaks::{BreakBuilder, Breaks, BreaksInfo, BreaksMetric};
 use xi_rope::spans::Spans;
 use xi_rope::{Cursor, Interval, LinesMetric, Rope, RopeDelta, RopeInfo};
 use xi_trace::trace_block;
-use xi_unicode::LineBreakLeafIter;
+use xi_unicode::{
+    sa_run, sa_run_start, Dictionary, LineBreakLeafIter, LineBreakStrictness, SaSegmenter,
+};
 
 use crate::client::Client;
 use crate::styles::{Style, N_RESERVED_STYLES};
@@ -68,6 +81,15 @@ pub(crate) struct Lines {
     wrap: WrapWidth,
     /// Aka the 'frontier'; ranges of lines that still need to be wrapped.
     work: Vec<Task>,
+    /// The dictionary for breaking lines within runs of SA text, such as
+    /// Thai, if any.
+    dict: Option<Arc<WrapDictionary>>,
+    /// The file `dict` was loaded from, or empty.
+    dict_path: String,
+    /// The tailoring of the line breaking rules.
+    strictness: LineBreakStrictness,
+    /// The threads that wrap large tasks, started by the first one.
+    wrap_pool: Option<WrapPool>,
 }
 
 pub(crate) struct VisualLine {
@@ -117,6 +139,30 @@ impl Lines {
         self.wrap = wrap;
     }
 
+    /// Uses the dictionary in the file at `path` to break lines within runs
+    /// of SA text, or none if `path` is empty. The dictionary is taken from
+    /// `dicts`, and only when `path` changes; the lines are rewrapped by
+    /// `set_wrap_width`.
+    pub(crate) fn set_wrap_dictionary(&mut self, path: &str, dicts: &mut WrapDictionaries) {
+        if path == self.dict_path {
+            return;
+        }
+        self.dict_path = path.to_owned();
+        self.dict = None;
+        if !path.is_empty() {
+            match dicts.get(Path::new(path)) {
+                Ok(dict) => self.dict = Some(dict),
+                Err(e) => warn!("failed to load wrap dictionary {}: {}", path, e),
+            }
+        }
+    }
+
+    /// Sets the tailoring of the line breaking rules. The lines are
+    /// rewrapped by `set_wrap_width`.
+    pub(crate) fn set_strictness(&mut self, strictness: LineBreakStrictness) {
+        self.strictness = strictness;
+    }
+
     fn add_task<T: Into<Interval>>(&mut self, iv: T) {
         let iv = iv.into();
         if iv.is_empty() {
@@ -275,8 +321,12 @@ impl Lines {
         if self.is_converged() {
             None
         } else {
+            let mut _t = trace_block("Lines::rewrap_chunk", &["core"]);
             let summary = self.do_wrap_task(text, width_cache, client, visible_lines, None);
             let WrapSummary { start_line, inval_count, new_count, .. } = summary;
+            _t.set_payload_with(|| {
+                format!("line {}: {} lines invalidated, {} new", start_line, inval_count, new_count)
+            });
             Some(InvalLines { start_line, inval_count, new_count })
         }
     }
@@ -301,8 +351,6 @@ impl Lines {
         let old_hard_count = old_logical_end_line - logical_start_line;
         let new_hard_count = new_logical_end_line - logical_start_line;
 
-        //TODO: we should be able to avoid wrapping the whole para in most cases,
-        // but the logic is trickier.
         let prev_break = text.offset_of_line(logical_start_line);
         let next_hard_break = text.offset_of_line(new_logical_end_line);
 
@@ -311,6 +359,7 @@ impl Lines {
             - self.breaks.count::<BreaksMetric>(prev_break);
 
         // update soft breaks, adding empty spans in the edited region
+        let old_breaks = self.breaks.clone();
         let mut builder = BreakBuilder::new();
         builder.add_no_break(newlen);
         self.breaks.edit(iv, builder.build());
@@ -324,7 +373,16 @@ impl Lines {
             });
         }
 
-        let new_task = prev_break..next_hard_break;
+        let new_task = Interval::new(prev_break, next_hard_break);
+        // If the lines were already wrapped, only the lines around the edit
+        // need rewrapping, which matters for very long lines.
+        if !new_task.is_empty() && !self.interval_needs_wrap(new_task) {
+            let old = EditedLines { text: old_text, breaks: &old_breaks, iv, new_len: newlen };
+            let inval = self.rewrap_around_edit(text, old, new_task, width_cache, client);
+            if let Some(inval) = inval {
+                return if self.is_converged() { Some(inval) } else { None };
+            }
+        }
         self.add_task(new_task);
 
         // possible if the whole buffer is deleted, e.g
@@ -354,7 +412,7 @@ impl Lines {
         max_lines: Option<usize>,
     ) -> WrapSummary {
         use self::WrapWidth::*;
-        let _t = trace_block("Lines::do_wrap_task", &["core"]);
+        let mut _t = trace_block("Lines::do_wrap_task", &["core"]);
         // 'line' is a poor unit here; could do some fancy Duration thing?
         const MAX_LINES_PER_BATCH: usize = 500;
 
@@ -362,55 +420,81 @@ impl Lines {
         let visible_off = cursor.offset_of_line(visible_lines.start);
         let logical_off = text.offset_of_line(text.line_of_offset(visible_off));
 
-        // task.start is a hard break; task.end is a boundary or EOF.
+        // task.start is a break; task.end is a boundary or EOF.
         let task = self.get_next_task(logical_off).unwrap();
         cursor.set_offset(task.start);
         debug_assert_eq!(cursor.offset, task.start, "task_start must be valid offset");
 
-        let mut ctx = match self.wrap {
-            Bytes(b) => RewrapCtx::new(text, &CodepointMono, b as f64, width_cache, task.start),
-            Width(w) => RewrapCtx::new(text, client, w, width_cache, task.start),
-            None => unreachable!(),
-        };
-
         let start_line = cursor.cur_line;
-        let max_lines = max_lines.unwrap_or(MAX_LINES_PER_BATCH);
-        // always wrap at least a screen worth of lines (unless we converge earlier)
-        let batch_size = max_lines.max(visible_lines.end - visible_lines.start);
-
-        let mut builder = BreakBuilder::new();
-        let mut lines_wrapped = 0;
-        let mut pos = task.start;
-        let mut old_next_maybe = cursor.next();
-
-        loop {
-            if let Some(new_next) = ctx.wrap_one_line(pos) {
-                while let Some(old_next) = old_next_maybe {
-                    if old_next >= new_next {
-                        break; // just advance old cursor and continue
+        let n_threads = wrap_threads();
+        let dict = self.dict.as_deref().map(WrapDictionary::get);
+        let dict = dict.as_ref();
+        let strictness = self.strictness;
+
+        let breaks = match self.wrap {
+            // Monospace widths need no front-end, so large tasks can be
+            // wrapped on worker threads.
+            Bytes(b) if n_threads > 1 && task.size() >= MIN_PARALLEL_WRAP_LEN => {
+                let pool = self.wrap_pool.get_or_insert_with(|| WrapPool::new(n_threads));
+                let dict = self.dict.as_ref();
+                let chunk_len = PARALLEL_WRAP_CHUNK_LEN;
+                wrap_parallel(text, task, b as f64, dict, strictness, pool, chunk_len)
+            }
+            _ => {
+                let mut ctx = match self.wrap {
+                    Bytes(b) => RewrapCtx::new(
+                        text,
+                        &CodepointMono,
+                        b as f64,
+                        width_cache,
+                        task.start,
+                        dict,
+                        strictness,
+                    ),
+                    Width(w) => {
+                        RewrapCtx::new(text, client, w, width_cache, task.start, dict, strictness)
+                    }
+                    None => unreachable!(),
+                };
+
+                let max_lines = max_lines.unwrap_or(MAX_LINES_PER_BATCH);
+                // always wrap at least a screen worth of lines (unless we converge earlier)
+                let batch_size = max_lines.max(visible_lines.end - visible_lines.start);
+
+                let mut builder = BreakBuilder::new();
+                let mut lines_wrapped = 0;
+                let mut pos = task.start;
+                let mut old_next_maybe = cursor.next();
+
+                loop {
+                    if let Some(new_next) = ctx.wrap_one_line(pos) {
+                        while let Some(old_next) = old_next_maybe {
+                            if old_next >= new_next {
+                                break; // just advance old cursor and continue
+                            }
+                            old_next_maybe = cursor.next();
+                        }
+
+                        let is_hard = cursor.offset == new_next && cursor.is_hard_break();
+                        if is_hard {
+                            builder.add_no_break(new_next - pos);
+                        } else {
+                            builder.add_break(new_next - pos);
+                        }
+                        lines_wrapped += 1;
+                        pos = new_next;
+                        if pos == task.end || (lines_wrapped > batch_size && is_hard) {
+                            break;
+                        }
+                    } else {
+                        // EOF
+                        builder.add_no_break(text.len() - pos);
+                        break;
                     }
-                    old_next_maybe = cursor.next();
-                }
-
-                let is_hard = cursor.offset == new_next && cursor.is_hard_break();
-                if is_hard {
-                    builder.add_no_break(new_next - pos);
-                } else {
-                    builder.add_break(new_next - pos);
-                }
-                lines_wrapped += 1;
-                pos = new_next;
-                if pos == task.end || (lines_wrapped > batch_size && is_hard) {
-                    break;
                 }
-            } else {
-                // EOF
-                builder.add_no_break(text.len() - pos);
-                break;
+                builder.build()
             }
-        }
-
-        let breaks = builder.build();
+        };
         let end = task.start + breaks.len();
 
         // this is correct *only* when an edit has not occured.
@@ -424,12 +508,109 @@ impl Lines {
         let new_count = new_soft + hard_count;
 
         let iv = Interval::new(task.start, end);
-        self.breaks.edit(iv, breaks);
-        self.update_tasks_after_wrap(iv);
+        _t.set_payload_with(|| format!("{} bytes, {} lines", iv.size(), new_count));
+        {
+            let _t = trace_block("Breaks::edit", &["core"]);
+            self.breaks.edit(iv, breaks);
+            self.update_tasks_after_wrap(iv);
+        }
 
         WrapSummary { start_line, inval_count, new_count, new_soft }
     }
 
+    /// Rewraps the edited lines `line`, which must already have been wrapped
+    /// before the edit, starting shortly before the edit and stopping at the
+    /// first break after it that matches one from before the edit: the lines
+    /// after that wrap just as before. This costs O(edit) rather than O(line)
+    /// for very long lines.
+    ///
+    /// Returns `None`, having changed nothing, if there is no place to resume
+    /// line breaking before the edit.
+    fn rewrap_around_edit(
+        &mut self,
+        text: &Rope,
+        old: EditedLines,
+        line: Interval,
+        width_cache: &mut WidthCache,
+        client: &Client,
+    ) -> Option<InvalLines> {
+        let mut _t = trace_block("Lines::rewrap_around_edit", &["core"]);
+        // Start a visual line early, as shortening the first word of a line
+        // can pull it up into the previous one.
+        let before_edit = text.prev_codepoint_offset(old.iv.start).unwrap_or(0);
+        let edit_line = self.visual_line_of_offset(text, before_edit);
+        let start = self.offset_of_visual_line(text, edit_line.saturating_sub(1)).max(line.start);
+        // `start` is a break, so line breaking can resume there without any
+        // look-behind, in almost all cases.
+        let strictness = self.strictness;
+        let lb_cursor = LineBreakCursor::resume(text, start, strictness)?;
+        let dict = self.dict.as_deref().map(WrapDictionary::get);
+        let dict = dict.as_ref();
+        let mut ctx = match self.wrap {
+            WrapWidth::Bytes(b) => {
+                let mono = &CodepointMono;
+                RewrapCtx::new(text, mono, b as f64, width_cache, start, dict, strictness)
+            }
+            WrapWidth::Width(w) => {
+                RewrapCtx::new(text, client, w, width_cache, start, dict, strictness)
+            }
+            WrapWidth::None => unreachable!(),
+        };
+        ctx.set_lb_cursor(lb_cursor);
+        ctx.end = line.end;
+        // Usually only a few lines change, so measure few words at first.
+        ctx.batch_len = MIN_POT_BREAKS;
+
+        let edit_end = old.iv.start + old.new_len;
+        let mut cursor = MergedBreaks::new(text, &self.breaks);
+        cursor.set_offset(start);
+        let start_line = cursor.cur_line;
+        let mut old_next_maybe = cursor.next();
+        let mut builder = BreakBuilder::new();
+        let mut pos = start;
+        while pos < line.end {
+            let new_next = match ctx.wrap_one_line(pos) {
+                Some(new_next) => new_next,
+                None => {
+                    // EOF
+                    builder.add_no_break(text.len() - pos);
+                    pos = text.len();
+                    break;
+                }
+            };
+            while old_next_maybe.map(|old_next| old_next < new_next).unwrap_or(false) {
+                old_next_maybe = cursor.next();
+            }
+            if cursor.offset == new_next && cursor.is_hard_break() {
+                builder.add_no_break(new_next - pos);
+            } else {
+                builder.add_break(new_next - pos);
+            }
+            pos = new_next;
+            // The state following a break doesn't depend on what came before
+            // it, so past the edit, wrapping from an old break repeats the
+            // old lines. An old break at `edit_end` may be from before the
+            // edit, if it was a deletion.
+            if pos > edit_end && old_next_maybe == Some(pos) {
+                break;
+            }
+        }
+        let end = pos;
+        let old_end = end - edit_end + old.iv.end;
+
+        let old_hard = old.text.line_of_offset(old_end) - old.text.line_of_offset(start);
+        let old_soft =
+            old.breaks.count::<BreaksMetric>(old_end) - old.breaks.count::<BreaksMetric>(start);
+        self.breaks.edit(Interval::new(start, end), builder.build());
+        let new_hard = text.line_of_offset(end) - text.line_of_offset(start);
+        let new_soft =
+            self.breaks.count::<BreaksMetric>(end) - self.breaks.count::<BreaksMetric>(start);
+        let new_count = 1 + new_hard + new_soft;
+        _t.set_payload_with(|| format!("{} bytes, {} lines", end - start, new_count));
+
+        Some(InvalLines { start_line, inval_count: 1 + old_hard + old_soft, new_count })
+    }
+
     pub fn logical_line_range(&self, text: &Rope, line: usize) -> (usize, usize) {
         let mut cursor = MergedBreaks::new(text, &self.breaks);
         let offset = cursor.offset_of_line(line);
@@ -454,6 +635,362 @@ impl Lines {
     }
 }
 
+/// A dictionary for `Lines::set_wrap_dictionary`, from a file which holds
+/// either one saved from `Dictionary::as_bytes`, or a UTF-8 list of words,
+/// one per line.
+pub(crate) enum WrapDictionary {
+    /// A saved dictionary, used in place. The file should not change while
+    /// it is mapped.
+    Mapped(Mmap),
+    /// A dictionary built from a list of words.
+    Built(Dictionary<'static>),
+}
+
+impl WrapDictionary {
+    fn load(path: &Path) -> io::Result<WrapDictionary> {
+        let file = File::open(path)?;
+        // Mapping is only unsafe if the file changes, which dictionaries,
+        // unlike buffers, are not expected to do.
+        let map = unsafe { Mmap::map(&file)? };
+        if Dictionary::from_bytes(&map).is_some() {
+            return Ok(WrapDictionary::Mapped(map));
+        }
+        let words =
+            str::from_utf8(&map).map_err(|e| io::Error::new(io::ErrorKind::InvalidData, e))?;
+        Ok(WrapDictionary::Built(Dictionary::from_words(words.lines().map(str::trim))))
+    }
+
+    fn get(&self) -> Dictionary<'_> {
+        let data = match self {
+            WrapDictionary::Mapped(map) => &map[..],
+            WrapDictionary::Built(dict) => dict.as_bytes(),
+        };
+        Dictionary::from_bytes(data).expect("wrap dictionary was checked when loaded")
+    }
+}
+
+/// The wrap dictionaries in use, by path, so that views which use the same
+/// file share one copy of it.
+#[derive(Default)]
+pub(crate) struct WrapDictionaries {
+    loaded: HashMap<PathBuf, Weak<WrapDictionary>>,
+}
+
+impl WrapDictionaries {
+    /// Returns the dictionary in the file at `path`, which is only loaded if
+    /// no view still uses it.
+    pub(crate) fn get(&mut self, path: &Path) -> io::Result<Arc<WrapDictionary>> {
+        if let Some(dict) = self.loaded.get(path).and_then(Weak::upgrade) {
+            return Ok(dict);
+        }
+        self.loaded.retain(|_, dict| dict.strong_count() > 0);
+        let dict = Arc::new(WrapDictionary::load(path)?);
+        self.loaded.insert(path.to_owned(), Arc::downgrade(&dict));
+        Ok(dict)
+    }
+}
+
+/// Tasks at least this long are split across worker threads, when widths
+/// can be measured without the front-end.
+const MIN_PARALLEL_WRAP_LEN: usize = 1 << 20;
+
+/// The approximate length of text given to each worker thread. Each call
+/// of `do_wrap_task` wraps up to one such chunk per thread.
+const PARALLEL_WRAP_CHUNK_LEN: usize = 1 << 20;
+
+/// The number of threads to wrap on.
+fn wrap_threads() -> usize {
+    thread::available_parallelism().map(|n| n.get()).unwrap_or(1)
+}
+
+/// Worker threads for `wrap_parallel`. They wait for chunks to wrap, and
+/// exit when the pool is dropped.
+struct WrapPool {
+    n_threads: usize,
+    jobs: mpsc::Sender<WrapJob>,
+}
+
+/// A chunk for a `WrapPool` thread to wrap, with where to send its lines.
+struct WrapJob {
+    text: Rope,
+    iv: Interval,
+    in_line: bool,
+    max_width: f64,
+    dict: Option<Arc<WrapDictionary>>,
+    strictness: LineBreakStrictness,
+    result: mpsc::Sender<WrappedChunk>,
+}
+
+impl WrapPool {
+    fn new(n_threads: usize) -> WrapPool {
+        let (jobs, rx) = mpsc::channel::<WrapJob>();
+        let rx = Arc::new(Mutex::new(rx));
+        for i in 0..n_threads {
+            let rx = rx.clone();
+            thread::Builder::new()
+                .name(format!("wrap worker {}", i))
+                .spawn(move || loop {
+                    // The lock is only held while waiting for a job.
+                    let job = match rx.lock().unwrap().recv() {
+                        Ok(job) => job,
+                        Err(_) => break,
+                    };
+                    let (iv, in_line, max_width) = (job.iv, job.in_line, job.max_width);
+                    let dict = job.dict.as_deref().map(WrapDictionary::get);
+                    let dict = dict.as_ref();
+                    let chunk = wrap_chunk(&job.text, iv, in_line, max_width, dict, job.strictness);
+                    let _ = job.result.send(chunk);
+                })
+                .expect("wrap worker should spawn");
+        }
+        WrapPool { n_threads, jobs }
+    }
+}
+
+/// Returns the start of the first line after `offset`, or `end` if that
+/// comes first.
+fn next_line_start(text: &Rope, offset: usize, end: usize) -> usize {
+    if offset >= end {
+        return end;
+    }
+    text.offset_of_line(text.line_of_offset(offset) + 1).min(end)
+}
+
+/// Wraps one chunk of about `chunk_len` bytes from the start of `task` on
+/// each of `pool`'s threads. Returns the breaks for a prefix of `task` that
+/// ends at a break from which wrapping can continue.
+///
+/// Lines restart at hard breaks, so chunks split at hard breaks can be
+/// wrapped independently. Lines much longer than a chunk are split too: the
+/// chunk after such a split is wrapped from a guessed line start, and once
+/// the lines wrapped from before meet one of its lines, the rest of them are
+/// exact. That usually takes a few lines.
+///
+/// Only `WrapWidth::Bytes` tasks are wrapped this way, since their widths
+/// need no front-end; `WrapWidth::Width` is always wrapped on the main
+/// thread. How this scales with the number of threads has not been
+/// measured.
+fn wrap_parallel(
+    text: &Rope,
+    task: Task,
+    max_width: f64,
+    dict: Option<&Arc<WrapDictionary>>,
+    strictness: LineBreakStrictness,
+    pool: &WrapPool,
+    chunk_len: usize,
+) -> Breaks {
+    let mut _t = trace_block("Lines::wrap_parallel", &["core"]);
+    let mut results = Vec::with_capacity(pool.n_threads);
+    let mut start = task.start;
+    let mut in_line = false;
+    while start < task.end && results.len() < pool.n_threads {
+        let mid = (start + chunk_len - 1).min(task.end);
+        let mid = text.at_or_prev_codepoint_boundary(mid).unwrap_or(mid);
+        let mut end = next_line_start(text, mid, task.end);
+        let split = end - start > 2 * chunk_len;
+        if split {
+            end = text.at_or_prev_codepoint_boundary(start + chunk_len).unwrap_or(end);
+        }
+        let (result, rx) = mpsc::channel();
+        let iv = Interval::new(start, end);
+        let text = text.clone();
+        let dict = dict.cloned();
+        let job = WrapJob { text, iv, in_line, max_width, dict, strictness, result };
+        pool.jobs.send(job).expect("wrap workers exited");
+        results.push(rx);
+        start = end;
+        in_line = split;
+    }
+    let mut width_cache = WidthCache::new();
+    let mut ends = Vec::new();
+    for result in results {
+        let chunk = result.recv().expect("wrap worker panicked");
+        if chunk.in_line {
+            let dict = dict.map(|dict| dict.get());
+            let dict = dict.as_ref();
+            let width_cache = &mut width_cache;
+            join_chunk(
+                text,
+                task.start,
+                max_width,
+                dict,
+                strictness,
+                width_cache,
+                &mut ends,
+                chunk,
+            );
+        } else {
+            ends.extend_from_slice(&chunk.ends);
+        }
+    }
+    // The next task starts where this one ends.
+    while ends.len() > 1 {
+        let end = ends[ends.len() - 1];
+        if end == task.end
+            || is_line_start(text, end)
+            || LineBreakCursor::resume(text, end, strictness).is_some()
+        {
+            break;
+        }
+        ends.pop();
+    }
+    _t.set_payload_with(|| {
+        let end = ends.last().cloned().unwrap_or(task.start);
+        format!("{} bytes, {} lines", end - task.start, ends.len())
+    });
+    build_breaks(text, task.start, &ends)
+}
+
+/// The lines of a chunk of a task, wrapped on a worker thread.
+struct WrappedChunk {
+    /// The end of the chunk.
+    end: usize,
+    /// Whether the chunk starts in the middle of a line, so that its lines
+    /// start from a guess.
+    in_line: bool,
+    /// The offsets where the lines end, in order. The last line ends at or
+    /// past `end`, and at `text.len()` if it reaches EOF.
+    ends: Vec<usize>,
+}
+
+/// Wraps the lines in `iv` with monospace widths, from scratch. Unless
+/// `in_line`, `iv.start` must be a break.
+///
+/// If `in_line`, lines start where line breaking synchronizes, shortly after
+/// `iv.start`; if it doesn't within the leaf, no lines are wrapped.
+fn wrap_chunk(
+    text: &Rope,
+    iv: Interval,
+    in_line: bool,
+    max_width: f64,
+    dict: Option<&Dictionary>,
+    strictness: LineBreakStrictness,
+) -> WrappedChunk {
+    let mut _t = trace_block("Lines::wrap_chunk", &["core"]);
+    let mut chunk = WrappedChunk { end: iv.end, in_line, ends: Vec::new() };
+    let (start, lb_cursor) = if in_line {
+        match LineBreakCursor::sync(text, iv.start, strictness) {
+            Some(sync) => sync,
+            None => return chunk,
+        }
+    } else {
+        (iv.start, LineBreakCursor::at_break(text, iv.start, strictness))
+    };
+    let mut width_cache = WidthCache::new();
+    let width_cache = &mut width_cache;
+    let mut ctx =
+        RewrapCtx::new(text, &CodepointMono, max_width, width_cache, start, dict, strictness);
+    ctx.set_lb_cursor(lb_cursor);
+    // The last line may run past the end of the chunk, unless that is at a
+    // hard break.
+    if is_line_start(text, iv.end) {
+        ctx.end = iv.end;
+    }
+    let mut pos = start;
+    while pos < iv.end {
+        match ctx.wrap_one_line(pos) {
+            Some(next) => {
+                chunk.ends.push(next);
+                pos = next;
+            }
+            None => {
+                // EOF
+                chunk.ends.push(text.len());
+                break;
+            }
+        }
+    }
+    _t.set_payload_with(|| format!("{} bytes, {} lines", iv.size(), chunk.ends.len()));
+    chunk
+}
+
+/// Wraps on from the last of `ends`, or from `start` if there are none,
+/// adding lines, until one ends where one of `chunk`'s lines does, and then
+/// takes the rest of `chunk`'s lines. If none do, this wraps the whole chunk.
+fn join_chunk(
+    text: &Rope,
+    start: usize,
+    max_width: f64,
+    dict: Option<&Dictionary>,
+    strictness: LineBreakStrictness,
+    width_cache: &mut WidthCache,
+    ends: &mut Vec<usize>,
+    chunk: WrappedChunk,
+) {
+    // Line breaking can resume at almost any break.
+    let (mut pos, lb_cursor) = loop {
+        match ends.last() {
+            Some(&pos) => match LineBreakCursor::resume(text, pos, strictness) {
+                Some(lb_cursor) => break (pos, lb_cursor),
+                None => ends.pop(),
+            },
+            None => break (start, LineBreakCursor::at_break(text, start, strictness)),
+        };
+    };
+    if pos >= chunk.end {
+        return;
+    }
+    let mut ctx =
+        RewrapCtx::new(text, &CodepointMono, max_width, width_cache, pos, dict, strictness);
+    ctx.set_lb_cursor(lb_cursor);
+    ctx.batch_len = MIN_POT_BREAKS;
+    let mut i = 0;
+    while pos < chunk.end {
+        match ctx.wrap_one_line(pos) {
+            Some(next) => {
+                ends.push(next);
+                pos = next;
+                while chunk.ends.get(i).map(|&end| end < next).unwrap_or(false) {
+                    i += 1;
+                }
+                if chunk.ends.get(i) == Some(&next) {
+                    ends.extend_from_slice(&chunk.ends[i + 1..]);
+                    return;
+                }
+            }
+            None => {
+                // EOF
+                ends.push(text.len());
+                return;
+            }
+        }
+    }
+}
+
+/// Whether `offset` is at the start of a line, or at EOF.
+fn is_line_start(text: &Rope, offset: usize) -> bool {
+    offset == text.len() || text.offset_of_line(text.line_of_offset(offset)) == offset
+}
+
+/// Builds the breaks for lines from `start` that end at `ends`.
+fn build_breaks(text: &Rope, start: usize, ends: &[usize]) -> Breaks {
+    let mut lines = Cursor::new(text, start);
+    let mut next_hard = lines.next::<LinesMetric>();
+    let mut builder = BreakBuilder::new();
+    let mut pos = start;
+    for &next in ends {
+        while next_hard.map(|hard| hard < next).unwrap_or(false) {
+            next_hard = lines.next::<LinesMetric>();
+        }
+        if next_hard == Some(next) || next == text.len() {
+            builder.add_no_break(next - pos);
+        } else {
+            builder.add_break(next - pos);
+        }
+        pos = next;
+    }
+    builder.build()
+}
+
+/// The text and breaks from before an edit, and the edit's extent: `iv` in
+/// the old text was replaced by `new_len` bytes.
+struct EditedLines<'a> {
+    text: &'a Rope,
+    breaks: &'a Breaks,
+    iv: Interval,
+    new_len: usize,
+}
+
 /// A potential opportunity to insert a break. In this representation, the widths
 /// have been requested (in a batch request) but are not necessarily known until
 /// the request is issued.
@@ -469,6 +1006,7 @@ struct PotentialBreak {
 /// State for a rewrap in progress
 struct RewrapCtx<'a> {
     text: &'a Rope,
+    dict: Option<&'a Dictionary<'a>>,
     lb_cursor: LineBreakCursor<'a>,
     lb_cursor_pos: usize,
     width_cache: &'a mut WidthCache,
@@ -477,12 +1015,22 @@ struct RewrapCtx<'a> {
     /// Index within `pot_breaks`
     pot_break_ix: usize,
     max_width: f64,
+    /// Potential breaks are not gathered past this offset, other than to
+    /// finish a leaf.
+    end: usize,
+    /// The number of potential breaks to gather next. This doubles with each
+    /// batch, up to `MAX_POT_BREAKS`.
+    batch_len: usize,
 }
 
 // This constant should be tuned so that the RPC takes about 1ms. Less than that,
 // RPC overhead becomes significant. More than that, interactivity suffers.
 const MAX_POT_BREAKS: usize = 10_000;
 
+/// The first batch of potential breaks gathered when rewrapping around an
+/// edit, which usually changes only a few lines.
+const MIN_POT_BREAKS: usize = 100;
+
 impl<'a> RewrapCtx<'a> {
     fn new(
         text: &'a Rope,
@@ -491,11 +1039,14 @@ impl<'a> RewrapCtx<'a> {
         max_width: f64,
         width_cache: &'a mut WidthCache,
         start: usize,
+        dict: Option<&'a Dictionary<'a>>,
+        strictness: LineBreakStrictness,
     ) -> RewrapCtx<'a> {
         let lb_cursor_pos = start;
-        let lb_cursor = LineBreakCursor::new(text, start);
+        let lb_cursor = LineBreakCursor::new(text, start, strictness).with_sa(dict);
         RewrapCtx {
             text,
+            dict,
             lb_cursor,
             lb_cursor_pos,
             width_cache,
@@ -503,24 +1054,76 @@ impl<'a> RewrapCtx<'a> {
             pot_breaks: Vec::new(),
             pot_break_ix: 0,
             max_width,
+            end: text.len(),
+            batch_len: MAX_POT_BREAKS,
         }
     }
 
+    /// Replaces the cursor made by `new`, which must start at the same
+    /// offset.
+    fn set_lb_cursor(&mut self, lb_cursor: LineBreakCursor<'a>) {
+        self.lb_cursor = lb_cursor.with_sa(self.dict);
+    }
+
     fn refill_pot_breaks(&mut self) {
+        let mut _t = trace_block("RewrapCtx::refill_pot_breaks", &["core"]);
+        // Timings and cache stats are only taken when tracing.
+        let tracing = _t.is_enabled();
+        let stats = if tracing { Some(self.width_cache.stats()) } else { None };
+        let mut lb_time = Duration::default();
+        let mut n_leaves = 0;
+        let mut n_spanning = 0;
         let mut req = self.width_cache.batch_req();
 
         self.pot_breaks.clear();
         self.pot_break_ix = 0;
-        let mut pos = self.lb_cursor_pos;
-        while pos < self.text.len() && self.pot_breaks.len() < MAX_POT_BREAKS {
-            let (next, hard) = self.lb_cursor.next();
-            let word = self.text.slice_to_cow(pos..next);
-            let tok = req.request(N_RESERVED_STYLES, &word);
-            pos = next;
-            self.pot_breaks.push(PotentialBreak { pos, tok, hard });
+        let start = self.lb_cursor_pos;
+        let mut pos = start;
+        // Breaks come a leaf at a time, so this may overshoot the batch by up
+        // to a leaf's worth.
+        while pos < self.end && self.pot_breaks.len() < self.batch_len {
+            let lb_start = if tracing { Some(Instant::now()) } else { None };
+            let batch = self.lb_cursor.next_batch();
+            if let Some(lb_start) = lb_start {
+                lb_time += lb_start.elapsed();
+            }
+            n_leaves += 1;
+            for i in 0..batch.len() {
+                let (next, hard) = batch.get(i);
+                // Words are borrowed from the leaf, unless they span leaves.
+                let word = if pos >= batch.base {
+                    Cow::Borrowed(&batch.leaf[pos - batch.base..next - batch.base])
+                } else {
+                    n_spanning += 1;
+                    self.text.slice_to_cow(pos..next)
+                };
+                let tok = req.request(N_RESERVED_STYLES, &word);
+                pos = next;
+                self.pot_breaks.push(PotentialBreak { pos, tok, hard });
+            }
         }
         req.resolve_pending(self.client).unwrap();
         self.lb_cursor_pos = pos;
+        self.batch_len = (self.batch_len * 2).min(MAX_POT_BREAKS);
+
+        let n_breaks = self.pot_breaks.len();
+        let width_cache = &self.width_cache;
+        _t.set_payload_with(|| {
+            let before = stats.unwrap_or_default();
+            let after = width_cache.stats();
+            format!(
+                "{} bytes, {} breaks, {} leaves ({} words spanning leaves), \
+                 line breaking {}us; width cache {} hits, {} misses ({} local)",
+                pos - start,
+                n_breaks,
+                n_leaves,
+                n_spanning,
+                lb_time.as_micros(),
+                after.hits - before.hits,
+                after.misses - before.misses,
+                after.local - before.local,
+            )
+        });
     }
 
     /// Compute the next break, assuming `start` is a valid break.
@@ -563,39 +1166,272 @@ impl<'a> RewrapCtx<'a> {
     }
 }
 
+/// The breaks found in one leaf by `LineBreakCursor::next_batch`.
+#[derive(Default)]
+struct BreakBatch<'a> {
+    /// The offset of the leaf within the text.
+    base: usize,
+    /// The leaf, which contains all of the breaks.
+    leaf: &'a str,
+    /// Break offsets, relative to `base`.
+    offsets: Vec<u32>,
+    /// Bitmap of hard breaks, indexed as `offsets`.
+    hard: Vec<u64>,
+}
+
+impl<'a> BreakBatch<'a> {
+    fn len(&self) -> usize {
+        self.offsets.len()
+    }
+
+    /// The position of the `i`th break, and whether it is hard.
+    fn get(&self, i: usize) -> (usize, bool) {
+        (self.base + self.offsets[i] as usize, self.hard[i / 64] & (1 << (i % 64)) != 0)
+    }
+
+    fn clear(&mut self) {
+        self.offsets.clear();
+        self.hard.clear();
+    }
+
+    /// Adds the soft breaks at `soft`, which are relative to `base`, in
+    /// order, and not already breaks.
+    fn add_soft(&mut self, soft: &[usize]) {
+        let n = self.len() + soft.len();
+        let mut offsets = Vec::with_capacity(n);
+        let mut hard = vec![0u64; (n + 63) / 64];
+        let mut j = 0;
+        for i in 0..self.len() {
+            let offset = self.offsets[i] as usize;
+            while j < soft.len() && soft[j] < offset {
+                offsets.push(soft[j] as u32);
+                j += 1;
+            }
+            if self.hard[i / 64] & (1 << (i % 64)) != 0 {
+                let k = offsets.len();
+                hard[k / 64] |= 1 << (k % 64);
+            }
+            offsets.push(offset as u32);
+        }
+        offsets.extend(soft[j..].iter().map(|&offset| offset as u32));
+        self.offsets = offsets;
+        self.hard = hard;
+    }
+}
+
+/// How far `SaBreaks` looks before and after a leaf for the rest of an SA
+/// run. Runs are rarely longer than a sentence; past this, they are
+/// segmented in pieces.
+const MAX_SA_CONTEXT: usize = 4096;
+
+/// Finds the breaks within runs of SA (complex context) text, such as Thai,
+/// with a dictionary, for `LineBreakCursor`; `LineBreakLeafIter` finds none.
+struct SaBreaks<'a> {
+    text: &'a Rope,
+    dict: &'a Dictionary<'a>,
+    segmenter: SaSegmenter,
+    /// The offset the cursor started at; breaks are only found after it.
+    start: usize,
+    /// The text before this offset has been segmented.
+    done: usize,
+    /// Breaks found past the end of the leaf, in runs that continue into
+    /// the next leaves.
+    found: VecDeque<usize>,
+    /// Scratch space for the breaks in a run.
+    run_breaks: Vec<usize>,
+}
+
+impl<'a> SaBreaks<'a> {
+    fn new(text: &'a Rope, dict: &'a Dictionary<'a>, start: usize) -> SaBreaks<'a> {
+        SaBreaks {
+            text,
+            dict,
+            segmenter: SaSegmenter::default(),
+            start,
+            done: start,
+            found: VecDeque::new(),
+            run_breaks: Vec::new(),
+        }
+    }
+
+    /// Appends the breaks within SA runs in `leaf`, at `base` in the text,
+    /// to `out`, relative to `base`. Leaves must be passed in order.
+    fn leaf_breaks(&mut self, leaf: &str, base: usize, out: &mut Vec<usize>) {
+        let end = base + leaf.len();
+        while let Some(&bk) = self.found.front() {
+            if bk >= end {
+                break;
+            }
+            out.push(bk - base);
+            self.found.pop_front();
+        }
+        if self.done >= end {
+            return;
+        }
+        let mut ix = self.done.max(base) - base;
+        while let Some(run) = sa_run(leaf, ix) {
+            let mut run_start = base + run.start;
+            let mut run_end = base + run.end;
+            // The run may start before the cursor, or continue past the leaf.
+            if run_start == self.start && run_start > 0 {
+                let lo = run_start.saturating_sub(MAX_SA_CONTEXT);
+                let lo = self.text.at_or_prev_codepoint_boundary(lo).unwrap_or(0);
+                let before = self.text.slice_to_cow(lo..run_start);
+                run_start = lo + sa_run_start(&before, before.len());
+            }
+            let mut cut = false;
+            if run.end == leaf.len() && run_end < self.text.len() {
+                let hi = (run_end + MAX_SA_CONTEXT).min(self.text.len());
+                let hi = self.text.at_or_prev_codepoint_boundary(hi).unwrap_or(run_end);
+                let after = self.text.slice_to_cow(run_end..hi);
+                if let Some(rest) = sa_run(&after, 0).filter(|rest| rest.start == 0) {
+                    run_end += rest.end;
+                    cut = run_end == hi && hi < self.text.len();
+                }
+            }
+            let run_text = self.text.slice_to_cow(run_start..run_end);
+            self.run_breaks.clear();
+            self.segmenter.segment(self.dict, &run_text, run_start, &mut self.run_breaks);
+            // If the run may go on, the last word found may too, so carry on
+            // from the last break, as `SaSegmenter` does between windows.
+            if cut {
+                if let Some(&last) = self.run_breaks.last() {
+                    run_end = last;
+                }
+            }
+            for &bk in &self.run_breaks {
+                if bk <= self.start {
+                    continue;
+                } else if bk < end {
+                    out.push(bk - base);
+                } else {
+                    self.found.push_back(bk);
+                }
+            }
+            self.done = run_end;
+            if run_end >= end {
+                return;
+            }
+            ix = run_end - base;
+        }
+        self.done = end;
+    }
+}
+
 struct LineBreakCursor<'a> {
     inner: Cursor<'a, RopeInfo>,
     lb_iter: LineBreakLeafIter,
     last_byte: u8,
+    batch: BreakBatch<'a>,
+    sa: Option<SaBreaks<'a>>,
+    /// Scratch space for the breaks from `sa`.
+    sa_breaks: Vec<usize>,
 }
 
 impl<'a> LineBreakCursor<'a> {
-    fn new(text: &'a Rope, pos: usize) -> LineBreakCursor<'a> {
+    fn new(text: &'a Rope, pos: usize, strictness: LineBreakStrictness) -> LineBreakCursor<'a> {
         let inner = Cursor::new(text, pos);
         let lb_iter = match inner.get_leaf() {
-            Some((s, offset)) => LineBreakLeafIter::new(s.as_str(), offset),
+            Some((s, offset)) => LineBreakLeafIter::with_strictness(s.as_str(), offset, strictness),
             _ => LineBreakLeafIter::default(),
         };
-        LineBreakCursor { inner, lb_iter, last_byte: 0 }
+        LineBreakCursor::from_parts(inner, lb_iter)
+    }
+
+    fn from_parts(inner: Cursor<'a, RopeInfo>, lb_iter: LineBreakLeafIter) -> Self {
+        let batch = BreakBatch::default();
+        LineBreakCursor { inner, lb_iter, last_byte: 0, batch, sa: None, sa_breaks: Vec::new() }
     }
 
-    // position and whether break is hard; up to caller to stop calling after EOT
-    fn next(&mut self) -> (usize, bool) {
+    /// Also breaks within runs of SA text, using `dict`, if there is one.
+    fn with_sa(mut self, dict: Option<&'a Dictionary<'a>>) -> Self {
+        let pos = self.inner.pos();
+        self.sa = dict.map(|dict| SaBreaks::new(self.inner.root(), dict, pos));
+        self
+    }
+
+    /// Like `new`, but `pos` must be a break found earlier with the same
+    /// `strictness`, and the breaks after it are found without look-behind.
+    /// See `LineBreakLeafIter::resume`.
+    fn resume(
+        text: &'a Rope,
+        pos: usize,
+        strictness: LineBreakStrictness,
+    ) -> Option<LineBreakCursor<'a>> {
+        let inner = Cursor::new(text, pos);
+        let lb_iter = match inner.get_leaf() {
+            Some((s, offset)) => LineBreakLeafIter::resume(s.as_str(), offset, strictness)?,
+            _ => LineBreakLeafIter::default(),
+        };
+        Some(LineBreakCursor::from_parts(inner, lb_iter))
+    }
+
+    /// Resumes at `pos`, a break, where possible, and otherwise starts
+    /// there as `new` does.
+    fn at_break(
+        text: &'a Rope,
+        pos: usize,
+        strictness: LineBreakStrictness,
+    ) -> LineBreakCursor<'a> {
+        LineBreakCursor::resume(text, pos, strictness)
+            .unwrap_or_else(|| LineBreakCursor::new(text, pos, strictness))
+    }
+
+    /// Starts at `pos`, anywhere, without look-behind. Returns the offset
+    /// from which the breaks are exact, and the cursor from there; see
+    /// `LineBreakLeafIter::sync`. Returns `None` if that isn't in the leaf.
+    fn sync(
+        text: &'a Rope,
+        pos: usize,
+        strictness: LineBreakStrictness,
+    ) -> Option<(usize, LineBreakCursor<'a>)> {
+        let mut inner = Cursor::new(text, pos);
+        let (leaf, offset) = inner.get_leaf()?;
+        let (sync, lb_iter) = LineBreakLeafIter::sync(leaf.as_str(), offset, strictness)?;
+        let pos = pos - offset + sync;
+        inner.set(pos);
+        Some((pos, LineBreakCursor::from_parts(inner, lb_iter)))
+    }
+
+    /// Returns the breaks up to the end of the next leaf that has any, all
+    /// at once. At EOT, returns just the final break; up to caller to stop
+    /// calling after that.
+    fn next_batch(&mut self) -> &BreakBatch<'a> {
+        self.batch.clear();
         let mut leaf = self.inner.get_leaf();
         loop {
             match leaf {
                 Some((s, offset)) => {
-                    let (next, hard) = self.lb_iter.next(s.as_str());
-                    if next < s.len() {
-                        return (self.inner.pos() - offset + next, hard);
+                    self.lb_iter.next_all(
+                        s.as_str(),
+                        &mut self.batch.offsets,
+                        &mut self.batch.hard,
+                    );
+                    self.batch.base = self.inner.pos() - offset;
+                    self.batch.leaf = s.as_str();
+                    if let Some(sa) = self.sa.as_mut() {
+                        self.sa_breaks.clear();
+                        sa.leaf_breaks(s.as_str(), self.batch.base, &mut self.sa_breaks);
+                        if !self.sa_breaks.is_empty() {
+                            self.batch.add_soft(&self.sa_breaks);
+                        }
                     }
                     if !s.is_empty() {
                         self.last_byte = s.as_bytes()[s.len() - 1];
                     }
                     leaf = self.inner.next_leaf();
+                    if self.batch.len() > 0 {
+                        return &self.batch;
+                    }
+                }
+                None => {
+                    // A little hacky but only reports last break as hard if final newline
+                    self.batch.base = self.inner.pos();
+                    self.batch.leaf = "";
+                    self.batch.offsets.push(0);
+                    self.batch.hard.push((self.last_byte == b'\n') as u64);
+                    return &self.batch;
                 }
-                // A little hacky but only reports last break as hard if final newline
-                None => return (self.inner.pos(), self.last_byte == b'\n'),
             }
         }
     }
@@ -778,6 +1614,7 @@ mod tests {
     use super::*;
     use std::borrow::Cow;
     use std::iter;
+    use xi_rope::DeltaBuilder;
     use xi_rpc::test_utils::DummyPeer;
 
     fn make_lines(text: &Rope, width: f64) -> Lines {
@@ -1086,6 +1923,195 @@ mod tests {
         assert_eq!(breaks, vec![6, 12, 15, 18]);
     }
 
+    #[test]
+    fn strictness() {
+        use xi_unicode::LineBreakStrictness::*;
+        // Small kana and an iteration mark.
+        let text: Rope = "\u{4EBA}\u{3041}\u{4EBA}\u{3005}\u{4EBA}".into();
+        let client = Client::new(Box::new(DummyPeer));
+        // Each line holds one segment between breaks.
+        let wrap = |strictness| {
+            let mut lines = Lines::for_testing(&text, WrapWidth::Bytes(1));
+            lines.set_strictness(strictness);
+            lines.rewrap_all(&text, &client, &mut WidthCache::new());
+            render_breaks(&text, &lines)
+        };
+        assert_eq!(wrap(Strict), vec!["\u{4EBA}\u{3041}", "\u{4EBA}\u{3005}", "\u{4EBA}"]);
+        assert_eq!(wrap(Normal), vec!["\u{4EBA}", "\u{3041}", "\u{4EBA}\u{3005}", "\u{4EBA}"]);
+        assert_eq!(wrap(Loose), vec!["\u{4EBA}", "\u{3041}", "\u{4EBA}", "\u{3005}", "\u{4EBA}"]);
+    }
+
+    #[test]
+    fn parallel_matches_sequential() {
+        let para = "Now is the time for all good people\nto come to the aid\r\nof their \
+                    country.\u{2028}Averyveryverylongwordthatmustbebroken and\n\n a";
+        // Lines much longer than a chunk are split across workers.
+        let long_line = para.replace('\n', " ").repeat(40);
+        let marks =
+            "a\u{301}\u{200d} b\u{301}\u{301}(c)  \u{1f1e6}\u{1f1e8}\u{1f1e6}-9 ".repeat(60);
+        let pool = WrapPool::new(3);
+        for text in &[para.repeat(40), para.repeat(40) + "\n", "\n".repeat(5), long_line, marks] {
+            let text: Rope = text.as_str().into();
+            for &width in &[4., 10., 30.] {
+                let Lines { breaks: expected, .. } = make_lines(&text, width);
+                let mut breaks = Breaks::new_no_break(0);
+                while breaks.len() < text.len() {
+                    let task = Task::new(breaks.len(), text.len());
+                    let chunk = wrap_parallel(
+                        &text,
+                        task,
+                        width,
+                        None,
+                        LineBreakStrictness::Strict,
+                        &pool,
+                        40,
+                    );
+                    assert!(chunk.len() > 0);
+                    breaks = Breaks::concat(breaks, chunk);
+                }
+                let expected = Cursor::new(&expected, 0).iter::<BreaksMetric>().collect::<Vec<_>>();
+                let actual = Cursor::new(&breaks, 0).iter::<BreaksMetric>().collect::<Vec<_>>();
+                assert_eq!(expected, actual, "width {}", width);
+            }
+        }
+    }
+
+    #[test]
+    fn sa_breaks_with_dictionary() {
+        // "cat eats fish", in Thai, without spaces between the words.
+        let words = ["แมว", "กิน", "ปลา"];
+        let dict = Dictionary::from_words(words.iter().cloned());
+        let dict = Arc::new(WrapDictionary::Built(dict));
+        let client = Client::new(Box::new(DummyPeer));
+        let pool = WrapPool::new(3);
+        // The runs cross leaves, and the second is one run much longer than
+        // `SaBreaks` looks ahead.
+        let wrap = |text: &Rope| {
+            let mut lines = Lines::for_testing(text, WrapWidth::Bytes(3));
+            lines.dict = Some(dict.clone());
+            lines.rewrap_all(text, &client, &mut WidthCache::new());
+            lines
+        };
+        let texts = [("แมวกินปลา ", 500), ("แมวกินปลา", 1000)];
+        for &(unit, n) in &texts {
+            let text: Rope = unit.repeat(n).into();
+            let mut lines = wrap(&text);
+            let result = render_breaks(&text, &lines);
+            assert_eq!(result.len(), 3 * n);
+            for (i, line) in result.iter().enumerate() {
+                assert_eq!(line.trim_end(), words[i % 3], "line {}", i);
+            }
+
+            let mut breaks = Breaks::new_no_break(0);
+            while breaks.len() < text.len() {
+                let task = Task::new(breaks.len(), text.len());
+                let chunk = wrap_parallel(
+                    &text,
+                    task,
+                    3.,
+                    Some(&dict),
+                    LineBreakStrictness::Strict,
+                    &pool,
+                    400,
+                );
+                breaks = Breaks::concat(breaks, chunk);
+            }
+            let expected = Cursor::new(&lines.breaks, 0).iter::<BreaksMetric>().collect::<Vec<_>>();
+            let actual = Cursor::new(&breaks, 0).iter::<BreaksMetric>().collect::<Vec<_>>();
+            assert_eq!(expected, actual);
+
+            // Delete a word in the middle.
+            let start = unit.len() * n / 2 + 9;
+            let mut builder = DeltaBuilder::new(text.len());
+            builder.delete(start..start + 9);
+            let delta = builder.build();
+            let new_text = delta.apply(&text);
+            let mut width_cache = WidthCache::new();
+            lines.after_edit(&new_text, &text, &delta, &mut width_cache, &client, 0..10);
+            let expected = wrap(&new_text);
+            assert_eq!(render_breaks(&new_text, &lines), render_breaks(&new_text, &expected));
+        }
+    }
+
+    #[test]
+    fn wrap_dictionaries_shared() {
+        let words = ["แมว", "กิน", "ปลา"];
+        let dir = std::env::temp_dir();
+        let saved = dir.join(format!("xi-wrap-dict-{}.bin", std::process::id()));
+        let list = dir.join(format!("xi-wrap-dict-{}.txt", std::process::id()));
+        std::fs::write(&saved, Dictionary::from_words(words.iter().cloned()).as_bytes()).unwrap();
+        std::fs::write(&list, words.join("\n")).unwrap();
+        let mut dicts = WrapDictionaries::default();
+        let dict = dicts.get(&saved).unwrap();
+        assert!(matches!(*dict, WrapDictionary::Mapped(_)));
+        assert!(Arc::ptr_eq(&dict, &dicts.get(&saved).unwrap()));
+        assert!(words.iter().all(|word| dict.get().contains(word)));
+        drop(dict);
+        let dict = dicts.get(&list).unwrap();
+        assert!(matches!(*dict, WrapDictionary::Built(_)));
+        assert!(words.iter().all(|word| dict.get().contains(word)));
+        // Dictionaries which are no longer used are forgotten.
+        assert_eq!(dicts.loaded.len(), 1);
+        std::fs::remove_file(&saved).unwrap();
+        std::fs::remove_file(&list).unwrap();
+    }
+
+    #[test]
+    fn rewrap_around_edit() {
+        let client = Client::new(Box::new(DummyPeer));
+        let mut width_cache = WidthCache::new();
+        let para = "aaa bb cccc d eeeee ffffff g hh iii\u{301} jj ";
+        let mut text: Rope = format!("{}\n{}", para.repeat(40), para.repeat(4)).into();
+        let mut lines = make_lines(&text, 16.0);
+        let edits = [
+            (5, 7, "x"),
+            (100, 100, "longword "),
+            (0, 0, "z"),
+            (900, 901, ""),
+            (50, 300, "q r\ns "),
+            (40, 40, "\u{301}"),
+            (7, 12, "ee ee ee ee ee ee ee ee ee ee"),
+            (600, 1500, ""),
+        ];
+        for &(start, end, new) in edits.iter() {
+            let mut builder = DeltaBuilder::new(text.len());
+            builder.replace(start..end, new.into());
+            let delta = builder.build();
+            let new_text = delta.apply(&text);
+            let inval =
+                lines.after_edit(&new_text, &text, &delta, &mut width_cache, &client, 0..10);
+            let inval = inval.expect("minimal invalidation");
+            assert_eq!(render_breaks(&new_text, &lines), debug_breaks(&new_text, 16.0));
+
+            // The invalidation covers the changed lines.
+            let old_lines = render_breaks(&text, &make_lines(&text, 16.0));
+            let new_lines = render_breaks(&new_text, &lines);
+            let InvalLines { start_line, inval_count, new_count } = inval;
+            assert_eq!(old_lines[..start_line], new_lines[..start_line]);
+            assert_eq!(old_lines.len() - inval_count, new_lines.len() - new_count);
+            assert_eq!(
+                old_lines[start_line + inval_count.min(old_lines.len() - start_line)..],
+                new_lines[start_line + new_count.min(new_lines.len() - start_line)..]
+            );
+            text = new_text;
+        }
+
+        // Typing in a very long line only rewraps a few lines.
+        let mut text: Rope = para.repeat(10_000).into();
+        let mut lines = make_lines(&text, 16.0);
+        for i in 0..10 {
+            let mut builder = DeltaBuilder::new(text.len());
+            builder.replace(200_000 + i..200_000 + i, "k".into());
+            let delta = builder.build();
+            let new_text = delta.apply(&text);
+            let inval =
+                lines.after_edit(&new_text, &text, &delta, &mut width_cache, &client, 0..10);
+            assert!(inval.unwrap().inval_count < 10);
+            text = new_text;
+        }
+        assert_eq!(render_breaks(&text, &lines), debug_breaks(&text, 16.0));
+    }
+
     #[test]
     fn offset_to_line() {
         let text = "a b c d ".into();
@@ -20,6 +20,7 @@ use crate::line_offset::LineOffset;
 use crate::selection::{HorizPos, SelRegion, Selection};
 use crate::word_boundaries::WordCursor;
 use xi_rope::{Cursor, LinesMetric, Rope};
+use xi_unicode::GraphemeLeafIter;
 
 /// The specification of a movement.
 #[derive(Debug, PartialEq, Clone, Copy)]
@@ -167,6 +168,26 @@ fn scroll_height(height: usize) -> isize {
     max(height as isize - SCROLL_OVERLAP, 1)
 }
 
+/// Returns the grapheme cluster boundary after `offset`, which should be
+/// one, or `None` at the end of the text.
+fn next_grapheme_offset(text: &Rope, offset: usize) -> Option<usize> {
+    let mut cursor = Cursor::new(text, offset);
+    let (mut leaf, ix) = cursor.get_leaf()?;
+    let mut leaf_start = offset - ix;
+    let mut graphemes = GraphemeLeafIter::new(leaf, ix);
+    loop {
+        let next = graphemes.next(leaf);
+        if next < leaf.len() {
+            return Some(leaf_start + next);
+        }
+        leaf_start += leaf.len();
+        match cursor.next_leaf() {
+            Some((next_leaf, _)) => leaf = next_leaf,
+            None => return Some(leaf_start).filter(|&end| end > offset),
+        }
+    }
+}
+
 /// Compute the result of movement on one selection region.
 ///
 /// # Arguments
@@ -194,7 +215,7 @@ pub fn region_movement(
         }
         Movement::Right => {
             if r.is_caret() || modify {
-                if let Some(offset) = text.next_grapheme_offset(r.end) {
+                if let Some(offset) = next_grapheme_offset(text, r.end) {
                     (offset, None)
                 } else {
                     (r.end, r.horiz)
@@ -309,3 +330,25 @@ pub fn selection_movement(
     }
     result
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn next_grapheme_offset_matches_rope() {
+        // A with ring, hangul, regional indicators and an emoji ZWJ sequence,
+        // split across leaves.
+        let unit =
+            "A\u{030a}\u{110b}\u{1161}\u{1f1fa}\u{1f1f8}\u{1f1fa}\u{1f469}\u{200d}\u{1f52c}\r\n";
+        let text = Rope::from(unit.repeat(200));
+        let mut offset = 0;
+        while let Some(next) = text.next_grapheme_offset(offset) {
+            assert_eq!(next_grapheme_offset(&text, offset), Some(next), "at {}", offset);
+            offset = next;
+        }
+        assert_eq!(offset, text.len());
+        assert_eq!(next_grapheme_offset(&text, offset), None);
+        assert_eq!(next_grapheme_offset(&Rope::from(""), 0), None);
+    }
+}
@@ -204,6 +204,16 @@ pub enum CoreNotification {
     SaveTrace { destination: PathBuf, frontend_samples: Value },
     /// Tells `xi-core` to set the language id for the view.
     SetLanguage { view_id: ViewId, language_id: LanguageId },
+    /// Tells `xi-core` that the given style, or all styles if `id` is
+    /// omitted, is drawn in a fixed pitch font with the given advance
+    /// `width`. Core then computes most widths itself, rather than sending
+    /// `measure_width` requests. A `null` width reverts to measurement by
+    /// the client.
+    SetFixedPitch {
+        #[serde(default)]
+        id: Option<usize>,
+        width: Option<f64>,
+    },
 }
 
 /// The requests which make up the base of the protocol.
@@ -660,4 +670,21 @@ mod tests {
             assert_eq!(chars, message);
         }
     }
+
+    #[test]
+    fn test_deserialize_set_fixed_pitch() {
+        let json = json!({"method": "set_fixed_pitch", "params": {"width": 7.5}});
+        let cmd: CoreNotification = serde_json::from_value(json).unwrap();
+        match cmd {
+            CoreNotification::SetFixedPitch { id: None, width: Some(w) } => assert_eq!(w, 7.5),
+            _ => panic!("unexpected {:?}", cmd),
+        }
+
+        let json = json!({"method": "set_fixed_pitch", "params": {"id": 8, "width": null}});
+        let cmd: CoreNotification = serde_json::from_value(json).unwrap();
+        match cmd {
+            CoreNotification::SetFixedPitch { id: Some(8), width: None } => (),
+            _ => panic!("unexpected {:?}", cmd),
+        }
+    }
 }
@@ -41,6 +41,7 @@ use crate::editor::Editor;
 use crate::event_context::EventContext;
 use crate::file::FileManager;
 use crate::line_ending::LineEnding;
+use crate::linewrap::WrapDictionaries;
 use crate::plugin_rpc::{PluginNotification, PluginRequest};
 use crate::plugins::rpc::ClientPluginInfo;
 use crate::plugins::{start_plugin_process, Plugin, PluginCatalog, PluginPid};
@@ -110,6 +111,8 @@ pub struct CoreState {
     /// Theme and style state.
     style_map: RefCell<ThemeStyleMap>,
     width_cache: RefCell<WidthCache>,
+    /// Dictionaries for wrapping text without spaces, shared by views.
+    wrap_dictionaries: RefCell<WrapDictionaries>,
     /// User and platform specific settings
     config_manager: ConfigManager,
     /// Recorded editor actions
@@ -176,6 +179,7 @@ impl CoreState {
             kill_ring: RefCell::new(Rope::from("")),
             style_map: RefCell::new(ThemeStyleMap::new(themes_dir)),
             width_cache: RefCell::new(WidthCache::new()),
+            wrap_dictionaries: RefCell::new(WrapDictionaries::default()),
             config_manager,
             recorder: RefCell::new(Recorder::new()),
             self_ref: None,
@@ -296,6 +300,7 @@ impl CoreState {
                 client: &self.peer,
                 style_map: &self.style_map,
                 width_cache: &self.width_cache,
+                wrap_dictionaries: &self.wrap_dictionaries,
                 kill_ring: &self.kill_ring,
                 weak_core: self.self_ref.as_ref().unwrap(),
             }
@@ -317,6 +322,7 @@ impl CoreState {
             CloseView { view_id } => self.do_close_view(view_id),
             ModifyUserConfig { domain, changes } => self.do_modify_user_config(domain, changes),
             SetTheme { theme_name } => self.do_set_theme(&theme_name),
+            SetFixedPitch { id, width } => self.do_set_fixed_pitch(id, width),
             SaveTrace { destination, frontend_samples } => {
                 self.save_trace(&destination, frontend_samples)
             }
@@ -454,6 +460,11 @@ impl CoreState {
         self.notify_client_and_update_views();
     }
 
+    fn do_set_fixed_pitch(&self, id: Option<usize>, width: Option<f64>) {
+        self.width_cache.borrow_mut().set_fixed_pitch(id, width);
+        self.iter_groups().for_each(|mut edit_ctx| edit_ctx.widths_changed());
+    }
+
     fn notify_client_and_update_views(&self) {
         {
             let style_map = self.style_map.borrow();
@@ -22,10 +22,10 @@ use serde_json::Value;
 use crate::annotations::{AnnotationStore, Annotations, ToAnnotation};
 use crate::client::{Client, Update, UpdateOp};
 use crate::edit_types::ViewEvent;
-use crate::find::{Find, FindStatus};
+use crate::find::{update_finds, Find, FindStatus};
 use crate::line_cache_shadow::{self, LineCacheShadow, RenderPlan, RenderTactic};
 use crate::line_offset::LineOffset;
-use crate::linewrap::{InvalLines, Lines, VisualLine, WrapWidth};
+use crate::linewrap::{InvalLines, Lines, VisualLine, WrapDictionaries, WrapWidth};
 use crate::movement::{region_movement, selection_movement, Movement};
 use crate::plugins::PluginId;
 use crate::rpc::{FindQuery, GestureType, MouseAction, SelectionGranularity, SelectionModifier};
@@ -37,6 +37,7 @@ use crate::word_boundaries::WordCursor;
 use xi_rope::spans::Spans;
 use xi_rope::{Cursor, Interval, LinesMetric, Rope, RopeDelta};
 use xi_trace::trace_block;
+use xi_unicode::LineBreakStrictness;
 
 type StyleMap = RefCell<ThemeStyleMap>;
 
@@ -217,6 +218,18 @@ impl View {
         self.lines.set_wrap_width(text, wrap_width);
     }
 
+    /// Sets the dictionary file for wrapping text without spaces, such as
+    /// Thai; takes effect with the next `update_wrap_settings`.
+    pub(crate) fn set_wrap_dictionary(&mut self, path: &str, dicts: &mut WrapDictionaries) {
+        self.lines.set_wrap_dictionary(path, dicts);
+    }
+
+    /// Sets the tailoring of the line breaking rules for wrapping; takes
+    /// effect with the next `update_wrap_settings`.
+    pub(crate) fn set_line_break(&mut self, strictness: LineBreakStrictness) {
+        self.lines.set_strictness(strictness);
+    }
+
     pub(crate) fn needs_more_wrap(&self) -> bool {
         !self.lines.is_converged()
     }
@@ -995,8 +1008,10 @@ impl View {
         self.annotations.invalidate(iv);
 
         // update only find highlights affected by change
-        for find in &mut self.find {
-            find.update_highlights(text, delta);
+        let ranges: Vec<_> =
+            self.find.iter_mut().map(|find| find.invalidate_for_edit(text, delta)).collect();
+        update_finds(&mut self.find, text, &ranges, false);
+        if !self.find.is_empty() {
             self.find_changed = FindStatusChange::All;
         }
 
@@ -1130,16 +1145,20 @@ impl View {
         };
 
         if let Some((search_range_start, search_range_end)) = search_range {
-            for query in &mut self.find {
-                if !query.is_multiline_regex() {
-                    query.update_find(text, search_range_start, search_range_end, true);
-                } else {
+            let is_entire_text = search_range_start == 0 && search_range_end == text.len();
+            let ranges: Vec<_> = self
+                .find
+                .iter()
+                .map(|query| {
                     // only execute multi-line regex queries if we are searching the entire text (last step)
-                    if search_range_start == 0 && search_range_end == text.len() {
-                        query.update_find(text, search_range_start, search_range_end, true);
+                    if !query.is_multiline_regex() || is_entire_text {
+                        Some((search_range_start, search_range_end))
+                    } else {
+                        None
                     }
-                }
-            }
+                })
+                .collect();
+            update_finds(&mut self.find, text, &ranges, true);
         }
     }
 
@@ -16,6 +16,11 @@
 
 use std::borrow::Cow;
 use std::collections::{BTreeMap, HashMap};
+use std::hash::{BuildHasherDefault, Hasher};
+use std::mem;
+
+use xi_trace::trace_block;
+use xi_unicode::str_mono_width;
 
 use crate::client::Client;
 
@@ -30,16 +35,60 @@ type Width = f64;
 
 type StyleId = usize;
 
+/// The default memory budget of a `WidthCache`, in bytes.
+pub const DEFAULT_WIDTH_CACHE_BUDGET: usize = 8 << 20;
+
+/// The approximate memory used per cached item, besides its string.
+const ITEM_OVERHEAD: usize =
+    mem::size_of::<InternedKey>() + mem::size_of::<Width>() + mem::size_of::<(u64, Token)>();
+
+/// Measured strings are interned: their bytes are appended once to an arena,
+/// and looked up through a map from key hash to token. Neither hits nor
+/// misses allocate a key.
+///
+/// When the cache outgrows its budget, the least recently used items are
+/// evicted at the start of the next batch, which renumbers the tokens of the
+/// items that remain. Tokens are therefore only valid until the next call
+/// to `batch_req`.
 pub struct WidthCache {
-    /// maps cache key to index within widths
-    m: HashMap<WidthCacheKey<'static>, Token>,
+    /// maps the hash of a key to the most recent token with that hash
+    m: HashMap<u64, Token, BuildHasherDefault<KeyHasher>>,
+    /// interned keys, indexed by token
+    keys: Vec<InternedKey>,
+    /// the bytes of all interned strings
+    arena: String,
     widths: Vec<Width>,
+    /// The maximum memory use in bytes, if bounded.
+    budget: Option<usize>,
+    /// Counts calls to `batch_req`, for recency of use.
+    generation: u32,
+    stats: WidthCacheStats,
+    /// The advance widths of styles reported to use fixed pitch fonts. The
+    /// `None` key applies to all styles.
+    fixed_pitch: BTreeMap<Option<StyleId>, Width>,
 }
 
-#[derive(Eq, PartialEq, Hash)]
-struct WidthCacheKey<'a> {
+/// A (style, string) pair, with the string stored as a span of the arena.
+struct InternedKey {
     id: StyleId,
-    s: Cow<'a, str>,
+    start: u32,
+    len: u32,
+    /// The previous token with the same hash, if any.
+    next: Option<Token>,
+    /// The generation in which this item was last requested.
+    used: u32,
+}
+
+/// Counters describing the effectiveness and size of a `WidthCache`.
+#[derive(Clone, Copy, Debug, Default, PartialEq)]
+pub struct WidthCacheStats {
+    pub hits: u64,
+    pub misses: u64,
+    /// The misses that were measured locally, for fixed pitch styles.
+    pub local: u64,
+    pub evictions: u64,
+    /// The approximate memory used by the cached items, in bytes.
+    pub bytes: usize,
 }
 
 /// A batched request, so that a number of strings can be measured in a
@@ -47,18 +96,19 @@ struct WidthCacheKey<'a> {
 pub struct WidthBatchReq<'a> {
     cache: &'a mut WidthCache,
     pending_tok: Token,
-    req: Vec<WidthReq>,
+    /// Pending tokens already measured locally.
+    local: Vec<(Token, Width)>,
     req_toks: Vec<Vec<Token>>,
-    // maps style id to index into req/req_toks
+    // maps style id to index into req_toks
     req_ids: BTreeMap<StyleId, Token>,
 }
 
 /// A request for measuring the widths of strings all of the same style
 /// (a request from core to front-end).
 #[derive(Serialize, Deserialize)]
-pub struct WidthReq {
+pub struct WidthReq<'a> {
     pub id: StyleId,
-    pub strings: Vec<String>,
+    pub strings: Vec<Cow<'a, str>>,
 }
 
 /// The response for a batch of [`WidthReq`]s.
@@ -90,14 +140,104 @@ impl WidthMeasure for CodepointMono {
     }
 }
 
+/// Hashes a cache key, word at a time, in the manner of FxHash. Keys are
+/// mostly short words, for which SipHash is comparatively slow.
+fn hash_key(id: StyleId, s: &str) -> u64 {
+    const SEED: u64 = 0x51_7c_c1_b7_27_22_0a_95;
+    fn add(h: u64, word: u64) -> u64 {
+        (h.rotate_left(5) ^ word).wrapping_mul(SEED)
+    }
+    let mut h = add(0, id as u64);
+    let mut chunks = s.as_bytes().chunks_exact(8);
+    for chunk in &mut chunks {
+        let mut word = [0; 8];
+        word.copy_from_slice(chunk);
+        h = add(h, u64::from_le_bytes(word));
+    }
+    let mut tail = [0; 8];
+    let rest = chunks.remainder();
+    tail[..rest.len()].copy_from_slice(rest);
+    // Mixing in the length distinguishes strings differing in trailing NULs.
+    add(add(h, u64::from_le_bytes(tail)), s.len() as u64)
+}
+
+/// The keys of `WidthCache::m` are already hashes, so pass them through.
+#[derive(Default)]
+struct KeyHasher(u64);
+
+impl Hasher for KeyHasher {
+    fn finish(&self) -> u64 {
+        self.0
+    }
+
+    fn write(&mut self, bytes: &[u8]) {
+        for &b in bytes {
+            self.0 = (self.0 << 8) | u64::from(b);
+        }
+    }
+
+    fn write_u64(&mut self, n: u64) {
+        self.0 = n;
+    }
+}
+
 impl WidthCache {
+    /// Creates a cache bounded by `DEFAULT_WIDTH_CACHE_BUDGET`.
     pub fn new() -> WidthCache {
-        WidthCache { m: HashMap::new(), widths: Vec::new() }
+        WidthCache::with_budget(Some(DEFAULT_WIDTH_CACHE_BUDGET))
+    }
+
+    /// Creates a cache that uses about `budget` bytes at most, or is
+    /// unbounded if `budget` is `None`.
+    pub fn with_budget(budget: Option<usize>) -> WidthCache {
+        WidthCache {
+            m: HashMap::default(),
+            keys: Vec::new(),
+            arena: String::new(),
+            widths: Vec::new(),
+            budget,
+            generation: 0,
+            stats: WidthCacheStats::default(),
+            fixed_pitch: BTreeMap::new(),
+        }
+    }
+
+    /// Sets the advance width of a fixed pitch style, or of all styles if
+    /// `id` is `None`. Strings in fixed pitch styles are measured locally,
+    /// except for those containing tabs and emoji clusters. A `width` of
+    /// `None` reverts to measurement by the front-end.
+    ///
+    /// This clears the cache, invalidating all tokens.
+    pub fn set_fixed_pitch(&mut self, id: Option<StyleId>, width: Option<Width>) {
+        match width {
+            Some(width) => self.fixed_pitch.insert(id, width),
+            None => self.fixed_pitch.remove(&id),
+        };
+        self.clear();
+    }
+
+    /// Removes all items, invalidating all tokens. Settings are kept.
+    pub fn clear(&mut self) {
+        let fixed_pitch = mem::replace(&mut self.fixed_pitch, BTreeMap::new());
+        *self = WidthCache { fixed_pitch, ..WidthCache::with_budget(self.budget) };
+    }
+
+    fn local_width(&self, id: StyleId, s: &str) -> Option<Width> {
+        let advance = self.fixed_pitch.get(&Some(id)).or_else(|| self.fixed_pitch.get(&None))?;
+        str_mono_width(s).map(|cols| cols as Width * advance)
     }
 
     /// Returns the number of items currently in the cache.
     pub(crate) fn len(&self) -> usize {
-        self.m.len()
+        self.keys.len()
+    }
+
+    pub(crate) fn stats(&self) -> WidthCacheStats {
+        WidthCacheStats { bytes: self.bytes(), ..self.stats }
+    }
+
+    fn bytes(&self) -> usize {
+        self.arena.len() + self.keys.len() * ITEM_OVERHEAD
     }
 
     /// Resolve a previously obtained token into a width value.
@@ -106,40 +246,113 @@ impl WidthCache {
     }
 
     /// Create a new batch of requests.
+    ///
+    /// This may evict items, invalidating tokens from previous batches.
     pub fn batch_req(self: &mut WidthCache) -> WidthBatchReq {
+        if let Some(budget) = self.budget {
+            if self.bytes() > budget {
+                self.evict(budget / 2);
+            }
+        }
+        self.generation = self.generation.wrapping_add(1);
         let pending_tok = self.widths.len();
         WidthBatchReq {
             cache: self,
             pending_tok,
-            req: Vec::new(),
+            local: Vec::new(),
             req_toks: Vec::new(),
             req_ids: BTreeMap::new(),
         }
     }
+
+    fn key_str(&self, tok: Token) -> &str {
+        let key = &self.keys[tok];
+        &self.arena[key.start as usize..(key.start + key.len) as usize]
+    }
+
+    fn find(&self, hash: u64, id: StyleId, s: &str) -> Option<Token> {
+        let mut tok = self.m.get(&hash).cloned();
+        while let Some(t) = tok {
+            if self.keys[t].id == id && self.key_str(t) == s {
+                return Some(t);
+            }
+            tok = self.keys[t].next;
+        }
+        None
+    }
+
+    fn intern(&mut self, hash: u64, id: StyleId, s: &str) -> Token {
+        let tok = self.keys.len();
+        let start = self.arena.len() as u32;
+        self.arena.push_str(s);
+        let next = self.m.insert(hash, tok);
+        let used = self.generation;
+        self.keys.push(InternedKey { id, start, len: s.len() as u32, next, used });
+        tok
+    }
+
+    /// Evicts the least recently used items, until about `target` bytes
+    /// remain. Must not be called while a batch is pending.
+    fn evict(&mut self, target: usize) {
+        debug_assert_eq!(self.keys.len(), self.widths.len());
+        let generation = self.generation;
+        let mut order = (0..self.keys.len()).collect::<Vec<_>>();
+        // Generations wrap, so order by age rather than by generation.
+        order.sort_by_key(|&tok| generation.wrapping_sub(self.keys[tok].used));
+        let mut bytes = 0;
+        let n_keep = order
+            .iter()
+            .take_while(|&&tok| {
+                bytes += self.keys[tok].len as usize + ITEM_OVERHEAD;
+                bytes <= target
+            })
+            .count();
+        order.truncate(n_keep);
+        // Keep the survivors in their existing order, for locality.
+        order.sort_unstable();
+
+        let old_keys = mem::replace(&mut self.keys, Vec::with_capacity(n_keep));
+        let old_arena = mem::replace(&mut self.arena, String::with_capacity(bytes));
+        let old_widths = mem::replace(&mut self.widths, Vec::with_capacity(n_keep));
+        self.m.clear();
+        for tok in order {
+            let key = &old_keys[tok];
+            let s = &old_arena[key.start as usize..(key.start + key.len) as usize];
+            let new_tok = self.intern(hash_key(key.id, s), key.id, s);
+            self.keys[new_tok].used = key.used;
+            self.widths.push(old_widths[tok]);
+        }
+        let n_evicted = old_keys.len() - self.keys.len();
+        self.stats.evictions += n_evicted as u64;
+        debug!("evicted {} items from width cache, {} remain", n_evicted, self.keys.len());
+    }
 }
 
 impl<'a> WidthBatchReq<'a> {
     /// Request measurement of one string/style pair within the batch.
     pub fn request(&mut self, id: StyleId, s: &str) -> Token {
-        let key = WidthCacheKey { id, s: Cow::Borrowed(s) };
-        if let Some(tok) = self.cache.m.get(&key) {
-            return *tok;
+        let hash = hash_key(id, s);
+        if let Some(tok) = self.cache.find(hash, id, s) {
+            self.cache.keys[tok].used = self.cache.generation;
+            self.cache.stats.hits += 1;
+            return tok;
+        }
+        self.cache.stats.misses += 1;
+        if let Some(width) = self.cache.local_width(id, s) {
+            let tok = self.cache.intern(hash, id, s);
+            self.pending_tok += 1;
+            self.local.push((tok, width));
+            self.cache.stats.local += 1;
+            return tok;
         }
         // cache miss, add the request
-        let key = WidthCacheKey { id, s: Cow::Owned(s.to_owned()) };
-        let req = &mut self.req;
         let req_toks = &mut self.req_toks;
         let id_off = *self.req_ids.entry(id).or_insert_with(|| {
-            let id_off = req.len();
-            req.push(WidthReq { id, strings: Vec::new() });
             req_toks.push(Vec::new());
-            id_off
+            req_toks.len() - 1
         });
-        // To avoid this second clone, we could potentially do a tricky thing where
-        // we extract the strings from the WidthReq. Probably not worth it though.
-        req[id_off].strings.push(s.to_owned());
-        let tok = self.pending_tok;
-        self.cache.m.insert(key, tok);
+        let tok = self.cache.intern(hash, id, s);
+        debug_assert_eq!(tok, self.pending_tok);
         self.pending_tok += 1;
         req_toks[id_off].push(tok);
         tok
@@ -154,14 +367,171 @@ impl<'a> WidthBatchReq<'a> {
         // The 0.0 values should all get replaced with actual widths, assuming the
         // shape of the response from the front-end matches that of the request.
         if self.pending_tok > self.cache.widths.len() {
-            self.cache.widths.resize(self.pending_tok, 0.0);
-            let widths = handler.measure_width(&self.req)?;
-            for (w, t) in widths.iter().zip(self.req_toks.iter()) {
-                for (width, tok) in w.iter().zip(t.iter()) {
-                    self.cache.widths[*tok] = *width;
+            let mut _t = trace_block("WidthBatchReq::resolve_pending", &["core"]);
+            let n_new = self.pending_tok - self.cache.widths.len();
+            let n_local = self.local.len();
+            _t.set_payload_with(|| format!("{} new widths, {} measured locally", n_new, n_local));
+            let cache = &mut *self.cache;
+            let req_toks = &self.req_toks;
+            cache.widths.resize(self.pending_tok, 0.0);
+            for &(tok, width) in &self.local {
+                cache.widths[tok] = width;
+            }
+            if self.req_ids.is_empty() {
+                return Ok(());
+            }
+            // The request borrows the strings from the arena.
+            let req = self
+                .req_ids
+                .iter()
+                .map(|(&id, &id_off)| WidthReq {
+                    id,
+                    strings: req_toks[id_off]
+                        .iter()
+                        .map(|&tok| Cow::Borrowed(cache.key_str(tok)))
+                        .collect(),
+                })
+                .collect::<Vec<_>>();
+            let widths = {
+                // The duration of this block is the round trip to the front-end.
+                let mut _t = trace_block("WidthMeasure::measure_width", &["core"]);
+                _t.set_payload_with(|| {
+                    let n_strings = req.iter().map(|r| r.strings.len()).sum::<usize>();
+                    let n_bytes =
+                        req.iter().flat_map(|r| r.strings.iter()).map(|s| s.len()).sum::<usize>();
+                    format!("{} strings, {} bytes", n_strings, n_bytes)
+                });
+                handler.measure_width(&req)?
+            };
+            for (w, &id_off) in widths.iter().zip(self.req_ids.values()) {
+                for (width, tok) in w.iter().zip(req_toks[id_off].iter()) {
+                    cache.widths[*tok] = *width;
                 }
             }
         }
         Ok(())
     }
 }
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn interned_keys() {
+        let mut cache = WidthCache::new();
+        let (a, b, c, d) = {
+            let mut req = cache.batch_req();
+            let a = req.request(0, "hello");
+            let b = req.request(0, "hello world, a longer string");
+            let c = req.request(1, "hello");
+            let d = req.request(0, "hello");
+            req.resolve_pending(&CodepointMono).unwrap();
+            (a, b, c, d)
+        };
+        assert_eq!(a, d);
+        assert_ne!(a, c);
+        assert_eq!(cache.len(), 3);
+        assert_eq!(cache.resolve(a), 5.0);
+        assert_eq!(cache.resolve(b), 28.0);
+        assert_eq!(cache.resolve(c), 5.0);
+
+        // Hits in a later batch resolve without a new request.
+        let mut req = cache.batch_req();
+        assert_eq!(req.request(0, "hello world, a longer string"), b);
+        let e = req.request(0, "");
+        let f = req.request(0, "\0");
+        assert_ne!(e, f);
+        req.resolve_pending(&CodepointMono).unwrap();
+        assert_eq!(cache.len(), 5);
+        assert_eq!(cache.resolve(e), 0.0);
+        assert_eq!(cache.resolve(f), 1.0);
+    }
+
+    #[test]
+    fn hash_collisions() {
+        // All keys collide, so lookups walk the chain.
+        let mut cache = WidthCache::new();
+        let toks = ["a", "bb", "ccc"].iter().map(|s| cache.intern(0, 0, s)).collect::<Vec<_>>();
+        assert_eq!(cache.find(0, 0, "a"), Some(toks[0]));
+        assert_eq!(cache.find(0, 0, "bb"), Some(toks[1]));
+        assert_eq!(cache.find(0, 0, "ccc"), Some(toks[2]));
+        assert_eq!(cache.find(0, 0, "d"), None);
+        assert_eq!(cache.find(0, 1, "a"), None);
+    }
+
+    #[test]
+    fn eviction() {
+        let words = (0..1000).map(|i| format!("word{}", i)).collect::<Vec<_>>();
+        let budget = 100 * (ITEM_OVERHEAD + 7);
+        let mut cache = WidthCache::with_budget(Some(budget));
+        for chunk in words.chunks(50) {
+            let mut req = cache.batch_req();
+            // "word0" is used in every batch, so is never evicted.
+            let hot = req.request(0, "word0");
+            let toks = chunk.iter().map(|w| req.request(0, w)).collect::<Vec<_>>();
+            req.resolve_pending(&CodepointMono).unwrap();
+            // Tokens from the current batch stay valid.
+            assert_eq!(cache.resolve(hot), 5.0);
+            for (w, &tok) in chunk.iter().zip(toks.iter()) {
+                assert_eq!(cache.resolve(tok), w.len() as f64);
+            }
+            assert!(cache.stats().bytes <= budget + 50 * (ITEM_OVERHEAD + 7));
+        }
+        let stats = cache.stats();
+        assert_eq!(stats.misses, 1000);
+        assert_eq!(stats.hits, 20);
+        assert_eq!(stats.evictions as usize, 1000 - cache.len());
+        assert!(stats.evictions > 0);
+
+        let mut req = cache.batch_req();
+        req.request(0, "word0");
+        req.request(0, "word999");
+        assert_eq!(cache.stats().hits, 22);
+    }
+
+    /// Fails the test if asked to measure anything.
+    struct NoMeasure;
+
+    impl WidthMeasure for NoMeasure {
+        fn measure_width(&self, request: &[WidthReq]) -> Result<WidthResponse, xi_rpc::Error> {
+            panic!("unexpected request for {:?}", request[0].strings);
+        }
+    }
+
+    #[test]
+    fn fixed_pitch() {
+        let mut cache = WidthCache::new();
+        cache.set_fixed_pitch(None, Some(8.0));
+        cache.set_fixed_pitch(Some(1), Some(10.0));
+        let mut req = cache.batch_req();
+        let a = req.request(0, "hello ");
+        let b = req.request(0, "\u{4E16}\u{754C}\n");
+        let c = req.request(1, "hello ");
+        req.resolve_pending(&NoMeasure).unwrap();
+        assert_eq!(cache.resolve(a), 48.0);
+        assert_eq!(cache.resolve(b), 32.0);
+        assert_eq!(cache.resolve(c), 60.0);
+
+        // Tabs and emoji clusters still go to the front-end.
+        let mut req = cache.batch_req();
+        let a = req.request(0, "hello ");
+        let d = req.request(0, "a\tb");
+        let e = req.request(0, "\u{1F44D}\u{1F3FD}");
+        req.resolve_pending(&CodepointMono).unwrap();
+        assert_eq!(cache.resolve(a), 48.0);
+        assert_eq!(cache.resolve(d), 3.0);
+        assert_eq!(cache.resolve(e), 2.0);
+        let stats = cache.stats();
+        assert_eq!((stats.hits, stats.misses, stats.local), (1, 5, 3));
+
+        cache.set_fixed_pitch(None, None);
+        assert_eq!(cache.len(), 0);
+        let mut req = cache.batch_req();
+        let b = req.request(0, "\u{4E16}\u{754C}\n");
+        let c = req.request(1, "hello ");
+        req.resolve_pending(&CodepointMono).unwrap();
+        assert_eq!(cache.resolve(b), 3.0);
+        assert_eq!(cache.resolve(c), 60.0);
+    }
+}
@@ -83,6 +83,33 @@ fn ne_idx_avx(b: &mut Bencher) {
     })
 }
 
+#[bench]
+#[cfg(target_arch = "x86_64")]
+fn ne_idx_avx512(b: &mut Bencher) {
+    if !is_x86_feature_detected!("avx512bw") {
+        return;
+    }
+    let (one, two) = make_test_data();
+
+    let mut dont_opt_me = 0;
+    b.iter(|| {
+        dont_opt_me += unsafe { compare::ne_idx_avx512(&one, &two).unwrap_or_default() };
+        dont_opt_me += unsafe { compare::ne_idx_avx512(&one, &one).unwrap_or_default() };
+    })
+}
+
+#[bench]
+#[cfg(target_arch = "aarch64")]
+fn ne_idx_neon(b: &mut Bencher) {
+    let (one, two) = make_test_data();
+
+    let mut dont_opt_me = 0;
+    b.iter(|| {
+        dont_opt_me += unsafe { compare::ne_idx_neon(&one, &two).unwrap_or_default() };
+        dont_opt_me += unsafe { compare::ne_idx_neon(&one, &one).unwrap_or_default() };
+    })
+}
+
 #[bench]
 fn ne_idx_detect(b: &mut Bencher) {
     let (one, two) = make_test_data();
@@ -119,6 +146,42 @@ fn ne_idx_rev_sse(b: &mut Bencher) {
     })
 }
 
+#[bench]
+#[cfg(target_arch = "x86_64")]
+fn ne_idx_rev_avx512(b: &mut Bencher) {
+    if !is_x86_feature_detected!("avx512bw") {
+        return;
+    }
+    let (one, two) = make_test_data();
+
+    b.iter(|| unsafe {
+        compare::ne_idx_rev_avx512(&one, &one);
+        compare::ne_idx_rev_avx512(&one, &two);
+    })
+}
+
+#[bench]
+#[cfg(target_arch = "aarch64")]
+fn ne_idx_rev_neon(b: &mut Bencher) {
+    let (one, two) = make_test_data();
+
+    b.iter(|| unsafe {
+        compare::ne_idx_rev_neon(&one, &one);
+        compare::ne_idx_rev_neon(&one, &two);
+    })
+}
+
+#[bench]
+fn ne_idx_rev_detect(b: &mut Bencher) {
+    let (one, two) = make_test_data();
+
+    let mut dont_opt_me = 0;
+    b.iter(|| {
+        dont_opt_me += compare::ne_idx_rev(&one, &two).unwrap_or_default();
+        dont_opt_me += compare::ne_idx_rev(&one, &one).unwrap_or_default();
+    })
+}
+
 #[bench]
 fn scanner(b: &mut Bencher) {
     let (one, two) = make_test_data();
@@ -132,6 +195,65 @@ fn scanner(b: &mut Bencher) {
     })
 }
 
+/// A document of about 8MB, as after a checkout, and a copy with a line
+/// in the middle changed.
+fn make_big_ropes() -> (Rope, Rope) {
+    let one = [EDITOR_STR, VIEW_STR, INTERVAL_STR, BREAKS_STR].concat().repeat(32);
+    let mid = one.len() / 2;
+    let mid = mid + one[mid..].find('\n').unwrap() + 1;
+    let two = [&one[..mid], "    // changed on another branch\n", &one[mid..]].concat();
+    (Rope::from(one), Rope::from(two))
+}
+
+#[bench]
+fn find_min_diff_range_big(b: &mut Bencher) {
+    let (one, two) = make_big_ropes();
+
+    let mut scanner = compare::RopeScanner::new(&one, &two);
+    b.bytes = one.len() as u64;
+    b.iter(|| scanner.find_min_diff_range())
+}
+
+#[bench]
+fn find_min_diff_range_big_same(b: &mut Bencher) {
+    let (one, _) = make_big_ropes();
+    // A separate copy, rather than a clone sharing the leaves.
+    let two = Rope::from(String::from(&one));
+
+    let mut scanner = compare::RopeScanner::new(&one, &two);
+    b.bytes = one.len() as u64;
+    b.iter(|| scanner.find_min_diff_range())
+}
+
+/// A generated document of about 8MB, and a regenerated copy of it with a
+/// line inserted every 256KB or so, as the rest of a reload diff isn't
+/// trimmed as common prefix or suffix.
+fn make_reload_ropes() -> (Rope, Rope) {
+    let part = [EDITOR_STR, VIEW_STR, INTERVAL_STR, BREAKS_STR].concat();
+    let mut one = String::new();
+    let mut two = String::new();
+    for i in 0..32 {
+        one.push_str(&part);
+        two.push_str(&format!("// regenerated part {} of the document\n", i));
+        two.push_str(&part);
+    }
+    (Rope::from(one), Rope::from(two))
+}
+
+#[bench]
+fn hash_diff_reload_serial(b: &mut Bencher) {
+    let (one, two) = make_reload_ropes();
+    b.bytes = one.len() as u64;
+    b.iter(|| LineHashDiff::compute_delta_parallel(&one, &two, 1));
+}
+
+#[bench]
+fn hash_diff_reload(b: &mut Bencher) {
+    let (one, two) = make_reload_ropes();
+    b.bytes = one.len() as u64;
+    b.iter(|| LineHashDiff::compute_delta(&one, &two));
+}
+
 #[bench]
 fn hash_diff(b: &mut Bencher) {
     let one = BASE_STR.into();
@@ -13,6 +13,8 @@
 // limitations under the License.
 
 //! Fast comparison of rope regions, principally for diffing.
+use std::sync::atomic::{AtomicU8, Ordering};
+
 use crate::rope::{BaseMetric, Rope, RopeInfo};
 use crate::tree::Cursor;
 
@@ -73,29 +75,145 @@ pub unsafe fn avx_compare_mask(one: &[u8], two: &[u8]) -> i32 {
     !_mm256_movemask_epi8(mask)
 }
 
+#[allow(dead_code)]
+const AVX512_STRIDE: usize = 64;
+
+/// Given two slices of at most 64 bytes and of the same length, returns a
+/// bitmask where the 1 bits indicate the positions of non-equal bytes, as
+/// above. Bytes past the end of the slices are not read, and their bits are
+/// 0.
+#[doc(hidden)]
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx512bw")]
+pub unsafe fn avx512_compare_mask(one: &[u8], two: &[u8]) -> u64 {
+    use std::arch::x86_64::*;
+    debug_assert!(one.len() <= AVX512_STRIDE && one.len() == two.len());
+    let (onev, twov) = if one.len() == AVX512_STRIDE {
+        (_mm512_loadu_si512(one.as_ptr() as *const _), _mm512_loadu_si512(two.as_ptr() as *const _))
+    } else {
+        let load_mask = (1 << one.len()) - 1;
+        (
+            _mm512_maskz_loadu_epi8(load_mask, one.as_ptr() as *const _),
+            _mm512_maskz_loadu_epi8(load_mask, two.as_ptr() as *const _),
+        )
+    };
+    _mm512_cmpneq_epi8_mask(onev, twov)
+}
+
+#[allow(dead_code)]
+const NEON_STRIDE: usize = 16;
+
+/// Given two 16-byte slices, returns a mask with 4 bits per byte, which are
+/// all set for the positions of non-equal bytes. NEON has no equivalent of
+/// `_mm_movemask_epi8`, so this narrows the comparison to nibbles.
+///
+/// The least significant nibble refers to the byte in position 0.
+#[doc(hidden)]
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+pub unsafe fn neon_compare_mask(one: &[u8], two: &[u8]) -> u64 {
+    use std::arch::aarch64::*;
+    debug_assert!(one.len() >= NEON_STRIDE && two.len() >= NEON_STRIDE);
+    let onev = vld1q_u8(one.as_ptr());
+    let twov = vld1q_u8(two.as_ptr());
+    let eq = vceqq_u8(onev, twov);
+    let nibbles = vshrn_n_u16::<4>(vreinterpretq_u16_u8(eq));
+    !vget_lane_u64::<0>(vreinterpret_u64_u8(nibbles))
+}
+
+/// The implementations of `ne_idx` and `ne_idx_rev`, best last.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+enum Kernel {
+    Fallback = 1,
+    #[cfg(target_arch = "x86_64")]
+    Sse = 2,
+    #[cfg(target_arch = "x86_64")]
+    Avx2 = 3,
+    #[cfg(target_arch = "x86_64")]
+    Avx512 = 4,
+    #[cfg(target_arch = "aarch64")]
+    Neon = 5,
+}
+
+/// The `Kernel` detected for this CPU, or 0 before the first comparison.
+static KERNEL: AtomicU8 = AtomicU8::new(0);
+
+impl Kernel {
+    fn detect() -> Kernel {
+        #[cfg(target_arch = "x86_64")]
+        {
+            if is_x86_feature_detected!("avx512bw") {
+                return Kernel::Avx512;
+            } else if is_x86_feature_detected!("avx2") {
+                return Kernel::Avx2;
+            } else if is_x86_feature_detected!("sse4.2") {
+                return Kernel::Sse;
+            }
+        }
+        #[cfg(target_arch = "aarch64")]
+        {
+            if std::arch::is_aarch64_feature_detected!("neon") {
+                return Kernel::Neon;
+            }
+        }
+        Kernel::Fallback
+    }
+
+    /// Returns the best kernel supported by this CPU, detecting it on the
+    /// first call. Threads racing on that all detect the same kernel.
+    #[inline]
+    fn get() -> Kernel {
+        match KERNEL.load(Ordering::Relaxed) {
+            1 => Kernel::Fallback,
+            #[cfg(target_arch = "x86_64")]
+            2 => Kernel::Sse,
+            #[cfg(target_arch = "x86_64")]
+            3 => Kernel::Avx2,
+            #[cfg(target_arch = "x86_64")]
+            4 => Kernel::Avx512,
+            #[cfg(target_arch = "aarch64")]
+            5 => Kernel::Neon,
+            _ => {
+                let kernel = Kernel::detect();
+                KERNEL.store(kernel as u8, Ordering::Relaxed);
+                kernel
+            }
+        }
+    }
+}
+
 /// Returns the lowest `i` for which `one[i] != two[i]`, if one exists.
 pub fn ne_idx(one: &[u8], two: &[u8]) -> Option<usize> {
-    #[cfg(target_arch = "x86_64")]
-    {
-        if is_x86_feature_detected!("avx2") {
-            return unsafe { ne_idx_avx(one, two) };
-        } else if is_x86_feature_detected!("sse4.2") {
-            return unsafe { ne_idx_sse(one, two) };
+    // Safe, as `Kernel::get` only returns kernels this CPU supports.
+    unsafe {
+        match Kernel::get() {
+            #[cfg(target_arch = "x86_64")]
+            Kernel::Avx512 => ne_idx_avx512(one, two),
+            #[cfg(target_arch = "x86_64")]
+            Kernel::Avx2 => ne_idx_avx(one, two),
+            #[cfg(target_arch = "x86_64")]
+            Kernel::Sse => ne_idx_sse(one, two),
+            #[cfg(target_arch = "aarch64")]
+            Kernel::Neon => ne_idx_neon(one, two),
+            Kernel::Fallback => ne_idx_fallback(one, two),
         }
     }
-    ne_idx_fallback(one, two)
 }
 
 /// Returns the lowest `i` such that `one[one.len()-i] != two[two.len()-i]`,
 /// if one exists.
 pub fn ne_idx_rev(one: &[u8], two: &[u8]) -> Option<usize> {
-    #[cfg(target_arch = "x86_64")]
-    {
-        if is_x86_feature_detected!("sse4.2") {
-            return unsafe { ne_idx_rev_sse(one, two) };
+    unsafe {
+        match Kernel::get() {
+            #[cfg(target_arch = "x86_64")]
+            Kernel::Avx512 => ne_idx_rev_avx512(one, two),
+            #[cfg(target_arch = "x86_64")]
+            Kernel::Avx2 | Kernel::Sse => ne_idx_rev_sse(one, two),
+            #[cfg(target_arch = "aarch64")]
+            Kernel::Neon => ne_idx_rev_neon(one, two),
+            Kernel::Fallback => ne_idx_rev_fallback(one, two),
         }
     }
-    ne_idx_rev_fallback(one, two)
 }
 
 #[doc(hidden)]
@@ -104,20 +222,18 @@ pub fn ne_idx_rev(one: &[u8], two: &[u8]) -> Option<usize> {
 pub unsafe fn ne_idx_avx(one: &[u8], two: &[u8]) -> Option<usize> {
     let min_len = one.len().min(two.len());
     let mut idx = 0;
-    while idx < min_len {
-        let stride_len = AVX_STRIDE.min(min_len - idx);
+    while idx + AVX_STRIDE <= min_len {
         let mask = avx_compare_mask(
-            &one.get_unchecked(idx..idx + stride_len),
-            &two.get_unchecked(idx..idx + stride_len),
+            one.get_unchecked(idx..idx + AVX_STRIDE),
+            two.get_unchecked(idx..idx + AVX_STRIDE),
         );
-        // at the end of the slice the mask might include garbage bytes, so
-        // we ignore matches that are OOB
-        if mask != 0 && idx + (mask.trailing_zeros() as usize) < min_len {
+        if mask != 0 {
             return Some(idx + mask.trailing_zeros() as usize);
         }
         idx += AVX_STRIDE;
     }
-    None
+    // The mask reads a whole stride, which would run past the end here.
+    ne_idx_fallback(&one[idx..min_len], &two[idx..min_len]).map(|i| idx + i)
 }
 
 #[doc(hidden)]
@@ -126,20 +242,59 @@ pub unsafe fn ne_idx_avx(one: &[u8], two: &[u8]) -> Option<usize> {
 pub unsafe fn ne_idx_sse(one: &[u8], two: &[u8]) -> Option<usize> {
     let min_len = one.len().min(two.len());
     let mut idx = 0;
-    while idx < min_len {
-        let stride_len = SSE_STRIDE.min(min_len - idx);
+    while idx + SSE_STRIDE <= min_len {
         let mask = sse_compare_mask(
-            &one.get_unchecked(idx..idx + stride_len),
-            &two.get_unchecked(idx..idx + stride_len),
+            one.get_unchecked(idx..idx + SSE_STRIDE),
+            two.get_unchecked(idx..idx + SSE_STRIDE),
         );
-        if mask != 0 && idx + (mask.trailing_zeros() as usize) < min_len {
+        if mask != 0 {
             return Some(idx + mask.trailing_zeros() as usize);
         }
         idx += SSE_STRIDE;
     }
+    ne_idx_fallback(&one[idx..min_len], &two[idx..min_len]).map(|i| idx + i)
+}
+
+#[doc(hidden)]
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx512bw")]
+pub unsafe fn ne_idx_avx512(one: &[u8], two: &[u8]) -> Option<usize> {
+    let min_len = one.len().min(two.len());
+    let mut idx = 0;
+    while idx < min_len {
+        // The last stride is masked, rather than done bytewise.
+        let stride_len = AVX512_STRIDE.min(min_len - idx);
+        let mask = avx512_compare_mask(
+            one.get_unchecked(idx..idx + stride_len),
+            two.get_unchecked(idx..idx + stride_len),
+        );
+        if mask != 0 {
+            return Some(idx + mask.trailing_zeros() as usize);
+        }
+        idx += AVX512_STRIDE;
+    }
     None
 }
 
+#[doc(hidden)]
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+pub unsafe fn ne_idx_neon(one: &[u8], two: &[u8]) -> Option<usize> {
+    let min_len = one.len().min(two.len());
+    let mut idx = 0;
+    while idx + NEON_STRIDE <= min_len {
+        let mask = neon_compare_mask(
+            one.get_unchecked(idx..idx + NEON_STRIDE),
+            two.get_unchecked(idx..idx + NEON_STRIDE),
+        );
+        if mask != 0 {
+            return Some(idx + mask.trailing_zeros() as usize / 4);
+        }
+        idx += NEON_STRIDE;
+    }
+    ne_idx_fallback(&one[idx..min_len], &two[idx..min_len]).map(|i| idx + i)
+}
+
 #[doc(hidden)]
 #[cfg(target_arch = "x86_64")]
 #[target_feature(enable = "sse4.2")]
@@ -171,6 +326,45 @@ pub unsafe fn ne_idx_rev_sse(one: &[u8], two: &[u8]) -> Option<usize> {
     None
 }
 
+#[doc(hidden)]
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx512bw")]
+pub unsafe fn ne_idx_rev_avx512(one: &[u8], two: &[u8]) -> Option<usize> {
+    let min_len = one.len().min(two.len());
+    let one = &one[one.len() - min_len..];
+    let two = &two[two.len() - min_len..];
+    let mut idx = min_len;
+    while idx > 0 {
+        let stride_len = AVX512_STRIDE.min(idx);
+        let mask = avx512_compare_mask(&one[idx - stride_len..idx], &two[idx - stride_len..idx]);
+        if mask != 0 {
+            // The mask's high bits, past `stride_len`, are 0.
+            let i = mask.leading_zeros() as usize + stride_len - AVX512_STRIDE;
+            return Some(min_len - idx + i);
+        }
+        idx -= stride_len;
+    }
+    None
+}
+
+#[doc(hidden)]
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+pub unsafe fn ne_idx_rev_neon(one: &[u8], two: &[u8]) -> Option<usize> {
+    let min_len = one.len().min(two.len());
+    let one = &one[one.len() - min_len..];
+    let two = &two[two.len() - min_len..];
+    let mut idx = min_len;
+    while idx >= NEON_STRIDE {
+        let mask = neon_compare_mask(&one[idx - NEON_STRIDE..idx], &two[idx - NEON_STRIDE..idx]);
+        if mask != 0 {
+            return Some(min_len - idx + mask.leading_zeros() as usize / 4);
+        }
+        idx -= NEON_STRIDE;
+    }
+    ne_idx_rev_fallback(&one[..idx], &two[..idx]).map(|i| min_len - idx + i)
+}
+
 #[inline]
 #[allow(dead_code)]
 #[doc(hidden)]
@@ -438,6 +632,91 @@ mod tests {
                 assert_eq!(ne_idx_avx(one.as_bytes(), tre.as_bytes()), Some(2));
                 assert_eq!(ne_idx_avx(one.as_bytes(), fur.as_bytes()), None);
             }
+            if is_x86_feature_detected!("avx512bw") {
+                assert!(ne_idx_avx512(one.as_bytes(), two.as_bytes()).is_none());
+                assert_eq!(ne_idx_avx512(one.as_bytes(), tre.as_bytes()), Some(2));
+                assert_eq!(ne_idx_avx512(one.as_bytes(), fur.as_bytes()), None);
+            }
+        }
+    }
+
+    type NeIdx = unsafe fn(&[u8], &[u8]) -> Option<usize>;
+
+    /// The `ne_idx` and `ne_idx_rev` kernels this CPU supports.
+    fn kernels() -> Vec<(&'static str, NeIdx, NeIdx)> {
+        let mut kernels: Vec<(&'static str, NeIdx, NeIdx)> = vec![("dispatch", ne_idx, ne_idx_rev)];
+        #[cfg(target_arch = "x86_64")]
+        {
+            if is_x86_feature_detected!("sse4.2") {
+                kernels.push(("sse", ne_idx_sse, ne_idx_rev_sse));
+            }
+            if is_x86_feature_detected!("avx2") {
+                kernels.push(("avx2", ne_idx_avx, ne_idx_rev_sse));
+            }
+            if is_x86_feature_detected!("avx512bw") {
+                kernels.push(("avx512", ne_idx_avx512, ne_idx_rev_avx512));
+            }
+        }
+        #[cfg(target_arch = "aarch64")]
+        {
+            if std::arch::is_aarch64_feature_detected!("neon") {
+                kernels.push(("neon", ne_idx_neon, ne_idx_rev_neon));
+            }
+        }
+        kernels
+    }
+
+    #[test]
+    fn ne_idx_kernels() {
+        // Every length up to a few strides, differing at each position, and
+        // compared against a longer slice so the kernels must stop at the
+        // shorter one.
+        let one: Vec<u8> = (0..200u32).map(|i| (i * 7 % 251) as u8).collect();
+        for (name, fwd, rev) in kernels() {
+            for len in 0..=one.len() {
+                let a = &one[..len];
+                let b = &one[one.len() - len..];
+                for &(x, y) in &[(a, &one[..]), (&one[..], a)] {
+                    let expected = ne_idx_fallback(x, y);
+                    assert_eq!(unsafe { fwd(x, y) }, expected, "{} {}", name, len);
+                }
+                for &(x, y) in &[(b, &one[..]), (&one[..], b)] {
+                    let expected = ne_idx_rev_fallback(x, y);
+                    assert_eq!(unsafe { rev(x, y) }, expected, "{} rev {}", name, len);
+                }
+                for i in 0..len {
+                    let mut c = a.to_vec();
+                    c[i] ^= 0x80;
+                    assert_eq!(unsafe { fwd(a, &c) }, Some(i), "{} {} at {}", name, len, i);
+                    assert_eq!(
+                        unsafe { rev(a, &c) },
+                        Some(len - 1 - i),
+                        "{} rev {} at {}",
+                        name,
+                        len,
+                        i
+                    );
+                    if i > 0 {
+                        c[i - 1] ^= 0x01;
+                        assert_eq!(
+                            unsafe { fwd(a, &c) },
+                            Some(i - 1),
+                            "{} {} near {}",
+                            name,
+                            len,
+                            i
+                        );
+                        assert_eq!(
+                            unsafe { rev(a, &c) },
+                            Some(len - 1 - i),
+                            "{} rev {} near {}",
+                            name,
+                            len,
+                            i
+                        );
+                    }
+                }
+            }
         }
     }
 
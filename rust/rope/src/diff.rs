@@ -15,12 +15,16 @@
 //! Computing deltas between two ropes.
 
 use std::borrow::Cow;
+use std::collections::hash_map::RandomState;
 use std::collections::HashMap;
+use std::hash::{BuildHasher, BuildHasherDefault, Hash, Hasher};
+use std::ops::Range;
+use std::thread;
 
 use crate::compare::RopeScanner;
 use crate::delta::{Delta, DeltaElement};
 use crate::interval::Interval;
-use crate::rope::{LinesMetric, Rope, RopeDelta, RopeInfo};
+use crate::rope::{Rope, RopeDelta, RopeInfo};
 use crate::tree::{Node, NodeInfo};
 
 /// A trait implemented by various diffing strategies.
@@ -32,6 +36,10 @@ pub trait Diff<N: NodeInfo> {
 /// we consider it for diffing purposes.
 const MIN_SIZE: usize = 32;
 
+/// The least length of the differing middle of the ropes given to each
+/// thread that hashes and matches lines.
+const MIN_PARALLEL_DIFF_LEN: usize = 256 << 10;
+
 /// A line-oriented, hash based diff algorithm.
 ///
 /// This works by taking a hash of each line in either document that
@@ -45,10 +53,31 @@ const MIN_SIZE: usize = 32;
 /// results on a variety of workloads that are comparable in quality
 /// (measured in terms of serialized diff size) with the results from
 /// using a suffix array, while being an order of magnitude faster.
+///
+/// The common prefix and suffix of the ropes are found first, and only the
+/// lines between them are hashed and matched. When that middle is large,
+/// this is done on several threads.
 pub struct LineHashDiff;
 
 impl Diff<RopeInfo> for LineHashDiff {
     fn compute_delta(base: &Rope, target: &Rope) -> RopeDelta {
+        // Finding the number of cores isn't free, and small ropes are
+        // diffed on one thread anyway.
+        let max_threads = if base.len().max(target.len()) >= 2 * MIN_PARALLEL_DIFF_LEN {
+            diff_threads()
+        } else {
+            1
+        };
+        LineHashDiff::compute_delta_parallel(base, target, max_threads)
+    }
+}
+
+impl LineHashDiff {
+    /// Computes the delta as `compute_delta` does, hashing and matching
+    /// lines on up to `max_threads` threads, each given at least
+    /// `MIN_PARALLEL_DIFF_LEN` bytes. The delta is the same for any number
+    /// of threads.
+    pub fn compute_delta_parallel(base: &Rope, target: &Rope, max_threads: usize) -> RopeDelta {
         let mut builder = DiffBuilder::default();
 
         // before doing anything, scan top down and bottom up for like-ness.
@@ -77,29 +106,14 @@ impl Diff<RopeInfo> for LineHashDiff {
             return builder.to_delta(base, target);
         }
 
-        let line_hashes = make_line_hashes(&base, MIN_SIZE);
-
-        let line_count = target.measure::<LinesMetric>() + 1;
-        let mut matches = Vec::with_capacity(line_count);
-
-        let mut targ_line_offset = 0;
-        let mut prev_base = 0;
-
-        let mut needs_subseq = false;
-        for line in target.lines_raw(start_offset..target_end) {
-            let non_ws = non_ws_offset(&line);
-            if line.len() - non_ws >= MIN_SIZE {
-                if let Some(base_off) = line_hashes.get(&line[non_ws..]) {
-                    let targ_off = targ_line_offset + non_ws;
-                    matches.push((start_offset + targ_off, *base_off));
-                    if *base_off < prev_base {
-                        needs_subseq = true;
-                    }
-                    prev_base = *base_off;
-                }
-            }
-            targ_line_offset += line.len();
-        }
+        // Lines of the common prefix and suffix can't be copied again, as
+        // copies must not go backwards in the base.
+        let base_end = base.len() - diff_end;
+        let middle_len = (base_end - start_offset).max(target_end - start_offset);
+        let n_threads = max_threads.min(middle_len / MIN_PARALLEL_DIFF_LEN).max(1);
+        let line_hashes = LineHashes::new(base, start_offset..base_end, MIN_SIZE, n_threads);
+        let matches = line_hashes.matches(target, start_offset..target_end, n_threads);
+        let needs_subseq = matches.windows(2).any(|pair| pair[1].1 < pair[0].1);
 
         // we now have an ordered list of matches and their positions.
         // to ensure that our delta only copies non-decreasing base regions,
@@ -141,6 +155,200 @@ impl Diff<RopeInfo> for LineHashDiff {
     }
 }
 
+/// The number of threads to diff on.
+fn diff_threads() -> usize {
+    thread::available_parallelism().map(|n| n.get()).unwrap_or(1)
+}
+
+/// Runs `f` on each of `items`, each on its own thread unless there is only
+/// one, and returns the results in order.
+fn par_map<T, R, F>(items: Vec<T>, f: F) -> Vec<R>
+where
+    T: Send,
+    R: Send,
+    F: Fn(T) -> R + Sync,
+{
+    if items.len() <= 1 {
+        return items.into_iter().map(f).collect();
+    }
+    let f = &f;
+    thread::scope(|scope| {
+        let workers =
+            items.into_iter().map(|item| scope.spawn(move || f(item))).collect::<Vec<_>>();
+        workers.into_iter().map(|worker| worker.join().expect("diff worker panicked")).collect()
+    })
+}
+
+/// Splits `iv` into up to `n` ranges of about the same length, which start
+/// at line starts, except for the first.
+fn split_lines(text: &Rope, iv: Range<usize>, n: usize) -> Vec<Range<usize>> {
+    let mut ranges = Vec::with_capacity(n);
+    let mut start = iv.start;
+    for i in 1..n {
+        let mid = iv.start + (iv.end - iv.start) * i / n;
+        if mid < start {
+            continue;
+        }
+        let end = text.offset_of_line(text.line_of_offset(mid) + 1).min(iv.end);
+        if end > start && end < iv.end {
+            ranges.push(start..end);
+            start = end;
+        }
+    }
+    ranges.push(start..iv.end);
+    ranges
+}
+
+/// A line, without its leading whitespace, and its hash.
+struct HashedLine<'a> {
+    hash: u64,
+    line: Cow<'a, str>,
+}
+
+impl<'a> HashedLine<'a> {
+    fn new(hasher: &RandomState, line: Cow<'a, str>) -> HashedLine<'a> {
+        HashedLine { hash: hasher.hash_one(&line), line }
+    }
+
+    /// The index of the shard of `LineHashes` this line belongs to. This is
+    /// taken from the high bits, as `HashMap` buckets lines by the low ones.
+    fn shard(&self, n_shards: usize) -> usize {
+        (self.hash >> 32) as usize % n_shards
+    }
+}
+
+impl<'a> PartialEq for HashedLine<'a> {
+    fn eq(&self, other: &HashedLine<'a>) -> bool {
+        self.hash == other.hash && self.line == other.line
+    }
+}
+
+impl<'a> Eq for HashedLine<'a> {}
+
+impl<'a> Hash for HashedLine<'a> {
+    fn hash<H: Hasher>(&self, state: &mut H) {
+        state.write_u64(self.hash);
+    }
+}
+
+/// The lines are hashed already, so pass the hashes through.
+#[derive(Default)]
+struct LineHasher(u64);
+
+impl Hasher for LineHasher {
+    fn finish(&self) -> u64 {
+        self.0
+    }
+
+    fn write(&mut self, bytes: &[u8]) {
+        for &b in bytes {
+            self.0 = (self.0 << 8) | u64::from(b);
+        }
+    }
+
+    fn write_u64(&mut self, n: u64) {
+        self.0 = n;
+    }
+}
+
+/// Calls `f` with each line in `iv` where `line.len() >= min_size`, ignoring
+/// leading whitespace, and the offset of its first non-whitespace byte.
+fn hash_lines<'a, F>(
+    text: &'a Rope,
+    iv: Range<usize>,
+    min_size: usize,
+    hasher: &RandomState,
+    mut f: F,
+) where
+    F: FnMut(HashedLine<'a>, usize),
+{
+    let mut offset = iv.start;
+    for line in text.lines_raw(iv) {
+        let non_ws = non_ws_offset(&line);
+        if line.len() - non_ws >= min_size {
+            let cow = match line {
+                Cow::Owned(ref s) => Cow::Owned(s[non_ws..].to_string()),
+                Cow::Borrowed(s) => Cow::Borrowed(&s[non_ws..]),
+            };
+            f(HashedLine::new(hasher, cow), offset + non_ws);
+        }
+        offset += line.len();
+    }
+}
+
+/// A map of lines to offsets, ignoring leading whitespace, for the lines of
+/// a range of the base rope where `line.len() >= min_size`. Offsets refer
+/// to the first non-whitespace byte in the line. The map is split into
+/// shards by hash, so that it can be built on several threads.
+struct LineHashes<'a> {
+    hasher: RandomState,
+    shards: Vec<HashMap<HashedLine<'a>, usize, BuildHasherDefault<LineHasher>>>,
+}
+
+impl<'a> LineHashes<'a> {
+    fn new(base: &'a Rope, iv: Range<usize>, min_size: usize, n_threads: usize) -> Self {
+        let hasher = RandomState::new();
+        if n_threads <= 1 {
+            let mut map = HashMap::with_capacity_and_hasher(iv.len() / 60, Default::default());
+            hash_lines(base, iv, min_size, &hasher, |line, offset| {
+                map.insert(line, offset);
+            });
+            return LineHashes { hasher, shards: vec![map] };
+        }
+        let n_shards = n_threads;
+        // Each thread hashes a range of lines, sorting them by shard...
+        let ranges = split_lines(base, iv, n_threads);
+        let hashed = par_map(ranges, |range| {
+            let mut shards = (0..n_shards).map(|_| Vec::new()).collect::<Vec<_>>();
+            hash_lines(base, range, min_size, &hasher, |line, offset| {
+                shards[line.shard(n_shards)].push((line, offset));
+            });
+            shards
+        });
+        // ...and then builds a shard from the lines of each range in order,
+        // so that the last of equal lines wins, as it does in one map.
+        let mut by_shard = (0..n_shards).map(|_| Vec::new()).collect::<Vec<_>>();
+        for shards in hashed {
+            for (shard, lines) in by_shard.iter_mut().zip(shards) {
+                shard.push(lines);
+            }
+        }
+        let shards = par_map(by_shard, |ranges| {
+            let len = ranges.iter().map(Vec::len).sum();
+            let mut map = HashMap::with_capacity_and_hasher(len, Default::default());
+            map.extend(ranges.into_iter().flatten());
+            map
+        });
+        LineHashes { hasher, shards }
+    }
+
+    fn get(&self, line: &str) -> Option<usize> {
+        let line = HashedLine::new(&self.hasher, Cow::Borrowed(line));
+        self.shards[line.shard(self.shards.len())].get(&line).cloned()
+    }
+
+    /// Returns the pairs of offsets, in `target` and in the base, of the
+    /// lines in `iv` of `target` that match one in the base, in order.
+    fn matches(&self, target: &Rope, iv: Range<usize>, n_threads: usize) -> Vec<(usize, usize)> {
+        let ranges = split_lines(target, iv, n_threads);
+        let matches = par_map(ranges, |range| {
+            let mut matches = Vec::new();
+            let mut offset = range.start;
+            for line in target.lines_raw(range) {
+                let non_ws = non_ws_offset(&line);
+                if line.len() - non_ws >= MIN_SIZE {
+                    if let Some(base_off) = self.get(&line[non_ws..]) {
+                        matches.push((offset + non_ws, base_off));
+                    }
+                }
+                offset += line.len();
+            }
+            matches
+        });
+        matches.concat()
+    }
+}
+
 /// Given two ropes and the offsets of two equal bytes, finds the largest
 /// identical substring shared between the two ropes which contains the offset.
 ///
@@ -257,25 +465,6 @@ impl DiffBuilder {
     }
 }
 
-/// Creates a map of lines to offsets, ignoring trailing whitespace, and only for those lines
-/// where line.len() >= min_size. Offsets refer to the first non-whitespace byte in the line.
-fn make_line_hashes(base: &Rope, min_size: usize) -> HashMap<Cow<str>, usize> {
-    let mut offset = 0;
-    let mut line_hashes = HashMap::with_capacity(base.len() / 60);
-    for line in base.lines_raw(..) {
-        let non_ws = non_ws_offset(&line);
-        if line.len() - non_ws >= min_size {
-            let cow = match line {
-                Cow::Owned(ref s) => Cow::Owned(s[non_ws..].to_string()),
-                Cow::Borrowed(s) => Cow::Borrowed(&s[non_ws..]),
-            };
-            line_hashes.insert(cow, offset + non_ws);
-        }
-        offset += line.len();
-    }
-    line_hashes
-}
-
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -336,4 +525,52 @@ Currently my sense of smell (and the pain of implementing Write) might be too mu
         let result = delta.apply(&one);
         assert_eq!(String::from(result), String::from(two));
     }
+
+    /// About 1.5MB of lines, some of them repeated, and a copy of them with
+    /// lines changed, deleted and inserted throughout, and two blocks swapped.
+    fn make_big_diff() -> (Rope, Rope) {
+        let line = |i: usize| match i % 50 {
+            0 => String::from("        this line is repeated many times in the file\n"),
+            _ => format!(
+                "{:indent$}line {} of a large generated file, {}\n",
+                "",
+                i,
+                i * 7919 % 1000,
+                indent = i % 12
+            ),
+        };
+        let mut one = String::new();
+        let mut two = String::new();
+        for i in 0..24_000 {
+            one.push_str(&line(i));
+        }
+        let moved = (10_000..10_500).chain(5_000..5_500);
+        for i in (0..5_000).chain(moved).chain(5_500..10_000).chain(10_500..24_000) {
+            match i % 997 {
+                0 => two.push_str("a line that was changed, in place of another\n"),
+                1 => (),
+                2 => {
+                    two.push_str(&line(i));
+                    two.push_str("and a line that was inserted after another\n");
+                }
+                _ => two.push_str(&line(i)),
+            }
+        }
+        (one.into(), two.into())
+    }
+
+    #[test]
+    fn parallel_diff() {
+        let (one, two) = make_big_diff();
+        let delta = LineHashDiff::compute_delta_parallel(&one, &two, 1);
+        assert_eq!(String::from(delta.apply(&one)), String::from(&two));
+        let serial = format!("{:?}", delta);
+        for n_threads in 2..6 {
+            let delta = LineHashDiff::compute_delta_parallel(&one, &two, n_threads);
+            assert_eq!(format!("{:?}", delta), serial, "{} threads", n_threads);
+        }
+        // The changes are small, so nearly all of the base is copied.
+        let inserted = delta.inserts_len();
+        assert!(inserted < 0x8000, "{} bytes inserted", inserted);
+    }
 }
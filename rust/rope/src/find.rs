@@ -16,11 +16,13 @@
 
 use std::cmp::min;
 
+use aho_corasick::{AhoCorasick, AhoCorasickBuilder, MatchKind};
 use memchr::{memchr, memchr2, memchr3};
 
+use crate::interval::Interval;
 use crate::rope::BaseMetric;
 use crate::rope::LinesRaw;
-use crate::rope::RopeInfo;
+use crate::rope::{Rope, RopeInfo};
 use crate::tree::Cursor;
 use regex::Regex;
 use std::borrow::Cow;
@@ -323,6 +325,125 @@ pub fn is_multiline_regex(regex: &str) -> bool {
     multiline_indicators.iter().any(|&i| regex.contains(i))
 }
 
+/// Literal patterns that are found together, in one pass over the leaves of
+/// a rope, by Aho-Corasick with a SIMD (Teddy) prefilter. Each pattern is
+/// found wherever [`find`][find] would find it on its own, except that
+/// matches may overlap.
+///
+/// [find]: fn.find.html
+pub struct MultiFinder {
+    automaton: AhoCorasick<u32>,
+    /// The patterns found by each pattern of the automaton, which are
+    /// all the same but for ASCII case.
+    targets: Vec<Vec<usize>>,
+    /// The patterns that must match exactly, which the automaton finds
+    /// ignoring ASCII case.
+    exact: Vec<Option<String>>,
+    max_len: usize,
+}
+
+impl MultiFinder {
+    /// Whether a `MultiFinder` can find `pat` just as `find` does. Case
+    /// insensitive patterns must be ASCII, and without `i` or `k`, as the
+    /// lowercase of U+0130 starts with `i`, and that of U+212A is `k`.
+    pub fn supports(pat: &str, cm: CaseMatching) -> bool {
+        !pat.is_empty()
+            && (cm == CaseMatching::Exact
+                || pat.bytes().all(|b| b.is_ascii() && !b"iIkK".contains(&b)))
+    }
+
+    /// Returns a finder for `patterns`, or `None` if one is not
+    /// `supported`, or there are too many for the automaton.
+    pub fn new(patterns: &[(&str, CaseMatching)]) -> Option<MultiFinder> {
+        let mut keys: Vec<String> = Vec::new();
+        let mut targets: Vec<Vec<usize>> = Vec::new();
+        let mut exact = Vec::with_capacity(patterns.len());
+        for (i, &(pat, cm)) in patterns.iter().enumerate() {
+            if !MultiFinder::supports(pat, cm) {
+                return None;
+            }
+            let key = pat.to_ascii_lowercase();
+            match keys.iter().position(|k| *k == key) {
+                Some(k) => targets[k].push(i),
+                None => {
+                    keys.push(key);
+                    targets.push(vec![i]);
+                }
+            }
+            exact.push(if cm == CaseMatching::Exact { Some(pat.to_owned()) } else { None });
+        }
+        let automaton = AhoCorasickBuilder::new()
+            .ascii_case_insensitive(true)
+            .match_kind(MatchKind::Standard)
+            .build_with_size::<u32, _, _>(&keys)
+            .ok()?;
+        let max_len = keys.iter().map(String::len).max().unwrap_or(0);
+        Some(MultiFinder { automaton, targets, exact, max_len })
+    }
+
+    /// The length of the longest pattern, in bytes.
+    pub fn max_len(&self) -> usize {
+        self.max_len
+    }
+
+    /// Calls `f` with the index of the pattern, and the start and end, of
+    /// each match in `iv` of `text`. The matches of each pattern come in
+    /// order, but those of different patterns are interleaved.
+    pub fn find_all<F>(&self, text: &Rope, iv: Interval, mut f: F)
+    where
+        F: FnMut(usize, usize, usize),
+    {
+        // Matches that span leaves are found in a window around the start
+        // of each leaf, of the bytes before it that could start one, and
+        // those of the leaf that could end one. A match that spans several
+        // short leaves is found at the last of them.
+        let carry_len = self.max_len.saturating_sub(1);
+        let mut carry = Vec::with_capacity(2 * carry_len);
+        let mut window = Vec::with_capacity(2 * carry_len);
+        let mut pos = iv.start();
+        for leaf in text.iter_chunks(iv) {
+            let leaf = leaf.as_bytes();
+            if !carry.is_empty() {
+                window.clear();
+                window.extend_from_slice(&carry);
+                window.extend_from_slice(&leaf[..leaf.len().min(carry_len)]);
+                let base = pos - carry.len();
+                for m in self.automaton.find_overlapping_iter(&window) {
+                    if m.start() < carry.len() && m.end() > carry.len() {
+                        self.report(m, &window, base, &mut f);
+                    }
+                }
+            }
+            for m in self.automaton.find_overlapping_iter(leaf) {
+                self.report(m, leaf, pos, &mut f);
+            }
+            if leaf.len() >= carry_len {
+                carry.clear();
+                carry.extend_from_slice(&leaf[leaf.len() - carry_len..]);
+            } else {
+                carry.extend_from_slice(leaf);
+                let excess = carry.len().saturating_sub(carry_len);
+                carry.drain(..excess);
+            }
+            pos += leaf.len();
+        }
+    }
+
+    fn report<F>(&self, m: aho_corasick::Match, hay: &[u8], base: usize, f: &mut F)
+    where
+        F: FnMut(usize, usize, usize),
+    {
+        for &i in &self.targets[m.pattern()] {
+            if let Some(ref pat) = self.exact[i] {
+                if &hay[m.start()..m.end()] != pat.as_bytes() {
+                    continue;
+                }
+            }
+            f(i, base + m.start(), base + m.end());
+        }
+    }
+}
+
 /// Scan for a codepoint that, after conversion to lowercase, matches the probe.
 fn scan_lowercase(probe: char, s: &str) -> Option<usize> {
     for (i, c) in s.char_indices() {
@@ -753,4 +874,90 @@ mod tests {
         c.set(2000);
         assert!(compare_cursor_str(&mut c, &mut raw_lines, &s[2000..]).is_some());
     }
+
+    fn multi_find_naive(s: &str, patterns: &[(&str, CaseMatching)]) -> Vec<(usize, usize)> {
+        let mut result = Vec::new();
+        for (i, &(pat, cm)) in patterns.iter().enumerate() {
+            for start in 0..s.len().saturating_sub(pat.len() - 1) {
+                let hay = &s.as_bytes()[start..start + pat.len()];
+                let found = match cm {
+                    Exact => hay == pat.as_bytes(),
+                    CaseInsensitive => hay.eq_ignore_ascii_case(pat.as_bytes()),
+                };
+                if found {
+                    result.push((i, start));
+                }
+            }
+        }
+        result
+    }
+
+    fn multi_find_all(a: &Rope, iv: Interval, finder: &MultiFinder) -> Vec<(usize, usize)> {
+        let mut result = Vec::new();
+        finder.find_all(a, iv, |i, start, end| {
+            assert!(start < end && end <= iv.end());
+            result.push((i, start));
+        });
+        result.sort();
+        result
+    }
+
+    #[test]
+    fn multi_finder_supports() {
+        assert!(MultiFinder::supports("Löwe", Exact));
+        assert!(MultiFinder::supports("Lower", CaseInsensitive));
+        assert!(!MultiFinder::supports("Löwe", CaseInsensitive));
+        assert!(!MultiFinder::supports("find", CaseInsensitive));
+        assert!(!MultiFinder::supports("Kelvin", CaseInsensitive));
+        assert!(!MultiFinder::supports("", Exact));
+        assert!(MultiFinder::new(&[("Löwe", Exact), ("k", CaseInsensitive)]).is_none());
+    }
+
+    #[test]
+    fn multi_find_small() {
+        let a = Rope::from("Löwe 老虎 Léopard löwe LÖWE abababa");
+        let patterns = [("Löwe", Exact), ("LÖWE", Exact), ("l", CaseInsensitive), ("aba", Exact)];
+        let finder = MultiFinder::new(&patterns).unwrap();
+        let found = multi_find_all(&a, Interval::new(0, a.len()), &finder);
+        let expected =
+            vec![(0, 0), (1, 28), (2, 0), (2, 13), (2, 22), (2, 28), (3, 34), (3, 36), (3, 38)];
+        assert_eq!(found, expected);
+        let found = multi_find_all(&a, Interval::new(1, 40), &finder);
+        assert_eq!(found, vec![(1, 28), (2, 13), (2, 22), (2, 28), (3, 34), (3, 36)]);
+    }
+
+    #[test]
+    fn multi_find_medium() {
+        // Leaves are at most 1024 bytes, so matches are found across
+        // boundaries at many offsets into the patterns.
+        let mut s = String::new();
+        for i in 0..2000 {
+            s.push_str(["xyz", "Hello", "hello ", "HeLLo\n", "abab", "he"][i % 6]);
+            if i % 7 == 0 {
+                s.push('é');
+            }
+        }
+        let a = Rope::from(&s);
+        let patterns = [
+            ("hello", Exact),
+            ("HELLO", CaseInsensitive),
+            ("lo\nabab", CaseInsensitive),
+            ("bab", Exact),
+            ("éabab", Exact),
+            ("xyzHello hello HeLLo\nababhexyz", Exact),
+        ];
+        let finder = MultiFinder::new(&patterns).unwrap();
+        assert_eq!(finder.max_len(), 30);
+        let found = multi_find_all(&a, Interval::new(0, a.len()), &finder);
+        let expected = multi_find_naive(&s, &patterns);
+        assert!(expected.len() > 1500);
+        assert_eq!(found, expected);
+        let iv = Interval::new(1000, 5000);
+        let found = multi_find_all(&a, iv, &finder);
+        let expected: Vec<_> = multi_find_naive(&s[1000..5000], &patterns)
+            .into_iter()
+            .map(|(i, start)| (i, start + 1000))
+            .collect();
+        assert_eq!(found, expected);
+    }
 }
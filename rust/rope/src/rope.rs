@@ -382,7 +382,67 @@ impl FromStr for Rope {
     }
 }
 
+/// The least number of bytes that `Rope::from_utf8_parallel` gives each
+/// thread.
+const MIN_PARALLEL_BUILD_LEN: usize = 1 << 22;
+
 impl Rope {
+    /// Builds a rope from `bytes`, validating them as UTF-8, on up to
+    /// `max_threads` threads. Each thread validates a chunk and builds its
+    /// leaves, counting their lines and UTF-16 code units, and the subtrees
+    /// are then joined in order.
+    ///
+    /// This is meant for loading large files; on small inputs, it is the
+    /// same as `Rope::from`.
+    pub fn from_utf8_parallel(bytes: &[u8], max_threads: usize) -> Result<Rope, str::Utf8Error> {
+        let n_threads = max_threads.min(bytes.len() / MIN_PARALLEL_BUILD_LEN).max(1);
+        Rope::from_utf8_chunks(bytes, n_threads)
+    }
+
+    fn from_utf8_chunks(bytes: &[u8], n_chunks: usize) -> Result<Rope, str::Utf8Error> {
+        if n_chunks <= 1 {
+            return Ok(Rope::from(str::from_utf8(bytes)?));
+        }
+        let mut chunks = Vec::with_capacity(n_chunks);
+        let mut start = 0;
+        for i in 1..n_chunks {
+            // chunks start at a codepoint boundary, if the bytes are UTF-8
+            // at all; a chunk that doesn't fails to validate.
+            let mut mid = bytes.len() * i / n_chunks;
+            let limit = min(mid + 3, bytes.len());
+            while mid < limit && bytes[mid] & 0xc0 == 0x80 {
+                mid += 1;
+            }
+            if mid > start {
+                chunks.push(&bytes[start..mid]);
+                start = mid;
+            }
+        }
+        chunks.push(&bytes[start..]);
+
+        let nodes = std::thread::scope(|scope| {
+            let workers = chunks
+                .into_iter()
+                .map(|chunk| {
+                    scope.spawn(move || {
+                        let mut b = TreeBuilder::new();
+                        b.push_str(str::from_utf8(chunk)?);
+                        Ok(b.build())
+                    })
+                })
+                .collect::<Vec<_>>();
+            workers
+                .into_iter()
+                .map(|worker| worker.join().expect("rope builder panicked"))
+                .collect::<Result<Vec<Rope>, str::Utf8Error>>()
+        })?;
+        let mut b = TreeBuilder::new();
+        for node in nodes {
+            b.push(node);
+        }
+        Ok(b.build())
+    }
+
     /// Edit the string, replacing the byte range [`start`..`end`] with `new`.
     ///
     /// Time complexity: O(log n)
@@ -1179,6 +1239,36 @@ mod tests {
         assert!(long_text.len() > 1024);
         assert_eq!(cow, Cow::Borrowed(&long_text[..500]));
     }
+
+    #[test]
+    fn from_utf8_parallel() {
+        let mut s = String::new();
+        for i in 0..5000 {
+            s.push_str(["a", "\u{00A1}", "\u{4E00}\n", "\u{1F4A9}", "bc\n"][i % 5]);
+        }
+        let expected = Rope::from(&s);
+        for n_chunks in 1..20 {
+            let rope = Rope::from_utf8_chunks(s.as_bytes(), n_chunks).unwrap();
+            assert_eq!(String::from(&rope), s);
+            assert_eq!(rope.measure::<LinesMetric>(), expected.measure::<LinesMetric>());
+            assert_eq!(rope.measure::<Utf16CodeUnitsMetric>(), s.encode_utf16().count());
+        }
+        assert_eq!(Rope::from_utf8_parallel(s.as_bytes(), 8).unwrap(), expected);
+
+        // invalid bytes are found wherever the chunks split
+        let mut bytes = s.into_bytes();
+        for &pos in &[0, 7, 9999, bytes.len() - 1] {
+            let b = bytes[pos];
+            bytes[pos] = 0xff;
+            for n_chunks in 1..20 {
+                assert!(Rope::from_utf8_chunks(&bytes, n_chunks).is_err());
+            }
+            bytes[pos] = b;
+        }
+        // as are codepoints cut short
+        bytes.extend_from_slice(&"\u{1F4A9}".as_bytes()[..2]);
+        assert!(Rope::from_utf8_chunks(&bytes, 7).is_err());
+    }
 }
 
 #[cfg(all(test, feature = "serde"))]
@@ -0,0 +1,890 @@
+// Copyright 2026 The xi-editor Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! A binary framing of RPC messages, for peers that exchange a lot of data.
+//!
+//! A frame is the byte `FRAME_MARKER`, which can never begin a line of
+//! UTF-8, the length of the payload as a little-endian `u32`, and the
+//! payload: a single value, encoded as a tag byte followed by
+//!
+//! - nothing, for `null`, `false` and `true`;
+//! - eight little-endian bytes, for a `u64`, `i64` or `f64` number;
+//! - a `u32` length and that many bytes of UTF-8, for a string;
+//! - a `u32` count and that many values, for an array;
+//! - a `u32` count and that many pairs of a key, encoded as a string
+//!   without its tag, and a value, for an object;
+//! - a `u32` count and that many little-endian `f32`s or `f64`s, for an
+//!   array of floating point numbers, such as widths.
+//!
+//! Lengths and counts are little-endian. `to_frame` encodes any
+//! `Serialize` type directly, and strings are decoded in place, so
+//! `from_frame` can borrow them from the payload.
+
+use std::str;
+
+use serde::de::value::BorrowedStrDeserializer;
+use serde::de::{
+    self, DeserializeSeed, Deserializer, EnumAccess, Error as _, IntoDeserializer, MapAccess,
+    SeqAccess, VariantAccess, Visitor,
+};
+use serde::forward_to_deserialize_any;
+use serde::ser::{
+    Serialize, SerializeMap, SerializeSeq, SerializeStruct, SerializeStructVariant, SerializeTuple,
+    SerializeTupleStruct, SerializeTupleVariant, Serializer,
+};
+use serde_json::{Error, Value};
+
+/// The first byte of a binary frame.
+pub const FRAME_MARKER: u8 = 0xfe;
+
+/// The length of the frame header: the marker and the payload length.
+pub const HEADER_LEN: usize = 5;
+
+const TAG_NULL: u8 = 0;
+const TAG_FALSE: u8 = 1;
+const TAG_TRUE: u8 = 2;
+const TAG_U64: u8 = 3;
+const TAG_I64: u8 = 4;
+const TAG_F64: u8 = 5;
+const TAG_STRING: u8 = 6;
+const TAG_ARRAY: u8 = 7;
+const TAG_OBJECT: u8 = 8;
+const TAG_F32_ARRAY: u8 = 9;
+const TAG_F64_ARRAY: u8 = 10;
+
+/// Appends a frame holding `v` to `buf`.
+pub fn write_frame(v: &Value, buf: &mut Vec<u8>) {
+    to_frame(v, buf).expect("a Value always serializes")
+}
+
+/// Appends a frame holding `value` to `buf`, encoded as `write_frame`
+/// would encode the `Value` it serializes to, without building that
+/// `Value`. On error, `buf` is left as it was.
+pub fn to_frame<T: Serialize + ?Sized>(value: &T, buf: &mut Vec<u8>) -> Result<(), Error> {
+    let start = buf.len();
+    buf.extend_from_slice(&[FRAME_MARKER, 0, 0, 0, 0]);
+    if let Err(err) = value.serialize(&mut FrameSerializer { buf }) {
+        buf.truncate(start);
+        return Err(err);
+    }
+    let len = (buf.len() - start - HEADER_LEN) as u32;
+    buf[start + 1..start + HEADER_LEN].copy_from_slice(&len.to_le_bytes());
+    Ok(())
+}
+
+/// Returns the payload length from a frame header, or `None` if `header`
+/// does not start with `FRAME_MARKER`.
+pub fn payload_len(header: &[u8; HEADER_LEN]) -> Option<usize> {
+    if header[0] != FRAME_MARKER {
+        return None;
+    }
+    let mut len = [0; 4];
+    len.copy_from_slice(&header[1..]);
+    Some(u32::from_le_bytes(len) as usize)
+}
+
+/// Deserializes an instance of `T` from the payload of a frame, borrowing
+/// strings from it where `T` allows.
+pub fn from_frame<'de, T: de::Deserialize<'de>>(payload: &'de [u8]) -> Result<T, Error> {
+    let mut de = FrameDeserializer { input: payload };
+    let value = T::deserialize(&mut de)?;
+    if de.input.is_empty() {
+        Ok(value)
+    } else {
+        Err(Error::custom("trailing bytes in frame"))
+    }
+}
+
+/// Returns `true` if the payload of a frame holds an object.
+pub(crate) fn is_object(payload: &[u8]) -> bool {
+    payload.first() == Some(&TAG_OBJECT)
+}
+
+fn write_len(len: usize, buf: &mut Vec<u8>) {
+    buf.extend_from_slice(&(len as u32).to_le_bytes());
+}
+
+fn write_str(s: &str, buf: &mut Vec<u8>) {
+    write_len(s.len(), buf);
+    buf.extend_from_slice(s.as_bytes());
+}
+
+/// Rewrites the array whose tag is at `start` as a packed array, if its
+/// items are all floats, as `f32`s if they all survive the round trip.
+fn pack_floats(buf: &mut Vec<u8>, start: usize, count: usize) {
+    // a float is a tag and eight bytes, so if the items are all floats,
+    // each starts nine bytes after the last
+    let items = start + HEADER_LEN;
+    if count == 0 || buf.len() - items != count * 9 {
+        return;
+    }
+    if (0..count).any(|i| buf[items + i * 9] != TAG_F64) {
+        return;
+    }
+    let float = |buf: &[u8], i: usize| {
+        let mut bytes = [0; 8];
+        bytes.copy_from_slice(&buf[items + i * 9 + 1..items + i * 9 + 9]);
+        f64::from_le_bytes(bytes)
+    };
+    let is_f32 = (0..count).all(|i| {
+        let x = float(buf, i);
+        f64::from(x as f32) == x
+    });
+    buf[start] = if is_f32 { TAG_F32_ARRAY } else { TAG_F64_ARRAY };
+    // the packed items are shorter, so each can be written over the
+    // items already read
+    let width = if is_f32 { 4 } else { 8 };
+    for i in 0..count {
+        let x = float(buf, i);
+        let pos = items + i * width;
+        if is_f32 {
+            buf[pos..pos + 4].copy_from_slice(&(x as f32).to_le_bytes());
+        } else {
+            buf[pos..pos + 8].copy_from_slice(&x.to_le_bytes());
+        }
+    }
+    buf.truncate(items + count * width);
+}
+
+struct FrameSerializer<'a> {
+    buf: &'a mut Vec<u8>,
+}
+
+impl<'a> FrameSerializer<'a> {
+    /// Writes the tag of an array or object, and a count to be filled in
+    /// by `Compound::end`.
+    fn begin(&mut self, tag: u8) -> usize {
+        let start = self.buf.len();
+        self.buf.extend_from_slice(&[tag, 0, 0, 0, 0]);
+        start
+    }
+
+    /// Writes the head of an object of one key, `variant`, as serde_json
+    /// does for enum variants with fields.
+    fn begin_variant(&mut self, variant: &str) {
+        self.buf.push(TAG_OBJECT);
+        write_len(1, self.buf);
+        write_str(variant, self.buf);
+    }
+}
+
+impl<'a, 'b> Serializer for &'b mut FrameSerializer<'a> {
+    type Ok = ();
+    type Error = Error;
+    type SerializeSeq = Compound<'a, 'b>;
+    type SerializeTuple = Compound<'a, 'b>;
+    type SerializeTupleStruct = Compound<'a, 'b>;
+    type SerializeTupleVariant = Compound<'a, 'b>;
+    type SerializeMap = Compound<'a, 'b>;
+    type SerializeStruct = Compound<'a, 'b>;
+    type SerializeStructVariant = Compound<'a, 'b>;
+
+    fn serialize_bool(self, v: bool) -> Result<(), Error> {
+        self.buf.push(if v { TAG_TRUE } else { TAG_FALSE });
+        Ok(())
+    }
+
+    fn serialize_i8(self, v: i8) -> Result<(), Error> {
+        self.serialize_i64(v.into())
+    }
+
+    fn serialize_i16(self, v: i16) -> Result<(), Error> {
+        self.serialize_i64(v.into())
+    }
+
+    fn serialize_i32(self, v: i32) -> Result<(), Error> {
+        self.serialize_i64(v.into())
+    }
+
+    fn serialize_i64(self, v: i64) -> Result<(), Error> {
+        // like serde_json, keep non-negative numbers unsigned
+        if v >= 0 {
+            return self.serialize_u64(v as u64);
+        }
+        self.buf.push(TAG_I64);
+        self.buf.extend_from_slice(&v.to_le_bytes());
+        Ok(())
+    }
+
+    fn serialize_u8(self, v: u8) -> Result<(), Error> {
+        self.serialize_u64(v.into())
+    }
+
+    fn serialize_u16(self, v: u16) -> Result<(), Error> {
+        self.serialize_u64(v.into())
+    }
+
+    fn serialize_u32(self, v: u32) -> Result<(), Error> {
+        self.serialize_u64(v.into())
+    }
+
+    fn serialize_u64(self, v: u64) -> Result<(), Error> {
+        self.buf.push(TAG_U64);
+        self.buf.extend_from_slice(&v.to_le_bytes());
+        Ok(())
+    }
+
+    fn serialize_f32(self, v: f32) -> Result<(), Error> {
+        self.serialize_f64(v.into())
+    }
+
+    fn serialize_f64(self, v: f64) -> Result<(), Error> {
+        // serde_json has no NaN or infinity either, and makes them null
+        if !v.is_finite() {
+            return self.serialize_unit();
+        }
+        self.buf.push(TAG_F64);
+        self.buf.extend_from_slice(&v.to_le_bytes());
+        Ok(())
+    }
+
+    fn serialize_char(self, v: char) -> Result<(), Error> {
+        self.serialize_str(v.encode_utf8(&mut [0; 4]))
+    }
+
+    fn serialize_str(self, v: &str) -> Result<(), Error> {
+        self.buf.push(TAG_STRING);
+        write_str(v, self.buf);
+        Ok(())
+    }
+
+    fn serialize_bytes(self, v: &[u8]) -> Result<(), Error> {
+        let mut seq = self.serialize_seq(Some(v.len()))?;
+        for byte in v {
+            seq.element(byte)?;
+        }
+        seq.end()
+    }
+
+    fn serialize_none(self) -> Result<(), Error> {
+        self.serialize_unit()
+    }
+
+    fn serialize_some<T: Serialize + ?Sized>(self, value: &T) -> Result<(), Error> {
+        value.serialize(self)
+    }
+
+    fn serialize_unit(self) -> Result<(), Error> {
+        self.buf.push(TAG_NULL);
+        Ok(())
+    }
+
+    fn serialize_unit_struct(self, _name: &'static str) -> Result<(), Error> {
+        self.serialize_unit()
+    }
+
+    fn serialize_unit_variant(
+        self,
+        _name: &'static str,
+        _index: u32,
+        variant: &'static str,
+    ) -> Result<(), Error> {
+        self.serialize_str(variant)
+    }
+
+    fn serialize_newtype_struct<T: Serialize + ?Sized>(
+        self,
+        _name: &'static str,
+        value: &T,
+    ) -> Result<(), Error> {
+        value.serialize(self)
+    }
+
+    fn serialize_newtype_variant<T: Serialize + ?Sized>(
+        self,
+        _name: &'static str,
+        _index: u32,
+        variant: &'static str,
+        value: &T,
+    ) -> Result<(), Error> {
+        self.begin_variant(variant);
+        value.serialize(self)
+    }
+
+    fn serialize_seq(self, _len: Option<usize>) -> Result<Compound<'a, 'b>, Error> {
+        let start = self.begin(TAG_ARRAY);
+        Ok(Compound { ser: self, start, count: 0 })
+    }
+
+    fn serialize_tuple(self, len: usize) -> Result<Compound<'a, 'b>, Error> {
+        self.serialize_seq(Some(len))
+    }
+
+    fn serialize_tuple_struct(
+        self,
+        _name: &'static str,
+        len: usize,
+    ) -> Result<Compound<'a, 'b>, Error> {
+        self.serialize_seq(Some(len))
+    }
+
+    fn serialize_tuple_variant(
+        self,
+        _name: &'static str,
+        _index: u32,
+        variant: &'static str,
+        len: usize,
+    ) -> Result<Compound<'a, 'b>, Error> {
+        self.begin_variant(variant);
+        self.serialize_seq(Some(len))
+    }
+
+    fn serialize_map(self, _len: Option<usize>) -> Result<Compound<'a, 'b>, Error> {
+        let start = self.begin(TAG_OBJECT);
+        Ok(Compound { ser: self, start, count: 0 })
+    }
+
+    fn serialize_struct(self, _name: &'static str, len: usize) -> Result<Compound<'a, 'b>, Error> {
+        self.serialize_map(Some(len))
+    }
+
+    fn serialize_struct_variant(
+        self,
+        _name: &'static str,
+        _index: u32,
+        variant: &'static str,
+        len: usize,
+    ) -> Result<Compound<'a, 'b>, Error> {
+        self.begin_variant(variant);
+        self.serialize_map(Some(len))
+    }
+}
+
+/// An array or object being serialized. Its count is only known once
+/// its items are, since fields may be skipped.
+struct Compound<'a, 'b> {
+    ser: &'b mut FrameSerializer<'a>,
+    start: usize,
+    count: usize,
+}
+
+impl<'a, 'b> Compound<'a, 'b> {
+    fn element<T: Serialize + ?Sized>(&mut self, value: &T) -> Result<(), Error> {
+        self.count += 1;
+        value.serialize(&mut *self.ser)
+    }
+
+    /// Writes a key, as a string without its tag. Like serde_json, this
+    /// also takes numbers, writing them as strings.
+    fn key<T: Serialize + ?Sized>(&mut self, key: &T) -> Result<(), Error> {
+        self.count += 1;
+        let pos = self.ser.buf.len();
+        key.serialize(&mut *self.ser)?;
+        let buf = &mut *self.ser.buf;
+        let number = match buf.get(pos).cloned() {
+            Some(TAG_STRING) => {
+                buf.remove(pos);
+                return Ok(());
+            }
+            Some(tag @ TAG_U64) | Some(tag @ TAG_I64) if buf.len() == pos + 9 => {
+                let mut bytes = [0; 8];
+                bytes.copy_from_slice(&buf[pos + 1..]);
+                if tag == TAG_U64 {
+                    u64::from_le_bytes(bytes).to_string()
+                } else {
+                    i64::from_le_bytes(bytes).to_string()
+                }
+            }
+            _ => return Err(Error::custom("key must be a string")),
+        };
+        buf.truncate(pos);
+        write_str(&number, buf);
+        Ok(())
+    }
+
+    fn end(self) -> Result<(), Error> {
+        let buf = &mut *self.ser.buf;
+        buf[self.start + 1..self.start + HEADER_LEN]
+            .copy_from_slice(&(self.count as u32).to_le_bytes());
+        if buf[self.start] == TAG_ARRAY {
+            pack_floats(buf, self.start, self.count);
+        }
+        Ok(())
+    }
+}
+
+impl<'a, 'b> SerializeSeq for Compound<'a, 'b> {
+    type Ok = ();
+    type Error = Error;
+
+    fn serialize_element<T: Serialize + ?Sized>(&mut self, value: &T) -> Result<(), Error> {
+        self.element(value)
+    }
+
+    fn end(self) -> Result<(), Error> {
+        Compound::end(self)
+    }
+}
+
+impl<'a, 'b> SerializeTuple for Compound<'a, 'b> {
+    type Ok = ();
+    type Error = Error;
+
+    fn serialize_element<T: Serialize + ?Sized>(&mut self, value: &T) -> Result<(), Error> {
+        self.element(value)
+    }
+
+    fn end(self) -> Result<(), Error> {
+        Compound::end(self)
+    }
+}
+
+impl<'a, 'b> SerializeTupleStruct for Compound<'a, 'b> {
+    type Ok = ();
+    type Error = Error;
+
+    fn serialize_field<T: Serialize + ?Sized>(&mut self, value: &T) -> Result<(), Error> {
+        self.element(value)
+    }
+
+    fn end(self) -> Result<(), Error> {
+        Compound::end(self)
+    }
+}
+
+impl<'a, 'b> SerializeTupleVariant for Compound<'a, 'b> {
+    type Ok = ();
+    type Error = Error;
+
+    fn serialize_field<T: Serialize + ?Sized>(&mut self, value: &T) -> Result<(), Error> {
+        self.element(value)
+    }
+
+    fn end(self) -> Result<(), Error> {
+        Compound::end(self)
+    }
+}
+
+impl<'a, 'b> SerializeMap for Compound<'a, 'b> {
+    type Ok = ();
+    type Error = Error;
+
+    fn serialize_key<T: Serialize + ?Sized>(&mut self, key: &T) -> Result<(), Error> {
+        self.key(key)
+    }
+
+    fn serialize_value<T: Serialize + ?Sized>(&mut self, value: &T) -> Result<(), Error> {
+        value.serialize(&mut *self.ser)
+    }
+
+    fn end(self) -> Result<(), Error> {
+        Compound::end(self)
+    }
+}
+
+impl<'a, 'b> SerializeStruct for Compound<'a, 'b> {
+    type Ok = ();
+    type Error = Error;
+
+    fn serialize_field<T: Serialize + ?Sized>(
+        &mut self,
+        key: &'static str,
+        value: &T,
+    ) -> Result<(), Error> {
+        write_str(key, self.ser.buf);
+        self.element(value)
+    }
+
+    fn end(self) -> Result<(), Error> {
+        Compound::end(self)
+    }
+}
+
+impl<'a, 'b> SerializeStructVariant for Compound<'a, 'b> {
+    type Ok = ();
+    type Error = Error;
+
+    fn serialize_field<T: Serialize + ?Sized>(
+        &mut self,
+        key: &'static str,
+        value: &T,
+    ) -> Result<(), Error> {
+        write_str(key, self.ser.buf);
+        self.element(value)
+    }
+
+    fn end(self) -> Result<(), Error> {
+        Compound::end(self)
+    }
+}
+
+struct FrameDeserializer<'de> {
+    input: &'de [u8],
+}
+
+impl<'de> FrameDeserializer<'de> {
+    fn take(&mut self, len: usize) -> Result<&'de [u8], Error> {
+        if len > self.input.len() {
+            return Err(Error::custom("unexpected end of frame"));
+        }
+        let (head, tail) = self.input.split_at(len);
+        self.input = tail;
+        Ok(head)
+    }
+
+    fn take_8(&mut self) -> Result<[u8; 8], Error> {
+        let mut bytes = [0; 8];
+        bytes.copy_from_slice(self.take(8)?);
+        Ok(bytes)
+    }
+
+    fn take_tag(&mut self) -> Result<u8, Error> {
+        Ok(self.take(1)?[0])
+    }
+
+    fn peek_tag(&self) -> Result<u8, Error> {
+        self.input.first().cloned().ok_or_else(|| Error::custom("unexpected end of frame"))
+    }
+
+    fn take_len(&mut self) -> Result<usize, Error> {
+        let mut bytes = [0; 4];
+        bytes.copy_from_slice(self.take(4)?);
+        Ok(u32::from_le_bytes(bytes) as usize)
+    }
+
+    fn take_str(&mut self) -> Result<&'de str, Error> {
+        let len = self.take_len()?;
+        str::from_utf8(self.take(len)?).map_err(|_| Error::custom("invalid UTF-8 in frame"))
+    }
+}
+
+impl<'de, 'a> Deserializer<'de> for &'a mut FrameDeserializer<'de> {
+    type Error = Error;
+
+    fn deserialize_any<V: Visitor<'de>>(self, visitor: V) -> Result<V::Value, Error> {
+        match self.take_tag()? {
+            TAG_NULL => visitor.visit_unit(),
+            TAG_FALSE => visitor.visit_bool(false),
+            TAG_TRUE => visitor.visit_bool(true),
+            TAG_U64 => visitor.visit_u64(u64::from_le_bytes(self.take_8()?)),
+            TAG_I64 => visitor.visit_i64(i64::from_le_bytes(self.take_8()?)),
+            TAG_F64 => visitor.visit_f64(f64::from_le_bytes(self.take_8()?)),
+            TAG_STRING => visitor.visit_borrowed_str(self.take_str()?),
+            TAG_ARRAY => {
+                let remaining = self.take_len()?;
+                visitor.visit_seq(Items { de: self, remaining })
+            }
+            TAG_OBJECT => {
+                let remaining = self.take_len()?;
+                visitor.visit_map(Items { de: self, remaining })
+            }
+            tag @ TAG_F32_ARRAY | tag @ TAG_F64_ARRAY => {
+                let width = if tag == TAG_F32_ARRAY { 4 } else { 8 };
+                let len = self.take_len()?;
+                let bytes = self.take(len.checked_mul(width).unwrap_or(usize::max_value()))?;
+                visitor.visit_seq(Floats { bytes, width })
+            }
+            tag => Err(Error::custom(format!("unknown tag {} in frame", tag))),
+        }
+    }
+
+    fn deserialize_option<V: Visitor<'de>>(self, visitor: V) -> Result<V::Value, Error> {
+        if self.peek_tag()? == TAG_NULL {
+            self.input = &self.input[1..];
+            visitor.visit_none()
+        } else {
+            visitor.visit_some(self)
+        }
+    }
+
+    fn deserialize_newtype_struct<V: Visitor<'de>>(
+        self,
+        _name: &'static str,
+        visitor: V,
+    ) -> Result<V::Value, Error> {
+        visitor.visit_newtype_struct(self)
+    }
+
+    fn deserialize_enum<V: Visitor<'de>>(
+        self,
+        _name: &'static str,
+        _variants: &'static [&'static str],
+        visitor: V,
+    ) -> Result<V::Value, Error> {
+        match self.take_tag()? {
+            TAG_STRING => visitor.visit_enum(BorrowedStrDeserializer::new(self.take_str()?)),
+            TAG_OBJECT if self.take_len()? == 1 => visitor.visit_enum(self),
+            _ => Err(Error::custom("expected a string or an object of one key for an enum")),
+        }
+    }
+
+    forward_to_deserialize_any! {
+        bool i8 i16 i32 i64 i128 u8 u16 u32 u64 u128 f32 f64 char str string
+        bytes byte_buf unit unit_struct seq tuple tuple_struct map struct
+        identifier ignored_any
+    }
+}
+
+/// The items of an array, or the entries of an object.
+struct Items<'a, 'de: 'a> {
+    de: &'a mut FrameDeserializer<'de>,
+    remaining: usize,
+}
+
+impl<'a, 'de> SeqAccess<'de> for Items<'a, 'de> {
+    type Error = Error;
+
+    fn next_element_seed<T: DeserializeSeed<'de>>(
+        &mut self,
+        seed: T,
+    ) -> Result<Option<T::Value>, Error> {
+        if self.remaining == 0 {
+            return Ok(None);
+        }
+        self.remaining -= 1;
+        seed.deserialize(&mut *self.de).map(Some)
+    }
+
+    fn size_hint(&self) -> Option<usize> {
+        Some(self.remaining)
+    }
+}
+
+impl<'a, 'de> MapAccess<'de> for Items<'a, 'de> {
+    type Error = Error;
+
+    fn next_key_seed<K: DeserializeSeed<'de>>(
+        &mut self,
+        seed: K,
+    ) -> Result<Option<K::Value>, Error> {
+        if self.remaining == 0 {
+            return Ok(None);
+        }
+        self.remaining -= 1;
+        let key = self.de.take_str()?;
+        seed.deserialize(BorrowedStrDeserializer::new(key)).map(Some)
+    }
+
+    fn next_value_seed<V: DeserializeSeed<'de>>(&mut self, seed: V) -> Result<V::Value, Error> {
+        seed.deserialize(&mut *self.de)
+    }
+
+    fn size_hint(&self) -> Option<usize> {
+        Some(self.remaining)
+    }
+}
+
+/// A packed array of floats, of `width` bytes each.
+struct Floats<'de> {
+    bytes: &'de [u8],
+    width: usize,
+}
+
+impl<'de> SeqAccess<'de> for Floats<'de> {
+    type Error = Error;
+
+    fn next_element_seed<T: DeserializeSeed<'de>>(
+        &mut self,
+        seed: T,
+    ) -> Result<Option<T::Value>, Error> {
+        if self.bytes.is_empty() {
+            return Ok(None);
+        }
+        let (head, tail) = self.bytes.split_at(self.width);
+        self.bytes = tail;
+        let x = if self.width == 4 {
+            let mut bytes = [0; 4];
+            bytes.copy_from_slice(head);
+            f64::from(f32::from_le_bytes(bytes))
+        } else {
+            let mut bytes = [0; 8];
+            bytes.copy_from_slice(head);
+            f64::from_le_bytes(bytes)
+        };
+        seed.deserialize(x.into_deserializer()).map(Some)
+    }
+
+    fn size_hint(&self) -> Option<usize> {
+        Some(self.bytes.len() / self.width)
+    }
+}
+
+impl<'a, 'de> EnumAccess<'de> for &'a mut FrameDeserializer<'de> {
+    type Error = Error;
+    type Variant = Self;
+
+    fn variant_seed<V: DeserializeSeed<'de>>(self, seed: V) -> Result<(V::Value, Self), Error> {
+        let key = self.take_str()?;
+        let variant = seed.deserialize(BorrowedStrDeserializer::<Error>::new(key))?;
+        Ok((variant, self))
+    }
+}
+
+impl<'a, 'de> VariantAccess<'de> for &'a mut FrameDeserializer<'de> {
+    type Error = Error;
+
+    fn unit_variant(self) -> Result<(), Error> {
+        de::Deserialize::deserialize(self)
+    }
+
+    fn newtype_variant_seed<T: DeserializeSeed<'de>>(self, seed: T) -> Result<T::Value, Error> {
+        seed.deserialize(self)
+    }
+
+    fn tuple_variant<V: Visitor<'de>>(self, _len: usize, visitor: V) -> Result<V::Value, Error> {
+        self.deserialize_any(visitor)
+    }
+
+    fn struct_variant<V: Visitor<'de>>(
+        self,
+        _fields: &'static [&'static str],
+        visitor: V,
+    ) -> Result<V::Value, Error> {
+        self.deserialize_any(visitor)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::collections::BTreeMap;
+
+    fn round_trip(v: &Value) -> Vec<u8> {
+        let mut buf = Vec::new();
+        write_frame(v, &mut buf);
+        let mut header = [0; HEADER_LEN];
+        header.copy_from_slice(&buf[..HEADER_LEN]);
+        assert_eq!(payload_len(&header), Some(buf.len() - HEADER_LEN));
+        assert_eq!(&from_frame::<Value>(&buf[HEADER_LEN..]).unwrap(), v);
+        buf
+    }
+
+    #[test]
+    fn values() {
+        round_trip(&json!(null));
+        round_trip(&json!([true, false, 0, -1, u64::max_value(), i64::min_value(), 0.5]));
+        round_trip(&json!({"method": "edit", "params": {"chars": "Löwe 老虎", "v": []}}));
+        round_trip(&json!([[], [1.5], [0.1, 2.0], [7.0, 3.0, 8.5], {"": [1, 2.5]}]));
+    }
+
+    #[test]
+    fn packed_floats() {
+        let widths = json!([[28.0, 8.0, 0.25], [0.1]]);
+        let buf = round_trip(&widths);
+        assert_eq!(buf[HEADER_LEN], TAG_ARRAY);
+        // 28.0 etc. fit in an f32, 0.1 does not
+        assert_eq!(buf[HEADER_LEN + 5], TAG_F32_ARRAY);
+        assert_eq!(buf[HEADER_LEN + 5 + 5 + 12], TAG_F64_ARRAY);
+        let decoded: Vec<Vec<f64>> = from_frame(&buf[HEADER_LEN..]).unwrap();
+        assert_eq!(decoded, vec![vec![28.0, 8.0, 0.25], vec![0.1]]);
+    }
+
+    // fields are in order, as they are in a `Value`
+    #[derive(Serialize)]
+    #[serde(rename_all = "snake_case")]
+    enum Op<'a> {
+        Ins { lines: Vec<&'a str>, n: usize },
+        Skip(usize),
+        Copy(usize, i64),
+        Invalidate,
+    }
+
+    #[derive(Serialize)]
+    struct Update<'a> {
+        data: &'a [u8],
+        ops: Vec<Op<'a>>,
+        pristine: (bool, ()),
+        #[serde(skip_serializing_if = "Option::is_none")]
+        rev: Option<u64>,
+        styles: BTreeMap<usize, char>,
+        widths: Vec<f64>,
+    }
+
+    #[test]
+    fn typed() {
+        // a typed frame is the frame of the equivalent Value
+        let update = Update {
+            data: &[0, 255],
+            ops: vec![
+                Op::Ins { lines: vec!["Löwe", ""], n: 2 },
+                Op::Skip(3),
+                Op::Copy(1, -1),
+                Op::Invalidate,
+            ],
+            pristine: (true, ()),
+            rev: None,
+            styles: vec![(0, 'a'), (17, '老')].into_iter().collect(),
+            widths: vec![7.0, 7.5, f64::NAN, -0.1],
+        };
+        let value = serde_json::to_value(&update).unwrap();
+        let mut expected = Vec::new();
+        write_frame(&value, &mut expected);
+        let mut buf = vec![1, 2];
+        to_frame(&update, &mut buf).unwrap();
+        assert_eq!(&buf[..2], &[1, 2]);
+        assert_eq!(&buf[2..], &expected[..]);
+        assert_eq!(from_frame::<Value>(&buf[2 + HEADER_LEN..]).unwrap(), value);
+        // NaN makes null, so the widths are not packed, unlike these
+        buf.clear();
+        to_frame(&[[28.0, 8.0], [0.1, 1.0]], &mut buf).unwrap();
+        assert_eq!(buf[HEADER_LEN + 5], TAG_F32_ARRAY);
+        assert_eq!(buf[HEADER_LEN + 5 + 5 + 8], TAG_F64_ARRAY);
+        assert_eq!(buf.len(), HEADER_LEN + 5 + 5 + 8 + 5 + 16);
+        let decoded: Vec<Vec<f64>> = from_frame(&buf[HEADER_LEN..]).unwrap();
+        assert_eq!(decoded, vec![vec![28.0, 8.0], vec![0.1, 1.0]]);
+        let mut keys = BTreeMap::new();
+        keys.insert(vec![1], 0);
+        assert!(to_frame(&keys, &mut buf).is_err());
+        assert_eq!(buf.len(), HEADER_LEN + 5 + 5 + 8 + 5 + 16);
+    }
+
+    #[derive(Deserialize, Debug, PartialEq)]
+    #[serde(rename_all = "snake_case")]
+    enum Req<'a> {
+        Measure {
+            id: u64,
+            #[serde(borrow)]
+            strings: Vec<&'a str>,
+        },
+        Unit,
+        Wrap(Option<u32>),
+    }
+
+    #[test]
+    fn borrowed() {
+        let v =
+            json!([{"measure": {"id": 3, "strings": ["a", "\"b\"\n"]}}, "unit", {"wrap": null}]);
+        let mut buf = Vec::new();
+        write_frame(&v, &mut buf);
+        let payload = &buf[HEADER_LEN..];
+        let reqs: Vec<Req> = from_frame(payload).unwrap();
+        assert_eq!(
+            reqs,
+            vec![Req::Measure { id: 3, strings: vec!["a", "\"b\"\n"] }, Req::Unit, Req::Wrap(None)]
+        );
+        // strings point into the payload
+        if let Req::Measure { ref strings, .. } = reqs[0] {
+            let start = payload.as_ptr() as usize;
+            let ptr = strings[1].as_ptr() as usize;
+            assert!(ptr > start && ptr < start + payload.len());
+        }
+        assert!(from_frame::<Value>(&payload[..payload.len() - 1]).is_err());
+        assert!(from_frame::<Value>(&[TAG_NULL, TAG_NULL]).is_err());
+    }
+
+    #[test]
+    fn tagged_enum() {
+        #[derive(Deserialize, Debug, PartialEq)]
+        #[serde(tag = "method", content = "params")]
+        #[serde(rename_all = "snake_case")]
+        enum Notif {
+            Scroll { first: i64, last: i64 },
+        }
+        let v = json!({"method": "scroll", "params": {"first": -1, "last": 40}});
+        let mut buf = Vec::new();
+        write_frame(&v, &mut buf);
+        let notif: Notif = from_frame(&buf[HEADER_LEN..]).unwrap();
+        assert_eq!(notif, Notif::Scroll { first: -1, last: 40 });
+    }
+}
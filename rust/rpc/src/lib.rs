@@ -21,6 +21,15 @@
 //!
 //! Because these changes make the protocol not fully compliant with the spec,
 //! the `"jsonrpc"` member is omitted from request and response objects.
+//!
+//! Messages are sent as lines of JSON, unless the peer opts into the
+//! [`binary`] framing by sending a binary frame, after which they are
+//! sent as binary frames too. Incoming frames are deserialized straight
+//! into the handler's types, and the `_typed` methods of [`Peer`] encode
+//! params and decode results without going through a `Value`.
+//!
+//! [`binary`]: binary/index.html
+//! [`Peer`]: trait.Peer.html
 #![allow(clippy::boxed_local, clippy::or_fun_call)]
 
 #[macro_use]
@@ -34,11 +43,13 @@ extern crate xi_trace;
 #[macro_use]
 extern crate log;
 
+pub mod binary;
 mod error;
 mod parse;
 
 pub mod test_utils;
 
+use std::cell::RefCell;
 use std::cmp;
 use std::collections::{BTreeMap, BinaryHeap, VecDeque};
 use std::io::{self, BufRead, Write};
@@ -49,16 +60,28 @@ use std::thread;
 use std::time::{Duration, Instant};
 
 use serde::de::DeserializeOwned;
+use serde::Serialize;
 use serde_json::Value;
 
 use xi_trace::{trace, trace_block, trace_block_payload, trace_payload};
 
 pub use crate::error::{Error, ReadError, RemoteError};
-use crate::parse::{Call, MessageReader, Response, RpcObject};
+pub use crate::parse::RawResponse;
+use crate::parse::{Call, Message, MessageReader, RawCall, Response, RpcObject};
 
 /// The maximum duration we will block on a reader before checking for an task.
 const MAX_IDLE_WAIT: Duration = Duration::from_millis(5);
 
+/// The capacity above which the buffer that messages are encoded into is
+/// freed after use, rather than kept for the next message.
+const MAX_RETAINED_SEND_BUF: usize = 1 << 20;
+
+thread_local! {
+    /// The buffer that messages sent from this thread are encoded into,
+    /// kept to save allocating one per message.
+    static SEND_BUF: RefCell<Vec<u8>> = RefCell::new(Vec::new());
+}
+
 /// An interface to access the other side of the RPC channel. The main purpose
 /// is to send RPC requests and notifications to the peer.
 ///
@@ -86,6 +109,21 @@ pub trait Peer: Send + 'static {
     fn send_rpc_request_async(&self, method: &str, params: &Value, f: Box<dyn Callback>);
     /// Sends a request (synchronous RPC) to the peer, and waits for the result.
     fn send_rpc_request(&self, method: &str, params: &Value) -> Result<Value, Error>;
+    /// Like `send_rpc_notification`, but encodes `params`, which may be of
+    /// any `Serialize` type, directly into the message.
+    fn send_rpc_notification_typed(&self, method: &str, params: &dyn Params) {
+        self.send_rpc_notification(method, &params.to_value())
+    }
+    /// Like `send_rpc_request`, but encodes `params` directly into the
+    /// message, and returns the result as it was received, to be
+    /// deserialized with `RawResponse::parse`.
+    fn send_rpc_request_typed(
+        &self,
+        method: &str,
+        params: &dyn Params,
+    ) -> Result<RawResponse, Error> {
+        self.send_rpc_request(method, &params.to_value()).map(RawResponse::from)
+    }
     /// Determines whether an incoming request (or notification) is
     /// pending. This is intended to reduce latency for bulk operations
     /// done in the background.
@@ -107,6 +145,43 @@ pub trait Peer: Send + 'static {
 /// The `Peer` trait object.
 pub type RpcPeer = Box<dyn Peer>;
 
+/// The params of a request or notification.
+///
+/// This is implemented for all `Serialize` types, and lets the `Peer`
+/// trait object encode them without first converting them to a `Value`.
+pub trait Params {
+    /// Converts the params to a `Value`.
+    fn to_value(&self) -> Value;
+    /// Appends a message with these params to `buf`, as a binary frame
+    /// if `is_binary`, or else as a line of JSON.
+    fn write_message(&self, id: Option<usize>, method: &str, is_binary: bool, buf: &mut Vec<u8>);
+}
+
+impl<T: Serialize + ?Sized> Params for T {
+    fn to_value(&self) -> Value {
+        serde_json::to_value(self).expect("failed to serialize params")
+    }
+
+    fn write_message(&self, id: Option<usize>, method: &str, is_binary: bool, buf: &mut Vec<u8>) {
+        let msg = OutgoingMessage { id, method, params: self };
+        if is_binary {
+            binary::to_frame(&msg, buf).expect("failed to serialize params");
+        } else {
+            serde_json::to_writer(&mut *buf, &msg).expect("failed to serialize params");
+            buf.push(b'\n');
+        }
+    }
+}
+
+/// A request, or a notification if it has no id.
+#[derive(Serialize)]
+struct OutgoingMessage<'a, P: ?Sized> {
+    #[serde(skip_serializing_if = "Option::is_none")]
+    id: Option<usize>,
+    method: &'a str,
+    params: &'a P,
+}
+
 pub struct RpcCtx {
     peer: RpcPeer,
 }
@@ -169,21 +244,28 @@ impl<F: Send + FnOnce(usize)> IdleProc for F {
 }
 
 enum ResponseHandler {
-    Chan(mpsc::Sender<Result<Value, Error>>),
+    Chan(mpsc::Sender<Result<RawResponse, Error>>),
     Callback(Box<dyn Callback>),
 }
 
 impl ResponseHandler {
-    fn invoke(self, result: Result<Value, Error>) {
+    fn invoke(self, result: Result<RawResponse, Error>) {
         match self {
             ResponseHandler::Chan(tx) => {
                 let _ = tx.send(result);
             }
-            ResponseHandler::Callback(f) => f.call(result),
+            ResponseHandler::Callback(f) => f.call(result.and_then(into_value)),
         }
     }
 }
 
+fn into_value(resp: RawResponse) -> Result<Value, Error> {
+    resp.into_value().map_err(|err| {
+        error!("failed to parse response: {}", err);
+        Error::InvalidResponse
+    })
+}
+
 #[derive(Debug, PartialEq, Eq)]
 struct Timer {
     fire_after: Instant,
@@ -191,7 +273,7 @@ struct Timer {
 }
 
 struct RpcState<W: Write> {
-    rx_queue: Mutex<VecDeque<Result<RpcObject, ReadError>>>,
+    rx_queue: Mutex<VecDeque<Result<RawCall, ReadError>>>,
     rx_cvar: Condvar,
     writer: Mutex<W>,
     id: AtomicUsize,
@@ -200,6 +282,7 @@ struct RpcState<W: Write> {
     timers: Mutex<BinaryHeap<Timer>>,
     needs_exit: AtomicBool,
     is_blocked: AtomicBool,
+    is_binary: AtomicBool,
 }
 
 /// A structure holding the state of a main loop for handling RPC's.
@@ -222,6 +305,7 @@ impl<W: Write + Send> RpcLoop<W> {
             timers: Mutex::new(BinaryHeap::new()),
             needs_exit: AtomicBool::new(false),
             is_blocked: AtomicBool::new(false),
+            is_binary: AtomicBool::new(false),
         }));
         RpcLoop { reader: MessageReader::default(), peer: rpc_peer }
     }
@@ -269,8 +353,8 @@ impl<W: Write + Send> RpcLoop<W> {
                         break;
                     }
 
-                    let json = match self.reader.next(&mut stream) {
-                        Ok(json) => json,
+                    let msg = match self.reader.next_message(&mut stream) {
+                        Ok(msg) => msg,
                         Err(err) => {
                             if self.peer.0.is_blocked.load(Ordering::Acquire) {
                                 error!("failed to parse response json: {}", err);
@@ -280,22 +364,30 @@ impl<W: Write + Send> RpcLoop<W> {
                             break;
                         }
                     };
-                    if json.is_response() {
-                        let id = json.get_id().unwrap();
-                        let _resp =
-                            trace_block_payload("read loop response", &["rpc"], format!("{}", id));
-                        match json.into_response() {
-                            Ok(resp) => {
-                                let resp = resp.map_err(Error::from);
-                                self.peer.handle_response(id, resp);
-                            }
-                            Err(msg) => {
-                                error!("failed to parse response: {}", msg);
-                                self.peer.handle_response(id, Err(Error::InvalidResponse));
+                    // a peer that sends binary frames can also read them
+                    if self.reader.is_binary() && !self.peer.is_binary() {
+                        trace("peer switched to binary framing", &["rpc"]);
+                        self.peer.set_binary(true);
+                    }
+                    match msg {
+                        Message::Response(id, resp) => {
+                            let _resp = trace_block_payload(
+                                "read loop response",
+                                &["rpc"],
+                                format!("{}", id),
+                            );
+                            match resp {
+                                Ok(resp) => {
+                                    let resp = resp.map_err(Error::from);
+                                    self.peer.handle_response(id, resp);
+                                }
+                                Err(msg) => {
+                                    error!("failed to parse response: {}", msg);
+                                    self.peer.handle_response(id, Err(Error::InvalidResponse));
+                                }
                             }
                         }
-                    } else {
-                        self.peer.put_rx(Ok(json));
+                        Message::Call(call) => self.peer.put_rx(Ok(call)),
                     }
                 }
             });
@@ -305,8 +397,8 @@ impl<W: Write + Send> RpcLoop<W> {
                 let read_result = next_read(&peer, handler, &ctx);
                 let _trace = trace_block("main got msg", &["rpc"]);
 
-                let json = match read_result {
-                    Ok(json) => json,
+                let call = match read_result {
+                    Ok(call) => call,
                     Err(err) => {
                         trace_payload("main loop err", &["rpc"], err.to_string());
                         // finish idle work before disconnecting;
@@ -319,8 +411,8 @@ impl<W: Write + Send> RpcLoop<W> {
                     }
                 };
 
-                let method = json.get_method().map(String::from);
-                match json.into_rpc::<H::Notification, H::Request>() {
+                let method = call.get_method().map(String::from);
+                match call.into_rpc::<H::Notification, H::Request>() {
                     Ok(Call::Request(id, cmd)) => {
                         let _t = trace_block_payload("handle request", &["rpc"], method.unwrap());
                         let result = handler.handle_request(&ctx, cmd);
@@ -351,7 +443,7 @@ impl<W: Write + Send> RpcLoop<W> {
 
 /// Returns the next read result, checking for idle work when no
 /// result is available.
-fn next_read<W, H>(peer: &RawPeer<W>, handler: &mut H, ctx: &RpcCtx) -> Result<RpcObject, ReadError>
+fn next_read<W, H>(peer: &RawPeer<W>, handler: &mut H, ctx: &RpcCtx) -> Result<RawCall, ReadError>
 where
     W: Write + Send,
     H: Handler,
@@ -407,13 +499,7 @@ impl<W: Write + Send + 'static> Peer for RawPeer<W> {
     }
 
     fn send_rpc_notification(&self, method: &str, params: &Value) {
-        let _trace = trace_block_payload("send notif", &["rpc"], method.to_owned());
-        if let Err(e) = self.send(&json!({
-            "method": method,
-            "params": params,
-        })) {
-            error!("send error on send_rpc_notification method {}: {}", method, e);
-        }
+        self.send_rpc_notification_typed(method, params)
     }
 
     fn send_rpc_request_async(&self, method: &str, params: &Value, f: Box<dyn Callback>) {
@@ -422,6 +508,23 @@ impl<W: Write + Send + 'static> Peer for RawPeer<W> {
     }
 
     fn send_rpc_request(&self, method: &str, params: &Value) -> Result<Value, Error> {
+        self.send_rpc_request_typed(method, params).and_then(into_value)
+    }
+
+    fn send_rpc_notification_typed(&self, method: &str, params: &dyn Params) {
+        let _trace = trace_block_payload("send notif", &["rpc"], method.to_owned());
+        if let Err(e) =
+            self.send_with(|buf, is_binary| params.write_message(None, method, is_binary, buf))
+        {
+            error!("send error on send_rpc_notification method {}: {}", method, e);
+        }
+    }
+
+    fn send_rpc_request_typed(
+        &self,
+        method: &str,
+        params: &dyn Params,
+    ) -> Result<RawResponse, Error> {
         let _trace = trace_block_payload("send req sync", &["rpc"], method.to_owned());
         self.0.is_blocked.store(true, Ordering::Release);
         let (tx, rx) = mpsc::channel();
@@ -444,12 +547,51 @@ impl<W: Write + Send + 'static> Peer for RawPeer<W> {
 }
 
 impl<W: Write> RawPeer<W> {
+    /// Sets whether messages are sent as binary frames rather than lines
+    /// of JSON. This is set when the peer sends a binary frame, but may
+    /// also be set up front, when the peer is known to read them.
+    pub fn set_binary(&self, is_binary: bool) {
+        self.0.is_binary.store(is_binary, Ordering::Relaxed);
+    }
+
+    /// Returns `true` if messages are sent as binary frames.
+    pub fn is_binary(&self) -> bool {
+        self.0.is_binary.load(Ordering::Relaxed)
+    }
+
     fn send(&self, v: &Value) -> Result<(), io::Error> {
+        self.send_with(|buf, is_binary| {
+            if is_binary {
+                binary::write_frame(v, buf);
+            } else {
+                serde_json::to_writer(&mut *buf, v).unwrap();
+                buf.push(b'\n');
+            }
+        })
+    }
+
+    /// Writes the message that `encode` appends to the buffer it is
+    /// given, along with whether to encode it as a binary frame.
+    ///
+    /// The message is encoded into the sending thread's buffer, so that the
+    /// writer is only locked while it is written.
+    fn send_with<F>(&self, encode: F) -> Result<(), io::Error>
+    where
+        F: FnOnce(&mut Vec<u8>, bool),
+    {
         let _trace = trace_block("send", &["rpc"]);
-        let mut s = serde_json::to_string(v).unwrap();
-        s.push('\n');
-        self.0.writer.lock().unwrap().write_all(s.as_bytes())
-        // Technically, maybe we should flush here, but doesn't seem to be required.
+        let is_binary = self.is_binary();
+        SEND_BUF.with(|buf| {
+            let mut buf = buf.borrow_mut();
+            buf.clear();
+            encode(&mut buf, is_binary);
+            let result = self.0.writer.lock().unwrap().write_all(&buf);
+            // Technically, maybe we should flush here, but doesn't seem to be required.
+            if buf.capacity() > MAX_RETAINED_SEND_BUF {
+                *buf = Vec::new();
+            }
+            result
+        })
     }
 
     fn respond(&self, result: Response, id: u64) {
@@ -463,17 +605,15 @@ impl<W: Write> RawPeer<W> {
         }
     }
 
-    fn send_rpc_request_common(&self, method: &str, params: &Value, rh: ResponseHandler) {
+    fn send_rpc_request_common(&self, method: &str, params: &dyn Params, rh: ResponseHandler) {
         let id = self.0.id.fetch_add(1, Ordering::Relaxed);
         {
             let mut pending = self.0.pending.lock().unwrap();
             pending.insert(id, rh);
         }
-        if let Err(e) = self.send(&json!({
-            "id": id,
-            "method": method,
-            "params": params,
-        })) {
+        if let Err(e) =
+            self.send_with(|buf, is_binary| params.write_message(Some(id), method, is_binary, buf))
+        {
             let mut pending = self.0.pending.lock().unwrap();
             if let Some(rh) = pending.remove(&id) {
                 rh.invoke(Err(Error::Io(e)));
@@ -481,7 +621,7 @@ impl<W: Write> RawPeer<W> {
         }
     }
 
-    fn handle_response(&self, id: u64, resp: Result<Value, Error>) {
+    fn handle_response(&self, id: u64, resp: Result<RawResponse, Error>) {
         let id = id as usize;
         let handler = {
             let mut pending = self.0.pending.lock().unwrap();
@@ -494,14 +634,14 @@ impl<W: Write> RawPeer<W> {
     }
 
     /// Get a message from the receive queue if available.
-    fn try_get_rx(&self) -> Option<Result<RpcObject, ReadError>> {
+    fn try_get_rx(&self) -> Option<Result<RawCall, ReadError>> {
         let mut queue = self.0.rx_queue.lock().unwrap();
         queue.pop_front()
     }
 
     /// Get a message from the receive queue, waiting for at most `Duration`
     /// and returning `None` if no message is available.
-    fn get_rx_timeout(&self, dur: Duration) -> Option<Result<RpcObject, ReadError>> {
+    fn get_rx_timeout(&self, dur: Duration) -> Option<Result<RawCall, ReadError>> {
         let mut queue = self.0.rx_queue.lock().unwrap();
         let result = self.0.rx_cvar.wait_timeout(queue, dur).unwrap();
         queue = result.0;
@@ -510,9 +650,9 @@ impl<W: Write> RawPeer<W> {
 
     /// Adds a message to the receive queue. The message should only
     /// be `None` if the read thread is exiting.
-    fn put_rx(&self, json: Result<RpcObject, ReadError>) {
+    fn put_rx(&self, call: Result<RawCall, ReadError>) {
         let mut queue = self.0.rx_queue.lock().unwrap();
-        queue.push_back(json);
+        queue.push_back(call);
         self.0.rx_cvar.notify_one();
     }
 
@@ -14,11 +14,13 @@
 
 //! Parsing of raw JSON messages into RPC objects.
 
-use std::io::BufRead;
+use std::io::{self, BufRead, Read};
+use std::mem;
 
-use serde::de::DeserializeOwned;
+use serde::de::{Deserialize, DeserializeOwned, Deserializer, IgnoredAny};
 use serde_json::{Error as JsonError, Value};
 
+use crate::binary::{self, FRAME_MARKER, HEADER_LEN};
 use crate::error::{ReadError, RemoteError};
 
 /// A unique identifier attached to request RPCs.
@@ -27,10 +29,74 @@ type RequestId = u64;
 /// An RPC response, received from the peer.
 pub type Response = Result<Value, RemoteError>;
 
+/// The result of a request, as it was received from the peer.
+///
+/// A result that arrived in a binary frame is kept as the frame, so that
+/// it can be deserialized straight into the type the caller wants, with
+/// no `Value` in between.
+#[derive(Debug)]
+pub struct RawResponse(RawResult);
+
+#[derive(Debug)]
+enum RawResult {
+    Value(Value),
+    /// The payload of a frame holding a response object.
+    Frame(Vec<u8>),
+}
+
+/// A message, parsed only as far as is needed to route it.
+pub(crate) enum Message {
+    /// A request or notification, to be handled on the main thread.
+    Call(RawCall),
+    /// A response, and the id of the request it answers; see
+    /// `RpcObject::into_response`.
+    Response(RequestId, Result<Result<RawResponse, RemoteError>, String>),
+}
+
+/// A request or notification, as it was received from the peer.
+#[derive(Debug)]
+pub(crate) enum RawCall {
+    Json(RpcObject),
+    Frame { id: Option<RequestId>, method: Option<String>, payload: Vec<u8> },
+}
+
+/// The fields of a message in a binary frame that are needed to route it.
+#[derive(Deserialize)]
+struct FrameHead {
+    id: Option<RequestId>,
+    method: Option<String>,
+    #[serde(default, deserialize_with = "present")]
+    result: Option<IgnoredAny>,
+    #[serde(default, deserialize_with = "present")]
+    error: Option<RemoteError>,
+}
+
+/// Deserializes a field that may be missing, so that a `null` is present.
+fn present<'de, D, T>(deserializer: D) -> Result<Option<T>, D::Error>
+where
+    D: Deserializer<'de>,
+    T: Deserialize<'de>,
+{
+    T::deserialize(deserializer).map(Some)
+}
+
+/// The `result` of a response object.
+#[derive(Deserialize)]
+struct ResultField<T> {
+    result: T,
+}
+
 /// Reads and parses RPC messages from a stream, maintaining an
 /// internal buffer.
+///
+/// Messages are either lines of JSON or, when they start with
+/// `FRAME_MARKER`, binary frames.
 #[derive(Debug, Default)]
-pub struct MessageReader(String);
+pub struct MessageReader {
+    line: String,
+    frame: Vec<u8>,
+    is_binary: bool,
+}
 
 /// An internal type used during initial JSON parsing.
 ///
@@ -63,12 +129,93 @@ impl MessageReader {
     /// I/O error, if the stream is closed, or if the message is not
     /// a valid JSON object.
     pub fn next<R: BufRead>(&mut self, reader: &mut R) -> Result<RpcObject, ReadError> {
-        self.0.clear();
-        let _ = reader.read_line(&mut self.0)?;
-        if self.0.is_empty() {
+        self.is_binary = reader.fill_buf()?.first() == Some(&FRAME_MARKER);
+        if self.is_binary {
+            return self.next_frame(reader);
+        }
+        self.line.clear();
+        let _ = reader.read_line(&mut self.line)?;
+        if self.line.is_empty() {
             Err(ReadError::Disconnect)
         } else {
-            self.parse(&self.0)
+            self.parse(&self.line)
+        }
+    }
+
+    /// Like `next`, but leaves the payload of a binary frame undecoded,
+    /// apart from the fields needed to tell what kind of message it is.
+    pub(crate) fn next_message<R: BufRead>(
+        &mut self,
+        reader: &mut R,
+    ) -> Result<Message, ReadError> {
+        if reader.fill_buf()?.first() != Some(&FRAME_MARKER) {
+            let obj = self.next(reader)?;
+            if !obj.is_response() {
+                return Ok(Message::Call(RawCall::Json(obj)));
+            }
+            let id = obj.get_id().unwrap();
+            let resp = obj.into_response().map(|resp| resp.map(RawResponse::from));
+            return Ok(Message::Response(id, resp));
+        }
+        self.is_binary = true;
+        self.read_frame(reader)?;
+        let _trace = xi_trace::trace_block("parse frame head", &["rpc"]);
+        if !binary::is_object(&self.frame) {
+            return Err(ReadError::NotObject);
+        }
+        let head = binary::from_frame::<FrameHead>(&self.frame)?;
+        // the payload is handed on, so the buffer is not reused this time
+        let payload = mem::replace(&mut self.frame, Vec::new());
+        let id = match head.id {
+            Some(id) if head.method.is_none() => id,
+            id => return Ok(Message::Call(RawCall::Frame { id, method: head.method, payload })),
+        };
+        let resp = if head.result.is_some() == head.error.is_some() {
+            Err("RPC response must contain exactly one of\
+                 'error' or 'result' fields."
+                .into())
+        } else {
+            match head.error {
+                Some(err) => Ok(Err(err)),
+                None => Ok(Ok(RawResponse(RawResult::Frame(payload)))),
+            }
+        };
+        Ok(Message::Response(id, resp))
+    }
+
+    /// Returns `true` if the last message read was a binary frame.
+    pub fn is_binary(&self) -> bool {
+        self.is_binary
+    }
+
+    fn next_frame<R: BufRead>(&mut self, reader: &mut R) -> Result<RpcObject, ReadError> {
+        self.read_frame(reader)?;
+        self.parse_frame(&self.frame)
+    }
+
+    /// Reads a binary frame into `self.frame`.
+    fn read_frame<R: BufRead>(&mut self, reader: &mut R) -> Result<(), ReadError> {
+        let mut header = [0; HEADER_LEN];
+        reader.read_exact(&mut header)?;
+        let len = binary::payload_len(&header).unwrap();
+        // the buffer is reused, so it only grows for the largest frames
+        self.frame.clear();
+        reader.by_ref().take(len as u64).read_to_end(&mut self.frame)?;
+        if self.frame.len() < len {
+            return Err(io::Error::new(io::ErrorKind::UnexpectedEof, "truncated frame").into());
+        }
+        Ok(())
+    }
+
+    /// Attempts to parse the payload of a binary frame as an RPC Object.
+    #[doc(hidden)]
+    pub fn parse_frame(&self, payload: &[u8]) -> Result<RpcObject, ReadError> {
+        let _trace = xi_trace::trace_block("parse frame", &["rpc"]);
+        let val = binary::from_frame::<Value>(payload)?;
+        if !val.is_object() {
+            Err(ReadError::NotObject)
+        } else {
+            Ok(val.into())
         }
     }
 
@@ -164,6 +311,65 @@ impl RpcObject {
     }
 }
 
+impl RawResponse {
+    /// Deserializes the result, borrowing from it where `T` allows.
+    pub fn parse<'de, T: Deserialize<'de>>(&'de self) -> Result<T, JsonError> {
+        match self.0 {
+            RawResult::Value(ref v) => T::deserialize(v),
+            RawResult::Frame(ref payload) => {
+                binary::from_frame::<ResultField<T>>(payload).map(|field| field.result)
+            }
+        }
+    }
+
+    /// Converts the result into a `Value`.
+    pub fn into_value(self) -> Result<Value, JsonError> {
+        match self.0 {
+            RawResult::Value(v) => Ok(v),
+            RawResult::Frame(_) => self.parse(),
+        }
+    }
+}
+
+impl From<Value> for RawResponse {
+    fn from(v: Value) -> RawResponse {
+        RawResponse(RawResult::Value(v))
+    }
+}
+
+impl RawCall {
+    /// Returns the 'method' field of the message, if present.
+    pub(crate) fn get_method(&self) -> Option<&str> {
+        match *self {
+            RawCall::Json(ref obj) => obj.get_method(),
+            RawCall::Frame { ref method, .. } => method.as_ref().map(String::as_str),
+        }
+    }
+
+    /// Like `RpcObject::into_rpc`, deserializing a binary frame straight
+    /// into the notification or request type.
+    pub(crate) fn into_rpc<N, R>(self) -> Result<Call<N, R>, JsonError>
+    where
+        N: DeserializeOwned,
+        R: DeserializeOwned,
+    {
+        let (id, payload) = match self {
+            RawCall::Json(obj) => return obj.into_rpc(),
+            RawCall::Frame { id, payload, .. } => (id, payload),
+        };
+        match id {
+            Some(id) => match binary::from_frame::<R>(&payload) {
+                Ok(resp) => Ok(Call::Request(id, resp)),
+                Err(err) => Ok(Call::InvalidRequest(id, err.into())),
+            },
+            None => {
+                let result = binary::from_frame::<N>(&payload)?;
+                Ok(Call::Notification(result))
+            }
+        }
+    }
+}
+
 impl From<Value> for RpcObject {
     fn from(v: Value) -> RpcObject {
         RpcObject(v)
@@ -255,4 +461,73 @@ mod tests {
         let e = serde_json::from_str::<RemoteError>(json).unwrap();
         assert_eq!(e, RemoteError::InvalidRequest(None));
     }
+
+    fn read_message(messages: &[Value]) -> Vec<Message> {
+        let mut input = Vec::new();
+        for msg in messages {
+            binary::write_frame(msg, &mut input);
+        }
+        let mut reader = MessageReader::default();
+        let mut input = input.as_slice();
+        let mut read = Vec::new();
+        while !input.is_empty() {
+            read.push(reader.next_message(&mut input).unwrap());
+            assert!(reader.is_binary());
+        }
+        read
+    }
+
+    #[test]
+    fn frame_messages() {
+        let read = read_message(&[
+            json!({"id": 5, "result": {"words": ["Löwe", "tiger"], "widths": [7.0, 8.5]}}),
+            json!({"id": 6, "error": {"code": 420, "message": "chill out"}}),
+            json!({"id": 7, "result": null, "error": null}),
+            json!({"id": 0, "method": "new_view", "params": {}}),
+            json!({"method": "close_view", "params": {"view_id": "view-id-1"}}),
+        ]);
+        let mut read = read.into_iter();
+        match read.next() {
+            Some(Message::Response(5, Ok(Ok(resp)))) => {
+                #[derive(Deserialize)]
+                struct Measured<'a> {
+                    #[serde(borrow)]
+                    words: Vec<&'a str>,
+                    widths: Vec<f64>,
+                }
+                let measured = resp.parse::<Measured>().unwrap();
+                assert_eq!(measured.words, vec!["Löwe", "tiger"]);
+                assert_eq!(measured.widths, vec![7.0, 8.5]);
+                let words = resp.parse::<Value>().unwrap()["words"].clone();
+                assert_eq!(resp.into_value().unwrap()["words"], words);
+            }
+            _ => panic!("expected a result"),
+        }
+        match read.next() {
+            Some(Message::Response(6, Ok(Err(err)))) => {
+                assert_eq!(err, RemoteError::custom(420, "chill out", None))
+            }
+            _ => panic!("expected an error"),
+        }
+        match read.next() {
+            Some(Message::Response(7, Err(_))) => (),
+            _ => panic!("expected an invalid response"),
+        }
+        match read.next() {
+            Some(Message::Call(call)) => {
+                assert_eq!(call.get_method(), Some("new_view"));
+                let req = call.into_rpc::<TestN, TestR>().unwrap();
+                assert_eq!(req, Call::Request(0, TestR::NewView { file_path: None }));
+            }
+            _ => panic!("expected a request"),
+        }
+        match read.next() {
+            Some(Message::Call(call)) => {
+                let notif = call.into_rpc::<TestN, TestR>().unwrap();
+                let view_id = "view-id-1".into();
+                assert_eq!(notif, Call::Notification(TestN::CloseView { view_id }));
+            }
+            _ => panic!("expected a notification"),
+        }
+    }
 }
@@ -26,11 +26,11 @@ use super::{Callback, Error, MessageReader, Peer, ReadError, Response, RpcObject
 ///
 /// This lets the tx side of an mpsc::channel serve as the destination
 /// stream for an RPC loop.
-pub struct DummyWriter(Sender<String>);
+pub struct DummyWriter(Sender<Vec<u8>>);
 
 /// Wraps an instance of `mpsc::Receiver`, providing convenience methods
 /// for parsing received messages.
-pub struct DummyReader(MessageReader, Receiver<String>);
+pub struct DummyReader(MessageReader, Receiver<Vec<u8>>);
 
 /// An Peer that doesn't do anything.
 #[derive(Debug, Clone)]
@@ -55,7 +55,13 @@ impl DummyReader {
     /// This method makes no assumptions about the contents of the
     /// message, and does no error handling.
     pub fn next_timeout(&mut self, timeout: Duration) -> Option<Result<RpcObject, ReadError>> {
-        self.1.recv_timeout(timeout).ok().map(|s| self.0.parse(&s))
+        let reader = &mut self.0;
+        self.1.recv_timeout(timeout).ok().map(|buf| reader.next(&mut buf.as_slice()))
+    }
+
+    /// Returns `true` if the last message read was a binary frame.
+    pub fn last_was_binary(&self) -> bool {
+        self.0.is_binary()
     }
 
     /// Reads and parses a response object.
@@ -97,9 +103,8 @@ impl DummyReader {
 
 impl Write for DummyWriter {
     fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
-        let s = String::from_utf8(buf.to_vec()).unwrap();
         self.0
-            .send(s)
+            .send(buf.to_vec())
             .map_err(|err| io::Error::new(io::ErrorKind::Other, format!("{:?}", err)))
             .map(|_| buf.len())
     }
@@ -15,11 +15,12 @@
 extern crate serde_json;
 extern crate xi_rpc;
 
-use std::io;
+use std::io::{self, BufReader, Cursor, Read};
 use std::time::Duration;
 
 use serde_json::Value;
-use xi_rpc::test_utils::{make_reader, test_channel};
+use xi_rpc::binary::write_frame;
+use xi_rpc::test_utils::{make_reader, test_channel, DummyReader};
 use xi_rpc::{Handler, ReadError, RemoteError, RpcCall, RpcCtx, RpcLoop};
 
 /// Handler that responds to requests with whatever params they sent.
@@ -90,3 +91,99 @@ fn test_bad_json_err() {
         Ok(()) => panic!("Expected an error"),
     }
 }
+
+#[test]
+fn test_recv_binary() {
+    // a peer that sends binary frames is answered in binary frames
+    let mut handler = EchoHandler;
+    let (tx, mut rx) = test_channel();
+    let mut rpc_looper = RpcLoop::new(tx);
+    let mut input = br#"{"id": 0, "method": "hullo", "params": {"words": "plz"}}"#.to_vec();
+    input.push(b'\n');
+    let widths = json!([[28.0, 8.0], [7.25]]);
+    write_frame(&json!({"id": 1, "method": "hullo", "params": widths}), &mut input);
+    write_frame(&json!({"method": "hullo", "params": {}}), &mut input);
+    assert!(rpc_looper.mainloop(|| Cursor::new(input), &mut handler).is_ok());
+    let resp = rx.expect_response().unwrap();
+    assert_eq!(resp["words"], json!("plz"));
+    let resp = rx.expect_response().unwrap();
+    assert!(rx.last_was_binary());
+    assert_eq!(resp, widths);
+    rx.expect_nothing();
+}
+
+#[test]
+fn test_truncated_frame_err() {
+    let mut handler = EchoHandler;
+    let mut rpc_looper = RpcLoop::new(io::sink());
+    let mut input = Vec::new();
+    write_frame(&json!({"id": 0, "method": "hullo", "params": {}}), &mut input);
+    input.pop();
+    let exit = rpc_looper.mainloop(|| Cursor::new(input), &mut handler);
+    match exit {
+        Err(ReadError::Io(_)) => (),
+        Err(err) => panic!("Incorrect error: {:?}", err),
+        Ok(()) => panic!("Expected an error"),
+    }
+}
+
+/// Handler that asks the peer to measure some strings when notified.
+#[derive(Default)]
+struct MeasureHandler {
+    widths: Option<Vec<Vec<f64>>>,
+}
+
+#[allow(unused)]
+impl Handler for MeasureHandler {
+    type Notification = RpcCall;
+    type Request = RpcCall;
+    fn handle_notification(&mut self, ctx: &RpcCtx, rpc: Self::Notification) {
+        let strings: &[&[&str]] = &[&["a", "bb"], &["老虎"]];
+        let resp = ctx.get_peer().send_rpc_request_typed("measure_width", &strings).unwrap();
+        self.widths = Some(resp.parse().unwrap());
+    }
+    fn handle_request(&mut self, ctx: &RpcCtx, rpc: Self::Request) -> Result<Value, RemoteError> {
+        unreachable!()
+    }
+}
+
+/// Input that answers the first request written to `rx` in a binary frame,
+/// after reading out `input`.
+struct Responder {
+    input: Cursor<Vec<u8>>,
+    rx: Option<DummyReader>,
+}
+
+impl Read for Responder {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        let n = self.input.read(buf)?;
+        if n != 0 {
+            return Ok(n);
+        }
+        let mut rx = match self.rx.take() {
+            Some(rx) => rx,
+            None => return Ok(0),
+        };
+        let req = rx.expect_rpc("measure_width");
+        assert!(rx.last_was_binary());
+        assert_eq!(req.0["params"], json!([["a", "bb"], ["老虎"]]));
+        let mut resp = Vec::new();
+        write_frame(&json!({"id": req.get_id(), "result": [[7.0, 14.0], [28.5]]}), &mut resp);
+        self.input = Cursor::new(resp);
+        self.input.read(buf)
+    }
+}
+
+#[test]
+fn test_typed_request_binary() {
+    // a typed request to a peer that sends binary frames is sent as one,
+    // and its result parsed straight from the frame of the response
+    let mut handler = MeasureHandler::default();
+    let (tx, rx) = test_channel();
+    let mut rpc_looper = RpcLoop::new(tx);
+    let mut input = Vec::new();
+    write_frame(&json!({"method": "measure", "params": {}}), &mut input);
+    let r = BufReader::new(Responder { input: Cursor::new(input), rx: Some(rx) });
+    assert!(rpc_looper.mainloop(|| r, &mut handler).is_ok());
+    assert_eq!(handler.widths, Some(vec![vec![7.0, 14.0], vec![28.5]]));
+}
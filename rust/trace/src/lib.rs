@@ -582,6 +582,31 @@ impl<'a> SampleGuard<'a> {
         trace.record(guard.sample.as_ref().unwrap().clone());
         guard
     }
+
+    /// Whether the sample will be recorded, which is false if tracing was
+    /// disabled when it was created.
+    #[inline]
+    pub fn is_enabled(&self) -> bool {
+        self.trace.is_some()
+    }
+
+    /// Sets the payload recorded when the block ends, replacing any given at
+    /// its start. This is for what is only known at the end, such as how much
+    /// work the block did; Chrome's viewer shows the payloads of both ends of
+    /// the block. `payload` is only called if the sample is recorded, so it
+    /// costs nothing when tracing is disabled.
+    #[inline]
+    pub fn set_payload_with<P, F>(&mut self, payload: F)
+    where
+        P: Into<TracePayloadT>,
+        F: FnOnce() -> P,
+    {
+        if let Some(ref mut sample) = self.sample {
+            if let Some(ref mut args) = sample.args {
+                args.payload = Some(payload().into());
+            }
+        }
+    }
 }
 
 impl<'a> Drop for SampleGuard<'a> {
@@ -1199,6 +1224,28 @@ mod tests {
         assert_eq!(trace.get_samples_count(), 0);
     }
 
+    #[test]
+    fn test_block_set_payload() {
+        let trace = Trace::enabled(Config::with_limit_count(10));
+        {
+            let mut guard = trace.block("x", &["test"]);
+            assert!(guard.is_enabled());
+            guard.set_payload_with(|| to_payload("test_block_set_payload"));
+        }
+        let snapshot = trace.samples_cloned_unsorted();
+        // +2 for exe & thread name.
+        assert_eq!(snapshot.len(), 4);
+        assert_eq!(snapshot[2].args.as_ref().unwrap().payload, None);
+        assert_eq!(snapshot[3].event_type, SampleEventType::DurationEnd);
+        assert_eq!(snapshot[3].args.as_ref().unwrap().payload,
+                   Some(to_payload("test_block_set_payload").into()));
+
+        let trace = Trace::disabled();
+        let mut guard = trace.block("x", &["test"]);
+        assert!(!guard.is_enabled());
+        guard.set_payload_with(|| -> &'static str { panic!("payload of a disabled block") });
+    }
+
     #[test]
     fn test_get_samples_nested_trace() {
         let trace = Trace::enabled(Config::with_limit_count(11));
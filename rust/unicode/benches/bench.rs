@@ -15,12 +15,17 @@
 
 extern crate test;
 
+mod corpus;
+
 #[cfg(test)]
 mod bench {
+    use crate::corpus;
     use std::cmp::max;
     use test::{black_box, Bencher};
+    use xi_unicode::linebreak_properties_ascii;
     use xi_unicode::linebreak_property;
     use xi_unicode::linebreak_property_str;
+    use xi_unicode::EmojiExt;
     use xi_unicode::LineBreakIterator;
 
     fn linebreak_property_chars(s: &str) -> u8 {
@@ -123,4 +128,99 @@ mod bench {
         let s = "Now is the time for all good persons to come to the aid of their country.";
         b.iter(|| LineBreakIterator::new(s).count())
     }
+
+    // Throughput over larger inputs; `cargo bench` reports these in MB/s.
+    // See also examples/lb_throughput.rs, which reports ns/break as well.
+
+    fn bench_iter(b: &mut Bencher, s: &str) {
+        b.bytes = s.len() as u64;
+        b.iter(|| LineBreakIterator::new(black_box(s)).count())
+    }
+
+    fn bench_leaf(b: &mut Bencher, s: &str) {
+        b.bytes = s.len() as u64;
+        b.iter(|| corpus::count_leaf_breaks(black_box(s), corpus::LEAF_LEN))
+    }
+
+    #[bench]
+    fn lb_iter_source(b: &mut Bencher) {
+        bench_iter(b, &corpus::source_code());
+    }
+
+    #[bench]
+    fn lb_iter_cjk(b: &mut Bencher) {
+        bench_iter(b, &corpus::cjk());
+    }
+
+    #[bench]
+    fn lb_iter_sa(b: &mut Bencher) {
+        bench_iter(b, &corpus::sa());
+    }
+
+    #[bench]
+    fn lb_iter_emoji(b: &mut Bencher) {
+        bench_iter(b, &corpus::emoji());
+    }
+
+    #[bench]
+    fn lb_iter_log(b: &mut Bencher) {
+        bench_iter(b, &corpus::log());
+    }
+
+    #[bench]
+    fn lb_leaf_source(b: &mut Bencher) {
+        bench_leaf(b, &corpus::source_code());
+    }
+
+    #[bench]
+    fn lb_leaf_cjk(b: &mut Bencher) {
+        bench_leaf(b, &corpus::cjk());
+    }
+
+    #[bench]
+    fn lb_leaf_sa(b: &mut Bencher) {
+        bench_leaf(b, &corpus::sa());
+    }
+
+    #[bench]
+    fn lb_leaf_emoji(b: &mut Bencher) {
+        bench_leaf(b, &corpus::emoji());
+    }
+
+    #[bench]
+    fn lb_leaf_log(b: &mut Bencher) {
+        bench_leaf(b, &corpus::log());
+    }
+
+    // Classifying a block of ASCII at once, against one lookup per byte.
+
+    #[bench]
+    fn classify_ascii_source(b: &mut Bencher) {
+        let s = corpus::source_code();
+        let mut out = vec![0; s.len()];
+        b.bytes = s.len() as u64;
+        b.iter(|| linebreak_properties_ascii(black_box(s.as_bytes()), &mut out))
+    }
+
+    #[bench]
+    fn classify_str_source(b: &mut Bencher) {
+        let s = corpus::source_code();
+        let mut out = vec![0; s.len()];
+        b.bytes = s.len() as u64;
+        b.iter(|| {
+            let s = black_box(&s);
+            for (i, class) in out.iter_mut().enumerate() {
+                *class = linebreak_property_str(s, i).0;
+            }
+        })
+    }
+
+    #[bench]
+    fn emoji_props_emoji(b: &mut Bencher) {
+        let s = corpus::emoji();
+        b.bytes = s.len() as u64;
+        b.iter(|| {
+            black_box(&s).chars().filter(|c| c.is_emoji() || c.is_emoji_modifier_base()).count()
+        })
+    }
 }
@@ -0,0 +1,175 @@
+// Copyright 2026 The xi-editor Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! Inputs for the line breaking throughput benchmarks, shared by
+//! benches/bench.rs and examples/lb_throughput.rs.
+
+#![allow(dead_code)]
+
+use xi_unicode::LineBreakLeafIter;
+
+/// Leaf size used to model iteration over a rope; matches the maximum leaf
+/// size in xi-rope.
+pub const LEAF_LEN: usize = 1024;
+
+/// The size of each corpus, apart from the log.
+const CORPUS_LEN: usize = 64 * 1024;
+
+const LOG_LEN: usize = 4 * 1024 * 1024;
+
+static SOURCE_STR: &str = include_str!("../../src/lib.rs");
+
+static CJK_STR: &str = "吾輩は猫である。名前はまだ無い。どこで生れたかとんと見当がつかぬ。\
+何でも薄暗いじめじめした所でニャーニャー泣いていた事だけは記憶している。\
+天下皆知美之為美，斯惡已；皆知善之為善，斯不善已。故有無相生，難易相成，長短相形，高下相傾。\
+「道可道，非常道。」한국어는 한글로 적는다。\n";
+
+static SA_STR: &str = "اللغة العربية هي أكثر اللغات السامية تحدثًا، وإحدى أكثر اللغات انتشارًا \
+في العالم. ภาษาไทยเป็นภาษาที่มีระดับเสียงของคำแน่นอนหรือวรรณยุกต์เช่นเดียวกับภาษาจีน \
+ພາສາລາວເປັນພາສາທາງການຂອງລາວ ဗမာစာသည် မြန်မာနိုင်ငံ၏ ရုံးသုံးဘာသာစကား ဖြစ်သည်။\n";
+
+/// The words of the Thai, Lao and Burmese in `SA_STR`, for dictionary
+/// segmentation.
+pub static SA_WORDS: &[&str] = &[
+    "ภาษา",
+    "ไทย",
+    "เป็น",
+    "ที่",
+    "มี",
+    "ระดับ",
+    "เสียง",
+    "ของ",
+    "คำ",
+    "แน่นอน",
+    "หรือ",
+    "วรรณยุกต์",
+    "เช่น",
+    "เดียว",
+    "กับ",
+    "จีน",
+    "ພາສາ",
+    "ລາວ",
+    "ເປັນ",
+    "ທາງການ",
+    "ຂອງ",
+    "ဗမာ",
+    "စာ",
+    "သည်",
+    "မြန်မာ",
+    "နိုင်ငံ",
+    "ရုံး",
+    "သုံး",
+    "ဘာသာ",
+    "စကား",
+    "ဖြစ်",
+];
+
+static EMOJI_STR: &str = "family 👨‍👩‍👧‍👦 coder 👩🏽‍💻 flag 🏳️‍🌈 friends 🧑‍🤝‍🧑 \
+thumbs 👍🏿👍🏻 keycap 1️⃣ #️⃣ regional 🇯🇵🇫🇷🇧🇷 cook 👨🏾‍🍳 rescue 🧑‍🚒 tag 🏴󠁧󠁢󠁳󠁣󠁴󠁿\n";
+
+/// A named input for the benchmarks.
+pub struct Corpus {
+    pub name: &'static str,
+    pub text: String,
+}
+
+fn repeat_to(sample: &str, len: usize) -> String {
+    let mut result = String::with_capacity(len + sample.len());
+    while result.len() < len {
+        result.push_str(sample);
+    }
+    result
+}
+
+/// ASCII-heavy source code.
+pub fn source_code() -> String {
+    repeat_to(SOURCE_STR, CORPUS_LEN)
+}
+
+/// Chinese, Japanese and Korean prose.
+pub fn cjk() -> String {
+    repeat_to(CJK_STR, CORPUS_LEN)
+}
+
+/// Arabic, and Thai, Lao and Burmese, which are SA (complex context).
+pub fn sa() -> String {
+    repeat_to(SA_STR, CORPUS_LEN)
+}
+
+/// Emoji, including ZWJ, modifier and tag sequences.
+pub fn emoji() -> String {
+    repeat_to(EMOJI_STR, CORPUS_LEN)
+}
+
+/// A multi-megabyte log file, the case of rewrapping a large document.
+pub fn log() -> String {
+    let mut result = String::with_capacity(LOG_LEN + 256);
+    let mut i = 0u64;
+    while result.len() < LOG_LEN {
+        let level = ["INFO", "DEBUG", "WARN"][(i % 7 % 3) as usize];
+        result.push_str(&format!(
+            "2019-03-01T12:{:02}:{:02}.{:03}Z {} [xi_core::tabs] handling request id={} \
+             method=edit view_id=view-id-{} params={{\"method\":\"insert\",\"chars\":\"{}\"}}\n",
+            i / 60 % 60,
+            i % 60,
+            i * 37 % 1000,
+            level,
+            i,
+            i % 5,
+            "x".repeat((i * 13 % 40) as usize)
+        ));
+        i += 1;
+    }
+    result
+}
+
+pub fn corpora() -> Vec<Corpus> {
+    vec![
+        Corpus { name: "source", text: source_code() },
+        Corpus { name: "cjk", text: cjk() },
+        Corpus { name: "sa", text: sa() },
+        Corpus { name: "emoji", text: emoji() },
+        Corpus { name: "log", text: log() },
+    ]
+}
+
+/// Counts the breaks of `s` with `LineBreakLeafIter`, splitting it into
+/// leaves of about `leaf_len` bytes, the way a rope cursor does.
+pub fn count_leaf_breaks(s: &str, leaf_len: usize) -> usize {
+    let mut count = 0;
+    let mut start = 0;
+    let mut end = leaf_end(s, 0, leaf_len);
+    let mut iter = LineBreakLeafIter::new(&s[..end], 0);
+    loop {
+        let leaf = &s[start..end];
+        let (bk, _hard) = iter.next(leaf);
+        if bk < leaf.len() {
+            count += 1;
+        } else if end == s.len() {
+            // EOT
+            return count + 1;
+        } else {
+            start = end;
+            end = leaf_end(s, start, leaf_len);
+        }
+    }
+}
+
+fn leaf_end(s: &str, start: usize, leaf_len: usize) -> usize {
+    let mut end = (start + leaf_len).min(s.len());
+    while !s.is_char_boundary(end) {
+        end -= 1;
+    }
+    end
+}
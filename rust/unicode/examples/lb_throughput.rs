@@ -0,0 +1,114 @@
+// Copyright 2026 The xi-editor Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! Line breaking throughput, in MB/s and ns/break, for `LineBreakIterator`,
+//! for `LineBreakLeafIter` over rope-sized leaves, and for
+//! `SaLineBreakIterator` with a dictionary.
+//!
+//! Usage: lb_throughput [--write DIR] [--dict WORDS] [FILE...]
+//!
+//! With no files, runs over the built-in corpora of benches/corpus. With
+//! `--write DIR`, also writes those corpora to DIR, so that tools/bench_icu
+//! can measure ICU on exactly the same inputs for a baseline. `--dict`
+//! reads the dictionary from a file of words, one per line, instead of using
+//! the words of the built-in SA corpus.
+
+extern crate xi_unicode;
+
+#[path = "../benches/corpus/mod.rs"]
+mod corpus;
+
+use std::env;
+use std::fs;
+use std::path::Path;
+use std::time::{Duration, Instant};
+
+use xi_unicode::{Dictionary, LineBreakIterator, SaLineBreakIterator};
+
+use crate::corpus::Corpus;
+
+/// Minimum running time of each measurement.
+const MIN_TIME: Duration = Duration::from_millis(500);
+
+/// Runs `f` repeatedly for at least `MIN_TIME` and returns the best time of
+/// a single run, along with its result.
+fn time<F: FnMut() -> usize>(mut f: F) -> (Duration, usize) {
+    let start = Instant::now();
+    let mut best = Duration::from_secs(1_000_000);
+    let mut result = 0;
+    while start.elapsed() < MIN_TIME {
+        let t = Instant::now();
+        result = f();
+        best = best.min(t.elapsed());
+    }
+    (best, result)
+}
+
+fn report(name: &str, what: &str, len: usize, elapsed: Duration, n_breaks: usize) {
+    let secs = elapsed.as_secs_f64();
+    println!(
+        "{:<12} {:<10} {:>10} {:>9} {:>10.1} {:>9.2}",
+        name,
+        what,
+        len,
+        n_breaks,
+        len as f64 / secs / 1e6,
+        secs * 1e9 / n_breaks as f64
+    );
+}
+
+fn main() {
+    let mut args = env::args().skip(1);
+    let mut write_dir = None;
+    let mut words = None;
+    let mut corpora = Vec::new();
+    while let Some(arg) = args.next() {
+        if arg == "--write" {
+            write_dir = args.next();
+        } else if arg == "--dict" {
+            let path = args.next().expect("--dict needs a file");
+            words = Some(fs::read_to_string(&path).expect("can't read dictionary"));
+        } else {
+            let text = fs::read_to_string(&arg).expect("can't read input");
+            let name = Box::leak(arg.into_boxed_str());
+            corpora.push(Corpus { name, text });
+        }
+    }
+    if corpora.is_empty() {
+        corpora = corpus::corpora();
+    }
+    if let Some(dir) = write_dir {
+        for c in &corpora {
+            fs::write(Path::new(&dir).join(format!("{}.txt", c.name)), &c.text)
+                .expect("can't write corpus");
+        }
+    }
+    let dict = match words {
+        Some(ref words) => Dictionary::from_words(words.lines()),
+        None => Dictionary::from_words(corpus::SA_WORDS.iter().cloned()),
+    };
+    println!(
+        "{:<12} {:<10} {:>10} {:>9} {:>10} {:>9}",
+        "corpus", "iterator", "bytes", "breaks", "MB/s", "ns/break"
+    );
+    for c in &corpora {
+        let s = c.text.as_str();
+        let (elapsed, n) = time(|| LineBreakIterator::new(s).count());
+        report(c.name, "iter", s.len(), elapsed, n);
+        let (elapsed, n) = time(|| corpus::count_leaf_breaks(s, corpus::LEAF_LEN));
+        report(c.name, "leaf", s.len(), elapsed, n);
+        let (elapsed, n) = time(|| SaLineBreakIterator::new(s, &dict).count());
+        report(c.name, "dict", s.len(), elapsed, n);
+    }
+}
@@ -16,14 +16,59 @@
 
 // Run on:
 // http://www.unicode.org/Public/UCD/latest/ucd/auxiliary/LineBreakTest.txt
-// or use randomized data from tools/gen_rand_icu.cc (same format)
+// or use randomized data from tools/gen_rand_icu.cc (same format, or the
+// binary format from `gen_rand_icu --format binary`). Data generated with
+// `gen_rand_icu --locale @lb=loose` (or normal) is checked with
+// `--strictness loose`.
+//
+// With `--segment grapheme` or `--segment word`, instead runs
+// GraphemeBreakTest.txt or WordBreakTest.txt (also in auxiliary/), or the
+// output of tools/diff_seg_icu.cc, against `GraphemeIterator` or
+// `WordBreakIterator`.
+//
+// The file is mapped into memory and split into shards at record boundaries,
+// which are checked on `--threads N` threads (by default, one per CPU).
+// Each shard reports its counts and its first `--max-failures N` failures
+// (default 10).
+//
+// `--lookbehind` checks instead that iteration starting at each break finds
+// the same breaks as iteration from the start. `--leaves` checks the breaks
+// found by `LineBreakLeafIter` over the string cut into leaves at the splits
+// of `gen_rand_icu --splits`, both with `next_all`, as the wrapping code's
+// cursor does, and with `next`. The hard flag of the final break is not
+// checked, as the leaf iterator leaves it to the caller.
 extern crate xi_unicode;
 
-use xi_unicode::{LineBreakIterator, LineBreakLeafIter};
+use xi_unicode::{
+    GraphemeIterator, LineBreakIterator, LineBreakLeafIter, LineBreakStrictness, WordBreakIterator,
+};
+
+use std::io::{Error, ErrorKind};
+use std::ops::Range;
+use std::sync::Arc;
+use std::thread;
+use std::time::Instant;
 
-use std::fs::File;
-use std::io::prelude::*;
-use std::io::BufReader;
+/// The header of the binary corpus format; see tools/gen_rand_icu.cc.
+const BINARY_MAGIC: &[u8] = b"XILB";
+const BINARY_VERSION: u8 = 1;
+/// The version with splits for `--leaves` after each case.
+const BINARY_VERSION_SPLITS: u8 = 2;
+
+const DEFAULT_MAX_FAILURES: usize = 10;
+
+/// A test case: a string and its expected breaks. One is reused for all the
+/// cases of a shard.
+#[derive(Default)]
+struct TestCase {
+    s: String,
+    breaks: Vec<usize>,
+    /// Whether each break is hard. Only the binary format records this.
+    hard: Vec<bool>,
+    has_hard: bool,
+    /// Where to cut the string into leaves; empty for a single leaf.
+    splits: Vec<usize>,
+}
 
 fn quote_str(s: &str) -> String {
     let mut result = String::new();
@@ -40,86 +85,561 @@ fn quote_str(s: &str) -> String {
     result
 }
 
-fn check_breaks(s: &str, breaks: &[usize]) -> bool {
-    let my_breaks = LineBreakIterator::new(s).map(|(bk, _hard)| bk).collect::<Vec<_>>();
-    if my_breaks != breaks {
-        println!("failed case: \"{}\"", quote_str(s));
-        println!("expected {:?} actual {:?}", breaks, my_breaks);
-        return false;
+/// What to check the test data against.
+#[derive(Clone, Copy)]
+enum Mode {
+    Line(LineBreakStrictness),
+    Grapheme,
+    Word,
+}
+
+/// Checks the case, returning a description of the failure if it fails.
+fn check_case(case: &TestCase, mode: Mode) -> Result<(), String> {
+    let s = &case.s;
+    let ok = match mode {
+        Mode::Line(strictness) => {
+            check_breaks(case, LineBreakIterator::with_strictness(s, strictness))
+        }
+        Mode::Grapheme => check_breaks(case, GraphemeIterator::new(s).map(|bk| (bk, false))),
+        Mode::Word => check_breaks(case, WordBreakIterator::new(s).map(|bk| (bk, false))),
+    };
+    if ok {
+        return Ok(());
+    }
+    let actual: Vec<(usize, bool)> = match mode {
+        Mode::Line(strictness) => LineBreakIterator::with_strictness(s, strictness).collect(),
+        Mode::Grapheme => GraphemeIterator::new(s).map(|bk| (bk, false)).collect(),
+        Mode::Word => WordBreakIterator::new(s).map(|bk| (bk, false)).collect(),
+    };
+    let my_breaks = actual.iter().map(|&(bk, _)| bk).collect::<Vec<_>>();
+    let mut msg = format!("failed case: \"{}\"\n", quote_str(s));
+    if my_breaks != case.breaks {
+        msg.push_str(&format!("expected {:?} actual {:?}", case.breaks, my_breaks));
+    } else {
+        let my_hard = actual.iter().map(|&(_, hard)| hard).collect::<Vec<_>>();
+        msg.push_str(&format!("expected hard {:?} actual {:?}", case.hard, my_hard));
+    }
+    Err(msg)
+}
+
+// Compares the breaks as they are found, without collecting them.
+fn check_breaks<I: Iterator<Item = (usize, bool)>>(case: &TestCase, iter: I) -> bool {
+    let mut n = 0;
+    for (bk, hard) in iter {
+        if case.breaks.get(n) != Some(&bk) || (case.has_hard && case.hard[n] != hard) {
+            return false;
+        }
+        n += 1;
     }
-    true
+    n == case.breaks.len()
 }
 
 // Verify that starting iteration at a break is insensitive to look-behind.
-fn check_lb(s: &str) -> bool {
-    let breaks = LineBreakIterator::new(s).collect::<Vec<_>>();
-    for i in 0..breaks.len() - 1 {
-        let mut cursor = LineBreakLeafIter::new(s, breaks[i].0);
-        for &bk in &breaks[i + 1..] {
-            let mut next = cursor.next(s);
-            if next.0 == s.len() {
-                next = (s.len(), true);
-            }
+//
+// Rather than running a new iterator from each break to the end, this runs
+// the new ones alongside the one from the start, and drops each as soon as
+// its state is the same, as from then on it must find the same breaks. That
+// is nearly always at once, so this is linear in practice.
+fn check_lb(s: &str, strictness: LineBreakStrictness) -> Result<(), String> {
+    let mut iter = LineBreakLeafIter::with_strictness(s, 0, strictness);
+    let mut cursors: Vec<(usize, LineBreakLeafIter)> = Vec::new();
+    loop {
+        let bk = iter.next(s);
+        for (start, cursor) in &mut cursors {
+            let next = cursor.next(s);
+            // Only the offset of the break at the end is reported.
             if next != bk {
-                println!("failed case: \"{}\"", quote_str(s));
-                println!("expected {:?} actual {:?}", bk, next);
-                return false;
+                return Err(format!(
+                    "failed case: \"{}\"\nfrom {}, expected {:?} actual {:?}",
+                    quote_str(s),
+                    start,
+                    bk,
+                    next
+                ));
             }
         }
+        if bk.0 == s.len() {
+            return Ok(());
+        }
+        cursors.push((bk.0, LineBreakLeafIter::with_strictness(s, bk.0, strictness)));
+        cursors.retain(|(_, cursor)| *cursor != iter);
     }
-    true
 }
 
-fn run_test(filename: &str, lb: bool) -> std::io::Result<()> {
-    let f = File::open(filename)?;
-    let mut reader = BufReader::new(f);
-    let mut pass = 0;
-    let mut total = 0;
-    loop {
-        let mut line = String::new();
-        if reader.read_line(&mut line)? == 0 {
-            break;
-        };
-        let mut s = String::new();
-        let mut breaks = Vec::new();
-        for token in line.split_whitespace() {
-            if token == "÷" {
-                breaks.push(s.len());
-            } else if token == "×" {
-            } else if token == "#" {
+// Checks the breaks found over the leaves of the case.
+fn check_leaves(case: &TestCase, strictness: LineBreakStrictness) -> Result<(), String> {
+    let s = &case.s;
+    let mut prev = 0;
+    for &split in &case.splits {
+        if split <= prev || split >= s.len() || !s.is_char_boundary(split) {
+            return Err(format!("bad split {} in \"{}\"", split, quote_str(s)));
+        }
+        prev = split;
+    }
+    let leaves = || {
+        let ends = case.splits.iter().cloned().chain(Some(s.len()));
+        let starts = Some(0).into_iter().chain(case.splits.iter().cloned());
+        starts.zip(ends)
+    };
+    // The leaves must agree with the whole string, which must agree with
+    // the expected breaks.
+    let mut whole = LineBreakIterator::with_strictness(s, strictness).collect::<Vec<_>>();
+    if let Some(last) = whole.last_mut() {
+        last.1 = false;
+    }
+
+    let mut all_breaks = Vec::new();
+    let mut iter =
+        LineBreakLeafIter::with_strictness(&s[..leaves().next().unwrap().1], 0, strictness);
+    let mut offsets = Vec::new();
+    let mut hard = Vec::new();
+    for (start, end) in leaves() {
+        offsets.clear();
+        hard.clear();
+        iter.next_all(&s[start..end], &mut offsets, &mut hard);
+        for (i, &offset) in offsets.iter().enumerate() {
+            let is_hard = hard[i / 64] & (1 << (i % 64)) != 0;
+            all_breaks.push((start + offset as usize, is_hard));
+        }
+    }
+    all_breaks.push((s.len(), false));
+
+    let mut next_breaks = Vec::new();
+    let mut iter =
+        LineBreakLeafIter::with_strictness(&s[..leaves().next().unwrap().1], 0, strictness);
+    for (start, end) in leaves() {
+        let leaf = &s[start..end];
+        loop {
+            let (offset, is_hard) = iter.next(leaf);
+            if offset == leaf.len() {
                 break;
-            } else if let Ok(cp) = u32::from_str_radix(token, 16) {
-                s.push(std::char::from_u32(cp).unwrap());
             }
+            next_breaks.push((start + offset, is_hard));
         }
-        total += 1;
-        if lb {
-            if check_lb(&s) {
-                pass += 1;
+    }
+    next_breaks.push((s.len(), false));
+
+    for (name, actual) in &[("next_all", &all_breaks), ("next", &next_breaks)] {
+        if **actual != whole {
+            return Err(format!(
+                "failed case: \"{}\"\nsplits {:?}, whole string {:?} leaves with {} {:?}",
+                quote_str(s),
+                case.splits,
+                whole,
+                name,
+                actual
+            ));
+        }
+    }
+    check_case(case, Mode::Line(strictness))
+}
+
+/// Parses one line of the text format, as in LineBreakTest.txt. The break
+/// at the start in GraphemeBreakTest.txt and WordBreakTest.txt is dropped.
+fn parse_text_case(line: &str, case: &mut TestCase) {
+    case.s.clear();
+    case.breaks.clear();
+    case.has_hard = false;
+    case.splits.clear();
+    let mut tokens = line.split_whitespace();
+    while let Some(token) = tokens.next() {
+        if token == "÷" {
+            if !case.s.is_empty() {
+                case.breaks.push(case.s.len());
             }
-        } else {
-            if check_breaks(&s, &breaks) {
-                pass += 1;
+        } else if token == "×" {
+        } else if token == "#" {
+            if tokens.next() == Some("splits:") {
+                case.splits.extend(tokens.filter_map(|t| t.parse::<usize>().ok()));
             }
+            break;
+        } else if let Ok(cp) = u32::from_str_radix(token, 16) {
+            case.s.push(std::char::from_u32(cp).unwrap());
+        }
+    }
+}
+
+fn invalid(msg: &str) -> Error {
+    Error::new(ErrorKind::InvalidData, msg)
+}
+
+fn read_varint(buf: &[u8], pos: &mut usize) -> std::io::Result<u64> {
+    let mut result = 0u64;
+    let mut shift = 0;
+    while let Some(&byte) = buf.get(*pos) {
+        *pos += 1;
+        result |= u64::from(byte & 0x7f) << shift;
+        if byte < 0x80 {
+            return Ok(result);
         }
+        shift += 7;
+    }
+    Err(Error::new(ErrorKind::UnexpectedEof, "truncated record"))
+}
+
+/// The format of the test data.
+#[derive(Clone, Copy, PartialEq)]
+enum Format {
+    Text,
+    Binary,
+    /// The binary format, with splits.
+    BinarySplits,
+}
+
+/// Reads the binary record at `pos` into `case`.
+fn read_binary_case(
+    buf: &[u8],
+    pos: &mut usize,
+    format: Format,
+    case: &mut TestCase,
+) -> std::io::Result<()> {
+    let len = read_varint(buf, pos)? as usize;
+    let bytes = buf.get(*pos..*pos + len).ok_or_else(|| invalid("truncated record"))?;
+    *pos += len;
+    case.s.clear();
+    case.s.push_str(std::str::from_utf8(bytes).map_err(|e| Error::new(ErrorKind::InvalidData, e))?);
+    let n_breaks = read_varint(buf, pos)? as usize;
+    case.breaks.clear();
+    case.hard.clear();
+    case.has_hard = true;
+    let mut offset = 0;
+    for _ in 0..n_breaks {
+        let x = read_varint(buf, pos)?;
+        offset += (x >> 1) as usize;
+        case.breaks.push(offset);
+        case.hard.push(x & 1 != 0);
+    }
+    case.splits.clear();
+    if format == Format::BinarySplits {
+        let n_splits = read_varint(buf, pos)? as usize;
+        let mut offset = 0;
+        for _ in 0..n_splits {
+            offset += read_varint(buf, pos)? as usize;
+            case.splits.push(offset);
+        }
+    }
+    Ok(())
+}
+
+/// Steps over the binary record at `pos`, decoding only the lengths.
+fn skip_binary_case(buf: &[u8], pos: &mut usize, format: Format) -> std::io::Result<()> {
+    let len = read_varint(buf, pos)? as usize;
+    *pos += len;
+    skip_varints(buf, pos)?;
+    if format == Format::BinarySplits {
+        skip_varints(buf, pos)?;
     }
-    println!("{}/{} pass", pass, total);
     Ok(())
 }
 
+/// Steps over a count and that many varints.
+fn skip_varints(buf: &[u8], pos: &mut usize) -> std::io::Result<()> {
+    let mut n = read_varint(buf, pos)?;
+    while n > 0 {
+        let byte = *buf.get(*pos).ok_or_else(|| invalid("truncated record"))?;
+        *pos += 1;
+        if byte < 0x80 {
+            n -= 1;
+        }
+    }
+    Ok(())
+}
+
+/// The test data, mapped into memory.
+#[cfg(unix)]
+struct Corpus {
+    ptr: *const u8,
+    len: usize,
+}
+
+// The mapping is read-only and lives until the `Corpus` is dropped.
+#[cfg(unix)]
+unsafe impl Send for Corpus {}
+#[cfg(unix)]
+unsafe impl Sync for Corpus {}
+
+#[cfg(unix)]
+impl Corpus {
+    fn open(filename: &str) -> std::io::Result<Corpus> {
+        use std::os::unix::io::AsRawFd;
+        let file = std::fs::File::open(filename)?;
+        let len = file.metadata()?.len() as usize;
+        if len == 0 {
+            return Ok(Corpus { ptr: std::ptr::NonNull::dangling().as_ptr(), len });
+        }
+        unsafe {
+            let ptr = libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ,
+                libc::MAP_PRIVATE,
+                file.as_raw_fd(),
+                0,
+            );
+            if ptr == libc::MAP_FAILED {
+                return Err(Error::last_os_error());
+            }
+            // Each shard is read in order, and only once.
+            libc::madvise(ptr, len, libc::MADV_SEQUENTIAL);
+            Ok(Corpus { ptr: ptr as *const u8, len })
+        }
+    }
+
+    fn data(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.ptr, self.len) }
+    }
+}
+
+#[cfg(unix)]
+impl Drop for Corpus {
+    fn drop(&mut self) {
+        if self.len != 0 {
+            unsafe {
+                libc::munmap(self.ptr as *mut libc::c_void, self.len);
+            }
+        }
+    }
+}
+
+/// The test data, read into memory.
+#[cfg(not(unix))]
+struct Corpus(Vec<u8>);
+
+#[cfg(not(unix))]
+impl Corpus {
+    fn open(filename: &str) -> std::io::Result<Corpus> {
+        std::fs::read(filename).map(Corpus)
+    }
+
+    fn data(&self) -> &[u8] {
+        &self.0
+    }
+}
+
+/// Splits `data[start..]` into `n` shards of about the same size, at records
+/// of the binary format, or at lines of the text format. Finding records
+/// takes a pass over their headers and break lists, but not their strings.
+fn split_shards(
+    data: &[u8],
+    start: usize,
+    n: usize,
+    format: Format,
+) -> std::io::Result<Vec<Range<usize>>> {
+    let mut bounds = vec![start];
+    let mut pos = start;
+    for i in 1..n {
+        let target = start + (data.len() - start) * i / n;
+        if format != Format::Text {
+            while pos < target {
+                skip_binary_case(data, &mut pos, format)?;
+            }
+        } else if pos < target {
+            pos = match data[target..].iter().position(|&b| b == b'\n') {
+                Some(newline) => target + newline + 1,
+                None => data.len(),
+            };
+        }
+        bounds.push(pos);
+    }
+    bounds.push(data.len());
+    Ok(bounds.windows(2).filter(|w| w[0] < w[1]).map(|w| w[0]..w[1]).collect())
+}
+
+/// The results of checking one shard.
+#[derive(Default)]
+struct ShardResult {
+    pass: u64,
+    total: u64,
+    failures: Vec<String>,
+    error: Option<Error>,
+}
+
+/// What to check of each case, beyond its breaks.
+#[derive(Clone, Copy, PartialEq)]
+enum Check {
+    Breaks,
+    Lookbehind,
+    Leaves,
+}
+
+struct Options {
+    mode: Mode,
+    check: Check,
+    max_failures: usize,
+}
+
+impl ShardResult {
+    fn record(&mut self, case: &TestCase, opts: &Options) {
+        self.total += 1;
+        let strictness = match opts.mode {
+            Mode::Line(strictness) => strictness,
+            _ => LineBreakStrictness::default(),
+        };
+        let checked = match opts.check {
+            Check::Breaks => check_case(case, opts.mode),
+            Check::Lookbehind => check_lb(&case.s, strictness),
+            Check::Leaves => check_leaves(case, strictness),
+        };
+        match checked {
+            Ok(()) => self.pass += 1,
+            Err(msg) => {
+                if self.failures.len() < opts.max_failures {
+                    self.failures.push(msg);
+                }
+            }
+        }
+    }
+}
+
+fn run_shard(data: &[u8], range: Range<usize>, format: Format, opts: &Options) -> ShardResult {
+    let mut result = ShardResult::default();
+    let mut case = TestCase::default();
+    let shard = &data[..range.end];
+    let mut pos = range.start;
+    if format != Format::Text {
+        while pos < shard.len() {
+            if let Err(e) = read_binary_case(shard, &mut pos, format, &mut case) {
+                result.error = Some(e);
+                break;
+            }
+            result.record(&case, opts);
+        }
+    } else {
+        for line in shard[pos..].split(|&b| b == b'\n') {
+            let line = match std::str::from_utf8(line) {
+                Ok(line) => line,
+                Err(e) => {
+                    result.error = Some(Error::new(ErrorKind::InvalidData, e));
+                    break;
+                }
+            };
+            parse_text_case(line, &mut case);
+            // Comments and blank lines.
+            if case.s.is_empty() {
+                continue;
+            }
+            result.record(&case, opts);
+        }
+    }
+    result
+}
+
+fn run_test(filename: &str, n_threads: usize, opts: Options) -> std::io::Result<bool> {
+    let start_time = Instant::now();
+    let corpus = Arc::new(Corpus::open(filename)?);
+    let data = corpus.data();
+    let (format, start) = if data.starts_with(BINARY_MAGIC) {
+        let format = match data.get(BINARY_MAGIC.len()) {
+            Some(&BINARY_VERSION) => Format::Binary,
+            Some(&BINARY_VERSION_SPLITS) => Format::BinarySplits,
+            _ => return Err(invalid("unknown corpus version")),
+        };
+        (format, BINARY_MAGIC.len() + 1)
+    } else {
+        (Format::Text, 0)
+    };
+    let shards = split_shards(data, start, n_threads, format)?;
+    let opts = Arc::new(opts);
+    let handles = shards
+        .iter()
+        .map(|range| {
+            let corpus = corpus.clone();
+            let opts = opts.clone();
+            let range = range.clone();
+            thread::spawn(move || run_shard(corpus.data(), range, format, &opts))
+        })
+        .collect::<Vec<_>>();
+    let mut pass = 0;
+    let mut total = 0;
+    let mut ok = true;
+    for (i, (handle, range)) in handles.into_iter().zip(&shards).enumerate() {
+        let result = handle.join().unwrap();
+        if shards.len() > 1 {
+            println!(
+                "shard {} (bytes {}..{}): {}/{} pass",
+                i, range.start, range.end, result.pass, result.total
+            );
+        }
+        for msg in &result.failures {
+            println!("{}", msg);
+        }
+        if result.total - result.pass > result.failures.len() as u64 {
+            println!(
+                "({} more failures)",
+                result.total - result.pass - result.failures.len() as u64
+            );
+        }
+        if let Some(e) = result.error {
+            println!("error in shard {}: {}", i, e);
+            ok = false;
+        }
+        pass += result.pass;
+        total += result.total;
+    }
+    println!("{}/{} pass in {:.1}s", pass, total, start_time.elapsed().as_secs_f64());
+    Ok(ok && pass == total)
+}
+
 fn main() {
     let mut args = std::env::args();
     let _ = args.next();
     let filename = args.next().unwrap();
-    match args.next() {
-        None => {
-            let _ = run_test(&filename, false);
-        }
-        Some(ref s) if s == "--lookbehind" => {
-            let _ = run_test(&filename, true);
+    let mut check = Check::Breaks;
+    let mut mode = Mode::Line(LineBreakStrictness::default());
+    let mut n_threads = thread::available_parallelism().map(|n| n.get()).unwrap_or(1);
+    let mut max_failures = DEFAULT_MAX_FAILURES;
+    while let Some(arg) = args.next() {
+        match arg.as_str() {
+            "--lookbehind" => check = Check::Lookbehind,
+            "--leaves" => check = Check::Leaves,
+            "--strictness" => {
+                mode = match args.next().as_ref().map(String::as_str) {
+                    Some("strict") => Mode::Line(LineBreakStrictness::Strict),
+                    Some("normal") => Mode::Line(LineBreakStrictness::Normal),
+                    Some("loose") => Mode::Line(LineBreakStrictness::Loose),
+                    _ => {
+                        println!("unknown strictness");
+                        return;
+                    }
+                }
+            }
+            "--segment" => {
+                mode = match args.next().as_ref().map(String::as_str) {
+                    Some("grapheme") => Mode::Grapheme,
+                    Some("word") => Mode::Word,
+                    _ => {
+                        println!("unknown segmentation");
+                        return;
+                    }
+                }
+            }
+            "--threads" | "--max-failures" => {
+                let n = match args.next().and_then(|n| n.parse::<usize>().ok()) {
+                    Some(n) => n,
+                    None => {
+                        println!("{} needs a number", arg);
+                        return;
+                    }
+                };
+                if arg == "--threads" {
+                    n_threads = n.max(1);
+                } else {
+                    max_failures = n;
+                }
+            }
+            _ => {
+                println!("unknown argument");
+                return;
+            }
         }
-        _ => {
-            println!("unknown argument");
+    }
+    let opts = Options { mode, check, max_failures };
+    match run_test(&filename, n_threads, opts) {
+        Ok(true) => (),
+        Ok(false) => std::process::exit(1),
+        Err(e) => {
+            println!("error reading {}: {}", filename, e);
+            std::process::exit(1);
         }
     }
 }
@@ -0,0 +1,365 @@
+// Copyright 2026 The xi-editor Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! A fast path for the line breaking iterators over runs of ASCII letters
+//! and digits, which dominate source code and logs.
+//!
+//! All of `[0-9A-Za-z_]` have line breaking class AL or NU, and there is
+//! never a break between two such characters (LB23, LB28), so starting
+//! from an AL or NU state a whole run can be skipped at once, leaving the
+//! state machine in the state of the run's last character.
+//!
+//! It also has a classifier that looks up the line breaking classes of a
+//! whole block of ASCII at once. The classes of 0..0x80 fit in eight 16-byte
+//! registers, so each byte is mapped with one shuffle per register, indexed
+//! by its low nibble and selected by its high nibble.
+//!
+//! This crate is `no_std`, so there is no runtime feature detection: SSE2
+//! is part of the x86_64 baseline, and SSSE3 and AVX2 are used when enabled
+//! at compile time (for example with `-C target-cpu=native`).
+
+use crate::tables::{LINEBREAK_MASK, PROPS_1_2};
+use crate::{lb_class_state, linebreak_class_str};
+
+/// The AL (alphabetic) line breaking class.
+const LB_AL: u8 = 2;
+/// The NU (numeric) line breaking class.
+const LB_NU: u8 = 19;
+/// The state following an AL code point.
+const STATE_AL: u8 = lb_class_state(LB_AL);
+/// The state following an NU code point.
+const STATE_NU: u8 = lb_class_state(LB_NU);
+
+#[inline]
+fn is_alnum(b: u8) -> bool {
+    b.is_ascii_alphanumeric() || b == b'_'
+}
+
+/// If the state machine is in a state where a run of ASCII alphanumerics
+/// can't break, advances `ix` past any such run at `ix` and updates `state`
+/// to the one the state machine would reach.
+#[inline]
+pub(crate) fn skip_alnum_run(s: &[u8], ix: &mut usize, state: &mut u8) {
+    if (*state == STATE_AL || *state == STATE_NU) && *ix < s.len() && is_alnum(s[*ix]) {
+        let end = skip_alnum(s, *ix + 1);
+        *state = if s[end - 1].is_ascii_digit() { STATE_NU } else { STATE_AL };
+        *ix = end;
+    }
+}
+
+/// Returns the index of the first byte at or after `ix` which is not an
+/// ASCII letter, digit or underscore, or `s.len()` if there is none.
+#[inline]
+pub(crate) fn skip_alnum(s: &[u8], ix: usize) -> usize {
+    #[cfg(all(target_arch = "x86_64", target_feature = "avx2"))]
+    {
+        unsafe { skip_alnum_avx2(s, ix) }
+    }
+    #[cfg(all(target_arch = "x86_64", not(target_feature = "avx2")))]
+    {
+        unsafe { skip_alnum_sse2(s, ix) }
+    }
+    #[cfg(not(target_arch = "x86_64"))]
+    {
+        skip_alnum_fallback(s, ix)
+    }
+}
+
+fn skip_alnum_fallback(s: &[u8], mut ix: usize) -> usize {
+    while ix < s.len() && is_alnum(s[ix]) {
+        ix += 1;
+    }
+    ix
+}
+
+// The range checks below shift each range to start at i8::MIN, so that an
+// unsigned comparison becomes a single signed one. Setting the 0x20 bit
+// folds upper case letters to lower case without creating new matches.
+
+/// Returns a mask with a 1 bit for each of the 16 bytes at `p` which is
+/// an ASCII letter, digit or underscore.
+#[cfg(target_arch = "x86_64")]
+#[inline]
+#[allow(clippy::cast_ptr_alignment)]
+unsafe fn alnum_mask_sse2(p: *const u8) -> u32 {
+    use core::arch::x86_64::*;
+    let v = _mm_loadu_si128(p as *const __m128i);
+    let lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    let letter = _mm_cmplt_epi8(
+        _mm_add_epi8(lower, _mm_set1_epi8(0x80u8.wrapping_sub(b'a') as i8)),
+        _mm_set1_epi8(-128 + 26),
+    );
+    let digit = _mm_cmplt_epi8(
+        _mm_add_epi8(v, _mm_set1_epi8(0x80u8.wrapping_sub(b'0') as i8)),
+        _mm_set1_epi8(-128 + 10),
+    );
+    let underscore = _mm_cmpeq_epi8(v, _mm_set1_epi8(b'_' as i8));
+    _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letter, digit), underscore)) as u32
+}
+
+#[cfg(target_arch = "x86_64")]
+#[allow(dead_code)]
+unsafe fn skip_alnum_sse2(s: &[u8], mut ix: usize) -> usize {
+    while ix + 16 <= s.len() {
+        let mask = alnum_mask_sse2(s.as_ptr().add(ix));
+        if mask != 0xffff {
+            return ix + (!mask).trailing_zeros() as usize;
+        }
+        ix += 16;
+    }
+    skip_alnum_fallback(s, ix)
+}
+
+/// Like `alnum_mask_sse2`, for the 32 bytes at `p`.
+#[cfg(all(target_arch = "x86_64", target_feature = "avx2"))]
+#[inline]
+#[allow(clippy::cast_ptr_alignment)]
+unsafe fn alnum_mask_avx2(p: *const u8) -> u32 {
+    use core::arch::x86_64::*;
+    let v = _mm256_loadu_si256(p as *const __m256i);
+    let lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    let letter = _mm256_cmpgt_epi8(
+        _mm256_set1_epi8(-128 + 26),
+        _mm256_add_epi8(lower, _mm256_set1_epi8(0x80u8.wrapping_sub(b'a') as i8)),
+    );
+    let digit = _mm256_cmpgt_epi8(
+        _mm256_set1_epi8(-128 + 10),
+        _mm256_add_epi8(v, _mm256_set1_epi8(0x80u8.wrapping_sub(b'0') as i8)),
+    );
+    let underscore = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(b'_' as i8));
+    _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(letter, digit), underscore)) as u32
+}
+
+#[cfg(all(target_arch = "x86_64", target_feature = "avx2"))]
+unsafe fn skip_alnum_avx2(s: &[u8], mut ix: usize) -> usize {
+    while ix + 32 <= s.len() {
+        let mask = alnum_mask_avx2(s.as_ptr().add(ix));
+        if mask != 0xffff_ffff {
+            return ix + (!mask).trailing_zeros() as usize;
+        }
+        ix += 32;
+    }
+    skip_alnum_sse2(s, ix)
+}
+
+/// Writes the line breaking class of each ASCII byte at the start of `s`
+/// to `out`, stopping at the first non-ASCII byte or when `out` is full.
+/// Returns the number of classes written.
+#[inline]
+pub(crate) fn classify(s: &[u8], out: &mut [u8]) -> usize {
+    let n = s.len().min(out.len());
+    let (s, out) = (&s[..n], &mut out[..n]);
+    #[cfg(all(target_arch = "x86_64", target_feature = "avx2"))]
+    {
+        unsafe { classify_avx2(s, out) }
+    }
+    #[cfg(all(target_arch = "x86_64", target_feature = "ssse3", not(target_feature = "avx2")))]
+    {
+        unsafe { classify_ssse3(s, out) }
+    }
+    #[cfg(not(all(target_arch = "x86_64", target_feature = "ssse3")))]
+    {
+        classify_fallback(s, out)
+    }
+}
+
+fn classify_fallback(s: &[u8], out: &mut [u8]) -> usize {
+    for (i, (&b, class)) in s.iter().zip(out.iter_mut()).enumerate() {
+        if b >= 0x80 {
+            return i;
+        }
+        *class = PROPS_1_2[b as usize] & LINEBREAK_MASK;
+    }
+    s.len()
+}
+
+/// The classes of 0..0x80, one register per high nibble.
+#[cfg(all(target_arch = "x86_64", target_feature = "ssse3"))]
+#[inline]
+#[allow(clippy::cast_ptr_alignment)]
+unsafe fn class_rows_ssse3() -> [core::arch::x86_64::__m128i; 8] {
+    use core::arch::x86_64::*;
+    let mut rows = [_mm_setzero_si128(); 8];
+    for (h, row) in rows.iter_mut().enumerate() {
+        let v = _mm_loadu_si128(PROPS_1_2.as_ptr().add(h * 16) as *const __m128i);
+        *row = _mm_and_si128(v, _mm_set1_epi8(LINEBREAK_MASK as i8));
+    }
+    rows
+}
+
+/// The classes of the 16 bytes in `v`; lanes which aren't ASCII are 0.
+#[cfg(all(target_arch = "x86_64", target_feature = "ssse3"))]
+#[inline]
+unsafe fn classes_ssse3(
+    v: core::arch::x86_64::__m128i,
+    rows: &[core::arch::x86_64::__m128i; 8],
+) -> core::arch::x86_64::__m128i {
+    use core::arch::x86_64::*;
+    let lo = _mm_and_si128(v, _mm_set1_epi8(0x0f));
+    let hi = _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f));
+    let mut classes = _mm_setzero_si128();
+    for (h, row) in rows.iter().enumerate() {
+        let sel = _mm_cmpeq_epi8(hi, _mm_set1_epi8(h as i8));
+        classes = _mm_or_si128(classes, _mm_and_si128(sel, _mm_shuffle_epi8(*row, lo)));
+    }
+    classes
+}
+
+#[cfg(all(target_arch = "x86_64", target_feature = "ssse3"))]
+#[allow(dead_code)]
+#[allow(clippy::cast_ptr_alignment)]
+unsafe fn classify_ssse3(s: &[u8], out: &mut [u8]) -> usize {
+    use core::arch::x86_64::*;
+    let rows = class_rows_ssse3();
+    let mut ix = 0;
+    while ix + 16 <= s.len() {
+        let v = _mm_loadu_si128(s.as_ptr().add(ix) as *const __m128i);
+        _mm_storeu_si128(out.as_mut_ptr().add(ix) as *mut __m128i, classes_ssse3(v, &rows));
+        let non_ascii = _mm_movemask_epi8(v);
+        if non_ascii != 0 {
+            return ix + non_ascii.trailing_zeros() as usize;
+        }
+        ix += 16;
+    }
+    ix + classify_fallback(&s[ix..], &mut out[ix..])
+}
+
+/// Like `classify_ssse3`, 32 bytes at a time. `vpshufb` shuffles within
+/// each 128-bit lane, so the rows are broadcast to both lanes.
+#[cfg(all(target_arch = "x86_64", target_feature = "avx2"))]
+#[allow(clippy::cast_ptr_alignment)]
+unsafe fn classify_avx2(s: &[u8], out: &mut [u8]) -> usize {
+    use core::arch::x86_64::*;
+    let rows = class_rows_ssse3();
+    let mut wide_rows = [_mm256_setzero_si256(); 8];
+    for (wide, row) in wide_rows.iter_mut().zip(rows.iter()) {
+        *wide = _mm256_broadcastsi128_si256(*row);
+    }
+    let mut ix = 0;
+    while ix + 32 <= s.len() {
+        let v = _mm256_loadu_si256(s.as_ptr().add(ix) as *const __m256i);
+        let lo = _mm256_and_si256(v, _mm256_set1_epi8(0x0f));
+        let hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0f));
+        let mut classes = _mm256_setzero_si256();
+        for (h, row) in wide_rows.iter().enumerate() {
+            let sel = _mm256_cmpeq_epi8(hi, _mm256_set1_epi8(h as i8));
+            let class = _mm256_shuffle_epi8(*row, lo);
+            classes = _mm256_or_si256(classes, _mm256_and_si256(sel, class));
+        }
+        _mm256_storeu_si256(out.as_mut_ptr().add(ix) as *mut __m256i, classes);
+        let non_ascii = _mm256_movemask_epi8(v);
+        if non_ascii != 0 {
+            return ix + non_ascii.trailing_zeros() as usize;
+        }
+        ix += 32;
+    }
+    ix + classify_ssse3(&s[ix..], &mut out[ix..])
+}
+
+/// The number of classes a `ClassBuffer` prepares at a time.
+const CLASS_BLOCK: usize = 32;
+
+/// A block of prepared line breaking classes for the ASCII text following
+/// some position, so the state machine can step through a run of ASCII
+/// without decoding each byte on its own.
+///
+/// Only the SIMD classifiers are fast enough to pay for preparing a block
+/// that may not be used; without them, this looks up each code point.
+#[derive(Copy, Clone)]
+pub(crate) struct ClassBuffer {
+    classes: [u8; CLASS_BLOCK],
+    start: usize,
+    len: usize,
+}
+
+impl Default for ClassBuffer {
+    fn default() -> ClassBuffer {
+        ClassBuffer { classes: [0; CLASS_BLOCK], start: 0, len: 0 }
+    }
+}
+
+impl ClassBuffer {
+    /// The line breaking class of the code point at `ix` in `s`, and its
+    /// utf-8 length, like `linebreak_class_str`.
+    ///
+    /// All calls must be for the same `s`.
+    #[inline]
+    pub(crate) fn get(&mut self, s: &str, ix: usize) -> (u8, usize) {
+        let bytes = s.as_bytes();
+        if cfg!(all(target_arch = "x86_64", target_feature = "ssse3")) && bytes[ix] < 0x80 {
+            let i = ix.wrapping_sub(self.start);
+            if i < self.len {
+                return (self.classes[i], 1);
+            }
+            // An isolated ASCII byte, such as a space between words in
+            // another script, isn't worth preparing a block for.
+            if bytes.get(ix + 1).map_or(false, |&b| b < 0x80) {
+                self.start = ix;
+                self.len = classify(&bytes[ix..], &mut self.classes);
+                return (self.classes[0], 1);
+            }
+        }
+        linebreak_class_str(s, ix)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn skip_matches_fallback() {
+        let mut s = alloc::vec::Vec::new();
+        for b in 0..=255u8 {
+            // Place each byte after runs of every length, across the
+            // SIMD strides.
+            for run in 0..70 {
+                s.clear();
+                s.extend((0..run).map(|i| b"aZ09_q"[i % 6]));
+                s.push(b);
+                s.extend_from_slice(b"abc");
+                for start in 0..s.len() {
+                    assert_eq!(skip_alnum(&s, start), skip_alnum_fallback(&s, start));
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn classify_matches_fallback() {
+        let mut s = alloc::vec::Vec::new();
+        let mut expected = [0u8; 80];
+        let mut actual = [0u8; 80];
+        for b in 0..=255u8 {
+            for pos in 0..70 {
+                s.clear();
+                s.extend((0..pos).map(|i| (i * 37 % 128) as u8));
+                s.push(b);
+                s.extend_from_slice(b"a b");
+                for start in 0..s.len() {
+                    let n = classify_fallback(&s[start..], &mut expected);
+                    assert_eq!(classify(&s[start..], &mut actual), n);
+                    assert_eq!(&actual[..n], &expected[..n]);
+                    // a short output buffer stops the classifier early
+                    assert_eq!(classify(&s[start..], &mut actual[..n / 2]), n / 2);
+                }
+            }
+        }
+        for b in 0..0x80u8 {
+            let s = [b];
+            classify(&s, &mut actual);
+            assert_eq!(actual[0], linebreak_class_str(core::str::from_utf8(&s).unwrap(), 0).0);
+        }
+    }
+}
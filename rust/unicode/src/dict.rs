@@ -0,0 +1,560 @@
+// Copyright 2026 The xi-editor Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! Dictionary-based word segmentation for the SA (complex context) class:
+//! Thai, Lao, Khmer, Myanmar and other scripts written without spaces.
+//!
+//! UAX 14 leaves the breaks within runs of SA to the implementation, and the
+//! state machine treats SA as AL, so there are none at all. `Dictionary` is a
+//! word list in a double-array trie, and `SaLineBreakIterator` uses it to
+//! find word boundaries within SA runs, choosing the segmentation with the
+//! fewest code points outside of any known word, then the fewest words,
+//! much as ICU's dictionary break engines do.
+//!
+//! The trie is stored as a flat byte array, which can be used in place, for
+//! example from a memory-mapped file; see `Dictionary::from_bytes`.
+//!
+//! For text that comes in pieces, such as the leaves of a rope, `sa_run` and
+//! `sa_run_start` find the SA runs, and `SaSegmenter` finds the breaks
+//! within them, to add to those of `LineBreakLeafIter`.
+
+use alloc::borrow::Cow;
+use alloc::vec::Vec;
+use core::ops::Range;
+
+use crate::{linebreak_class_str, linebreak_property, mono_width, LineBreakIterator};
+
+/// The SA (complex context) line breaking class.
+const LB_SA: u8 = 24;
+
+/// The header of the serialized format: a magic number and a version.
+const MAGIC: &[u8; 4] = b"XIDA";
+const VERSION: u32 = 1;
+const HEADER_LEN: usize = 8;
+
+/// Each unit of the double array is a base and a check, as little-endian
+/// `u32`s.
+const UNIT_LEN: usize = 8;
+
+/// The `check` of a unit that is not in use.
+const FREE: u32 = u32::max_value();
+
+/// The longest run of SA text segmented at once. Longer runs are segmented
+/// a window at a time, which bounds the memory used.
+const MAX_WINDOW: usize = 1024;
+
+/// A list of words, in a double-array trie over their UTF-8 bytes.
+///
+/// From unit `s`, byte `b` leads to unit `t = base[s] + b + 1` if
+/// `check[t] == s`, and the unit `base[s]` (code 0) marks the end of a word.
+/// The root is unit 0.
+#[derive(Clone)]
+pub struct Dictionary<'a> {
+    data: Cow<'a, [u8]>,
+}
+
+impl<'a> Dictionary<'a> {
+    /// Uses `data`, as from `as_bytes`, in place. Returns `None` if it is
+    /// not a dictionary in this format.
+    pub fn from_bytes(data: &'a [u8]) -> Option<Dictionary<'a>> {
+        if data.len() < HEADER_LEN + UNIT_LEN
+            || &data[..4] != MAGIC
+            || read_u32(data, 4) != VERSION
+            || (data.len() - HEADER_LEN) % UNIT_LEN != 0
+        {
+            return None;
+        }
+        Some(Dictionary { data: Cow::Borrowed(data) })
+    }
+
+    /// The serialized dictionary, for `from_bytes`.
+    pub fn as_bytes(&self) -> &[u8] {
+        &self.data
+    }
+
+    /// A copy of the dictionary which owns its data.
+    pub fn into_owned(self) -> Dictionary<'static> {
+        Dictionary { data: Cow::Owned(self.data.into_owned()) }
+    }
+
+    fn n_units(&self) -> usize {
+        (self.data.len() - HEADER_LEN) / UNIT_LEN
+    }
+
+    #[inline]
+    fn base(&self, unit: usize) -> usize {
+        read_u32(&self.data, HEADER_LEN + unit * UNIT_LEN) as usize
+    }
+
+    #[inline]
+    fn check(&self, unit: usize) -> u32 {
+        read_u32(&self.data, HEADER_LEN + unit * UNIT_LEN + 4)
+    }
+
+    #[inline]
+    fn child(&self, unit: usize, code: usize) -> Option<usize> {
+        // The data may come from anywhere, so the base may be out of range.
+        let t = self.base(unit).checked_add(code)?;
+        if t < self.n_units() && self.check(t) == unit as u32 {
+            Some(t)
+        } else {
+            None
+        }
+    }
+
+    /// Whether `word` is in the dictionary.
+    pub fn contains(&self, word: &str) -> bool {
+        let mut found = false;
+        self.prefixes(word.as_bytes(), |len| found |= len == word.len());
+        found
+    }
+
+    /// Calls `f` with the length of each word in the dictionary which is a
+    /// prefix of `s`, shortest first.
+    pub fn prefixes<F: FnMut(usize)>(&self, s: &[u8], mut f: F) {
+        let mut unit = 0;
+        for (i, &b) in s.iter().enumerate() {
+            unit = match self.child(unit, b as usize + 1) {
+                Some(t) => t,
+                None => return,
+            };
+            if self.child(unit, 0).is_some() {
+                f(i + 1);
+            }
+        }
+    }
+}
+
+impl Dictionary<'static> {
+    /// Builds a dictionary of `words`. Empty words are ignored.
+    pub fn from_words<'w, I: IntoIterator<Item = &'w str>>(words: I) -> Dictionary<'static> {
+        let mut words =
+            words.into_iter().map(str::as_bytes).filter(|w| !w.is_empty()).collect::<Vec<_>>();
+        words.sort();
+        words.dedup();
+        let mut builder = Builder { base: Vec::new(), check: Vec::new(), first_free: 1 };
+        builder.alloc(1);
+        builder.check[0] = 0;
+        if !words.is_empty() {
+            builder.insert(0, &words, 0);
+        }
+        let mut data = Vec::with_capacity(HEADER_LEN + builder.base.len() * UNIT_LEN);
+        data.extend_from_slice(MAGIC);
+        data.extend_from_slice(&VERSION.to_le_bytes());
+        for (&base, &check) in builder.base.iter().zip(builder.check.iter()) {
+            data.extend_from_slice(&base.to_le_bytes());
+            data.extend_from_slice(&check.to_le_bytes());
+        }
+        Dictionary { data: Cow::Owned(data) }
+    }
+}
+
+#[inline]
+fn read_u32(data: &[u8], ix: usize) -> u32 {
+    u32::from_le_bytes([data[ix], data[ix + 1], data[ix + 2], data[ix + 3]])
+}
+
+struct Builder {
+    base: Vec<u32>,
+    check: Vec<u32>,
+    /// No unit before this one is free.
+    first_free: usize,
+}
+
+impl Builder {
+    fn alloc(&mut self, len: usize) {
+        if self.check.len() < len {
+            self.base.resize(len, 0);
+            self.check.resize(len, FREE);
+        }
+    }
+
+    /// Adds the children of `unit`, the node for the common prefix of length
+    /// `depth` of `words`, which are sorted.
+    fn insert(&mut self, unit: usize, words: &[&[u8]], depth: usize) {
+        let code = |w: &[u8]| if w.len() == depth { 0 } else { w[depth] as usize + 1 };
+        let mut codes = Vec::new();
+        for w in words {
+            let c = code(w);
+            if codes.last() != Some(&c) {
+                codes.push(c);
+            }
+        }
+        // First fit, as the units before `first_free` are all taken.
+        let mut base = self.first_free.saturating_sub(codes[0]).max(1);
+        loop {
+            self.alloc(base + codes[codes.len() - 1] + 1);
+            if codes.iter().all(|&c| self.check[base + c] == FREE) {
+                break;
+            }
+            base += 1;
+        }
+        self.base[unit] = base as u32;
+        for &c in &codes {
+            self.check[base + c] = unit as u32;
+        }
+        while self.first_free < self.check.len() && self.check[self.first_free] != FREE {
+            self.first_free += 1;
+        }
+        let mut start = 0;
+        while start < words.len() {
+            let c = code(words[start]);
+            let mut end = start + 1;
+            while end < words.len() && code(words[end]) == c {
+                end += 1;
+            }
+            if c != 0 {
+                self.insert(base + c, &words[start..end], depth + 1);
+            }
+            start = end;
+        }
+    }
+}
+
+/// The best segmentation found so far of the text up to a position.
+#[derive(Clone, Copy)]
+struct Step {
+    /// The number of code points not in any word.
+    unknown: u32,
+    words: u32,
+    /// The start of the last word or unknown code point.
+    prev: u32,
+    /// Whether that was a word.
+    word: bool,
+}
+
+impl Step {
+    fn cost(&self) -> (u32, u32) {
+        (self.unknown, self.words)
+    }
+}
+
+/// Finds the word boundaries within runs of SA text with a `Dictionary`,
+/// keeping its scratch space between runs.
+#[derive(Default)]
+pub struct SaSegmenter {
+    steps: Vec<Option<Step>>,
+    breaks: Vec<usize>,
+}
+
+impl SaSegmenter {
+    /// Finds the word boundaries strictly within `run`, appending their
+    /// offsets plus `base` to `out`, in order. These are the breaks that
+    /// `SaLineBreakIterator` adds within a run of SA text, as from `sa_run`.
+    pub fn segment(&mut self, dict: &Dictionary, run: &str, base: usize, out: &mut Vec<usize>) {
+        let mut start = 0;
+        while start < run.len() {
+            let mut end = (start + MAX_WINDOW).min(run.len());
+            while !run.is_char_boundary(end) {
+                end -= 1;
+            }
+            self.segment_window(dict, &run[start..end]);
+            // Unless this is the last window, the segmentation near its end
+            // depends on the text after it, so only keep the boundaries in
+            // its first part and continue from the last of them.
+            let mut next = end;
+            if end < run.len() {
+                let keep = end - start - MAX_WINDOW / 4;
+                while self.breaks.last().map(|&bk| bk > keep).unwrap_or(false) {
+                    self.breaks.pop();
+                }
+                if let Some(last) = self.breaks.pop() {
+                    next = start + last;
+                }
+            }
+            out.extend(self.breaks.iter().map(|&bk| base + start + bk));
+            if next < run.len() {
+                out.push(base + next);
+            }
+            start = next;
+        }
+    }
+
+    /// Segments `s`, leaving the boundaries within it in `self.breaks`.
+    fn segment_window(&mut self, dict: &Dictionary, s: &str) {
+        let steps = &mut self.steps;
+        steps.clear();
+        steps.resize(s.len() + 1, None);
+        steps[0] = Some(Step { unknown: 0, words: 0, prev: 0, word: true });
+        let bytes = s.as_bytes();
+        for (i, c) in s.char_indices() {
+            let from = match steps[i] {
+                Some(step) => step,
+                None => continue,
+            };
+            let mut relax = |j: usize, step: Step| {
+                if steps[j].map(|old| step.cost() < old.cost()).unwrap_or(true) {
+                    steps[j] = Some(step);
+                }
+            };
+            dict.prefixes(&bytes[i..], |len| {
+                if s.is_char_boundary(i + len) {
+                    let step = Step { words: from.words + 1, prev: i as u32, word: true, ..from };
+                    relax(i + len, step);
+                }
+            });
+            let unknown = Step { unknown: from.unknown + 1, prev: i as u32, word: false, ..from };
+            relax(i + c.len_utf8(), unknown);
+        }
+        // Breaks are at the edges of words, but not within runs of unknown
+        // code points, nor before combining marks.
+        self.breaks.clear();
+        let mut pos = s.len();
+        let mut after_word = false;
+        while pos > 0 {
+            let step = steps[pos].unwrap();
+            if pos < s.len() && (step.word || after_word) && !is_combining(s, pos) {
+                self.breaks.push(pos);
+            }
+            after_word = step.word;
+            pos = step.prev as usize;
+        }
+        self.breaks.reverse();
+    }
+}
+
+fn is_combining(s: &str, ix: usize) -> bool {
+    s[ix..].chars().next().map(|c| mono_width(c) == Some(0)).unwrap_or(false)
+}
+
+/// Whether `b` is the first byte of the UTF-8 of any SA code point. They
+/// are all in U+0E00..U+1FFF, U+A000..U+AFFF and the supplementary planes.
+#[inline]
+fn maybe_sa(b: u8) -> bool {
+    b == 0xe0 || b == 0xe1 || b == 0xea || b == 0xf0
+}
+
+/// The end of the run of SA code points at `ix` in `s`, or `ix` if there is
+/// none.
+fn sa_run_end(s: &str, mut ix: usize) -> usize {
+    while ix < s.len() {
+        let (lb, len) = linebreak_class_str(s, ix);
+        if lb != LB_SA {
+            break;
+        }
+        ix += len;
+    }
+    ix
+}
+
+/// The first run of SA (complex context) code points at or after `ix` in
+/// `s`, which must be a code point boundary, if there is one. The run may
+/// continue past the end of `s`.
+pub fn sa_run(s: &str, ix: usize) -> Option<Range<usize>> {
+    let mut start = next_candidate(s, ix);
+    while start < s.len() {
+        let end = sa_run_end(s, start);
+        if end > start {
+            return Some(start..end);
+        }
+        start = next_candidate(s, start + 1);
+    }
+    None
+}
+
+/// The start of the run of SA code points that ends at `end` in `s`, or
+/// `end` if the code point before it is not SA. The run may start before
+/// the start of `s`.
+pub fn sa_run_start(s: &str, end: usize) -> usize {
+    let mut start = end;
+    while let Some(c) = s[..start].chars().next_back() {
+        if linebreak_property(c) != LB_SA {
+            break;
+        }
+        start -= c.len_utf8();
+    }
+    start
+}
+
+/// A `LineBreakIterator` which also breaks between the words of runs of SA
+/// text, as found with a `Dictionary`.
+///
+/// The text is scanned once for the lead bytes of SA code points, and the
+/// line breaking class is only looked up at those, so the only cost for
+/// other text is that scan, and the dictionary is only used on SA runs.
+pub struct SaLineBreakIterator<'a, 'd> {
+    s: &'a str,
+    inner: LineBreakIterator<'a>,
+    dict: &'d Dictionary<'d>,
+    /// The offset of the next byte that may start an SA run.
+    candidate: usize,
+    /// The breaks within SA runs before `next`, in reverse order.
+    pending: Vec<usize>,
+    /// The next break of `inner`, when there are pending breaks before it.
+    next: Option<(usize, bool)>,
+    segmenter: SaSegmenter,
+}
+
+impl<'a, 'd> SaLineBreakIterator<'a, 'd> {
+    pub fn new(s: &'a str, dict: &'d Dictionary<'d>) -> SaLineBreakIterator<'a, 'd> {
+        SaLineBreakIterator::with_iter(s, LineBreakIterator::new(s), dict)
+    }
+
+    /// Adds the breaks within SA runs to those of `inner`, which must be an
+    /// iterator over `s` from its start, for example one constructed with
+    /// `LineBreakIterator::with_strictness`.
+    pub fn with_iter(
+        s: &'a str,
+        inner: LineBreakIterator<'a>,
+        dict: &'d Dictionary<'d>,
+    ) -> SaLineBreakIterator<'a, 'd> {
+        SaLineBreakIterator {
+            s,
+            inner,
+            dict,
+            candidate: next_candidate(s, 0),
+            pending: Vec::new(),
+            next: None,
+            segmenter: SaSegmenter::default(),
+        }
+    }
+
+    /// Adds the breaks in SA runs before `end`, a break of `inner`, to
+    /// `pending`. SA runs never contain breaks of `inner`, as the state
+    /// machine treats SA as AL.
+    fn find_sa_breaks(&mut self, end: usize) {
+        let s = self.s;
+        while self.candidate < end {
+            let start = self.candidate;
+            let mut ix = sa_run_end(&s[..end], start);
+            if ix > start {
+                self.segmenter.segment(self.dict, &s[start..ix], start, &mut self.pending);
+            } else {
+                ix += 1;
+            }
+            self.candidate = next_candidate(s, ix);
+        }
+        self.pending.reverse();
+    }
+}
+
+fn next_candidate(s: &str, ix: usize) -> usize {
+    s.as_bytes()[ix..].iter().position(|&b| maybe_sa(b)).map(|i| ix + i).unwrap_or(s.len())
+}
+
+impl<'a, 'd> Iterator for SaLineBreakIterator<'a, 'd> {
+    type Item = (usize, bool);
+
+    #[inline]
+    fn next(&mut self) -> Option<(usize, bool)> {
+        if let Some(bk) = self.pending.pop() {
+            return Some((bk, false));
+        }
+        if let Some(next) = self.next.take() {
+            return Some(next);
+        }
+        let next = self.inner.next()?;
+        if self.candidate >= next.0 {
+            return Some(next);
+        }
+        self.find_sa_breaks(next.0);
+        match self.pending.pop() {
+            Some(bk) => {
+                self.next = Some(next);
+                Some((bk, false))
+            }
+            None => Some(next),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use alloc::vec;
+
+    const WORDS: &[&str] = &["ไป", "กิน", "ข้าว", "กินข้าว", "ที่", "บ้าน", "บ้า", "น้ำ"];
+
+    #[test]
+    fn trie_lookup() {
+        let dict = Dictionary::from_words(WORDS.iter().cloned());
+        for w in WORDS {
+            assert!(dict.contains(w), "{}", w);
+        }
+        assert!(!dict.contains("ก"));
+        assert!(!dict.contains("กินข"));
+        assert!(!dict.contains(""));
+        let mut lens = Vec::new();
+        dict.prefixes("บ้านที่".as_bytes(), |len| lens.push(len));
+        assert_eq!(vec!["บ้า".len(), "บ้าน".len()], lens);
+
+        let copy = Dictionary::from_bytes(dict.as_bytes()).unwrap();
+        assert!(WORDS.iter().all(|w| copy.contains(w)));
+        assert!(Dictionary::from_bytes(b"XIDA").is_none());
+        Dictionary::from_words(None).prefixes(b"a", |_| panic!());
+        assert!(WORDS.iter().all(|w| copy.clone().into_owned().contains(w)));
+    }
+
+    #[test]
+    fn malformed_dictionary() {
+        // The root's base is past the end of the units, and would overflow
+        // a 32-bit usize when followed.
+        let mut data = MAGIC.to_vec();
+        data.extend_from_slice(&VERSION.to_le_bytes());
+        data.extend_from_slice(&u32::max_value().to_le_bytes());
+        data.extend_from_slice(&0u32.to_le_bytes());
+        let dict = Dictionary::from_bytes(&data).unwrap();
+        assert!(!dict.contains("a"));
+        assert!(!dict.contains("\u{ff}"));
+    }
+
+    #[test]
+    fn sa_runs() {
+        let s = "ab ไปกิน, cd ข้าว";
+        let first = sa_run(s, 0).unwrap();
+        assert_eq!("ไปกิน", &s[first.clone()]);
+        assert_eq!(first, sa_run(s, first.start).unwrap());
+        let second = sa_run(s, first.end).unwrap();
+        assert_eq!("ข้าว", &s[second.clone()]);
+        assert_eq!(None, sa_run(s, second.end));
+        assert_eq!(first.start, sa_run_start(s, first.end));
+        assert_eq!(first.start, sa_run_start(s, first.start + "ไป".len()));
+        assert_eq!(first.start, sa_run_start(s, first.start));
+        assert_eq!(first.end + 1, sa_run_start(s, first.end + 1));
+    }
+
+    fn sa_breaks(s: &str, dict: &Dictionary) -> Vec<usize> {
+        SaLineBreakIterator::new(s, dict).map(|(bk, _)| bk).collect()
+    }
+
+    #[test]
+    fn sa_segmentation() {
+        let dict = Dictionary::from_words(WORDS.iter().cloned());
+        let s = "ไปกินข้าวที่บ้าน";
+        // Fewest words: กินข้าว rather than กิน ข้าว.
+        let ends = ["ไป", "ไปกินข้าว", "ไปกินข้าวที่", s].iter().map(|w| w.len()).collect::<Vec<_>>();
+        assert_eq!(ends, sa_breaks(s, &dict));
+        // Unknown code points stay together, and with a following mark.
+        let s = "ไปกขกิน";
+        assert_eq!(vec!["ไป".len(), "ไปกข".len(), s.len()], sa_breaks(s, &dict));
+        // Other text is unaffected.
+        let s = "hello ไปกิน world";
+        assert_eq!(vec![6, 6 + "ไป".len(), 7 + "ไปกิน".len(), s.len()], sa_breaks(s, &dict));
+        let s = "hello world\n";
+        let expected = LineBreakIterator::new(s).collect::<Vec<_>>();
+        assert_eq!(expected, SaLineBreakIterator::new(s, &dict).collect::<Vec<_>>());
+    }
+
+    #[test]
+    fn sa_long_run() {
+        let dict = Dictionary::from_words(WORDS.iter().cloned());
+        let s = "ไปกินข้าวที่บ้าน".repeat(100);
+        let breaks = sa_breaks(&s, &dict);
+        let ends = ["ไป", "ไปกินข้าว", "ไปกินข้าวที่", "ไปกินข้าวที่บ้าน"];
+        let unit = ends[3].len();
+        let expected =
+            (0..100).flat_map(|i| ends.iter().map(move |w| i * unit + w.len())).collect::<Vec<_>>();
+        assert_eq!(expected, breaks);
+    }
+}
@@ -17,55 +17,291 @@
 
 extern crate alloc;
 
+mod ascii;
+mod dict;
+mod segment;
 mod tables;
 
+use alloc::vec::Vec;
 use core::cmp::Ordering;
 
 use crate::tables::*;
 
-/// The Unicode line breaking property of the given code point.
-///
-/// This is given as a numeric value which matches the ULineBreak
-/// enum value from ICU.
-pub fn linebreak_property(cp: char) -> u8 {
+pub use crate::dict::{sa_run, sa_run_start, Dictionary, SaLineBreakIterator, SaSegmenter};
+pub use crate::segment::{GraphemeIterator, GraphemeLeafIter, WordBreakIterator};
+
+/// The packed properties of the given code point: the line breaking class
+/// in the `LINEBREAK_MASK` bits, plus emoji flags.
+#[cfg(not(feature = "flat_tables"))]
+#[inline]
+fn props(cp: char) -> u8 {
     let cp = cp as usize;
     if cp < 0x800 {
-        LINEBREAK_1_2[cp]
+        PROPS_1_2[cp]
     } else if cp < 0x10000 {
-        let child = LINEBREAK_3_ROOT[cp >> 6];
-        LINEBREAK_3_CHILD[(child as usize) * 0x40 + (cp & 0x3f)]
+        let child = PROPS_3_ROOT[cp >> 6];
+        PROPS_3_CHILD[(child as usize) * 0x40 + (cp & 0x3f)]
     } else {
-        let mid = LINEBREAK_4_ROOT[cp >> 12];
-        let leaf = LINEBREAK_4_MID[(mid as usize) * 0x40 + ((cp >> 6) & 0x3f)];
-        LINEBREAK_4_LEAVES[(leaf as usize) * 0x40 + (cp & 0x3f)]
+        let mid = PROPS_4_ROOT[cp >> 12];
+        let leaf = PROPS_4_MID[(mid as usize) * 0x40 + ((cp >> 6) & 0x3f)];
+        PROPS_4_LEAVES[(leaf as usize) * 0x40 + (cp & 0x3f)]
     }
 }
 
-/// The Unicode line breaking property of the given code point.
-///
-/// Look up the line breaking property for the first code point in the
-/// string. Return the property as a numeric value, and also the utf-8
-/// length of the codepoint, for convenience.
-pub fn linebreak_property_str(s: &str, ix: usize) -> (u8, usize) {
+#[cfg(feature = "flat_tables")]
+#[inline]
+fn props(cp: char) -> u8 {
+    let cp = cp as usize;
+    if cp < 0x800 {
+        PROPS_1_2[cp]
+    } else {
+        let leaf = PROPS_FLAT_ROOT[cp >> PROPS_FLAT_SHIFT] as usize;
+        PROPS_FLAT_LEAVES[(leaf << PROPS_FLAT_SHIFT) + (cp & ((1 << PROPS_FLAT_SHIFT) - 1))]
+    }
+}
+
+/// The packed properties of the first code point in the string, and its
+/// utf-8 length.
+#[cfg(not(feature = "flat_tables"))]
+#[inline]
+fn props_str(s: &str, ix: usize) -> (u8, usize) {
     let b = s.as_bytes()[ix];
     if b < 0x80 {
-        (LINEBREAK_1_2[b as usize], 1)
+        (PROPS_1_2[b as usize], 1)
     } else if b < 0xe0 {
         // 2 byte UTF-8 sequences
         let cp = ((b as usize) << 6) + (s.as_bytes()[ix + 1] as usize) - 0x3080;
-        (LINEBREAK_1_2[cp], 2)
+        (PROPS_1_2[cp], 2)
     } else if b < 0xf0 {
         // 3 byte UTF-8 sequences
         let mid_ix = ((b as usize) << 6) + (s.as_bytes()[ix + 1] as usize) - 0x3880;
-        let mid = LINEBREAK_3_ROOT[mid_ix];
-        (LINEBREAK_3_CHILD[(mid as usize) * 0x40 + (s.as_bytes()[ix + 2] as usize) - 0x80], 3)
+        let mid = PROPS_3_ROOT[mid_ix];
+        (PROPS_3_CHILD[(mid as usize) * 0x40 + (s.as_bytes()[ix + 2] as usize) - 0x80], 3)
     } else {
         // 4 byte UTF-8 sequences
         let mid_ix = ((b as usize) << 6) + (s.as_bytes()[ix + 1] as usize) - 0x3c80;
-        let mid = LINEBREAK_4_ROOT[mid_ix];
+        let mid = PROPS_4_ROOT[mid_ix];
         let leaf_ix = ((mid as usize) << 6) + (s.as_bytes()[ix + 2] as usize) - 0x80;
-        let leaf = LINEBREAK_4_MID[leaf_ix];
-        (LINEBREAK_4_LEAVES[(leaf as usize) * 0x40 + (s.as_bytes()[ix + 3] as usize) - 0x80], 4)
+        let leaf = PROPS_4_MID[leaf_ix];
+        (PROPS_4_LEAVES[(leaf as usize) * 0x40 + (s.as_bytes()[ix + 3] as usize) - 0x80], 4)
+    }
+}
+
+#[cfg(feature = "flat_tables")]
+#[inline]
+fn props_str(s: &str, ix: usize) -> (u8, usize) {
+    let b = s.as_bytes()[ix];
+    if b < 0x80 {
+        return (PROPS_1_2[b as usize], 1);
+    }
+    let (cp, len) = if b < 0xe0 {
+        (((b as usize) << 6) + (s.as_bytes()[ix + 1] as usize) - 0x3080, 2)
+    } else if b < 0xf0 {
+        let cp = ((b as usize) << 12)
+            + ((s.as_bytes()[ix + 1] as usize) << 6)
+            + (s.as_bytes()[ix + 2] as usize)
+            - 0xe2080;
+        (cp, 3)
+    } else {
+        let cp = ((b as usize) << 18)
+            + ((s.as_bytes()[ix + 1] as usize) << 12)
+            + ((s.as_bytes()[ix + 2] as usize) << 6)
+            + (s.as_bytes()[ix + 3] as usize)
+            - 0x3c82080;
+        (cp, 4)
+    };
+    if cp < 0x800 {
+        return (PROPS_1_2[cp], len);
+    }
+    let leaf = PROPS_FLAT_ROOT[cp >> PROPS_FLAT_SHIFT] as usize;
+    (PROPS_FLAT_LEAVES[(leaf << PROPS_FLAT_SHIFT) + (cp & ((1 << PROPS_FLAT_SHIFT) - 1))], len)
+}
+
+/// The ID (ideographic) line breaking class.
+const LB_ID: u8 = 14;
+/// The NS (nonstarter) line breaking class.
+const LB_NS: u8 = 18;
+/// The OP (opening punctuation) line breaking class.
+const LB_OP: u8 = 20;
+/// The class the state machines use for the iteration marks (such as
+/// U+3005), which are NS in Unicode, because loose line breaking treats them
+/// differently from other NS. It is not a UAX #14 class, and ICU uses its
+/// value for AK, so it never leaves the crate.
+const LB_IM: u8 = 43;
+/// The class for the East Asian wide OP, which LB30 leaves out. Like IM it
+/// is internal, and is OP outside the crate.
+const LB_OPW: u8 = 44;
+/// The class for the unassigned Extended_Pictographic code points, which
+/// LB30b treats as EB. Outside the crate it is ID.
+const LB_EPU: u8 = 45;
+
+/// The line breaking class of the code point at `ix` in `s` as the state
+/// machines see it, and its utf-8 length. This is `linebreak_property_str`,
+/// except for the internal classes IM, OPW and EPU.
+#[inline]
+pub(crate) fn linebreak_class_str(s: &str, ix: usize) -> (u8, usize) {
+    let (props, len) = props_str(s, ix);
+    (props & LINEBREAK_MASK, len)
+}
+
+/// The Unicode line breaking property of the given code point.
+///
+/// This is given as a numeric value which matches the ULineBreak
+/// enum value from ICU.
+pub fn linebreak_property(cp: char) -> u8 {
+    match props(cp) & LINEBREAK_MASK {
+        LB_IM => LB_NS,
+        LB_OPW => LB_OP,
+        LB_EPU => LB_ID,
+        lb => lb,
+    }
+}
+
+/// The Unicode line breaking property of the given code point.
+///
+/// Look up the line breaking property for the first code point in the
+/// string. Return the property as a numeric value, and also the utf-8
+/// length of the codepoint, for convenience.
+pub fn linebreak_property_str(s: &str, ix: usize) -> (u8, usize) {
+    match linebreak_class_str(s, ix) {
+        (LB_IM, len) => (LB_NS, len),
+        (LB_OPW, len) => (LB_OP, len),
+        (LB_EPU, len) => (LB_ID, len),
+        result => result,
+    }
+}
+
+/// The Unicode line breaking properties of a run of ASCII.
+///
+/// Writes the line breaking property of each byte of `s` to `out`, stopping
+/// at the first byte which is not ASCII or when `out` is full, and returns
+/// the number of properties written. This is equivalent to calling
+/// `linebreak_property_str` for each byte, but handles 16 or 32 bytes at a
+/// time when SSSE3 or AVX2 is enabled at compile time.
+pub fn linebreak_properties_ascii(s: &[u8], out: &mut [u8]) -> usize {
+    ascii::classify(s, out)
+}
+
+/// The width of the given code point in the columns of a monospace font.
+///
+/// This is 0 for combining marks, format characters and newlines, 2 for
+/// East Asian Wide and Fullwidth characters, and otherwise 1, including for
+/// those of ambiguous width. Returns `None` for code points whose width
+/// depends on context: tabs and other control characters, and those that
+/// combine into emoji clusters, such as ZWJ, emoji variation selectors,
+/// skin tone modifiers and regional indicators.
+pub fn mono_width(c: char) -> Option<usize> {
+    let cp = c as usize;
+    let mid = MONO_WIDTH_ROOT[cp >> 12] as usize;
+    let leaf = MONO_WIDTH_MID[(mid << 5) + ((cp >> 7) & 0x1f)] as usize;
+    let width = (MONO_WIDTH_LEAVES[(leaf << 5) + ((cp >> 2) & 0x1f)] >> ((cp & 3) * 2)) & 3;
+    if width == MONO_WIDTH_CONTEXT {
+        None
+    } else {
+        Some(width as usize)
+    }
+}
+
+/// The width of the string in the columns of a monospace font, as the sum
+/// of `mono_width` over its code points, or `None` if any of them depends
+/// on context.
+pub fn str_mono_width(s: &str) -> Option<usize> {
+    let mut width = 0;
+    for c in s.chars() {
+        if (' '..='~').contains(&c) {
+            width += 1;
+        } else {
+            width += mono_width(c)?;
+        }
+    }
+    Some(width)
+}
+
+/// A line breaking state machine.
+type StateMachine = [u8; N_LINEBREAK_STATES * N_LINEBREAK_CATEGORIES];
+
+/// The state following a code point of line breaking class `lb` at the
+/// start of the text. The default tables number these states by class.
+#[cfg(not(feature = "compact_lb_tables"))]
+#[inline]
+const fn lb_class_state(lb: u8) -> u8 {
+    lb
+}
+
+/// The state following a code point of line breaking class `lb` at the
+/// start of the text. The compact tables merge equivalent states, so this
+/// is a lookup.
+#[cfg(feature = "compact_lb_tables")]
+#[inline]
+const fn lb_class_state(lb: u8) -> u8 {
+    LINEBREAK_CLASS_STATE[lb as usize]
+}
+
+/// How strictly line breaking restricts breaks in Chinese and Japanese text.
+///
+/// These are the tailorings of UAX 14 that ICU selects with the `lb` locale
+/// keyword, as in `@lb=loose`, and that CSS calls `line-break`. They differ
+/// only in the treatment of non-starters: `Strict` doesn't break before
+/// small kana and the prolonged sound mark (the conditional Japanese
+/// starters, CJ), `Normal` does, and `Loose` also breaks before the
+/// iteration marks, such as U+3005. No strictness breaks before the other
+/// non-starters (NS), such as U+30FB or U+203C.
+///
+/// Note that ICU's Chinese and Japanese locales make a few further changes
+/// of their own, which are not implemented here.
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash)]
+pub enum LineBreakStrictness {
+    /// The default, as with ICU's root locale.
+    Strict,
+    Normal,
+    Loose,
+}
+
+impl Default for LineBreakStrictness {
+    fn default() -> LineBreakStrictness {
+        LineBreakStrictness::Strict
+    }
+}
+
+impl LineBreakStrictness {
+    fn state_machine(self) -> &'static StateMachine {
+        match self {
+            LineBreakStrictness::Strict => &LINEBREAK_STATE_MACHINE,
+            LineBreakStrictness::Normal => &LINEBREAK_STATE_MACHINE_NORMAL,
+            LineBreakStrictness::Loose => &LINEBREAK_STATE_MACHINE_LOOSE,
+        }
+    }
+}
+
+/// The line breaking state machines, for the differential tests in `tools/`,
+/// which model them. This follows the table layout selected by the crate's
+/// features, and is not a stable API.
+#[doc(hidden)]
+pub mod lb_machine {
+    use super::*;
+
+    /// The number of line breaking classes, which is the row length of the
+    /// state machines.
+    pub const N_CLASSES: usize = N_LINEBREAK_CATEGORIES;
+
+    /// The state machine for `strictness`, as rows of `N_CLASSES` entries.
+    /// The entry at row `state`, column `class` is the new state; if bit
+    /// 0x80 is set, there is a break before the code point, 0x40 marks it
+    /// as hard, and the low 6 bits are the new state.
+    pub fn state_machine(strictness: LineBreakStrictness) -> &'static [u8] {
+        strictness.state_machine()
+    }
+
+    /// The class of `c` in the state machines. This is `linebreak_property`,
+    /// except for the iteration marks, which have a class of their own.
+    pub fn class(c: char) -> u8 {
+        props(c) & LINEBREAK_MASK
+    }
+
+    /// The state following a code point of class `class` at the start of
+    /// the text.
+    pub fn start_state(class: u8) -> u8 {
+        lb_class_state(class)
     }
 }
 
@@ -82,6 +318,8 @@ pub struct LineBreakIterator<'a> {
     s: &'a str,
     ix: usize,
     state: u8,
+    sm: &'static StateMachine,
+    classes: ascii::ClassBuffer,
 }
 
 impl<'a> Iterator for LineBreakIterator<'a> {
@@ -90,6 +328,7 @@ impl<'a> Iterator for LineBreakIterator<'a> {
     // return break pos and whether it's a hard break
     fn next(&mut self) -> Option<(usize, bool)> {
         loop {
+            ascii::skip_alnum_run(self.s.as_bytes(), &mut self.ix, &mut self.state);
             match self.ix.cmp(&self.s.len()) {
                 Ordering::Greater => {
                     return None;
@@ -98,13 +337,13 @@ impl<'a> Iterator for LineBreakIterator<'a> {
                     // LB3, break at EOT
                     self.ix += 1;
                     let i = (self.state as usize) * N_LINEBREAK_CATEGORIES;
-                    let new = LINEBREAK_STATE_MACHINE[i];
+                    let new = self.sm[i];
                     return Some((self.s.len(), new >= 0xc0));
                 }
                 Ordering::Less => {
-                    let (lb, len) = linebreak_property_str(self.s, self.ix);
+                    let (lb, len) = self.classes.get(self.s, self.ix);
                     let i = (self.state as usize) * N_LINEBREAK_CATEGORIES + (lb as usize);
-                    let new = LINEBREAK_STATE_MACHINE[i];
+                    let new = self.sm[i];
                     //println!("{:?}[{}], state {} + lb {} -> {}", &self.s[self.ix..], self.ix, self.state, lb, new);
                     let result = self.ix;
                     self.ix += len;
@@ -124,15 +363,25 @@ impl<'a> Iterator for LineBreakIterator<'a> {
 impl<'a> LineBreakIterator<'a> {
     /// Create a new iterator for the given string slice.
     pub fn new(s: &str) -> LineBreakIterator {
+        LineBreakIterator::with_strictness(s, LineBreakStrictness::default())
+    }
+
+    /// Create a new iterator for the given string slice, with the given
+    /// tailoring of the rules.
+    pub fn with_strictness(s: &str, strictness: LineBreakStrictness) -> LineBreakIterator {
+        let sm = strictness.state_machine();
         if s.is_empty() {
             LineBreakIterator {
                 s,
                 ix: 1, // LB2, don't break; sot takes priority for empty string
                 state: 0,
+                sm,
+                classes: Default::default(),
             }
         } else {
-            let (lb, len) = linebreak_property_str(s, 0);
-            LineBreakIterator { s, ix: len, state: lb }
+            let (lb, len) = linebreak_class_str(s, 0);
+            let state = lb_class_state(lb);
+            LineBreakIterator { s, ix: len, state, sm, classes: Default::default() }
         }
     }
 }
@@ -149,13 +398,27 @@ impl<'a> LineBreakIterator<'a> {
 pub struct LineBreakLeafIter {
     ix: usize,
     state: u8,
+    sm: &'static StateMachine,
+}
+
+// Two iterators that compare equal find the same breaks from here on, given
+// the same text. The tables are constants, so the same one usually, but not
+// always, has the same address.
+impl PartialEq for LineBreakLeafIter {
+    fn eq(&self, other: &LineBreakLeafIter) -> bool {
+        self.ix == other.ix
+            && self.state == other.state
+            && (core::ptr::eq(self.sm, other.sm) || self.sm[..] == other.sm[..])
+    }
 }
 
+impl Eq for LineBreakLeafIter {}
+
 impl Default for LineBreakLeafIter {
     // A default value. No guarantees on what happens when next() is called
     // on this. Intended to be useful for empty ropes.
     fn default() -> LineBreakLeafIter {
-        LineBreakLeafIter { ix: 0, state: 0 }
+        LineBreakLeafIter { ix: 0, state: 0, sm: &LINEBREAK_STATE_MACHINE }
     }
 }
 
@@ -163,8 +426,82 @@ impl LineBreakLeafIter {
     /// Create a new line break iterator suitable for leaves in a rope.
     /// Precondition: ix is at a code point boundary within s.
     pub fn new(s: &str, ix: usize) -> LineBreakLeafIter {
-        let (lb, len) = if ix == s.len() { (0, 0) } else { linebreak_property_str(s, ix) };
-        LineBreakLeafIter { ix: ix + len, state: lb }
+        LineBreakLeafIter::with_strictness(s, ix, LineBreakStrictness::default())
+    }
+
+    /// Like `new`, with the given tailoring of the rules.
+    pub fn with_strictness(
+        s: &str,
+        ix: usize,
+        strictness: LineBreakStrictness,
+    ) -> LineBreakLeafIter {
+        let (lb, len) = if ix == s.len() { (0, 0) } else { linebreak_class_str(s, ix) };
+        let state = lb_class_state(lb);
+        LineBreakLeafIter { ix: ix + len, state, sm: strictness.state_machine() }
+    }
+
+    /// Create an iterator that resumes after a break at `ix`, found by an
+    /// earlier iteration over the same text, so that from there on it finds
+    /// the same breaks as that iteration would. Unlike `new`, this needs no
+    /// look-behind, as long as `ix` really is a break.
+    ///
+    /// Returns `None` in the rare cases where the state following the break
+    /// also depends on the text before it: a combining mark or ZWJ after
+    /// spaces.
+    ///
+    /// `strictness` must be the one that found the break.
+    pub fn resume(
+        s: &str,
+        ix: usize,
+        strictness: LineBreakStrictness,
+    ) -> Option<LineBreakLeafIter> {
+        let sm = strictness.state_machine();
+        if ix == s.len() {
+            return Some(LineBreakLeafIter { ix, state: lb_class_state(0), sm });
+        }
+        let (lb, len) = linebreak_class_str(s, ix);
+        match LINEBREAK_RESUME_STATE[lb as usize] {
+            0xff => None,
+            state => Some(LineBreakLeafIter { ix: ix + len, state, sm }),
+        }
+    }
+
+    /// Create an iterator at `ix`, any code point boundary, without knowing
+    /// anything about the text before it. This runs the state machine from
+    /// every state at once until they all agree, which usually takes only a
+    /// few code points. Returns the offset where they agreed and the iterator
+    /// from there: the breaks it finds, at and after that offset, are the same
+    /// as those of an iteration from the start of the text.
+    ///
+    /// Returns `None` if the states still disagree at the end of `s`, which
+    /// can happen in a long run of spaces.
+    pub fn sync(
+        s: &str,
+        ix: usize,
+        strictness: LineBreakStrictness,
+    ) -> Option<(usize, LineBreakLeafIter)> {
+        let sm = strictness.state_machine();
+        debug_assert!(N_LINEBREAK_STATES <= 128);
+        let mut states = !0u128 >> (128 - N_LINEBREAK_STATES);
+        let mut ix = ix;
+        while ix < s.len() {
+            let (lb, len) = linebreak_class_str(s, ix);
+            let mut next = 0u128;
+            let mut rest = states;
+            while rest != 0 {
+                let state = rest.trailing_zeros() as usize;
+                rest &= rest - 1;
+                let new = sm[state * N_LINEBREAK_CATEGORIES + (lb as usize)];
+                next |= 1 << if (new as i8) < 0 { new & 0x3f } else { new };
+            }
+            states = next;
+            ix += len;
+            if states.count_ones() == 1 {
+                let state = states.trailing_zeros() as u8;
+                return Some((ix, LineBreakLeafIter { ix, state, sm }));
+            }
+        }
+        None
     }
 
     /// Return break pos and whether it's a hard break. Note: hard break
@@ -179,13 +516,14 @@ impl LineBreakLeafIter {
     /// reached (and initially this should be the same as in the `new` call).
     pub fn next(&mut self, s: &str) -> (usize, bool) {
         loop {
+            ascii::skip_alnum_run(s.as_bytes(), &mut self.ix, &mut self.state);
             if self.ix == s.len() {
                 self.ix = 0; // in preparation for next leaf
                 return (s.len(), false);
             }
-            let (lb, len) = linebreak_property_str(s, self.ix);
+            let (lb, len) = linebreak_class_str(s, self.ix);
             let i = (self.state as usize) * N_LINEBREAK_CATEGORIES + (lb as usize);
-            let new = LINEBREAK_STATE_MACHINE[i];
+            let new = self.sm[i];
             //println!("\"{}\"[{}], state {} + lb {} -> {}", &s[self.ix..], self.ix, self.state, lb, new);
             let result = self.ix;
             self.ix += len;
@@ -198,22 +536,48 @@ impl LineBreakLeafIter {
             }
         }
     }
-}
 
-fn is_in_asc_list<T: core::cmp::PartialOrd>(c: T, list: &[T], start: usize, end: usize) -> bool {
-    if c == list[start] || c == list[end] {
-        return true;
-    }
-    if end - start <= 1 {
-        return false;
-    }
-
-    let mid = (start + end) / 2;
-
-    if c >= list[mid] {
-        is_in_asc_list(c, &list, mid, end)
-    } else {
-        is_in_asc_list(c, &list, start, mid)
+    /// Compute all the remaining breaks in the leaf in one call, appending
+    /// their offsets to `offsets`. Hard breaks are recorded in the bitmap
+    /// `hard`: bit `i % 64` of `hard[i / 64]` is set if `offsets[i]` is a
+    /// hard break, so `hard` should cover `offsets` on entry (both empty is
+    /// simplest), and is extended to cover it on return.
+    ///
+    /// This is equivalent to calling `next` until it returns the end of the
+    /// leaf, and leaves the iterator ready for the next leaf in the same way.
+    /// Offsets are `u32` to keep the buffer compact; `s` must be shorter
+    /// than 4GiB, which holds for rope leaves.
+    pub fn next_all(&mut self, s: &str, offsets: &mut Vec<u32>, hard: &mut Vec<u64>) {
+        debug_assert!(s.len() <= u32::max_value() as usize);
+        let bytes = s.as_bytes();
+        let mut ix = self.ix;
+        let mut state = self.state;
+        let mut classes = ascii::ClassBuffer::default();
+        loop {
+            ascii::skip_alnum_run(bytes, &mut ix, &mut state);
+            if ix >= bytes.len() {
+                break;
+            }
+            let (lb, len) = classes.get(s, ix);
+            let new = self.sm[(state as usize) * N_LINEBREAK_CATEGORIES + (lb as usize)];
+            if (new as i8) < 0 {
+                let i = offsets.len();
+                offsets.push(ix as u32);
+                if new >= 0xc0 {
+                    if hard.len() <= i / 64 {
+                        hard.resize(i / 64 + 1, 0);
+                    }
+                    hard[i / 64] |= 1 << (i % 64);
+                }
+                state = new & 0x3f;
+            } else {
+                state = new;
+            }
+            ix += len;
+        }
+        hard.resize((offsets.len() + 63) / 64, 0);
+        self.ix = 0; // in preparation for next leaf
+        self.state = state;
     }
 }
 
@@ -244,10 +608,10 @@ impl EmojiExt for char {
         self == '\u{20E3}'
     }
     fn is_emoji(self) -> bool {
-        is_in_asc_list(self, &EMOJI_TABLE, 0, EMOJI_TABLE.len() - 1)
+        props(self) & EMOJI_FLAG != 0
     }
     fn is_emoji_modifier_base(self) -> bool {
-        is_in_asc_list(self, &EMOJI_MODIFIER_BASE_TABLE, 0, EMOJI_MODIFIER_BASE_TABLE.len() - 1)
+        props(self) & EMOJI_MODIFIER_BASE_FLAG != 0
     }
     fn is_tag_spec_char(self) -> bool {
         ('\u{E0020}'..='\u{E007E}').contains(&self)
@@ -268,7 +632,12 @@ pub fn is_keycap_base(c: char) -> bool {
 mod tests {
     use crate::linebreak_property;
     use crate::linebreak_property_str;
+    use crate::mono_width;
+    use crate::str_mono_width;
+    use crate::EmojiExt;
     use crate::LineBreakIterator;
+    use crate::LineBreakLeafIter;
+    use crate::LineBreakStrictness;
     use alloc::vec;
     use alloc::vec::*;
 
@@ -494,7 +863,7 @@ mod tests {
         assert_eq!((9, 3), linebreak_property_str(&"\u{A928}", 0));
         assert_eq!((24, 3), linebreak_property_str(&"\u{AA7E}", 0));
         assert_eq!((2, 3), linebreak_property_str(&"\u{AAEA}", 0));
-        assert_eq!((0, 3), linebreak_property_str(&"\u{AB66}", 0));
+        assert_eq!((2, 3), linebreak_property_str(&"\u{AB66}", 0));
         assert_eq!((32, 3), linebreak_property_str(&"\u{B9FC}", 0));
         assert_eq!((32, 3), linebreak_property_str(&"\u{CD89}", 0));
         assert_eq!((32, 3), linebreak_property_str(&"\u{CDB2}", 0));
@@ -609,6 +978,60 @@ mod tests {
         );
     }
 
+    #[test]
+    // The iteration marks are NS, although the state machines tell them apart.
+    fn linebreak_property_iteration_marks() {
+        for &c in &['\u{3005}', '\u{303B}', '\u{309D}', '\u{309E}', '\u{30FD}', '\u{30FE}'] {
+            assert_eq!(18, linebreak_property(c));
+            let mut buf = [0; 4];
+            assert_eq!((18, 3), linebreak_property_str(c.encode_utf8(&mut buf), 0));
+        }
+    }
+
+    #[test]
+    // The wide OP and the unassigned Extended_Pictographic code points are OP
+    // and ID, although the state machines tell them apart.
+    fn linebreak_property_internal_classes() {
+        assert_eq!(20, linebreak_property('\u{3008}'));
+        assert_eq!((20, 3), linebreak_property_str("\u{FF08}", 0));
+        assert_eq!(14, linebreak_property('\u{1F02C}'));
+        assert_eq!((14, 4), linebreak_property_str("\u{1FAFF}", 0));
+    }
+
+    #[test]
+    fn lb_strictness() {
+        use super::LineBreakStrictness::*;
+        let breaks = |s, strictness| {
+            let breaks = LineBreakIterator::with_strictness(s, strictness).collect::<Vec<_>>();
+            let mut leaf = LineBreakLeafIter::with_strictness(s, 0, strictness);
+            let mut leaf_breaks = Vec::new();
+            loop {
+                let (bk, hard) = leaf.next(s);
+                leaf_breaks.push((bk, hard && bk < s.len()));
+                if bk == s.len() {
+                    break;
+                }
+            }
+            assert_eq!(breaks, leaf_breaks);
+            breaks.into_iter().map(|(bk, _)| bk).collect::<Vec<_>>()
+        };
+        // small kana (CJ)
+        let s = "\u{3042}\u{3041}\u{3044}";
+        assert_eq!(vec![6, 9], breaks(s, Strict));
+        assert_eq!(vec![3, 6, 9], breaks(s, Normal));
+        assert_eq!(vec![3, 6, 9], breaks(s, Loose));
+        // iteration mark (NS)
+        let s = "\u{4eba}\u{3005}\u{3044}";
+        assert_eq!(vec![6, 9], breaks(s, Strict));
+        assert_eq!(vec![6, 9], breaks(s, Normal));
+        assert_eq!(vec![3, 6, 9], breaks(s, Loose));
+        // but still not after an opening bracket
+        assert_eq!(vec![6, 9], breaks("\u{300c}\u{3005}\u{3041}", Loose));
+        // nor before other NS
+        assert_eq!(vec![6, 9], breaks("\u{4eba}\u{30fb}\u{4eba}", Loose));
+        assert_eq!(vec![6, 9], breaks("\u{4eba}\u{203c}\u{4eba}", Loose));
+    }
+
     #[test]
     // The final break is hard only when there is an explicit separator.
     fn lb_iter_eot() {
@@ -618,4 +1041,172 @@ mod tests {
 
         assert_eq!(vec![(5, true)], LineBreakIterator::new("abc\u{0085}").collect::<Vec<_>>());
     }
+
+    #[test]
+    fn leaf_next_all() {
+        let s = "Now is\r\nthe time\u{2028}for 1\u{FF0C}234 \u{1F466}\u{1F3FB}\u{1F1E6}\u{1F1E6} x";
+        // Split into leaves at every possible point, starting mid-leaf too.
+        for split in (0..s.len()).filter(|&i| s.is_char_boundary(i)) {
+            let leaves = [&s[..split], &s[split..]];
+            let mut expected = Vec::new();
+            let mut iter = LineBreakLeafIter::new(leaves[0], 0);
+            for leaf in &leaves {
+                loop {
+                    let (bk, hard) = iter.next(leaf);
+                    if bk == leaf.len() {
+                        break;
+                    }
+                    expected.push((bk as u32, hard));
+                }
+            }
+            let mut actual = Vec::new();
+            let mut iter = LineBreakLeafIter::new(leaves[0], 0);
+            for leaf in &leaves {
+                let mut offsets = Vec::new();
+                let mut hard = Vec::new();
+                iter.next_all(leaf, &mut offsets, &mut hard);
+                assert_eq!(hard.len(), (offsets.len() + 63) / 64);
+                for (i, &offset) in offsets.iter().enumerate() {
+                    actual.push((offset, hard[i / 64] & (1 << (i % 64)) != 0));
+                }
+            }
+            assert_eq!(expected, actual);
+        }
+
+        // The hard break bitmap spans several words.
+        let s = "a\nb ".repeat(100);
+        let mut offsets = Vec::new();
+        let mut hard = Vec::new();
+        LineBreakLeafIter::new(&s, 0).next_all(&s, &mut offsets, &mut hard);
+        assert_eq!(offsets.len(), 199);
+        assert_eq!(hard.len(), 4);
+        for (i, &offset) in offsets.iter().enumerate() {
+            assert_eq!(hard[i / 64] & (1 << (i % 64)) != 0, offset % 4 == 2);
+        }
+    }
+
+    #[test]
+    fn leaf_resume() {
+        use super::LineBreakStrictness::*;
+        let s = "Now is\r\nthe time\u{2028}for 1\u{FF0C}234 \u{1F466}\u{1F3FB}\u{1F1E6}\u{1F1E6} \
+                 x (\"a\")  \u{300C}b\u{300D} \u{0301}c \u{200D}d 12.5%, e-f \u{5B57}\u{3002}\
+                 \u{4EBA}\u{3041}\u{4EBA}\u{3005}\u{4EBA}";
+        for &strictness in &[Strict, Normal, Loose] {
+            let breaks: Vec<usize> =
+                LineBreakIterator::with_strictness(s, strictness).map(|(bk, _)| bk).collect();
+            // The last break is at the end of the string.
+            for (i, &ix) in breaks.iter().enumerate().take(breaks.len() - 1) {
+                let mut iter = match LineBreakLeafIter::resume(s, ix, strictness) {
+                    Some(iter) => iter,
+                    None => {
+                        let c = s[ix..].chars().next().unwrap();
+                        assert!(c == '\u{0301}' || c == '\u{200D}', "can't resume at {:?}", c);
+                        continue;
+                    }
+                };
+                let mut rest = Vec::new();
+                loop {
+                    let (bk, _) = iter.next(s);
+                    rest.push(bk);
+                    if bk == s.len() {
+                        break;
+                    }
+                }
+                assert_eq!(&rest[..], &breaks[i + 1..], "resuming at {}, {:?}", ix, strictness);
+            }
+        }
+    }
+
+    #[test]
+    fn leaf_sync() {
+        use super::LineBreakStrictness::*;
+        let s = "Now is\r\nthe time\u{2028}for 1\u{FF0C}234 \u{1F466}\u{1F3FB}\u{1F1E6}\u{1F1E6} \
+                 x (\"a\")  \u{300C}b\u{300D} \u{0301}c \u{200D}d 12.5%, e-f \u{5B57}\u{3002}\
+                 \u{4EBA}\u{3041}\u{4EBA}\u{3005}\u{4EBA}";
+        for &strictness in &[Strict, Normal, Loose] {
+            let breaks: Vec<usize> =
+                LineBreakIterator::with_strictness(s, strictness).map(|(bk, _)| bk).collect();
+            for ix in (0..s.len()).filter(|&ix| s.is_char_boundary(ix)) {
+                let (sync, mut iter) = match LineBreakLeafIter::sync(s, ix, strictness) {
+                    Some(result) => result,
+                    None => {
+                        assert!(s.len() - ix < 8, "no sync from {}", ix);
+                        continue;
+                    }
+                };
+                assert!(sync > ix && sync - ix < 16);
+                let mut rest = Vec::new();
+                loop {
+                    let (bk, _) = iter.next(s);
+                    rest.push(bk);
+                    if bk == s.len() {
+                        break;
+                    }
+                }
+                let expected: Vec<usize> =
+                    breaks.iter().cloned().filter(|&bk| bk >= sync).collect();
+                assert_eq!(rest, expected, "syncing from {}, {:?}", ix, strictness);
+            }
+        }
+    }
+
+    #[test]
+    fn emoji_props() {
+        assert!('#'.is_emoji());
+        assert!('\u{2764}'.is_emoji());
+        assert!('\u{1F600}'.is_emoji());
+        assert!('\u{1F3FB}'.is_emoji());
+        assert!(!'a'.is_emoji());
+        assert!(!'\u{200D}'.is_emoji());
+        assert!(!'\u{1F1E6}'.is_emoji_modifier_base());
+
+        assert!('\u{261D}'.is_emoji_modifier_base());
+        assert!('\u{1F466}'.is_emoji_modifier_base());
+        assert!(!'\u{1F600}'.is_emoji_modifier_base());
+        assert!(!'\u{1F3FB}'.is_emoji_modifier_base());
+
+        // The flags don't disturb the line breaking class.
+        assert_eq!(41, linebreak_property('\u{1F3FB}'));
+        assert_eq!(40, linebreak_property('\u{1F466}'));
+    }
+
+    #[test]
+    fn mono_widths() {
+        assert_eq!(Some(1), mono_width('a'));
+        assert_eq!(Some(0), mono_width('\n'));
+        assert_eq!(None, mono_width('\t'));
+        assert_eq!(Some(0), mono_width('\u{0301}'));
+        assert_eq!(Some(1), mono_width('\u{00AD}'));
+        assert_eq!(Some(0), mono_width('\u{200B}'));
+        assert_eq!(Some(1), mono_width('\u{00E9}'));
+        assert_eq!(Some(1), mono_width('\u{03B1}'));
+        assert_eq!(Some(2), mono_width('\u{4E00}'));
+        assert_eq!(Some(2), mono_width('\u{9FFF}'));
+        assert_eq!(Some(2), mono_width('\u{FF21}'));
+        assert_eq!(Some(1), mono_width('\u{FF61}'));
+        assert_eq!(Some(2), mono_width('\u{AC00}'));
+        assert_eq!(Some(0), mono_width('\u{1160}'));
+        assert_eq!(Some(2), mono_width('\u{1F600}'));
+        assert_eq!(Some(2), mono_width('\u{2A700}'));
+        assert_eq!(None, mono_width('\u{200D}'));
+        assert_eq!(None, mono_width('\u{FE0F}'));
+        assert_eq!(None, mono_width('\u{1F3FB}'));
+        assert_eq!(None, mono_width('\u{1F1E6}'));
+
+        assert_eq!(Some(0), str_mono_width(""));
+        assert_eq!(Some(5), str_mono_width("hello\n"));
+        assert_eq!(Some(7), str_mono_width("e\u{0301} \u{4E16}\u{754C}!\r\n"));
+        assert_eq!(None, str_mono_width("a\tb"));
+        assert_eq!(None, str_mono_width("\u{1F44D}\u{1F3FD}"));
+    }
+
+    #[test]
+    fn leaf_iter_eq() {
+        let s = "hello world";
+        let mut iter = LineBreakLeafIter::new(s, 0);
+        assert!(iter != LineBreakLeafIter::new(s, 6));
+        assert_eq!((6, false), iter.next(s));
+        assert!(iter == LineBreakLeafIter::new(s, 6));
+        assert!(iter != LineBreakLeafIter::with_strictness(s, 6, LineBreakStrictness::Loose));
+    }
 }
@@ -0,0 +1,356 @@
+// Copyright 2026 The xi-editor Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! Grapheme cluster and word boundaries, as in UAX #29.
+//!
+//! These work the same way as line breaking: a class per code point, looked
+//! up in a trie indexed by utf-8 bytes, drives a state machine generated by
+//! tools/mk_tables.py, with one table lookup per code point, and no other
+//! branches on the text.
+
+use crate::tables::*;
+
+/// A trie indexed by the utf-8 bytes of a code point, in the layout of the
+/// line breaking property tables.
+struct Utf8Trie {
+    t_1_2: &'static [u8; 0x800],
+    root_3: &'static [u8],
+    child_3: &'static [u8],
+    root_4: &'static [u8],
+    mid_4: &'static [u8],
+    leaves_4: &'static [u8],
+}
+
+impl Utf8Trie {
+    /// The value for the first code point in the string, and its utf-8
+    /// length.
+    #[inline]
+    fn get(&self, s: &str, ix: usize) -> (u8, usize) {
+        let s = s.as_bytes();
+        let b = s[ix];
+        if b < 0x80 {
+            (self.t_1_2[b as usize], 1)
+        } else if b < 0xe0 {
+            let cp = ((b as usize) << 6) + (s[ix + 1] as usize) - 0x3080;
+            (self.t_1_2[cp], 2)
+        } else if b < 0xf0 {
+            let mid = self.root_3[((b as usize) << 6) + (s[ix + 1] as usize) - 0x3880];
+            (self.child_3[(mid as usize) * 0x40 + (s[ix + 2] as usize) - 0x80], 3)
+        } else {
+            let mid = self.root_4[((b as usize) << 6) + (s[ix + 1] as usize) - 0x3c80];
+            let leaf = self.mid_4[((mid as usize) << 6) + (s[ix + 2] as usize) - 0x80];
+            (self.leaves_4[(leaf as usize) * 0x40 + (s[ix + 3] as usize) - 0x80], 4)
+        }
+    }
+}
+
+static GRAPHEME: Utf8Trie = Utf8Trie {
+    t_1_2: &GRAPHEME_1_2,
+    root_3: &GRAPHEME_3_ROOT,
+    child_3: &GRAPHEME_3_CHILD,
+    root_4: &GRAPHEME_4_ROOT,
+    mid_4: &GRAPHEME_4_MID,
+    leaves_4: &GRAPHEME_4_LEAVES,
+};
+
+static WORD: Utf8Trie = Utf8Trie {
+    t_1_2: &WORD_1_2,
+    root_3: &WORD_3_ROOT,
+    child_3: &WORD_3_CHILD,
+    root_4: &WORD_4_ROOT,
+    mid_4: &WORD_4_MID,
+    leaves_4: &WORD_4_LEAVES,
+};
+
+static GRAPHEME_SM: &[u8; N_GRAPHEME_STATES * N_GRAPHEME_CATEGORIES] = &GRAPHEME_STATE_MACHINE;
+
+/// The row length of `WORD_STATE_MACHINE`, which has a column for the end of
+/// the text after those for the classes.
+const WORD_ROW: usize = N_WORD_CATEGORIES + 1;
+
+static WORD_SM: &[u16; N_WORD_STATES * WORD_ROW] = &WORD_STATE_MACHINE;
+
+/// One step of the grapheme cluster state machine, from `state` over the
+/// code point at `ix`. Returns the new entry and the code point's length.
+#[inline]
+fn grapheme_step(s: &str, ix: usize, state: u8) -> (u8, usize) {
+    let (gc, len) = GRAPHEME.get(s, ix);
+    (GRAPHEME_SM[(state as usize) * N_GRAPHEME_CATEGORIES + (gc as usize)], len)
+}
+
+/// An iterator over the extended grapheme cluster boundaries of a string,
+/// as in UAX #29, producing the offset of each.
+///
+/// As with `LineBreakIterator`, the start of the string is not included
+/// (thus, the empty string has none), and for non-empty strings, the end
+/// always is.
+#[derive(Copy, Clone)]
+pub struct GraphemeIterator<'a> {
+    s: &'a str,
+    ix: usize,
+    state: u8,
+}
+
+impl<'a> GraphemeIterator<'a> {
+    pub fn new(s: &'a str) -> GraphemeIterator<'a> {
+        // The start state never breaks, so the start of the string is not
+        // reported; for the empty string, there is no end either.
+        let ix = if s.is_empty() { 1 } else { 0 };
+        GraphemeIterator { s, ix, state: 0 }
+    }
+}
+
+impl<'a> Iterator for GraphemeIterator<'a> {
+    type Item = usize;
+
+    fn next(&mut self) -> Option<usize> {
+        while self.ix < self.s.len() {
+            let (new, len) = grapheme_step(self.s, self.ix, self.state);
+            let result = self.ix;
+            self.ix += len;
+            self.state = new & 0x7f;
+            if new & 0x80 != 0 {
+                return Some(result);
+            }
+        }
+        if self.ix == self.s.len() {
+            self.ix += 1;
+            Some(self.s.len())
+        } else {
+            None
+        }
+    }
+}
+
+/// Grapheme cluster boundaries in a rope or other non-contiguous string,
+/// in the manner of `LineBreakLeafIter`, which see.
+///
+/// Unlike line breaks, grapheme cluster boundaries need no look-behind
+/// beyond a boundary, so an iterator can start at any known one.
+#[derive(Copy, Clone, Default)]
+pub struct GraphemeLeafIter {
+    ix: usize,
+    state: u8,
+}
+
+impl GraphemeLeafIter {
+    /// Create a new iterator starting at `ix` in the leaf `s`, which must be
+    /// a grapheme cluster boundary, such as the start of the text.
+    pub fn new(_s: &str, ix: usize) -> GraphemeLeafIter {
+        GraphemeLeafIter { ix, state: 0 }
+    }
+
+    /// Return the next boundary in the leaf. If the end of the leaf is
+    /// reached first, return its length; this is not necessarily a boundary,
+    /// and the next call, with the next leaf, returns 0 if it is. The end of
+    /// the text is always a boundary, which is up to the caller.
+    ///
+    /// As with `LineBreakLeafIter`, always supply the same `s` until the end
+    /// of the leaf is reached.
+    pub fn next(&mut self, s: &str) -> usize {
+        while self.ix < s.len() {
+            let (new, len) = grapheme_step(s, self.ix, self.state);
+            let result = self.ix;
+            self.ix += len;
+            self.state = new & 0x7f;
+            if new & 0x80 != 0 {
+                return result;
+            }
+        }
+        self.ix = 0; // in preparation for next leaf
+        s.len()
+    }
+}
+
+/// An iterator over the word boundaries of a string, as in UAX #29,
+/// producing the offset of each. As with `GraphemeIterator`, the start of
+/// the string is not included, and the end is.
+///
+/// Some boundaries depend on the code point after the next, as between
+/// "e" and "." in "e.g" and "e.", so the state machine can mark a boundary
+/// as pending, and confirm or cancel it a code point later. This is why
+/// there is no leaf iterator for words: a boundary can be found only in the
+/// leaf after its own.
+#[derive(Copy, Clone)]
+pub struct WordBreakIterator<'a> {
+    s: &'a str,
+    ix: usize,
+    state: u8,
+    /// The offset of the pending boundary, if the state is pending.
+    mark: usize,
+    /// A boundary found along with a confirmed pending one, to be returned
+    /// after it.
+    queued: Option<usize>,
+}
+
+impl<'a> WordBreakIterator<'a> {
+    pub fn new(s: &'a str) -> WordBreakIterator<'a> {
+        let ix = if s.is_empty() { 1 } else { 0 };
+        WordBreakIterator { s, ix, state: 0, mark: 0, queued: None }
+    }
+}
+
+impl<'a> Iterator for WordBreakIterator<'a> {
+    type Item = usize;
+
+    fn next(&mut self) -> Option<usize> {
+        if let Some(bk) = self.queued.take() {
+            return Some(bk);
+        }
+        while self.ix < self.s.len() {
+            let (wb, len) = WORD.get(self.s, self.ix);
+            let new = WORD_SM[(self.state as usize) * WORD_ROW + (wb as usize)];
+            let result = self.ix;
+            self.ix += len;
+            self.state = new as u8;
+            if new & WORD_CONFIRM != 0 {
+                if new & WORD_BREAK != 0 {
+                    self.queued = Some(result);
+                }
+                return Some(self.mark);
+            }
+            if new & WORD_MARK != 0 {
+                self.mark = result;
+            } else if new & WORD_BREAK != 0 {
+                return Some(result);
+            }
+        }
+        if self.ix == self.s.len() {
+            self.ix += 1;
+            let eot = WORD_SM[(self.state as usize) * WORD_ROW + N_WORD_CATEGORIES];
+            if eot & WORD_CONFIRM != 0 {
+                self.queued = Some(self.s.len());
+                return Some(self.mark);
+            }
+            Some(self.s.len())
+        } else {
+            None
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use alloc::format;
+    use alloc::vec::Vec;
+
+    fn graphemes(s: &str) -> Vec<&str> {
+        let mut start = 0;
+        GraphemeIterator::new(s)
+            .map(|bk| {
+                let g = &s[start..bk];
+                start = bk;
+                g
+            })
+            .collect()
+    }
+
+    fn words(s: &str) -> Vec<&str> {
+        let mut start = 0;
+        WordBreakIterator::new(s)
+            .map(|bk| {
+                let w = &s[start..bk];
+                start = bk;
+                w
+            })
+            .collect()
+    }
+
+    #[test]
+    fn grapheme_clusters() {
+        assert!(graphemes("").is_empty());
+        assert_eq!(graphemes("ab\r\nc\n\n"), ["a", "b", "\r\n", "c", "\n", "\n"]);
+        // combining marks, and a Devanagari spacing mark
+        assert_eq!(
+            graphemes("e\u{301}\u{308}x\u{915}\u{93f}"),
+            ["e\u{301}\u{308}", "x", "\u{915}\u{93f}"]
+        );
+        // Hangul syllables, precomposed and from jamo
+        assert_eq!(
+            graphemes("\u{d55c}\u{1100}\u{1161}\u{11a8}\u{1100}"),
+            ["\u{d55c}", "\u{1100}\u{1161}\u{11a8}", "\u{1100}"]
+        );
+        // emoji ZWJ sequences and modifiers
+        let family = "\u{1F468}\u{200D}\u{1F469}\u{200D}\u{1F467}";
+        let s = format!("{}\u{1F44D}\u{1F3FD}a\u{200D}\u{1F600}", family);
+        assert_eq!(graphemes(&s), [family, "\u{1F44D}\u{1F3FD}", "a\u{200D}", "\u{1F600}"]);
+        // regional indicators pair off
+        let flags = "\u{1F1EF}\u{1F1F5}\u{1F1EB}\u{1F1F7}\u{1F1E7}";
+        assert_eq!(graphemes(flags), ["\u{1F1EF}\u{1F1F5}", "\u{1F1EB}\u{1F1F7}", "\u{1F1E7}"]);
+        // a leading extend, and prepend
+        assert_eq!(graphemes("\u{301}\u{600}1a"), ["\u{301}", "\u{600}1", "a"]);
+    }
+
+    #[test]
+    fn grapheme_leaves() {
+        let s = "e\u{301}\u{1F1EF}\u{1F1F5}\u{1F1EB}\u{1F1F7}\r\n\u{1F468}\u{200D}\u{1F469}x";
+        let expected = GraphemeIterator::new(s).collect::<Vec<_>>();
+        for leaf_len in 1..12 {
+            let mut actual = Vec::new();
+            let mut iter = GraphemeLeafIter::new(s, 0);
+            let mut start = 0;
+            while start < s.len() {
+                let mut end = (start + leaf_len).min(s.len());
+                while !s.is_char_boundary(end) {
+                    end += 1;
+                }
+                let leaf = &s[start..end];
+                loop {
+                    let bk = iter.next(leaf);
+                    if bk == leaf.len() {
+                        break;
+                    }
+                    if start + bk > 0 {
+                        actual.push(start + bk);
+                    }
+                }
+                start = end;
+            }
+            actual.push(s.len());
+            actual.dedup();
+            assert_eq!(expected, actual, "leaves of {}", leaf_len);
+        }
+    }
+
+    #[test]
+    fn word_breaks() {
+        assert!(words("").is_empty());
+        assert_eq!(words("Hello, world!"), ["Hello", ",", " ", "world", "!"]);
+        assert_eq!(
+            words("can't e.g. 3.14 1,000"),
+            ["can't", " ", "e.g", ".", " ", "3.14", " ", "1,000"]
+        );
+        // pending boundaries confirmed by the code point after the next,
+        // or the end of the text
+        assert_eq!(words("a.,b."), ["a", ".", ",", "b", "."]);
+        assert_eq!(words("1.a"), ["1", ".", "a"]);
+        // colons don't join letters, as in CLDR
+        assert_eq!(words("a:b"), ["a", ":", "b"]);
+        // Extend and Format are ignored, but not at the start
+        assert_eq!(words("\u{301}a\u{301}'\u{ad}b"), ["\u{301}", "a\u{301}'\u{ad}b"]);
+        // Hebrew quotes
+        assert_eq!(words("\u{5d0}\"\u{5d1} \u{5d0}'"), ["\u{5d0}\"\u{5d1}", " ", "\u{5d0}'"]);
+        assert_eq!(words("\u{5d0}\"a"), ["\u{5d0}", "\"", "a"]);
+        // spaces, letters with numbers, katakana, and emoji
+        assert_eq!(
+            words("a1_b  \u{30a2}\u{30a4}x\u{200D}\u{1F600}"),
+            ["a1_b", "  ", "\u{30a2}\u{30a4}", "x\u{200D}\u{1F600}"]
+        );
+        assert_eq!(
+            words("\r\n\n\u{1F1EF}\u{1F1F5}\u{1F1EB}"),
+            ["\r\n", "\n", "\u{1F1EF}\u{1F1F5}", "\u{1F1EB}"]
+        );
+    }
+}
@@ -18,6 +18,7 @@ use std::io::BufReader;
 use std::io::Read;
 
 use xi_unicode::LineBreakIterator;
+use xi_unicode::LineBreakLeafIter;
 
 const TEST_FILE: &'static str = "tests/LineBreakTest.txt";
 
@@ -56,6 +57,47 @@ fn line_break_test() {
     }
 }
 
+// The breaks found by LineBreakLeafIter over `s` cut at `splits`, as the
+// rope cursor in core-lib's linewrap.rs does, leaving out the final one.
+fn leaf_breaks(s: &str, splits: &[usize]) -> Vec<usize> {
+    let mut bounds = vec![0];
+    bounds.extend_from_slice(splits);
+    bounds.push(s.len());
+    let mut iter = LineBreakLeafIter::new(&s[..bounds[1]], 0);
+    let mut breaks = Vec::new();
+    for leaf in bounds.windows(2) {
+        let mut offsets = Vec::new();
+        let mut hard = Vec::new();
+        iter.next_all(&s[leaf[0]..leaf[1]], &mut offsets, &mut hard);
+        breaks.extend(offsets.iter().map(|&offset| leaf[0] + offset as usize));
+    }
+    breaks
+}
+
+#[test]
+fn line_break_test_leaves() {
+    let file = File::open(TEST_FILE).expect("unable to open test file.");
+
+    let mut reader = BufReader::new(file);
+    let mut buffer = String::new();
+
+    reader.read_to_string(&mut buffer).expect("failed to read test file.");
+
+    for full_test in buffer.lines().filter(|s| !s.starts_with('#')) {
+        let test = full_test.split('#').next().unwrap().trim();
+        let (string, _) = parse_test(test);
+        let mut breaks = LineBreakIterator::new(&string).map(|(idx, _)| idx).collect::<Vec<_>>();
+        breaks.pop();
+
+        // Every split into two leaves, and every codepoint a leaf.
+        let bounds = string.char_indices().map(|(ix, _)| ix).skip(1).collect::<Vec<_>>();
+        for &split in &bounds {
+            assert_eq!(leaf_breaks(&string, &[split]), breaks, "{} split at {}", full_test, split);
+        }
+        assert_eq!(leaf_breaks(&string, &bounds), breaks, "{} in codepoints", full_test);
+    }
+}
+
 // A typical test looks like: "× 0023 × 0308 × 0020 ÷ 0023 ÷"
 fn parse_test(test: &str) -> (String, Vec<usize>) {
     use std::char;
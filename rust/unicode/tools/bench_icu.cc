@@ -0,0 +1,106 @@
+// Copyright 2026 The xi-editor Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ICU baseline for examples/lb_throughput.rs: times ICU's line break
+// iterator over the given UTF-8 files, reporting in the same format.
+//
+// Usage: bench_icu FILE...
+//
+// To compare on the built-in corpora:
+//
+//     cargo run --release --example lb_throughput -- --write /tmp/corpus
+//     tools/bench_icu /tmp/corpus/*.txt
+
+#include <unicode/brkiter.h>
+#include <unicode/utext.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using std::endl;
+using std::string;
+using icu::BreakIterator;
+using icu::Locale;
+
+typedef std::chrono::steady_clock Clock;
+
+// Minimum running time of each measurement, in seconds.
+const double MIN_TIME = 0.5;
+
+bool read_file(const char* path, string* s) {
+    FILE* f = fopen(path, "rb");
+    if (f == nullptr) return false;
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        s->append(buf, n);
+    }
+    fclose(f);
+    return true;
+}
+
+// Counts the breaks of `s`, including setting up the text.
+size_t count_breaks(BreakIterator* bi, UText* ut, const string& s) {
+    UErrorCode status = U_ZERO_ERROR;
+    utext_openUTF8(ut, s.data(), s.size(), &status);
+    bi->setText(ut, status);
+    size_t count = 0;
+    while (bi->next() != BreakIterator::DONE) {
+        count++;
+    }
+    return count;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: bench_icu FILE..." << endl;
+        return 1;
+    }
+    UErrorCode status = U_ZERO_ERROR;
+    std::unique_ptr<BreakIterator> bi(BreakIterator::createLineInstance(Locale(), status));
+    if (U_FAILURE(status)) {
+        std::cerr << "failed to create break iterator: " << u_errorName(status) << endl;
+        return 1;
+    }
+    UText ut = UTEXT_INITIALIZER;
+    printf("%-12s %-10s %10s %9s %10s %9s\n", "corpus", "iterator", "bytes", "breaks", "MB/s",
+        "ns/break");
+    for (int i = 1; i < argc; i++) {
+        string s;
+        if (!read_file(argv[i], &s)) {
+            std::cerr << "can't read " << argv[i] << endl;
+            return 1;
+        }
+        string name = argv[i];
+        size_t slash = name.rfind('/');
+        if (slash != string::npos) name = name.substr(slash + 1);
+        size_t dot = name.rfind('.');
+        if (dot != string::npos && dot > 0) name = name.substr(0, dot);
+        double best = 1e9;
+        size_t n_breaks = 0;
+        Clock::time_point start = Clock::now();
+        while (std::chrono::duration<double>(Clock::now() - start).count() < MIN_TIME) {
+            Clock::time_point t = Clock::now();
+            n_breaks = count_breaks(bi.get(), &ut, s);
+            best = std::min(best, std::chrono::duration<double>(Clock::now() - t).count());
+        }
+        printf("%-12s %-10s %10zu %9zu %10.1f %9.2f\n", name.c_str(), "icu", s.size(), n_breaks,
+            s.size() / best / 1e6, best * 1e9 / n_breaks);
+    }
+    utext_close(&ut);
+    return 0;
+}
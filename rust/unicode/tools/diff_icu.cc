@@ -0,0 +1,266 @@
+// Copyright 2026 The xi-editor Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A differential test of xi-unicode's line breaking against ICU, running
+// both in the same process. xi-unicode is linked through the C ABI in ffi/.
+//
+// Usage: diff_icu [niter] [--seed S] [--leaf N] [--locale L]
+//        diff_icu [--locale L] --input FILE...
+//
+// The first form checks `niter` random strings (from the same generator as
+// gen_rand_icu; 0 means run forever); the second checks the contents of each
+// file as a single string, which suits AFL and reproducing crashes. For each
+// case, `LineBreakIterator` is compared against ICU, and `LineBreakLeafIter`
+// over leaves of N bytes (default 4) is compared against `LineBreakIterator`.
+// With --locale, ICU's rules for that locale, such as "@lb=loose", are
+// compared against xi's matching `LineBreakStrictness`.
+//
+// Only mismatches are printed, in the format of LineBreakTest.txt with ICU's
+// breaks, so the output can be fed back to examples/runtestdata.rs. A comment
+// on each line gives xi's result. Note that differences in Unicode version
+// between xi's tables and the ICU in use show up as mismatches too.
+//
+// Built with -DXI_LIBFUZZER (see `make diff_icu_fuzzer`), this instead
+// provides a libFuzzer entry point that aborts on the first mismatch.
+
+#include "lb_common.h"
+#include "ffi/xi_unicode.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+using std::endl;
+using std::string;
+using std::vector;
+using icu::BreakIterator;
+
+// Default leaf size for the LineBreakLeafIter check; small, so that most
+// strings span several leaves.
+const size_t DEFAULT_LEAF_LEN = 4;
+
+// Decodes UTF-8 already known to be valid.
+void decode_utf8(const string& s, vector<uint32_t>* codepoints) {
+    codepoints->clear();
+    for (size_t i = 0; i < s.size();) {
+        uint8_t b = s[i];
+        uint32_t cp;
+        size_t len;
+        if (b < 0x80) {
+            cp = b;
+            len = 1;
+        } else if (b < 0xe0) {
+            cp = b & 0x1f;
+            len = 2;
+        } else if (b < 0xf0) {
+            cp = b & 0x0f;
+            len = 3;
+        } else {
+            cp = b & 0x07;
+            len = 4;
+        }
+        for (size_t j = 1; j < len; j++) {
+            cp = (cp << 6) | (s[i + j] & 0x3f);
+        }
+        codepoints->push_back(cp);
+        i += len;
+    }
+}
+
+// Runs one of the xi_line_breaks functions, growing the buffers as needed.
+// Returns false if the input is not valid UTF-8.
+template <typename F>
+bool xi_breaks(F f, vector<Break>* breaks) {
+    vector<size_t> offsets(16);
+    vector<uint8_t> hard(16);
+    size_t n = f(offsets.data(), hard.data(), offsets.size());
+    if (n == XI_INVALID_UTF8) return false;
+    if (n > offsets.size()) {
+        offsets.resize(n);
+        hard.resize(n);
+        f(offsets.data(), hard.data(), n);
+    }
+    breaks->clear();
+    for (size_t i = 0; i < n; i++) {
+        breaks->push_back({offsets[i], hard[i] != 0});
+    }
+    return true;
+}
+
+bool same_breaks(const vector<Break>& a, const vector<Break>& b, bool final_hard) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].offset != b[i].offset) return false;
+        if ((final_hard || i + 1 < a.size()) && a[i].hard != b[i].hard) return false;
+    }
+    return true;
+}
+
+void push_hard_offsets(string* out, const vector<Break>& breaks) {
+    *out += '[';
+    bool first = true;
+    for (const Break& bk : breaks) {
+        if (!bk.hard) continue;
+        if (!first) *out += ", ";
+        *out += std::to_string(bk.offset);
+        first = false;
+    }
+    *out += ']';
+}
+
+// Checks one string, appending a description of any mismatch to `report`.
+// Strings that are not valid UTF-8 are skipped.
+bool check(BreakIterator* bi, UText* ut, uint8_t strictness, const string& s, size_t leaf_len,
+        string* report) {
+    vector<Break> icu, xi, xi_leaves;
+    const uint8_t* data = (const uint8_t*)s.data();
+    bool valid = xi_breaks([&](size_t* offsets, uint8_t* hard, size_t cap) {
+        return xi_line_breaks(data, s.size(), strictness, offsets, hard, cap);
+    }, &xi);
+    if (!valid || s.empty()) return true;
+    xi_breaks([&](size_t* offsets, uint8_t* hard, size_t cap) {
+        return xi_line_breaks_leaves(data, s.size(), strictness, leaf_len, offsets, hard, cap);
+    }, &xi_leaves);
+    icu_breaks(bi, ut, s, &icu);
+    bool icu_ok = same_breaks(icu, xi, true);
+    bool leaves_ok = same_breaks(xi, xi_leaves, false);
+    if (icu_ok && leaves_ok) return true;
+    if (report != nullptr) {
+        vector<uint32_t> codepoints;
+        decode_utf8(s, &codepoints);
+        report_string(report, s, icu, codepoints);
+        *report += "\t# xi: ";
+        report_string(report, s, xi, codepoints);
+        string xi_hard, icu_hard;
+        push_hard_offsets(&xi_hard, xi);
+        push_hard_offsets(&icu_hard, icu);
+        if (xi_hard != icu_hard) {
+            *report += "; hard breaks " + xi_hard + " vs ICU " + icu_hard;
+        }
+        if (!leaves_ok) {
+            *report += "; leaves of " + std::to_string(leaf_len) + ": ";
+            report_string(report, s, xi_leaves, codepoints);
+        }
+        *report += '\n';
+    }
+    return false;
+}
+
+#ifdef XI_LIBFUZZER
+
+// The first byte selects the leaf size; the rest is the string.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static uint8_t strictness;
+    static std::unique_ptr<BreakIterator> bi = make_line_iterator("", &strictness);
+    static UText ut = UTEXT_INITIALIZER;
+    if (size == 0) return 0;
+    size_t leaf_len = 1 + data[0] % 16;
+    string s((const char*)data + 1, size - 1);
+    string report;
+    if (!check(bi.get(), &ut, strictness, s, leaf_len, &report)) {
+        fwrite(report.data(), 1, report.size(), stderr);
+        abort();
+    }
+    return 0;
+}
+
+#else
+
+bool read_file(const char* path, string* s) {
+    FILE* f = fopen(path, "rb");
+    if (f == nullptr) return false;
+    char buf[4096];
+    size_t n;
+    s->clear();
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        s->append(buf, n);
+    }
+    fclose(f);
+    return true;
+}
+
+void usage() {
+    std::cerr << "usage: diff_icu [niter] [--seed S] [--leaf N] [--locale L]" << endl
+        << "       diff_icu [--locale L] --input FILE..." << endl;
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    uint64_t niter = 100000;
+    uint64_t seed = 0;
+    size_t leaf_len = DEFAULT_LEAF_LEN;
+    const char* locale = "";
+    vector<const char*> inputs;
+    bool files = false;
+    for (int i = 1; i < argc; i++) {
+        if (files) {
+            inputs.push_back(argv[i]);
+        } else if (strcmp(argv[i], "--input") == 0) {
+            files = true;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--leaf") == 0 && i + 1 < argc) {
+            leaf_len = strtoull(argv[++i], nullptr, 0);
+            if (leaf_len == 0) usage();
+        } else if (strcmp(argv[i], "--locale") == 0 && i + 1 < argc) {
+            locale = argv[++i];
+        } else if (argv[i][0] != '-') {
+            niter = strtoull(argv[i], nullptr, 0);
+        } else {
+            usage();
+        }
+    }
+    uint8_t strictness;
+    std::unique_ptr<BreakIterator> bi = make_line_iterator(locale, &strictness);
+    UText ut = UTEXT_INITIALIZER;
+    uint64_t ncases = 0, nfail = 0;
+    string report;
+    string s;
+    if (files) {
+        for (const char* path : inputs) {
+            if (!read_file(path, &s)) {
+                std::cerr << "can't read " << path << endl;
+                return 1;
+            }
+            report.clear();
+            ncases++;
+            if (!check(bi.get(), &ut, strictness, s, leaf_len, &report)) {
+                nfail++;
+                fwrite(report.data(), 1, report.size(), stdout);
+            }
+        }
+    } else {
+        Rng rng(seed, 0);
+        vector<uint32_t> codepoints;
+        for (; niter == 0 || ncases < niter; ncases++) {
+            codepoints.clear();
+            s = randstring(&rng, &codepoints);
+            report.clear();
+            if (!check(bi.get(), &ut, strictness, s, leaf_len, &report)) {
+                nfail++;
+                fwrite(report.data(), 1, report.size(), stdout);
+                fflush(stdout);
+            }
+        }
+    }
+    utext_close(&ut);
+    std::cerr << ncases << " cases, " << nfail << " mismatches" << endl;
+    return nfail == 0 ? 0 : 2;
+}
+
+#endif  // XI_LIBFUZZER
@@ -0,0 +1,282 @@
+// Copyright 2026 The xi-editor Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// A differential test of xi-unicode's grapheme cluster and word boundaries
+// against ICU's character and word break iterators, in the manner of
+// diff_icu.
+//
+// Usage: diff_seg_icu grapheme|word [niter] [--seed S] [--leaf N]
+//        diff_seg_icu grapheme|word --input FILE...
+//
+// Random strings are drawn mostly from code points of the classes that the
+// rules treat specially (by ICU's Grapheme_Cluster_Break and Word_Break
+// properties, and Extended_Pictographic), as uniformly random ones are
+// nearly all Other. For words, the scripts that ICU segments with
+// dictionaries, or by rules of its own, are left out. For graphemes,
+// `GraphemeLeafIter` over leaves of N bytes (default 4) is also compared
+// against `GraphemeIterator`.
+//
+// Mismatches are printed in the format of GraphemeBreakTest.txt and
+// WordBreakTest.txt, with ICU's boundaries, so that they can be fed back to
+// examples/runtestdata.rs with `--segment`; a comment gives xi's.
+
+#include "lb_common.h"
+#include "ffi/xi_unicode.h"
+
+#include <unicode/uchar.h>
+#include <unicode/uscript.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using std::endl;
+using std::string;
+using std::vector;
+using icu::BreakIterator;
+
+enum class Kind { Grapheme, Word };
+
+const size_t DEFAULT_LEAF_LEN = 4;
+
+// Whether ICU segments words of `cp` with a dictionary, or otherwise by
+// rules of its own, rather than UAX #29: Han, Hiragana, Katakana, Hangul
+// syllables, and the SA line breaking class (Thai and others).
+bool icu_dictionary_word(uint32_t cp) {
+    UErrorCode status = U_ZERO_ERROR;
+    UScriptCode script = uscript_getScript(cp, &status);
+    return script == USCRIPT_HAN || script == USCRIPT_HIRAGANA || script == USCRIPT_KATAKANA
+        || u_getIntPropertyValue(cp, UCHAR_HANGUL_SYLLABLE_TYPE) != U_HST_NOT_APPLICABLE
+        || u_getIntPropertyValue(cp, UCHAR_LINE_BREAK) == U_LB_COMPLEX_CONTEXT;
+}
+
+// Code points grouped by class, to draw from.
+struct Buckets {
+    vector<vector<uint32_t>> buckets;
+    bool word;
+
+    explicit Buckets(Kind kind) : word(kind == Kind::Word) {
+        UProperty prop = kind == Kind::Grapheme ? UCHAR_GRAPHEME_CLUSTER_BREAK : UCHAR_WORD_BREAK;
+        std::map<int32_t, vector<uint32_t>> by_value;
+        for (uint32_t cp = 0; cp < 0x110000; cp++) {
+            if (0xd800 <= cp && cp < 0xe000) continue;
+            if (kind == Kind::Word && icu_dictionary_word(cp)) continue;
+            int32_t value = u_getIntPropertyValue(cp, prop);
+            if (u_hasBinaryProperty(cp, UCHAR_EXTENDED_PICTOGRAPHIC)) value = -1;
+            by_value[value].push_back(cp);
+        }
+        for (auto& kv : by_value) {
+            buckets.push_back(std::move(kv.second));
+        }
+    }
+};
+
+std::string randstring_seg(Rng* rng, const Buckets& b, vector<uint32_t>* codepoints) {
+    std::string result;
+    uint32_t len = 1 + (uint32_t)(6 * rng->expd(rng->generator));
+    for (uint32_t i = 0; i < len; i++) {
+        uint32_t cp;
+        if (rng->unif(rng->generator) < 0.1) {
+            cp = (uint32_t)(0x110000 * rng->unif(rng->generator));
+            if ((0xd800 <= cp && cp < 0xe000) || (b.word && icu_dictionary_word(cp))) continue;
+        } else {
+            const vector<uint32_t>& bucket =
+                b.buckets[(size_t)(b.buckets.size() * rng->unif(rng->generator))];
+            cp = bucket[(size_t)(bucket.size() * rng->unif(rng->generator))];
+        }
+        codepoints->push_back(cp);
+        push_utf8(&result, cp);
+    }
+    return result;
+}
+
+// Runs one of the xi segmentation functions, growing the buffer as needed.
+template <typename F>
+bool xi_offsets(F f, vector<size_t>* offsets) {
+    offsets->resize(16);
+    size_t n = f(offsets->data(), offsets->size());
+    if (n == XI_INVALID_UTF8) return false;
+    if (n > offsets->size()) {
+        offsets->resize(n);
+        f(offsets->data(), n);
+    }
+    offsets->resize(n);
+    return true;
+}
+
+void icu_offsets(BreakIterator* bi, UText* ut, const string& s, vector<size_t>* offsets) {
+    UErrorCode status = U_ZERO_ERROR;
+    offsets->clear();
+    utext_openUTF8(ut, s.data(), s.size(), &status);
+    bi->setText(ut, status);
+    int32_t bk;
+    while ((bk = bi->next()) != BreakIterator::DONE) {
+        offsets->push_back((size_t)bk);
+    }
+}
+
+// Appends a case in the GraphemeBreakTest.txt format; unlike
+// LineBreakTest.txt, the start of the text is a boundary.
+void report_offsets(string* out, const string& s, const vector<size_t>& offsets) {
+    *out += "÷";
+    size_t bks_ix = 0;
+    size_t i = 0;
+    while (i < s.size()) {
+        uint8_t b = s[i];
+        size_t len = b >= 0xf0 ? 4 : b >= 0xe0 ? 3 : b >= 0xc0 ? 2 : 1;
+        uint32_t cp = len == 1 ? b : b & (0x7f >> len);
+        for (size_t j = 1; j < len; j++) {
+            cp = (cp << 6) | (s[i + j] & 0x3f);
+        }
+        i += len;
+        *out += ' ';
+        push_hex(out, cp);
+        if (bks_ix < offsets.size() && offsets[bks_ix] == i) {
+            *out += " ÷";
+            bks_ix++;
+        } else {
+            *out += " ×";
+        }
+    }
+}
+
+bool check(Kind kind, BreakIterator* bi, UText* ut, const string& s, size_t leaf_len,
+        string* report) {
+    const uint8_t* data = (const uint8_t*)s.data();
+    vector<size_t> xi, xi_leaves, icu;
+    bool valid = xi_offsets([&](size_t* offsets, size_t cap) {
+        return kind == Kind::Grapheme ? xi_grapheme_breaks(data, s.size(), 0, offsets, cap)
+            : xi_word_breaks(data, s.size(), offsets, cap);
+    }, &xi);
+    if (!valid || s.empty()) return true;
+    bool leaves_ok = true;
+    if (kind == Kind::Grapheme) {
+        xi_offsets([&](size_t* offsets, size_t cap) {
+            return xi_grapheme_breaks(data, s.size(), leaf_len, offsets, cap);
+        }, &xi_leaves);
+        leaves_ok = xi == xi_leaves;
+    }
+    icu_offsets(bi, ut, s, &icu);
+    if (icu == xi && leaves_ok) return true;
+    report_offsets(report, s, icu);
+    *report += "\t# xi: ";
+    report_offsets(report, s, xi);
+    if (!leaves_ok) {
+        *report += "; leaves of " + std::to_string(leaf_len) + ": ";
+        report_offsets(report, s, xi_leaves);
+    }
+    *report += '\n';
+    return false;
+}
+
+bool read_file(const char* path, string* s) {
+    FILE* f = fopen(path, "rb");
+    if (f == nullptr) return false;
+    char buf[4096];
+    size_t n;
+    s->clear();
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        s->append(buf, n);
+    }
+    fclose(f);
+    return true;
+}
+
+void usage() {
+    std::cerr << "usage: diff_seg_icu grapheme|word [niter] [--seed S] [--leaf N]" << endl
+        << "       diff_seg_icu grapheme|word --input FILE..." << endl;
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) usage();
+    Kind kind;
+    if (strcmp(argv[1], "grapheme") == 0) {
+        kind = Kind::Grapheme;
+    } else if (strcmp(argv[1], "word") == 0) {
+        kind = Kind::Word;
+    } else {
+        usage();
+    }
+    uint64_t niter = 100000;
+    uint64_t seed = 0;
+    size_t leaf_len = DEFAULT_LEAF_LEN;
+    vector<const char*> inputs;
+    bool files = false;
+    for (int i = 2; i < argc; i++) {
+        if (files) {
+            inputs.push_back(argv[i]);
+        } else if (strcmp(argv[i], "--input") == 0) {
+            files = true;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--leaf") == 0 && i + 1 < argc) {
+            leaf_len = strtoull(argv[++i], nullptr, 0);
+            if (leaf_len == 0) usage();
+        } else if (argv[i][0] != '-') {
+            niter = strtoull(argv[i], nullptr, 0);
+        } else {
+            usage();
+        }
+    }
+    UErrorCode status = U_ZERO_ERROR;
+    icu::Locale root = icu::Locale::getRoot();
+    std::unique_ptr<BreakIterator> bi(kind == Kind::Grapheme
+        ? BreakIterator::createCharacterInstance(root, status)
+        : BreakIterator::createWordInstance(root, status));
+    if (U_FAILURE(status)) {
+        std::cerr << "failed to create break iterator: " << u_errorName(status) << endl;
+        return 1;
+    }
+    UText ut = UTEXT_INITIALIZER;
+    uint64_t ncases = 0, nfail = 0;
+    string report;
+    string s;
+    if (files) {
+        for (const char* path : inputs) {
+            if (!read_file(path, &s)) {
+                std::cerr << "can't read " << path << endl;
+                return 1;
+            }
+            report.clear();
+            ncases++;
+            if (!check(kind, bi.get(), &ut, s, leaf_len, &report)) {
+                nfail++;
+                fwrite(report.data(), 1, report.size(), stdout);
+            }
+        }
+    } else {
+        Buckets buckets(kind);
+        Rng rng(seed, 0);
+        vector<uint32_t> codepoints;
+        for (; niter == 0 || ncases < niter; ncases++) {
+            codepoints.clear();
+            s = randstring_seg(&rng, buckets, &codepoints);
+            report.clear();
+            if (!check(kind, bi.get(), &ut, s, leaf_len, &report)) {
+                nfail++;
+                fwrite(report.data(), 1, report.size(), stdout);
+                fflush(stdout);
+            }
+        }
+    }
+    utext_close(&ut);
+    std::cerr << ncases << " cases, " << nfail << " mismatches" << endl;
+    return nfail == 0 ? 0 : 2;
+}
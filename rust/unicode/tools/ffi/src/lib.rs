@@ -0,0 +1,293 @@
+// Copyright 2026 The xi-editor Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+//! A minimal C ABI to xi-unicode's line breaking and segmentation, so that
+//! it can be driven in the same process as ICU by the tools in this
+//! directory. See `xi_unicode.h` for the C declarations.
+
+use std::slice;
+use std::str;
+
+use xi_unicode::{
+    lb_machine, linebreak_property, GraphemeIterator, GraphemeLeafIter, LineBreakIterator,
+    LineBreakLeafIter, LineBreakStrictness, WordBreakIterator,
+};
+
+/// Returned in place of a count when the input is not valid UTF-8.
+pub const XI_INVALID_UTF8: usize = usize::max_value();
+
+/// The values of the `strictness` arguments; anything else is taken as
+/// `XI_LB_STRICT`.
+pub const XI_LB_STRICT: u8 = 0;
+pub const XI_LB_NORMAL: u8 = 1;
+pub const XI_LB_LOOSE: u8 = 2;
+
+fn to_strictness(strictness: u8) -> LineBreakStrictness {
+    match strictness {
+        XI_LB_NORMAL => LineBreakStrictness::Normal,
+        XI_LB_LOOSE => LineBreakStrictness::Loose,
+        _ => LineBreakStrictness::Strict,
+    }
+}
+
+/// Writes `breaks` to the output arrays, up to `cap` of them, and returns
+/// the total number of breaks.
+fn write_breaks<I>(breaks: I, out_offsets: *mut usize, out_hard: *mut u8, cap: usize) -> usize
+where
+    I: Iterator<Item = (usize, bool)>,
+{
+    let mut n = 0;
+    for (offset, hard) in breaks {
+        if n < cap {
+            unsafe {
+                *out_offsets.add(n) = offset;
+                *out_hard.add(n) = hard as u8;
+            }
+        }
+        n += 1;
+    }
+    n
+}
+
+unsafe fn as_str<'a>(s: *const u8, len: usize) -> Option<&'a str> {
+    if len == 0 {
+        return Some("");
+    }
+    str::from_utf8(slice::from_raw_parts(s, len)).ok()
+}
+
+/// Computes the line breaks of the UTF-8 string `s` with `LineBreakIterator`,
+/// with the given strictness.
+///
+/// At most `cap` breaks are written to `out_offsets` and `out_hard`; the
+/// return value is the total number, so the caller can retry with larger
+/// arrays. Returns `XI_INVALID_UTF8` if `s` is not valid UTF-8.
+#[no_mangle]
+pub unsafe extern "C" fn xi_line_breaks(
+    s: *const u8,
+    len: usize,
+    strictness: u8,
+    out_offsets: *mut usize,
+    out_hard: *mut u8,
+    cap: usize,
+) -> usize {
+    match as_str(s, len) {
+        Some(s) => {
+            let iter = LineBreakIterator::with_strictness(s, to_strictness(strictness));
+            write_breaks(iter, out_offsets, out_hard, cap)
+        }
+        None => XI_INVALID_UTF8,
+    }
+}
+
+/// Iterates over the breaks of `s` split into leaves of at most `leaf_len`
+/// bytes (but at least one codepoint), the way a rope cursor does.
+struct LeafBreaks<'a> {
+    s: &'a str,
+    leaf_len: usize,
+    start: usize,
+    end: usize,
+    iter: LineBreakLeafIter,
+    done: bool,
+}
+
+impl<'a> LeafBreaks<'a> {
+    fn new(s: &'a str, leaf_len: usize, strictness: LineBreakStrictness) -> LeafBreaks<'a> {
+        let leaf_len = leaf_len.max(1);
+        let end = LeafBreaks::leaf_end(s, 0, leaf_len);
+        let iter = LineBreakLeafIter::with_strictness(&s[..end], 0, strictness);
+        LeafBreaks { s, leaf_len, start: 0, end, iter, done: s.is_empty() }
+    }
+
+    fn leaf_end(s: &str, start: usize, leaf_len: usize) -> usize {
+        if start + leaf_len >= s.len() {
+            return s.len();
+        }
+        let mut end = start + leaf_len;
+        while !s.is_char_boundary(end) {
+            end -= 1;
+        }
+        if end == start {
+            end = start + leaf_len;
+            while !s.is_char_boundary(end) {
+                end += 1;
+            }
+        }
+        end
+    }
+}
+
+impl<'a> Iterator for LeafBreaks<'a> {
+    type Item = (usize, bool);
+
+    fn next(&mut self) -> Option<(usize, bool)> {
+        if self.done {
+            return None;
+        }
+        loop {
+            let leaf = &self.s[self.start..self.end];
+            let (bk, hard) = self.iter.next(leaf);
+            if bk < leaf.len() {
+                return Some((self.start + bk, hard));
+            }
+            if self.end == self.s.len() {
+                // As with a rope, EOT is up to the caller; its hardness is
+                // not known to the leaf iterator.
+                self.done = true;
+                return Some((self.s.len(), false));
+            }
+            self.start = self.end;
+            self.end = LeafBreaks::leaf_end(self.s, self.start, self.leaf_len);
+        }
+    }
+}
+
+/// Like `xi_line_breaks`, but feeds the string to `LineBreakLeafIter` in
+/// leaves of at most `leaf_len` bytes. The hard flag of the final break is
+/// always 0, as `LineBreakLeafIter` does not determine it.
+#[no_mangle]
+pub unsafe extern "C" fn xi_line_breaks_leaves(
+    s: *const u8,
+    len: usize,
+    strictness: u8,
+    leaf_len: usize,
+    out_offsets: *mut usize,
+    out_hard: *mut u8,
+    cap: usize,
+) -> usize {
+    match as_str(s, len) {
+        Some(s) => {
+            let breaks = LeafBreaks::new(s, leaf_len, to_strictness(strictness));
+            write_breaks(breaks, out_offsets, out_hard, cap)
+        }
+        None => XI_INVALID_UTF8,
+    }
+}
+
+/// The line breaking property of `cp`, as in `linebreak_property`, or 0 (XX)
+/// if `cp` is not a valid codepoint.
+#[no_mangle]
+pub extern "C" fn xi_linebreak_property(cp: u32) -> u8 {
+    std::char::from_u32(cp).map(linebreak_property).unwrap_or(0)
+}
+
+/// The class of `cp` in the state machine, as `lb_machine::class`, or 0
+/// (XX) if `cp` is not a valid codepoint.
+#[no_mangle]
+pub extern "C" fn xi_linebreak_class(cp: u32) -> u8 {
+    std::char::from_u32(cp).map(lb_machine::class).unwrap_or(0)
+}
+
+/// The state following a codepoint of class `class` at the start of text.
+#[no_mangle]
+pub extern "C" fn xi_linebreak_start_state(class: u8) -> u8 {
+    lb_machine::start_state(class)
+}
+
+/// The number of line breaking categories, which is the row length of the
+/// state machine.
+#[no_mangle]
+pub extern "C" fn xi_linebreak_n_categories() -> usize {
+    lb_machine::N_CLASSES
+}
+
+/// The line breaking state machine for the given strictness, and its length
+/// in `*len`. See `lb_machine::state_machine` for the encoding.
+#[no_mangle]
+pub unsafe extern "C" fn xi_linebreak_state_machine(strictness: u8, len: *mut usize) -> *const u8 {
+    let sm = lb_machine::state_machine(to_strictness(strictness));
+    *len = sm.len();
+    sm.as_ptr()
+}
+
+/// Writes `breaks` to `out_offsets`, up to `cap` of them, and returns the
+/// total number of breaks.
+fn write_offsets<I: Iterator<Item = usize>>(
+    breaks: I,
+    out_offsets: *mut usize,
+    cap: usize,
+) -> usize {
+    let mut n = 0;
+    for offset in breaks {
+        if n < cap {
+            unsafe {
+                *out_offsets.add(n) = offset;
+            }
+        }
+        n += 1;
+    }
+    n
+}
+
+/// Computes the grapheme cluster boundaries of `s`, with `GraphemeIterator`
+/// if `leaf_len` is 0, or else with `GraphemeLeafIter` over leaves of at most
+/// `leaf_len` bytes. Otherwise as `xi_line_breaks`.
+#[no_mangle]
+pub unsafe extern "C" fn xi_grapheme_breaks(
+    s: *const u8,
+    len: usize,
+    leaf_len: usize,
+    out_offsets: *mut usize,
+    cap: usize,
+) -> usize {
+    let s = match as_str(s, len) {
+        Some(s) => s,
+        None => return XI_INVALID_UTF8,
+    };
+    if leaf_len == 0 {
+        return write_offsets(GraphemeIterator::new(s), out_offsets, cap);
+    }
+    let mut n = 0;
+    let mut push = |offset| {
+        if n < cap {
+            *out_offsets.add(n) = offset;
+        }
+        n += 1;
+    };
+    let mut iter = GraphemeLeafIter::new(s, 0);
+    let mut start = 0;
+    while start < s.len() {
+        let end = LeafBreaks::leaf_end(s, start, leaf_len);
+        let leaf = &s[start..end];
+        loop {
+            let bk = iter.next(leaf);
+            if bk == leaf.len() {
+                break;
+            }
+            if start + bk != 0 {
+                push(start + bk);
+            }
+        }
+        start = end;
+    }
+    if !s.is_empty() {
+        push(s.len());
+    }
+    n
+}
+
+/// Computes the word boundaries of `s` with `WordBreakIterator`. Otherwise
+/// as `xi_line_breaks`.
+#[no_mangle]
+pub unsafe extern "C" fn xi_word_breaks(
+    s: *const u8,
+    len: usize,
+    out_offsets: *mut usize,
+    cap: usize,
+) -> usize {
+    match as_str(s, len) {
+        Some(s) => write_offsets(WordBreakIterator::new(s), out_offsets, cap),
+        None => XI_INVALID_UTF8,
+    }
+}
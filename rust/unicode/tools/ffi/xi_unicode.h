@@ -0,0 +1,81 @@
+// Copyright 2026 The xi-editor Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// C declarations for the xi-unicode-ffi static library (see src/lib.rs).
+
+#ifndef XI_UNICODE_FFI_H_
+#define XI_UNICODE_FFI_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Returned in place of a count when the input is not valid UTF-8.
+#define XI_INVALID_UTF8 ((size_t)-1)
+
+// Values of the strictness arguments, selecting a LineBreakStrictness; they
+// correspond to ICU's lb=strict, lb=normal and lb=loose.
+#define XI_LB_STRICT 0
+#define XI_LB_NORMAL 1
+#define XI_LB_LOOSE 2
+
+// Computes the line breaks of the UTF-8 string s with LineBreakIterator.
+// At most cap breaks are written to offsets and hard; returns the total
+// number of breaks, or XI_INVALID_UTF8.
+size_t xi_line_breaks(const uint8_t* s, size_t len, uint8_t strictness,
+    size_t* offsets, uint8_t* hard, size_t cap);
+
+// As xi_line_breaks, but with LineBreakLeafIter over leaves of at most
+// leaf_len bytes. The hard flag of the final break is always 0.
+size_t xi_line_breaks_leaves(const uint8_t* s, size_t len, uint8_t strictness,
+    size_t leaf_len, size_t* offsets, uint8_t* hard, size_t cap);
+
+// The line breaking property of cp, or 0 (XX) if cp is not a codepoint.
+uint8_t xi_linebreak_property(uint32_t cp);
+
+// The class of cp in the state machine, or 0 (XX) if cp is not a codepoint.
+// This is xi_linebreak_property, except that the iteration marks (such as
+// U+3005) have a class of their own.
+uint8_t xi_linebreak_class(uint32_t cp);
+
+// The state following a codepoint of class `cls` at the start of text.
+uint8_t xi_linebreak_start_state(uint8_t cls);
+
+// The number of line breaking categories (the state machine's row length).
+size_t xi_linebreak_n_categories(void);
+
+// The line breaking state machine for the given strictness, with its length
+// stored in *len. The entry at row `state`, column `category` is the new
+// state; if bit 0x80 is set, there is a break before the codepoint, 0x40
+// marks it as hard, and the low 6 bits are the new state.
+const uint8_t* xi_linebreak_state_machine(uint8_t strictness, size_t* len);
+
+// Computes the grapheme cluster boundaries of s with GraphemeIterator, or,
+// if leaf_len is not 0, with GraphemeLeafIter over leaves of at most
+// leaf_len bytes. Otherwise as xi_line_breaks, without the hard flags.
+size_t xi_grapheme_breaks(const uint8_t* s, size_t len, size_t leaf_len,
+    size_t* offsets, size_t cap);
+
+// Computes the word boundaries of s with WordBreakIterator. Otherwise as
+// xi_grapheme_breaks.
+size_t xi_word_breaks(const uint8_t* s, size_t len, size_t* offsets, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // XI_UNICODE_FFI_H_
@@ -14,122 +14,928 @@
 
 // A tool for generating random strings and result of the ICU line break
 // iterator.
+//
+// Usage: gen_rand_icu [niter] [--seed S] [--threads N] [--shard K/M] [-o path]
+//                     [--format text|binary] [--coverage] [--guided]
+//                     [--locale L] [--doc-len N] [--splits]
+//        gen_rand_icu --bench [niter] [--seed S] [--rounds R] [--input FILE]...
+//                     [--format json|csv] [-o path] [--locale L]
+//
+// The corpus is divided into fixed-size blocks of cases, and each block draws
+// from its own random stream, seeded from the seed and the block index. The
+// output for a given seed is thus the same regardless of the number of
+// threads, and concatenating the outputs of shards 0..M-1 gives exactly the
+// output of an unsharded run (for the binary format, minus the headers of
+// all but the first shard). When sharding, each shard is written to
+// `path.K` (or to stdout if no path is given).
+//
+// With --coverage, the transitions of xi-unicode's line breaking state
+// machine that the corpus exercises, as (state, line break class) pairs, are
+// counted and reported on stderr. With --guided, instead of drawing from
+// fixed codepoint ranges, each codepoint is drawn from a line break class
+// chosen to favor transitions not yet seen, which reaches full coverage in
+// far fewer cases. Guidance starts afresh in each block, so that the output
+// stays independent of the number of threads and shards.
+//
+// With --doc-len, each case is instead a long document of at least N bytes
+// (the count may end in k or M), for testing at the scale of real text
+// in a rope, whose leaves are about 1k. Documents are paragraphs of
+// sentences of words of the same random codepoints, ended by LF, CR LF, CR,
+// NEL, LS or PS and sometimes a blank line. Each document is a block of its
+// own.
+//
+// With --locale, the breaks are those of ICU's rules for that locale, such as
+// "@lb=loose" or "@lb=normal", for checking xi's matching tailoring (as with
+// `runtestdata --strictness loose`). Coverage is then measured on the state
+// machine for that tailoring.
+//
+// The text format is the one used by LineBreakTest.txt. The binary format is
+// a header ("XILB" followed by a version byte), then for each case:
+//
+//     varint  length of the string in bytes
+//     bytes   the string, in UTF-8
+//     varint  number of breaks
+//     varint  for each break, (offset - previous offset) << 1 | hard
+//
+// where varints are LEB128 encoded, and hard is set for mandatory breaks.
+//
+// With --splits, each case also gets split points, at which to cut it into
+// the leaves of a rope for `runtestdata --leaves`. There are about as many
+// as a rope would have, some more at random, and half the boundaries within
+// runs of spaces, combining marks and ZWJ, whose look-behind is hardest to
+// carry across leaves. Splits come from a stream of their own, so the cases
+// are the same as without them. In the text format they follow the case in
+// a comment, "# splits:" and the byte offsets; the binary format has version
+// 2, with after each case's breaks:
+//
+//     varint  number of splits
+//     varint  for each split, offset - previous offset
+//
+// With --bench, nothing is written but a timing report. Cases are generated
+// into memory first: niter (default 10000) of the usual random strings, and
+// as many paragraphs of each of a few scripts. With --input, the lines of the
+// given files are used instead, grouped by their most common script. Then for
+// each group, ICU's iterator (setting the text and iterating it, and nothing
+// else) and xi's `xi_line_breaks` (which also validates the UTF-8) each run
+// over all the cases R times (default 10). The report gives the best and
+// median times of a round, and the rates of the best, as JSON or CSV, for
+// tracking next to benches/bench.rs.
 
-#include <unicode/brkiter.h>
+#include "lb_common.h"
+#include "ffi/xi_unicode.h"
 
+#include <unicode/uchar.h>
+#include <unicode/uscript.h>
+#include <unicode/utf8.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
 #include <iostream>
-#include <random>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
-using std::cout;
 using std::endl;
-using std::rand;
 using std::string;
 using std::vector;
 using icu::BreakIterator;
 using icu::UnicodeString;
 using icu::StringPiece;
 
-void push_utf8(string* buf, uint32_t cp) {
-    if (cp < 0x80) {
-        *buf += cp;
-    } else if (cp < 0x800) {
-        *buf += 0xc0 | (cp >> 6);
-        *buf += 0x80 | (cp & 0x3f);
-    } else if (cp < 0x10000) {
-        *buf += 0xe0 | (cp >> 12);
-        *buf += 0x80 | ((cp >> 6) & 0x3f);
-        *buf += 0x80 | (cp & 0x3f);
-    } else {
-        *buf += 0xf0 | (cp >> 18);
-        *buf += 0x80 | ((cp >> 12) & 0x3f);
-        *buf += 0x80 | ((cp >> 6) & 0x3f);
-        *buf += 0x80 | (cp & 0x3f);
+// Number of cases generated from a single random stream, except with
+// --doc-len.
+const uint64_t BLOCK_SIZE = 1 << 16;
+
+const char BINARY_MAGIC[] = "XILB";
+const uint8_t BINARY_VERSION = 1;
+const uint8_t BINARY_VERSION_SPLITS = 2;
+
+// Text and Binary are formats of the corpus; Json and Csv of --bench reports.
+enum class Format { Text, Binary, Json, Csv };
+
+// The probability of choosing a class for an unseen transition in guided
+// mode, when there is one; otherwise the class is uniformly random.
+const double GUIDED_BIAS = 0.875;
+
+// xi-unicode's line break classes and state machine.
+struct LbModel {
+    size_t n_cat;
+    size_t n_states;
+    const uint8_t* sm;
+    // The codepoints of each class.
+    vector<vector<uint32_t>> class_cps;
+    // The classes that have any codepoints.
+    vector<uint8_t> classes;
+    // The number of (state, class) pairs reachable from the start of text.
+    size_t n_reachable;
+
+    explicit LbModel(uint8_t strictness);
+
+    uint8_t step(uint8_t state, uint8_t cls) const {
+        uint8_t new_state = sm[state * n_cat + cls];
+        return (new_state & 0x80) ? new_state & 0x3f : new_state;
+    }
+};
+
+LbModel::LbModel(uint8_t strictness) {
+    size_t len;
+    sm = xi_linebreak_state_machine(strictness, &len);
+    n_cat = xi_linebreak_n_categories();
+    n_states = len / n_cat;
+    class_cps.resize(n_cat);
+    for (uint32_t cp = 0; cp < 0x110000; cp++) {
+        if (cp < 0xd800 || cp >= 0xe000) {
+            class_cps[xi_linebreak_class(cp)].push_back(cp);
+        }
     }
+    for (size_t c = 0; c < n_cat; c++) {
+        if (!class_cps[c].empty()) classes.push_back(c);
+    }
+    // The iterator starts in the state for the first codepoint's class.
+    vector<bool> reachable(n_states);
+    vector<uint8_t> stack;
+    for (uint8_t c : classes) {
+        uint8_t state = xi_linebreak_start_state(c);
+        if (!reachable[state]) {
+            reachable[state] = true;
+            stack.push_back(state);
+        }
+    }
+    while (!stack.empty()) {
+        uint8_t state = stack.back();
+        stack.pop_back();
+        for (uint8_t c : classes) {
+            uint8_t next = step(state, c);
+            if (!reachable[next]) {
+                reachable[next] = true;
+                stack.push_back(next);
+            }
+        }
+    }
+    n_reachable = std::count(reachable.begin(), reachable.end(), true) * classes.size();
 }
 
-string randstring(vector<uint32_t>* codepoints) {
-    static std::default_random_engine generator;
-    static std::exponential_distribution<double> expd(1.0);
-    static std::uniform_real_distribution<double> unif;
-    string result;
-    uint32_t len = 1 + (uint32_t)(10 * expd(generator));
-    while (result.size() < len) {
-        double kind = unif(generator);
-        double lo = 0x20, hi;
-        if (kind < 0.01) {
-            lo = 0;
-            hi = 0x20;
-        } else if (kind < 0.5) {
-            hi = 0x7f;
-        } else if (kind < 0.8) {
-            hi = 0x800;
-        } else if (kind < 0.95) {
-            hi = 0x10000;
+// The set of (state, class) transitions seen so far.
+struct Coverage {
+    vector<bool> hit;
+    vector<size_t> state_count;
+    size_t count = 0;
+
+    bool seen(const LbModel& model, uint8_t state, uint8_t cls) const {
+        return !hit.empty() && hit[state * model.n_cat + cls];
+    }
+
+    // The number of transitions seen out of `state`.
+    size_t n_seen(uint8_t state) const {
+        return state_count.empty() ? 0 : state_count[state];
+    }
+
+    void mark(const LbModel& model, uint8_t state, uint8_t cls) {
+        if (hit.empty()) {
+            hit.resize(model.n_states * model.n_cat);
+            state_count.resize(model.n_states);
+        }
+        if (!hit[state * model.n_cat + cls]) {
+            hit[state * model.n_cat + cls] = true;
+            state_count[state]++;
+            count++;
+        }
+    }
+
+    void merge(const LbModel& model, const Coverage& other) {
+        for (size_t i = 0; i < other.hit.size(); i++) {
+            if (other.hit[i]) mark(model, i / model.n_cat, i % model.n_cat);
+        }
+    }
+};
+
+// Marks the transitions taken by xi's state machine over `codepoints`.
+void track_coverage(const LbModel& model, const vector<uint32_t>& codepoints, Coverage* cov) {
+    if (codepoints.empty()) return;
+    uint8_t state = xi_linebreak_start_state(xi_linebreak_class(codepoints[0]));
+    for (size_t i = 1; i < codepoints.size(); i++) {
+        uint8_t cls = xi_linebreak_class(codepoints[i]);
+        cov->mark(model, state, cls);
+        state = model.step(state, cls);
+    }
+}
+
+// Like randstring_into, but draws each codepoint from a line break class,
+// with a bias toward classes completing transitions not yet in `cov`.
+void guided_string(Rng* rng, const LbModel& model, Coverage* cov, string* result,
+        vector<uint32_t>* codepoints) {
+    uint32_t len = 1 + (uint32_t)(10 * rng->expd(rng->generator));
+    bool first = true;
+    uint8_t state = 0;
+    vector<uint8_t> unseen;
+    while (result->size() < len) {
+        unseen.clear();
+        if (!first) {
+            for (uint8_t c : model.classes) {
+                if (!cov->seen(model, state, c)) unseen.push_back(c);
+            }
+            // Failing that, head for a state with unseen transitions.
+            if (unseen.empty()) {
+                for (uint8_t c : model.classes) {
+                    if (cov->n_seen(model.step(state, c)) < model.classes.size()) {
+                        unseen.push_back(c);
+                    }
+                }
+            }
+        }
+        const vector<uint8_t>& candidates =
+            (!unseen.empty() && rng->unif(rng->generator) < GUIDED_BIAS) ? unseen : model.classes;
+        uint8_t cls = candidates[(size_t)(candidates.size() * rng->unif(rng->generator))];
+        const vector<uint32_t>& cps = model.class_cps[cls];
+        uint32_t cp = cps[(size_t)(cps.size() * rng->unif(rng->generator))];
+        codepoints->push_back(cp);
+        push_utf8(result, cp);
+        if (first) {
+            state = xi_linebreak_start_state(cls);
+            first = false;
         } else {
-            hi = 0x110000;
+            cov->mark(model, state, cls);
+            state = model.step(state, cls);
         }
-        uint32_t cp = (uint32_t)(lo + (hi - lo) * unif(generator));
-        if (cp < 0xd800 || (0xe000 <= cp && cp < 0x110000)) {
-            codepoints->push_back(cp);
-            push_utf8(&result, cp);
+    }
+}
+
+void push_codepoint(string* out, vector<uint32_t>* codepoints, uint32_t cp) {
+    codepoints->push_back(cp);
+    push_utf8(out, cp);
+}
+
+// Appends one of the mandatory line ends, mostly LF.
+void push_line_end(Rng* rng, string* out, vector<uint32_t>* codepoints) {
+    double kind = rng->unif(rng->generator);
+    if (kind < 0.85) {
+        if (kind >= 0.6) push_codepoint(out, codepoints, '\r');
+        push_codepoint(out, codepoints, '\n');
+    } else if (kind < 0.9) {
+        push_codepoint(out, codepoints, '\r');
+    } else if (kind < 0.95) {
+        push_codepoint(out, codepoints, 0x85);
+    } else {
+        push_codepoint(out, codepoints, kind < 0.975 ? 0x2028 : 0x2029);
+    }
+}
+
+// Appends a document of at least `len` bytes; see --doc-len.
+void randdoc(Rng* rng, size_t len, string* out, vector<uint32_t>* codepoints) {
+    while (out->size() < len) {
+        uint32_t n_sentences = 1 + (uint32_t)(4 * rng->expd(rng->generator));
+        for (uint32_t i = 0; i < n_sentences; i++) {
+            uint32_t n_words = 1 + (uint32_t)(12 * rng->expd(rng->generator));
+            for (uint32_t j = 0; j < n_words; j++) {
+                if (j > 0) {
+                    double space = rng->unif(rng->generator);
+                    push_codepoint(out, codepoints, space < 0.01 ? '\t' : ' ');
+                    if (space > 0.98) push_codepoint(out, codepoints, ' ');
+                }
+                uint32_t word_len = 1 + (uint32_t)(6 * rng->expd(rng->generator));
+                for (uint32_t k = 0; k < word_len; k++) {
+                    uint32_t cp;
+                    if (rand_codepoint(rng, &cp)) push_codepoint(out, codepoints, cp);
+                }
+            }
+            push_codepoint(out, codepoints, ".?!"[(size_t)(3 * rng->unif(rng->generator))]);
+            if (i + 1 < n_sentences) push_codepoint(out, codepoints, ' ');
         }
+        push_line_end(rng, out, codepoints);
+        if (rng->unif(rng->generator) < 0.3) push_line_end(rng, out, codepoints);
+    }
+}
+
+struct GenOptions {
+    uint64_t seed = 0;
+    Format format = Format::Text;
+    // Set if coverage is measured.
+    const LbModel* model = nullptr;
+    bool guided = false;
+    // If nonzero, the minimum length of the documents of --doc-len.
+    size_t doc_len = 0;
+    // The number of cases generated from a single random stream.
+    uint64_t block_size = BLOCK_SIZE;
+    bool splits = false;
+};
+
+void push_varint(string* buf, uint64_t x) {
+    while (x >= 0x80) {
+        *buf += (char)(0x80 | (x & 0x7f));
+        x >>= 7;
+    }
+    *buf += (char)x;
+}
+
+void report_binary(string* out, const string& s, const vector<Break>& breaks) {
+    push_varint(out, s.size());
+    *out += s;
+    push_varint(out, breaks.size());
+    size_t prev = 0;
+    for (const Break& bk : breaks) {
+        push_varint(out, (uint64_t)(bk.offset - prev) << 1 | bk.hard);
+        prev = bk.offset;
     }
-    return result;
 }
 
-void report_string(const string& s, const vector<size_t>& breaks,
-        const vector<uint32_t>& codepoints) {
-    size_t bks_ix = 0;
-    size_t utf8_ix = 0;
-    cout << "×";
+void report_splits(string* out, Format format, const vector<size_t>& splits) {
+    if (format == Format::Binary) {
+        push_varint(out, splits.size());
+        size_t prev = 0;
+        for (size_t split : splits) {
+            push_varint(out, split - prev);
+            prev = split;
+        }
+    } else {
+        *out += "\t# splits:";
+        for (size_t split : splits) {
+            *out += ' ' + std::to_string(split);
+        }
+    }
+}
+
+// The range of leaf sizes in a rope; see rope/src/tree.rs.
+const size_t MIN_LEAF = 511;
+const size_t MAX_LEAF = 1024;
+
+// Whether `cls` is SP, CM or ZWJ, the classes whose runs need look-behind.
+bool is_run_class(uint8_t cls) {
+    static const uint8_t sp = xi_linebreak_property(' ');
+    static const uint8_t cm = xi_linebreak_property(0x0301);
+    static const uint8_t zwj = xi_linebreak_property(0x200d);
+    return cls == sp || cls == cm || cls == zwj;
+}
+
+// Chooses the splits of a case; see --splits.
+void choose_splits(Rng* rng, const vector<uint32_t>& codepoints, size_t len,
+        vector<size_t>* splits) {
+    splits->clear();
+    double random_prob = std::min(0.125, 64.0 / len);
+    size_t leaf_end = MIN_LEAF + (size_t)((MAX_LEAF - MIN_LEAF) * rng->unif(rng->generator));
+    size_t offset = 0;
+    uint8_t prev_cls = 0;
     for (size_t i = 0; i < codepoints.size(); i++) {
-        uint8_t b = s[utf8_ix];
-        size_t cp_len = 1;
-        if (b >= 0xf0) {
-            cp_len = 4;
-        } else if (b >= 0xe0) {
-            cp_len = 3;
-        } else if (b >= 0xc0) {
-            cp_len = 2;
-        }
-        utf8_ix += cp_len;
-        cout << " " << std::hex << codepoints[i];
-        if (breaks[bks_ix] == utf8_ix) {
-            cout << " ÷";
-            bks_ix++;
-        } else {
-            cout << " ×";
+        uint8_t cls = xi_linebreak_property(codepoints[i]);
+        if (i > 0) {
+            double r = rng->unif(rng->generator);
+            bool in_run = is_run_class(prev_cls) && is_run_class(cls);
+            if (offset >= leaf_end || r < random_prob || (in_run && r < 0.5)) {
+                splits->push_back(offset);
+                leaf_end = offset + MIN_LEAF
+                    + (size_t)((MAX_LEAF - MIN_LEAF) * rng->unif(rng->generator));
+            }
         }
+        uint32_t cp = codepoints[i];
+        offset += cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+        prev_cls = cls;
     }
-    cout << endl;
 }
 
-int main(int argc, char** argv) {
-    int niter = 100;
-    if (argc == 2) niter = atoi(argv[1]);
+// The buffers of one generating thread, reused from case to case and block
+// to block.
+struct GenScratch {
     UText ut = UTEXT_INITIALIZER;
-    UErrorCode status = U_ZERO_ERROR;
-    BreakIterator* bi = BreakIterator::createLineInstance(Locale(), status);
-    vector<size_t> breaks;
+    string s;
+    vector<Break> breaks;
     vector<uint32_t> codepoints;
-    for (int i = 0; i < niter; i++) {
+    vector<size_t> splits;
+
+    GenScratch() {}
+    GenScratch(const GenScratch&) = delete;
+    ~GenScratch() { utext_close(&ut); }
+};
+
+// Generates cases [start, end) of the given block into `out`, adding the
+// transitions they cover to `cov`.
+void gen_block(BreakIterator* bi, const GenOptions& opts, uint64_t block, uint64_t start,
+        uint64_t end, GenScratch* scratch, string* out, Coverage* cov) {
+    Rng rng(opts.seed, block);
+    // Splits draw from a stream for the block besides the cases'.
+    Rng split_rng(opts.seed, block | 1ull << 63);
+    Coverage block_cov;
+    string& s = scratch->s;
+    vector<Break>& breaks = scratch->breaks;
+    vector<uint32_t>& codepoints = scratch->codepoints;
+    for (uint64_t i = block * opts.block_size; i < end; i++) {
         codepoints.clear();
         breaks.clear();
-        string s = randstring(&codepoints);
-        utext_openUTF8(&ut, s.data(), s.size(), &status);
-        bi->setText(&ut, status);
-        bool first = true;
-        while (true) {
-            int32_t i = bi->next();
-            if (i == BreakIterator::DONE) {
-                break;
+        s.clear();
+        if (opts.doc_len != 0) {
+            randdoc(&rng, opts.doc_len, &s, &codepoints);
+        } else if (opts.guided) {
+            guided_string(&rng, *opts.model, &block_cov, &s, &codepoints);
+        } else {
+            randstring_into(&rng, &s, &codepoints);
+        }
+        if (opts.splits) choose_splits(&split_rng, codepoints, s.size(), &scratch->splits);
+        // Cases before `start` are generated only to advance the streams.
+        if (i < start) continue;
+        if (opts.model != nullptr && !opts.guided) {
+            track_coverage(*opts.model, codepoints, &block_cov);
+        }
+        icu_breaks(bi, &scratch->ut, s, &breaks);
+        if (opts.format == Format::Binary) {
+            report_binary(out, s, breaks);
+        } else {
+            report_string(out, s, breaks, codepoints);
+        }
+        if (opts.splits) report_splits(out, opts.format, scratch->splits);
+        if (opts.format != Format::Binary) *out += '\n';
+    }
+    if (opts.model != nullptr) cov->merge(*opts.model, block_cov);
+}
+
+// Generated output for one block, shared between a worker and the writer.
+struct BlockSlot {
+    string out;
+    Coverage cov;
+    bool done = false;
+};
+
+// Generates cases [start, end) on `nthreads` threads, writing them to `out`
+// in order. Each worker claims whole blocks, and at most a bounded number of
+// finished blocks are buffered ahead of the writer. A block's output is
+// accumulated in memory and written with a single fwrite.
+void gen_range(BreakIterator* bi, const GenOptions& opts, uint64_t start, uint64_t end,
+        int nthreads, FILE* out, Coverage* cov) {
+    if (start >= end) return;
+    const uint64_t block_size = opts.block_size;
+    uint64_t first_block = start / block_size;
+    uint64_t n_blocks = (end + block_size - 1) / block_size - first_block;
+    if (nthreads <= 1) {
+        GenScratch scratch;
+        string buf;
+        for (uint64_t b = first_block; b < first_block + n_blocks; b++) {
+            buf.clear();
+            gen_block(bi, opts, b, std::max(start, b * block_size),
+                std::min(end, (b + 1) * block_size), &scratch, &buf, cov);
+            fwrite(buf.data(), 1, buf.size(), out);
+        }
+        return;
+    }
+    const uint64_t window = 2 * nthreads;
+    vector<std::unique_ptr<BlockSlot>> slots(n_blocks);
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::atomic<uint64_t> next_block(0);
+    uint64_t written = 0;
+    vector<std::thread> workers;
+    for (int t = 0; t < nthreads; t++) {
+        // Each worker gets its own iterator; an ICU BreakIterator is not
+        // safe for concurrent use.
+        std::shared_ptr<BreakIterator> worker_bi(bi->clone());
+        workers.emplace_back([&, worker_bi]() {
+            GenScratch scratch;
+            while (true) {
+                uint64_t ix = next_block++;
+                if (ix >= n_blocks) break;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [&]() { return ix < written + window; });
+                    slots[ix].reset(new BlockSlot());
+                }
+                uint64_t b = first_block + ix;
+                gen_block(worker_bi.get(), opts, b, std::max(start, b * block_size),
+                    std::min(end, (b + 1) * block_size), &scratch, &slots[ix]->out,
+                    &slots[ix]->cov);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    slots[ix]->done = true;
+                }
+                cv.notify_all();
             }
-            breaks.push_back(i);
-            first = false;
+        });
+    }
+    for (uint64_t ix = 0; ix < n_blocks; ix++) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() { return slots[ix] && slots[ix]->done; });
+        }
+        fwrite(slots[ix]->out.data(), 1, slots[ix]->out.size(), out);
+        if (opts.model != nullptr) cov->merge(*opts.model, slots[ix]->cov);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slots[ix].reset();
+            written++;
+        }
+        cv.notify_all();
+    }
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+typedef std::chrono::steady_clock Clock;
+
+const uint64_t DEFAULT_BENCH_NITER = 10000;
+const int DEFAULT_BENCH_ROUNDS = 10;
+
+// A script of the generated --bench corpus, and how often its words are
+// followed by a space; where they are not, ideographic punctuation sometimes
+// follows instead.
+struct BenchScript {
+    UScriptCode script;
+    double space_prob;
+};
+
+const BenchScript BENCH_SCRIPTS[] = {
+    {USCRIPT_LATIN, 1.0},
+    {USCRIPT_GREEK, 1.0},
+    {USCRIPT_CYRILLIC, 1.0},
+    {USCRIPT_ARABIC, 1.0},
+    {USCRIPT_HEBREW, 1.0},
+    {USCRIPT_DEVANAGARI, 1.0},
+    {USCRIPT_HANGUL, 1.0},
+    {USCRIPT_THAI, 0.2},
+    {USCRIPT_HAN, 0.0},
+    {USCRIPT_HIRAGANA, 0.0},
+};
+
+// A group of cases timed together.
+struct BenchGroup {
+    string name;
+    vector<string> cases;
+    size_t bytes = 0;
+
+    void add(string s) {
+        bytes += s.size();
+        cases.push_back(std::move(s));
+    }
+};
+
+// A paragraph of words of `letters`, of about the same length in bytes as
+// the strings of randstring, times 20.
+string script_paragraph(Rng* rng, const vector<uint32_t>& letters, double space_prob) {
+    string result;
+    uint32_t len = 1 + (uint32_t)(200 * rng->expd(rng->generator));
+    while (result.size() < len) {
+        uint32_t word_len = 1 + (uint32_t)(6 * rng->expd(rng->generator));
+        for (uint32_t i = 0; i < word_len; i++) {
+            push_utf8(&result, letters[(size_t)(letters.size() * rng->unif(rng->generator))]);
+        }
+        double sep = rng->unif(rng->generator);
+        if (sep < space_prob) {
+            result += sep < 0.1 * space_prob ? ". " : " ";
+        } else if (sep < space_prob + 0.1) {
+            push_utf8(&result, sep < space_prob + 0.05 ? 0x3001 : 0x3002);
+        }
+    }
+    return result;
+}
+
+void gen_bench_groups(uint64_t seed, uint64_t niter, vector<BenchGroup>* groups) {
+    groups->emplace_back();
+    groups->back().name = "random";
+    Rng rng(seed, 0);
+    vector<uint32_t> codepoints;
+    for (uint64_t i = 0; i < niter; i++) {
+        codepoints.clear();
+        groups->back().add(randstring(&rng, &codepoints));
+    }
+    const size_t n_scripts = sizeof(BENCH_SCRIPTS) / sizeof(BENCH_SCRIPTS[0]);
+    vector<vector<uint32_t>> letters(n_scripts);
+    for (uint32_t cp = 0; cp < 0x110000; cp++) {
+        if (!u_isalpha(cp)) continue;
+        UErrorCode status = U_ZERO_ERROR;
+        UScriptCode script = uscript_getScript(cp, &status);
+        for (size_t i = 0; i < n_scripts; i++) {
+            if (BENCH_SCRIPTS[i].script == script) letters[i].push_back(cp);
+        }
+    }
+    for (size_t i = 0; i < n_scripts; i++) {
+        // Each script draws from its own stream, as blocks do.
+        Rng script_rng(seed, i + 1);
+        groups->emplace_back();
+        groups->back().name = uscript_getName(BENCH_SCRIPTS[i].script);
+        for (uint64_t j = 0; j < niter; j++) {
+            groups->back().add(
+                script_paragraph(&script_rng, letters[i], BENCH_SCRIPTS[i].space_prob));
+        }
+    }
+}
+
+// The most common script of the codepoints of `s`, other than Common and
+// Inherited, or Common if there are none.
+UScriptCode main_script(const string& s) {
+    std::map<UScriptCode, size_t> counts;
+    int32_t i = 0;
+    while (i < (int32_t)s.size()) {
+        UChar32 c;
+        U8_NEXT(s.data(), i, (int32_t)s.size(), c);
+        UErrorCode status = U_ZERO_ERROR;
+        UScriptCode script = c < 0 ? USCRIPT_COMMON : uscript_getScript(c, &status);
+        if (script != USCRIPT_COMMON && script != USCRIPT_INHERITED) counts[script]++;
+    }
+    UScriptCode result = USCRIPT_COMMON;
+    size_t best = 0;
+    for (auto& kv : counts) {
+        if (kv.second > best) {
+            result = kv.first;
+            best = kv.second;
+        }
+    }
+    return result;
+}
+
+// Splits the files into lines, keeping the newlines, and groups them by
+// script, after a group of all of them.
+bool load_bench_groups(const vector<const char*>& paths, vector<BenchGroup>* groups) {
+    BenchGroup all;
+    all.name = "all";
+    std::map<UScriptCode, BenchGroup> by_script;
+    for (const char* path : paths) {
+        FILE* f = fopen(path, "rb");
+        if (f == nullptr) {
+            std::cerr << "can't read " << path << endl;
+            return false;
+        }
+        string text;
+        char buf[65536];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+            text.append(buf, n);
+        }
+        fclose(f);
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t end = text.find('\n', start);
+            end = end == string::npos ? text.size() : end + 1;
+            string line = text.substr(start, end - start);
+            start = end;
+            UScriptCode script = main_script(line);
+            if (by_script[script].name.empty()) by_script[script].name = uscript_getName(script);
+            by_script[script].add(line);
+            all.add(std::move(line));
         }
-        report_string(s, breaks, codepoints);
-        utext_close(&ut);
+    }
+    groups->push_back(std::move(all));
+    for (auto& kv : by_script) {
+        groups->push_back(std::move(kv.second));
+    }
+    return true;
+}
+
+// The timing of one engine on one group.
+struct BenchResult {
+    const char* engine;
+    const BenchGroup* group;
+    size_t breaks;
+    double best;
+    double median;
+};
+
+// Runs `round`, which returns the number of breaks it found, once to warm
+// up and then `rounds` times.
+template <typename F>
+BenchResult time_rounds(const char* engine, const BenchGroup& group, int rounds, F round) {
+    size_t breaks = round();
+    vector<double> times;
+    for (int i = 0; i < rounds; i++) {
+        Clock::time_point t = Clock::now();
+        breaks = round();
+        times.push_back(std::chrono::duration<double>(Clock::now() - t).count());
+    }
+    std::sort(times.begin(), times.end());
+    return {engine, &group, breaks, times[0], times[times.size() / 2]};
+}
+
+void push_json_string(string* out, const string& s) {
+    *out += '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            *out += '\\';
+            *out += c;
+        } else if ((uint8_t)c < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            *out += esc;
+        } else {
+            *out += c;
+        }
+    }
+    *out += '"';
+}
+
+void report_bench(FILE* out, Format format, const char* locale, int rounds,
+        const vector<BenchResult>& results) {
+    string report;
+    char buf[256];
+    if (format == Format::Csv) {
+        report += "engine,script,strings,bytes,breaks,best_s,median_s,breaks_per_s,bytes_per_s\n";
+    } else {
+        report += "{\"locale\": ";
+        push_json_string(&report, locale);
+        report += ", \"rounds\": " + std::to_string(rounds) + ", \"results\": [";
+    }
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        if (format == Format::Csv) {
+            report += r.engine;
+            report += ',' + r.group->name + ',';
+            snprintf(buf, sizeof(buf), "%zu,%zu,%zu,%.6g,%.6g,%.6g,%.6g\n", r.group->cases.size(),
+                r.group->bytes, r.breaks, r.best, r.median, r.breaks / r.best,
+                r.group->bytes / r.best);
+        } else {
+            report += i == 0 ? "\n  {\"engine\": " : ",\n  {\"engine\": ";
+            push_json_string(&report, r.engine);
+            report += ", \"script\": ";
+            push_json_string(&report, r.group->name);
+            snprintf(buf, sizeof(buf), ", \"strings\": %zu, \"bytes\": %zu, \"breaks\": %zu, "
+                "\"best_s\": %.6g, \"median_s\": %.6g, \"breaks_per_s\": %.6g, "
+                "\"bytes_per_s\": %.6g}", r.group->cases.size(), r.group->bytes, r.breaks, r.best,
+                r.median, r.breaks / r.best, r.group->bytes / r.best);
+        }
+        report += buf;
+    }
+    if (format != Format::Csv) report += "\n]}\n";
+    fwrite(report.data(), 1, report.size(), out);
+}
+
+void run_bench(BreakIterator* bi, uint8_t strictness, const vector<BenchGroup>& groups,
+        int rounds, vector<BenchResult>* results) {
+    UText ut = UTEXT_INITIALIZER;
+    vector<size_t> offsets;
+    vector<uint8_t> hard;
+    for (const BenchGroup& group : groups) {
+        if (group.cases.empty()) continue;
+        results->push_back(time_rounds("icu", group, rounds, [&]() {
+            size_t breaks = 0;
+            for (const string& s : group.cases) {
+                UErrorCode status = U_ZERO_ERROR;
+                utext_openUTF8(&ut, s.data(), s.size(), &status);
+                bi->setText(&ut, status);
+                while (bi->next() != BreakIterator::DONE) {
+                    breaks++;
+                }
+            }
+            return breaks;
+        }));
+        size_t cap = 0;
+        for (const string& s : group.cases) {
+            cap = std::max(cap, s.size() + 1);
+        }
+        offsets.resize(cap);
+        hard.resize(cap);
+        results->push_back(time_rounds("xi", group, rounds, [&]() {
+            size_t breaks = 0;
+            for (const string& s : group.cases) {
+                breaks += xi_line_breaks((const uint8_t*)s.data(), s.size(), strictness,
+                    offsets.data(), hard.data(), cap);
+            }
+            return breaks;
+        }));
+    }
+    utext_close(&ut);
+}
+
+void usage() {
+    std::cerr << "usage: gen_rand_icu [niter] [--seed S] [--threads N] [--shard K/M] [-o path]"
+        << " [--format text|binary] [--coverage] [--guided] [--locale L] [--doc-len N]"
+        << " [--splits]" << endl
+        << "       gen_rand_icu --bench [niter] [--seed S] [--rounds R] [--input FILE]..."
+        << " [--format json|csv] [-o path] [--locale L]" << endl;
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    uint64_t niter = 100;
+    GenOptions opts;
+    bool coverage = false;
+    int nthreads = 1;
+    uint64_t shard = 0, nshards = 1;
+    bool sharded = false;
+    const char* out_path = nullptr;
+    const char* locale = "";
+    bool bench = false;
+    bool niter_given = false;
+    bool format_given = false;
+    int rounds = DEFAULT_BENCH_ROUNDS;
+    vector<const char*> inputs;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            opts.seed = strtoull(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shard") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%" SCNu64 "/%" SCNu64, &shard, &nshards) != 2 ||
+                    nshards == 0 || shard >= nshards) {
+                usage();
+            }
+            sharded = true;
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "text") == 0) {
+                opts.format = Format::Text;
+            } else if (strcmp(argv[i], "binary") == 0) {
+                opts.format = Format::Binary;
+            } else if (strcmp(argv[i], "json") == 0) {
+                opts.format = Format::Json;
+            } else if (strcmp(argv[i], "csv") == 0) {
+                opts.format = Format::Csv;
+            } else {
+                usage();
+            }
+            format_given = true;
+        } else if (strcmp(argv[i], "--coverage") == 0) {
+            coverage = true;
+        } else if (strcmp(argv[i], "--guided") == 0) {
+            coverage = true;
+            opts.guided = true;
+        } else if (strcmp(argv[i], "--locale") == 0 && i + 1 < argc) {
+            locale = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(argv[i], "--doc-len") == 0 && i + 1 < argc) {
+            char* suffix;
+            opts.doc_len = strtoull(argv[++i], &suffix, 0);
+            if (strcmp(suffix, "k") == 0) {
+                opts.doc_len <<= 10;
+            } else if (strcmp(suffix, "M") == 0) {
+                opts.doc_len <<= 20;
+            } else if (*suffix != '\0' || opts.doc_len == 0) {
+                usage();
+            }
+            opts.block_size = 1;
+        } else if (strcmp(argv[i], "--splits") == 0) {
+            opts.splits = true;
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+        } else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+            if (rounds < 1) usage();
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            inputs.push_back(argv[++i]);
+        } else if (argv[i][0] != '-') {
+            niter = strtoull(argv[i], nullptr, 0);
+            niter_given = true;
+        } else {
+            usage();
+        }
+    }
+    bool bench_format = opts.format == Format::Json || opts.format == Format::Csv;
+    if (bench ? format_given && !bench_format : bench_format || !inputs.empty()) usage();
+    if ((opts.doc_len != 0 || opts.splits) && bench) usage();
+    if (opts.doc_len != 0 && opts.guided) usage();
+    uint8_t strictness;
+    std::unique_ptr<BreakIterator> bi = make_line_iterator(locale, &strictness);
+    if (bench) {
+        vector<BenchGroup> groups;
+        if (inputs.empty()) {
+            gen_bench_groups(opts.seed, niter_given ? niter : DEFAULT_BENCH_NITER, &groups);
+        } else if (!load_bench_groups(inputs, &groups)) {
+            return 1;
+        }
+        vector<BenchResult> results;
+        run_bench(bi.get(), strictness, groups, rounds, &results);
+        FILE* out = out_path == nullptr ? stdout : fopen(out_path, "wb");
+        if (out == nullptr) {
+            std::cerr << "can't open " << out_path << endl;
+            return 1;
+        }
+        report_bench(out, format_given ? opts.format : Format::Json, locale, rounds, results);
+        return fclose(out) == 0 ? 0 : 1;
+    }
+    // Shards split the corpus on block boundaries, so that every shard's
+    // random streams are independent of the shard count.
+    uint64_t n_blocks = (niter + opts.block_size - 1) / opts.block_size;
+    uint64_t start = std::min(niter, n_blocks * shard / nshards * opts.block_size);
+    uint64_t end = std::min(niter, n_blocks * (shard + 1) / nshards * opts.block_size);
+    FILE* out = stdout;
+    if (out_path != nullptr) {
+        string path = out_path;
+        if (sharded) path += "." + std::to_string(shard);
+        out = fopen(path.c_str(), "wb");
+        if (out == nullptr) {
+            std::cerr << "can't open " << path << endl;
+            return 1;
+        }
+    }
+    std::unique_ptr<LbModel> model;
+    if (coverage) {
+        model.reset(new LbModel(strictness));
+        opts.model = model.get();
+    }
+    if (opts.format == Format::Binary) {
+        fwrite(BINARY_MAGIC, 1, 4, out);
+        fputc(opts.splits ? BINARY_VERSION_SPLITS : BINARY_VERSION, out);
+    }
+    Coverage cov;
+    gen_range(bi.get(), opts, start, end, nthreads, out, &cov);
+    if (fclose(out) != 0) {
+        std::cerr << "error writing output" << endl;
+        return 1;
+    }
+    if (coverage) {
+        std::cerr << "covered " << cov.count << " of " << model->n_reachable
+            << " reachable state machine transitions" << endl;
     }
     return 0;
 }
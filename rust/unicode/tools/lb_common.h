@@ -0,0 +1,216 @@
+// Copyright 2016 The xi-editor Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Helpers shared by the ICU-based tools in this directory: random string
+// generation, creating ICU's line break iterator for a locale, collecting its
+// line breaks, and the LineBreakTest.txt format.
+
+#ifndef XI_UNICODE_TOOLS_LB_COMMON_H_
+#define XI_UNICODE_TOOLS_LB_COMMON_H_
+
+#include "ffi/xi_unicode.h"
+
+#include <unicode/brkiter.h>
+#include <unicode/ubrk.h>
+#include <unicode/utext.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// A break offset, and whether it is a mandatory break.
+struct Break {
+    size_t offset;
+    bool hard;
+};
+
+// Appends the UTF-8 encoding of `cp` to `buf`.
+inline void push_utf8(std::string* buf, uint32_t cp) {
+    if (cp < 0x80) {
+        *buf += cp;
+    } else if (cp < 0x800) {
+        *buf += 0xc0 | (cp >> 6);
+        *buf += 0x80 | (cp & 0x3f);
+    } else if (cp < 0x10000) {
+        *buf += 0xe0 | (cp >> 12);
+        *buf += 0x80 | ((cp >> 6) & 0x3f);
+        *buf += 0x80 | (cp & 0x3f);
+    } else {
+        *buf += 0xf0 | (cp >> 18);
+        *buf += 0x80 | ((cp >> 12) & 0x3f);
+        *buf += 0x80 | ((cp >> 6) & 0x3f);
+        *buf += 0x80 | (cp & 0x3f);
+    }
+}
+
+// The random stream for one block of cases. Note that the standard library
+// distributions are implementation-defined, so output is only reproducible
+// with the same C++ standard library.
+struct Rng {
+    std::mt19937_64 generator;
+    std::exponential_distribution<double> expd;
+    std::uniform_real_distribution<double> unif;
+
+    Rng(uint64_t seed, uint64_t block) : expd(1.0) {
+        std::seed_seq seq{(uint32_t)seed, (uint32_t)(seed >> 32),
+            (uint32_t)block, (uint32_t)(block >> 32)};
+        generator.seed(seq);
+    }
+};
+
+// Draws a codepoint, mostly ASCII and then increasingly rarely from larger
+// ranges. Returns false, for the caller to skip it, if it drew a surrogate.
+inline bool rand_codepoint(Rng* rng, uint32_t* cp) {
+    double kind = rng->unif(rng->generator);
+    double lo = 0x20, hi;
+    if (kind < 0.01) {
+        lo = 0;
+        hi = 0x20;
+    } else if (kind < 0.5) {
+        hi = 0x7f;
+    } else if (kind < 0.8) {
+        hi = 0x800;
+    } else if (kind < 0.95) {
+        hi = 0x10000;
+    } else {
+        hi = 0x110000;
+    }
+    *cp = (uint32_t)(lo + (hi - lo) * rng->unif(rng->generator));
+    return *cp < 0xd800 || (0xe000 <= *cp && *cp < 0x110000);
+}
+
+// Appends a random string to `result`, which is usually empty; a buffer
+// reused across strings saves allocating each one.
+inline void randstring_into(Rng* rng, std::string* result, std::vector<uint32_t>* codepoints) {
+    size_t len = result->size() + 1 + (uint32_t)(10 * rng->expd(rng->generator));
+    while (result->size() < len) {
+        uint32_t cp;
+        if (rand_codepoint(rng, &cp)) {
+            codepoints->push_back(cp);
+            push_utf8(result, cp);
+        }
+    }
+}
+
+inline std::string randstring(Rng* rng, std::vector<uint32_t>* codepoints) {
+    std::string result;
+    randstring_into(rng, &result, codepoints);
+    return result;
+}
+
+// Creates ICU's line break iterator for the locale `locale_id`, such as
+// "@lb=loose" (the default is the root locale), and sets `*strictness` to
+// xi's tailoring for its "lb" keyword, one of the XI_LB_* values. Exits if
+// the locale is not supported.
+//
+// ICU tailors line breaking further for Chinese and Japanese, beyond the lb
+// keyword; xi does not, so with those languages some mismatches are expected.
+inline std::unique_ptr<icu::BreakIterator> make_line_iterator(const char* locale_id,
+        uint8_t* strictness) {
+    UErrorCode status = U_ZERO_ERROR;
+    icu::Locale locale = icu::Locale::createFromName(locale_id);
+    char lb[16] = "";
+    locale.getKeywordValue("lb", lb, sizeof(lb), status);
+    if (U_FAILURE(status) || status == U_STRING_NOT_TERMINATED_WARNING) {
+        lb[0] = '?';
+        lb[1] = '\0';
+    }
+    if (lb[0] == '\0' || strcmp(lb, "strict") == 0) {
+        *strictness = XI_LB_STRICT;
+    } else if (strcmp(lb, "normal") == 0) {
+        *strictness = XI_LB_NORMAL;
+    } else if (strcmp(lb, "loose") == 0) {
+        *strictness = XI_LB_LOOSE;
+    } else {
+        fprintf(stderr, "unsupported lb keyword in locale %s\n", locale_id);
+        exit(1);
+    }
+    if (strcmp(locale.getLanguage(), "ja") == 0 || strcmp(locale.getLanguage(), "zh") == 0) {
+        fprintf(stderr, "warning: ICU's %s line breaking differs from xi's\n",
+            locale.getLanguage());
+    }
+    status = U_ZERO_ERROR;
+    std::unique_ptr<icu::BreakIterator> bi(icu::BreakIterator::createLineInstance(locale, status));
+    if (U_FAILURE(status)) {
+        fprintf(stderr, "failed to create break iterator: %s\n", u_errorName(status));
+        exit(1);
+    }
+    return bi;
+}
+
+// Collects ICU's breaks of `s` into `breaks`, using `ut` as scratch; the
+// caller closes it.
+inline void icu_breaks(icu::BreakIterator* bi, UText* ut, const std::string& s,
+        std::vector<Break>* breaks) {
+    UErrorCode status = U_ZERO_ERROR;
+    breaks->clear();
+    utext_openUTF8(ut, s.data(), s.size(), &status);
+    bi->setText(ut, status);
+    while (true) {
+        int32_t bk = bi->next();
+        if (bk == icu::BreakIterator::DONE) {
+            break;
+        }
+        int32_t rule_status = bi->getRuleStatus();
+        bool hard = rule_status >= UBRK_LINE_HARD && rule_status < UBRK_LINE_HARD_LIMIT;
+        breaks->push_back({(size_t)bk, hard});
+    }
+}
+
+inline void push_hex(std::string* buf, uint32_t x) {
+    char digits[8];
+    int n = 0;
+    do {
+        digits[n++] = "0123456789abcdef"[x & 0xf];
+        x >>= 4;
+    } while (x != 0);
+    while (n > 0) {
+        *buf += digits[--n];
+    }
+}
+
+// Appends a case in the LineBreakTest.txt format, without the newline.
+inline void report_string(std::string* out, const std::string& s,
+        const std::vector<Break>& breaks, const std::vector<uint32_t>& codepoints) {
+    size_t bks_ix = 0;
+    size_t utf8_ix = 0;
+    *out += "×";
+    for (size_t i = 0; i < codepoints.size(); i++) {
+        uint8_t b = s[utf8_ix];
+        size_t cp_len = 1;
+        if (b >= 0xf0) {
+            cp_len = 4;
+        } else if (b >= 0xe0) {
+            cp_len = 3;
+        } else if (b >= 0xc0) {
+            cp_len = 2;
+        }
+        utf8_ix += cp_len;
+        *out += ' ';
+        push_hex(out, codepoints[i]);
+        if (bks_ix < breaks.size() && breaks[bks_ix].offset == utf8_ix) {
+            *out += " ÷";
+            bks_ix++;
+        } else {
+            *out += " ×";
+        }
+    }
+}
+
+#endif  // XI_UNICODE_TOOLS_LB_COMMON_H_
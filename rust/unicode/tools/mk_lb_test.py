@@ -0,0 +1,300 @@
+#!/usr/bin/env python3
+# Copyright 2026 The xi-editor Authors.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Writes line breaking tests in the format of the UCD's LineBreakTest.txt.
+# The breaks come from the rules of UAX #14, applied one by one to each
+# position as in the text of the standard, and not from the state machines
+# of mk_tables.py, so that each checks the other. Unlike the UCD's tests,
+# which tailor LB25 as in Example 7 of section 8.2 of UAX #14, these follow
+# the untailored rules.
+
+# Usage: python3 tools/mk_lb_test.py datadir > tests/LineBreakTest.txt
+# datadir is as for mk_tables.py, and the Unicode version must be the one
+# the rules below are for.
+
+import os
+import sys
+import unicodedata
+
+UCD_VERSION = '15.0.0'
+
+def open_ucd(datadir, fn):
+    for subdir in ('', 'auxiliary', 'emoji'):
+        path = os.path.join(datadir, subdir, fn)
+        if os.path.exists(path):
+            return open(path)
+    sys.exit('%s not found in %s' % (fn, datadir))
+
+def ranges(f):
+    for line in f:
+        s = line.split('#', 1)[0].split(';')
+        if len(s) == 2:
+            t = s[0].strip().split('..')
+            yield (range(int(t[0], 16), int(t[-1], 16) + 1), s[1].strip())
+
+def load_data(datadir):
+    f = open_ucd(datadir, 'LineBreak.txt')
+    if not f.readline().startswith('# LineBreak-%s.txt' % UCD_VERSION):
+        sys.exit('LineBreak.txt is not from Unicode %s' % UCD_VERSION)
+    lb = ['XX'] * 0x110000
+    for line in f:
+        if line.startswith('# @missing:'):
+            (r, val), = ranges([line[len('# @missing:'):]])
+            for cp in r:
+                lb[cp] = val
+    f.seek(0)
+    for (r, val) in ranges(f):
+        for cp in r:
+            lb[cp] = val
+    ea = ['N'] * 0x110000
+    for (r, val) in ranges(open_ucd(datadir, 'EastAsianWidth.txt')):
+        for cp in r:
+            ea[cp] = val
+    gc = ['Cn'] * 0x110000
+    first = None
+    for line in open_ucd(datadir, 'UnicodeData.txt'):
+        s = line.split(';')
+        cp = int(s[0], 16)
+        if s[1].endswith(', First>'):
+            first = cp
+            continue
+        for c in range(first if s[1].endswith(', Last>') else cp, cp + 1):
+            gc[c] = s[2]
+    ext_pict = set()
+    for (r, val) in ranges(open_ucd(datadir, 'emoji-data.txt')):
+        if val == 'Extended_Pictographic':
+            ext_pict.update(r)
+    return (lb, ea, gc, ext_pict)
+
+def resolve(cp, data):
+    # LB1, and the subsets of classes which some rules single out: OPW for
+    # the East Asian wide OP which LB30 excludes, and EPU for the unassigned
+    # Extended_Pictographic code points of LB30b.
+    (lb, ea, gc, ext_pict) = data
+    c = lb[cp]
+    if c in ('AI', 'SG', 'XX'):
+        return 'AL'
+    elif c == 'SA':
+        return 'CM' if gc[cp] in ('Mn', 'Mc') else 'AL'
+    elif c == 'CJ':
+        return 'NS'
+    elif c == 'OP' and ea[cp] in ('F', 'W', 'H'):
+        return 'OPW'
+    elif c == 'CP' and ea[cp] in ('F', 'W', 'H'):
+        return 'CPW'
+    elif cp in ext_pict and gc[cp] == 'Cn':
+        return 'EPU'
+    return c
+
+OP = ('OP', 'OPW')
+CP = ('CP', 'CPW')
+ID = ('ID', 'EB', 'EM', 'EPU')
+AL_HL = ('AL', 'HL')
+JAMO = ('JL', 'JV', 'JT', 'H2', 'H3')
+LB25 = set([('CL', 'PO'), ('CP', 'PO'), ('CL', 'PR'), ('CP', 'PR'), ('NU', 'PO'),
+    ('NU', 'PR'), ('PO', 'OP'), ('PO', 'NU'), ('PR', 'OP'), ('PR', 'NU'), ('HY', 'NU'),
+    ('IS', 'NU'), ('NU', 'NU'), ('SY', 'NU')])
+
+def find_breaks(cls):
+    # For each position after the first code point, '÷' for a break, '!'
+    # for a mandatory one or '×' for none, and the rule which decides it.
+    # LB9 and LB10: `eff` is the class each code point is treated as.
+    eff = []
+    absorbed = []
+    for (i, c) in enumerate(cls):
+        if c in ('CM', 'ZWJ') and i > 0 and eff[i - 1] not in ('BK', 'CR', 'LF', 'NL', 'SP', 'ZW'):
+            eff.append(eff[i - 1])
+            absorbed.append(True)
+        else:
+            eff.append('AL' if c in ('CM', 'ZWJ') else c)
+            absorbed.append(False)
+    # LB25 pairs with OP and CP include the wide ones.
+    base = lambda c: {'OPW': 'OP', 'CPW': 'CP'}.get(c, c)
+
+    def rule(i):
+        (l, r) = (cls[i - 1], cls[i])
+        if l == 'BK':
+            return ('!', '4.0')
+        if l == 'CR' and r == 'LF':
+            return ('×', '5.01')
+        if l in ('CR', 'LF', 'NL'):
+            return ('!', '5.02')
+        if r in ('BK', 'CR', 'LF', 'NL'):
+            return ('×', '6.0')
+        if r in ('SP', 'ZW'):
+            return ('×', '7.0')
+        k = i - 1
+        while k >= 0 and cls[k] == 'SP':
+            k -= 1
+        if k >= 0 and cls[k] == 'ZW':
+            return ('÷', '8.0')
+        if l == 'ZWJ':
+            return ('×', '8.1')
+        if absorbed[i]:
+            return ('×', '9.0')
+        # The rest apply to the classes after LB9 and LB10.
+        (l, r) = (eff[i - 1], eff[i])
+        k = i - 1
+        while k >= 0 and eff[k] == 'SP':
+            k -= 1
+        before_sp = eff[k] if k >= 0 else None
+        if l == 'WJ' or r == 'WJ':
+            return ('×', '11.0')
+        if l == 'GL':
+            return ('×', '12.0')
+        if r == 'GL' and l not in ('SP', 'BA', 'HY'):
+            return ('×', '12.1')
+        if r in ('CL', 'EX', 'IS', 'SY') + CP:
+            return ('×', '13.0')
+        if before_sp in OP:
+            return ('×', '14.0')
+        if before_sp == 'QU' and r in OP:
+            return ('×', '15.0')
+        if before_sp in ('CL',) + CP and r == 'NS':
+            return ('×', '16.0')
+        if before_sp == 'B2' and r == 'B2':
+            return ('×', '17.0')
+        if l == 'SP':
+            return ('÷', '18.0')
+        if l == 'QU' or r == 'QU':
+            return ('×', '19.0')
+        if l == 'CB' or r == 'CB':
+            return ('÷', '20.0')
+        if r in ('BA', 'HY', 'NS') or l == 'BB':
+            return ('×', '21.0')
+        if l in ('HY', 'BA'):
+            k = i - 1
+            while absorbed[k]:
+                k -= 1
+            if k > 0 and eff[k - 1] == 'HL':
+                return ('×', '21.1')
+        if l == 'SY' and r == 'HL':
+            return ('×', '21.2')
+        if r == 'IN':
+            return ('×', '22.0')
+        if (l in AL_HL and r == 'NU') or (l == 'NU' and r in AL_HL):
+            return ('×', '23.0')
+        if (l == 'PR' and r in ID) or (l in ID and r == 'PO'):
+            return ('×', '23.1')
+        if (l in ('PR', 'PO') and r in AL_HL) or (l in AL_HL and r in ('PR', 'PO')):
+            return ('×', '24.0')
+        if (base(l), base(r)) in LB25:
+            return ('×', '25.0')
+        if (l == 'JL' and r in ('JL', 'JV', 'H2', 'H3')) or \
+                (l in ('JV', 'H2') and r in ('JV', 'JT')) or (l in ('JT', 'H3') and r == 'JT'):
+            return ('×', '26.0')
+        if (l in JAMO and r == 'PO') or (l == 'PR' and r in JAMO):
+            return ('×', '27.0')
+        if l in AL_HL and r in AL_HL:
+            return ('×', '28.0')
+        if l == 'IS' and r in AL_HL:
+            return ('×', '29.0')
+        if (l in AL_HL + ('NU',) and r == 'OP') or (l == 'CP' and r in AL_HL + ('NU',)):
+            return ('×', '30.0')
+        if l == 'RI' and r == 'RI':
+            k = i - 1
+            n_ri = 0
+            while k >= 0 and (absorbed[k] or eff[k] == 'RI'):
+                n_ri += not absorbed[k]
+                k -= 1
+            if n_ri % 2 == 1:
+                return ('×', '30.1')
+        if l in ('EB', 'EPU') and r == 'EM':
+            return ('×', '30.2')
+        return ('÷', '999.0')
+
+    return [rule(i) for i in range(1, len(cls))]
+
+def char_name(cp):
+    name = unicodedata.name(chr(cp), None)
+    return name or '<U+%04X>' % cp
+
+def gen_test(cps, data):
+    cls = [resolve(cp, data) for cp in cps]
+    breaks = find_breaks(cls)
+    test = '× %04X' % cps[0]
+    comment = '× [0.3] %s (%s)' % (char_name(cps[0]), data[0][cps[0]])
+    for (cp, (bk, rule)) in zip(cps[1:], breaks):
+        bk = '÷' if bk == '!' else bk
+        test += ' %s %04X' % (bk, cp)
+        comment += ' %s [%s] %s (%s)' % (bk, rule, char_name(cp), data[0][cp])
+    print('%s ÷\t#  %s ÷ [0.3]' % (test, comment))
+
+# A code point of each class, as in the UCD's tests, then the subsets of
+# classes which some rules single out, and an iteration mark, which is NS
+# but has a class of its own in the state machines.
+samples = [0x0023, 0x2014, 0x0009, 0x00B4, 0x000B, 0xFFFC, 0x007D, 0x0029,
+    0x000D, 0x0021, 0x00A0, 0xAC00, 0xAC01, 0x05D0, 0x002D, 0x231A, 0x2024,
+    0x002C, 0x1100, 0x11A8, 0x1160, 0x000A, 0x0085, 0x17D6, 0x0030, 0x0028,
+    0x0025, 0x0024, 0x0022, 0x0020, 0x002F, 0x2060, 0x200B, 0x1F1E6, 0x261D,
+    0x1F3FB, 0x0001, 0x200D, 0x00A7, 0x50005, 0x0E01, 0x3041,
+    0x3008, 0x1F02C, 0x3005]
+
+# Each pair of samples is tested alone, and with a space, a combining mark
+# (U+0308) and ZWJ between them, as with LB9 and LB10 the state after each
+# of these depends on the code point before it.
+between = [[], [0x20], [0x308], [0x308, 0x20], [0x200D], [0x200D, 0x308]]
+
+# Longer tests, of text and of the rules with more context.
+extra = [
+    'The quick (“brown”) fox can’t jump 32.3 feet, right?',
+    'a­-b $-1,234.56% (12)% [$3]',
+    'や、⁈(?!)の た ‽と',
+    'ァベット々っ。「れ」は',
+    'x「y」z a（b）c a(b)c 1(2)3',
+    'a․․․ 1… …… あ…',
+    '\U0001F469‍\U0001F52C\U0001F468\U0001F3FD‍\U0001F9B0☝\U0001F3FB',
+    'a‍̈b ‍あ 1‍(2) §‍̈、',
+    '\U0001F1F7\U0001F1FA\U0001F1F8‍\U0001F1EA\U0001F1F8̈\U0001F1EA',
+    '\U0001F02C\U0001F3FB\U0001F02B\U0001F3FB\U0001FAF8\U0001F3FB',
+    'א-ב ג‐ד /ה',
+    'กิน แมว ក្រ',
+    '봤어. A.2 볼 각!',
+    'a —— b— —c ⁠d',
+    'x) 、y} ・z ”» «“(『',
+]
+
+def main():
+    data = load_data(sys.argv[1])
+    print('# Line breaking tests for Unicode %s, in the format of LineBreakTest.txt' % UCD_VERSION)
+    print('# Generated by tools/mk_lb_test.py from the rules of UAX #14.')
+    print('#')
+    print('# Format:')
+    print('# <string> (# <comment>)?')
+    print('#  <string> contains hex Unicode code points, with')
+    print('#\t÷ wherever there is a break opportunity, and')
+    print('#\t× wherever there is not.')
+    print('#  <comment> shows the name and Line_Break property value of each')
+    print('#  code point, and the number of the rule of UAX #14 which decides')
+    print('#  whether there is a break before it. 0.3 is the start or end of')
+    print('#  the text, and 999.0 is LB31.')
+    print('#')
+    print('# Unlike LineBreakTest.txt, LB25 is not tailored.')
+    print('#')
+    n = 0
+    for a in samples:
+        for b in samples:
+            for mid in between:
+                gen_test([a] + mid + [b], data)
+                n += 1
+    for s in extra:
+        gen_test([ord(c) for c in s], data)
+        n += 1
+    print('#')
+    print('# Lines: %d' % n)
+    print('#')
+    print('# EOF')
+
+main()
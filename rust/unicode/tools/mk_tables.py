@@ -1,4 +1,4 @@
-#!/usr/bin/env python
+#!/usr/bin/env python3
 # Copyright 2016 The xi-editor Authors.
 #
 # Licensed under the Apache License, Version 2.0 (the "License");
@@ -16,17 +16,44 @@
 # Utility for distilling Unicode data into properties which can be
 # efficiently queried.
 
-# Usage: python tools/mk_tables.py datadir > src/tables.rs
-# datadir should point to Unicode data, including LineBreak.txt
+# Usage: python3 tools/mk_tables.py datadir > src/tables.rs
+# datadir should point to the Unicode Character Database of UCD_VERSION, as
+# unpacked from https://www.unicode.org/Public/<UCD_VERSION>/ucd/UCD.zip. It
+# includes LineBreak.txt, EastAsianWidth.txt, UnicodeData.txt,
+# emoji/emoji-data.txt, and auxiliary/GraphemeBreakProperty.txt and
+# auxiliary/WordBreakProperty.txt; these may also be directly in datadir.
 
 import os
+import re
 import sys
 import random
 
+# The version of the UCD that all of the inputs must come from, so that the
+# tables agree with each other.
+UCD_VERSION = '15.0.0'
+
+def open_ucd(datadir, fn):
+    for subdir in ('', 'auxiliary', 'emoji'):
+        path = os.path.join(datadir, subdir, fn)
+        if os.path.exists(path):
+            return open(path)
+    sys.exit('%s not found in %s' % (fn, datadir))
+
+def check_version(fn, version):
+    # emoji-data.txt gives only the major and minor version.
+    if version is None or not (UCD_VERSION + '.').startswith(version + '.'):
+        sys.exit('%s is from Unicode %s, not %s' % (fn, version, UCD_VERSION))
+
 linebreak_assignments = ['XX', 'AI', 'AL', 'B2', 'BA', 'BB', 'BK', 'CB', 'CL',
 'CM', 'CR', 'EX', 'GL', 'HY', 'ID', 'IN', 'IS', 'LF', 'NS', 'NU', 'OP', 'PO',
 'PR', 'QU', 'SA', 'SG', 'SP', 'SY', 'ZW', 'NL', 'WJ', 'H2', 'H3', 'JL', 'JT',
-'JV', 'CP', 'CJ', 'HL', 'RI', 'EB', 'EM', 'ZWJ']
+'JV', 'CP', 'CJ', 'HL', 'RI', 'EB', 'EM', 'ZWJ', 'IM', 'OPW', 'EPU']
+
+# The last three are not UAX #14 classes, but are split out of others for
+# the state machines; see mk_numeric_lb. IM is split out from NS for the
+# iteration marks, which ICU breaks before with lb=loose (but not before
+# other NS).
+iteration_marks = [0x3005, 0x303B, 0x309D, 0x309E, 0x30FD, 0x30FE]
 
 inv_lb_assigments = dict((val, i) for (i, val) in enumerate(linebreak_assignments))
 
@@ -35,24 +62,26 @@ def gen_data(data, width=80):
     for val in data:
         new = '%d,' % val
         if len(line) + 1 + len(new) > width :
-            print line
+            print(line)
             line = ''
         prefix = ' ' if line else '    '
         line += prefix + new
-    print line
-
-def gen_table(name, t, data, width=80):
-    print
-    print '#[rustfmt::skip]'
-    print 'pub const %s: [%s; %d] = [' % (name, t, len(data))
+    print(line)
+
+def gen_table(name, t, data, width=80, cfg=None):
+    print()
+    if cfg:
+        print(cfg)
+    print('#[rustfmt::skip]')
+    print('pub const %s: [%s; %d] = [' % (name, t, len(data)))
     gen_data(data)
-    print '];'
+    print('];')
 
 def compute_trie(rawdata, chunksize):
     root = []
     childmap = {}
     child_data = []
-    for i in range(len(rawdata) / chunksize):
+    for i in range(len(rawdata) // chunksize):
         data = rawdata[i * chunksize: (i + 1) * chunksize]
         child = '|'.join(map(str, data))
         if child not in childmap:
@@ -66,18 +95,32 @@ def compute_trie2(rawdata, midsize, leafsize):
     (root, midnodes) = compute_trie(mid, midsize)
     return (root, midnodes, leaves)
 
+def file_version(line):
+    # The version in the first line of most UCD files, as in
+    # "# LineBreak-15.0.0.txt".
+    m = re.match(r'# \S+-(\d+\.\d+\.\d+)\.txt', line)
+    return m and m.group(1)
+
 def load_unicode_props(datadir, fn):
-    f = open(os.path.join(datadir, fn))
+    f = open_ucd(datadir, fn)
 
     lb = ['XX'] * 0x110000;
     did_notice = False
+    version = None
 
     for line in f:
         if line.startswith('#'):
             if not did_notice:
+                version = file_version(line)
                 orig = line.split('#', 1)[1].strip()
-                print "// This file autogenerated from %s by mk_tables.py" % orig
+                print("// This file autogenerated from %s by mk_tables.py" % orig)
                 did_notice = True
+            # Since Unicode 14, the defaults for unlisted code points, such as
+            # ID for unassigned CJK, are given as "# @missing: lo..hi; val".
+            m = re.match(r'# @missing: ([0-9A-F]+)\.\.([0-9A-F]+); *(\w+)', line)
+            if m:
+                for cp in range(int(m.group(1), 16), int(m.group(2), 16) + 1):
+                    lb[cp] = m.group(3)
         s = line.split(' ')[0].split(';')
         if len(s) == 2:
             t = s[0].split('..')
@@ -85,27 +128,187 @@ def load_unicode_props(datadir, fn):
             hi = int(t[-1], 16) + 1
             for cp in range(lo, hi):
                 lb[cp] = s[1]
-
-    numeric_lb = [inv_lb_assigments[lb[cp]] for cp in range(0x110000)]
-    return numeric_lb
-
-def mk_linebreak_props(datadir):
-    numeric_lb = load_unicode_props(datadir, 'LineBreak.txt')
-
-    # generate table for 1 and 2 byte utf-8, direct lookup
-    gen_table('LINEBREAK_1_2', 'u8', numeric_lb[0:0x800])
-
-    (root3, child3) = compute_trie(numeric_lb[0x800:0x10000], 0x40)
-    gen_table('LINEBREAK_3_ROOT', 'u8', [255] * 32 + root3);
-    gen_table('LINEBREAK_3_CHILD', 'u8', child3);
-
-    (root4, mid4, leaves4) = compute_trie2(numeric_lb[0x10000:], 0x40, 0x40)
-    gen_table('LINEBREAK_4_ROOT', 'u8', [255] * 16 + root4);
-    gen_table('LINEBREAK_4_MID', 'u8', mid4);
-    gen_table('LINEBREAK_4_LEAVES', 'u8', leaves4);
+    check_version(fn, version)
+    return lb
+
+def mk_numeric_lb(lb, eaw, gc, emoji):
+    # The classes of the state machines. As well as IM, OPW is split out
+    # from OP for those which are East Asian wide, as LB30 doesn't apply to
+    # them, and EPU from ID for the unassigned Extended_Pictographic code
+    # points, which LB30b keeps with a following EM.
+    lb = lb[:]
+    for cp in iteration_marks:
+        assert lb[cp] == 'NS'
+        lb[cp] = 'IM'
+    for cp in range(0x110000):
+        if eaw[cp] in ('F', 'W', 'H'):
+            if lb[cp] == 'OP':
+                lb[cp] = 'OPW'
+            # LB30 excludes wide CP too, but there are none.
+            assert lb[cp] != 'CP'
+    for cp in emoji['Extended_Pictographic']:
+        if gc[cp] == 'Cn':
+            assert lb[cp] == 'ID'
+            lb[cp] = 'EPU'
+    return [inv_lb_assigments[lb[cp]] for cp in range(0x110000)]
+
+def load_emoji_props(datadir, fn):
+    f = open_ucd(datadir, fn)
+
+    props = {}
+    version = None
+    for line in f:
+        # Older files have "# Version: 11.0", and those in the UCD "# Used
+        # with Emoji Version 15.0 and subsequent minor revisions".
+        m = re.match(r'# (?:Version:|Used with Emoji Version) (\d+\.\d+)', line)
+        if m and version is None:
+            version = m.group(1)
+            print("// and from emoji-data.txt, version %s" % version)
+        s = line.split('#', 1)[0].split(';')
+        if len(s) == 2:
+            t = s[0].strip().split('..')
+            lo = int(t[0], 16)
+            hi = int(t[-1], 16) + 1
+            props.setdefault(s[1].strip(), set()).update(range(lo, hi))
+    check_version(fn, version)
+    return props
+
+# Bits of a packed property value; the low bits hold the line breaking class.
+LINEBREAK_MASK = 0x3f
+EMOJI_FLAG = 0x40
+EMOJI_MODIFIER_BASE_FLAG = 0x80
+
+# log2 of the leaf size of the flat layout
+FLAT_SHIFT = 7
+
+def gen_const(name, t, val):
+    print('pub const %s: %s = 0x%x;' % (name, t, val))
+
+def mk_props(numeric_lb, emoji):
+    props = numeric_lb[:]
+    for cp in emoji['Emoji']:
+        props[cp] |= EMOJI_FLAG
+    for cp in emoji['Emoji_Modifier_Base']:
+        props[cp] |= EMOJI_MODIFIER_BASE_FLAG
+
+    print()
+    gen_const('LINEBREAK_MASK', 'u8', LINEBREAK_MASK)
+    gen_const('EMOJI_FLAG', 'u8', EMOJI_FLAG)
+    gen_const('EMOJI_MODIFIER_BASE_FLAG', 'u8', EMOJI_MODIFIER_BASE_FLAG)
+
+    # generate table for 1 and 2 byte utf-8, direct lookup; shared by
+    # both layouts
+    gen_table('PROPS_1_2', 'u8', props[0:0x800])
+
+    # The default layout is a trie indexed by utf-8 bytes, so that lookups
+    # from a string need not decode the codepoint.
+    cfg = '#[cfg(not(feature = "flat_tables"))]'
+    (root3, child3) = compute_trie(props[0x800:0x10000], 0x40)
+    gen_table('PROPS_3_ROOT', 'u8', [255] * 32 + root3, cfg=cfg)
+    gen_table('PROPS_3_CHILD', 'u8', child3, cfg=cfg)
+
+    (root4, mid4, leaves4) = compute_trie2(props[0x10000:], 0x40, 0x40)
+    gen_table('PROPS_4_ROOT', 'u8', [255] * 16 + root4, cfg=cfg)
+    gen_table('PROPS_4_MID', 'u8', mid4, cfg=cfg)
+    gen_table('PROPS_4_LEAVES', 'u8', leaves4, cfg=cfg)
+
+    # The alternative is a single level trie indexed by codepoint, trading
+    # size for one fewer dependent load on astral codepoints.
+    cfg = '#[cfg(feature = "flat_tables")]'
+    (root, leaves) = compute_trie(props, 1 << FLAT_SHIFT)
+    assert len(leaves) >> FLAT_SHIFT <= 256
+    print()
+    print(cfg)
+    print('pub const PROPS_FLAT_SHIFT: usize = %d;' % FLAT_SHIFT)
+    gen_table('PROPS_FLAT_ROOT', 'u8', root, cfg=cfg)
+    gen_table('PROPS_FLAT_LEAVES', 'u8', leaves, cfg=cfg)
+
+def load_general_category(datadir):
+    # UnicodeData.txt has no version of its own, so this relies on it
+    # coming from the same directory as the others.
+    f = open_ucd(datadir, 'UnicodeData.txt')
+    gc = ['Cn'] * 0x110000
+    first = None
+    for line in f:
+        s = line.split(';')
+        cp = int(s[0], 16)
+        if s[1].endswith(', First>'):
+            first = cp
+            continue
+        lo = cp
+        if s[1].endswith(', Last>'):
+            lo = first
+        for c in range(lo, cp + 1):
+            gc[c] = s[2]
+    return gc
+
+def load_east_asian_width(datadir):
+    f = open_ucd(datadir, 'EastAsianWidth.txt')
+    eaw = ['N'] * 0x110000
+    version = None
+    # Unassigned code points in these ranges default to W.
+    for (lo, hi) in ((0x3400, 0x4DBF), (0x4E00, 0x9FFF), (0xF900, 0xFAFF),
+            (0x20000, 0x2FFFD), (0x30000, 0x3FFFD)):
+        for cp in range(lo, hi + 1):
+            eaw[cp] = 'W'
+    for line in f:
+        if line.startswith('#'):
+            if line.startswith('# EastAsianWidth'):
+                version = file_version(line)
+                print("// and from %s" % line.split('#', 1)[1].strip())
+            continue
+        s = line.split('#', 1)[0].split(';')
+        if len(s) == 2:
+            t = s[0].strip().split('..')
+            for cp in range(int(t[0], 16), int(t[-1], 16) + 1):
+                eaw[cp] = s[1].strip()
+    check_version('EastAsianWidth.txt', version)
+    return eaw
+
+# Values of the monospace width table, in columns, except for
+# MONO_WIDTH_CONTEXT.
+MONO_WIDTH_CONTEXT = 3
+
+# Code points whose width depends on context: tabs and other controls, and
+# those that combine into emoji clusters.
+mono_width_context = [(0x200D, 0x200D), (0x20E3, 0x20E3), (0xFE0E, 0xFE0F),
+    (0x1F1E6, 0x1F1FF), (0x1F3FB, 0x1F3FF), (0xE0020, 0xE007F)]
+
+def mk_mono_width(eaw, gc):
+    widths = []
+    for cp in range(0x110000):
+        if gc[cp] in ('Mn', 'Me', 'Cf') and cp != 0xAD:
+            w = 0
+        elif cp in (0x0A, 0x0D) or 0x1160 <= cp <= 0x11FF or 0xD7B0 <= cp <= 0xD7FF:
+            # newlines, and Hangul medial vowels and final consonants
+            w = 0
+        elif gc[cp] == 'Cc':
+            w = MONO_WIDTH_CONTEXT
+        elif eaw[cp] in ('W', 'F'):
+            w = 2
+        else:
+            w = 1
+        widths.append(w)
+    for (lo, hi) in mono_width_context:
+        for cp in range(lo, hi + 1):
+            widths[cp] = MONO_WIDTH_CONTEXT
+
+    # Pack four 2-bit widths per byte, low bits first, then build a
+    # three level trie indexed by cp >> 12, (cp >> 7) & 0x1f and
+    # (cp >> 2) & 0x1f.
+    packed = []
+    for cp in range(0, 0x110000, 4):
+        packed.append(sum(widths[cp + i] << (2 * i) for i in range(4)))
+    (root, mid, leaves) = compute_trie2(packed, 0x20, 0x20)
+    assert len(mid) // 0x20 <= 256 and len(leaves) // 0x20 <= 256
+    print()
+    gen_const('MONO_WIDTH_CONTEXT', 'u8', MONO_WIDTH_CONTEXT)
+    gen_table('MONO_WIDTH_ROOT', 'u8', root)
+    gen_table('MONO_WIDTH_MID', 'u8', mid)
+    gen_table('MONO_WIDTH_LEAVES', 'u8', leaves)
 
 def mk_tables(datadir):
-    print """// Copyright 2016 The xi-editor Authors.
+    print("""// Copyright 2016 The xi-editor Authors.
 //
 // Licensed under the Apache License, Version 2.0 (the "License");
 // you may not use this file except in compliance with the License.
@@ -119,13 +322,21 @@ def mk_tables(datadir):
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-//! Raw trie data for linebreak property lookup.
-"""
-    mk_linebreak_props(datadir)
-    mk_lb_rules()
+//! Raw trie data for linebreak, emoji, monospace width, grapheme cluster
+//! and word break property lookup, and the break state machines.
+""")
+    lb = load_unicode_props(datadir, 'LineBreak.txt')
+    emoji = load_emoji_props(datadir, 'emoji-data.txt')
+    eaw = load_east_asian_width(datadir)
+    gc = load_general_category(datadir)
+    mk_props(mk_numeric_lb(lb, eaw, gc, emoji), emoji)
+    mk_mono_width(eaw, gc)
+    mk_lb_tables()
+    mk_segment_tables(datadir, emoji)
 
 def mk_tests(datadir, do_str = False):
-    numeric_lb = load_unicode_props(datadir, 'LineBreak.txt')
+    lb = load_unicode_props(datadir, 'LineBreak.txt')
+    numeric_lb = [inv_lb_assigments[lb[cp]] for cp in range(0x110000)]
     ranges = (range(0x80), range(0x80, 0x800), range(0x800, 0x10000), range(0x10000, 0x110000))
     for r in ranges:
         for cp in sorted(random.sample(r, 32)):
@@ -140,9 +351,9 @@ def mk_tests(datadir, do_str = False):
                     cplen = 3
                 else:
                     cplen = 4
-                print '        assert_eq!((%d, %d), linebreak_property_str(&"\\u{%04X}", 0));' % (lb_prop, cplen, cp)
+                print('        assert_eq!((%d, %d), linebreak_property_str(&"\\u{%04X}", 0));' % (lb_prop, cplen, cp))
             else:
-                print '        assert_eq!(%2d, linebreak_property(\'\\u{%04X}\'));' % (lb_prop, cp)
+                print('        assert_eq!(%2d, linebreak_property(\'\\u{%04X}\'));' % (lb_prop, cp))
 
 def update(table, left, right, new):
     if type(left) == str: left = [left]
@@ -156,7 +367,7 @@ def update_both(table1, table2, left, right, new):
     update(table1, left, right, new)
     update(table2, left, right, new)
 
-def resolve_ambig(orig):
+def resolve_ambig(orig, strictness):
     # LB1
     if orig in ('AI', 'SG', 'XX'):
         return 'AL'
@@ -164,12 +375,21 @@ def resolve_ambig(orig):
         # TODO: need to incorporate this into property lookup
         return 'AL'
     elif orig == 'CJ':
-        return 'NS'
+        # As in ICU, CJ is resolved to NS unless tailored with lb=normal or
+        # lb=loose.
+        return 'NS' if strictness == 'strict' else 'ID'
+    elif orig == 'IM':
+        return 'IM' if strictness == 'loose' else 'NS'
     else:
         return orig
 
-def mk_lb_rules():
-    # Rules derived from UAX #14
+# The tailorings of ICU's line break rules selected by the "lb" locale
+# keyword, and the suffix of the name of each one's state machine.
+strictnesses = [('strict', ''), ('normal', '_NORMAL'), ('loose', '_LOOSE')]
+
+def mk_lb_rules(strictness):
+    # Rules derived from UAX #14, tailored to `strictness` as ICU does.
+    # Returns the state machine.
 
     t = {}
     ts = {}  # transitions for when there is one or more SP
@@ -198,8 +418,7 @@ def mk_lb_rules():
     # LB8
     update_both(t, ts, 'ZW', Any, '_')
 
-    # LB8a
-    update(t, 'ZWJ', ['ID', 'EB', 'EM'], 'x')
+    # LB8a: handled by add_zwj_states
 
     # LB9: handled in state machine construction
     # LB10: handled in state machine construction
@@ -223,10 +442,10 @@ def mk_lb_rules():
     update_both(t, ts, Any, 'SY', 'x')
 
     # LB14
-    update_both(t, ts, 'OP', Any, 'x')
+    update_both(t, ts, ['OP', 'OPW'], Any, 'x')
 
     # LB15
-    update_both(t, ts, 'QU', 'OP', 'x')
+    update_both(t, ts, 'QU', ['OP', 'OPW'], 'x')
 
     # LB16
     update_both(t, ts, ['CL', 'CP'], 'NS', 'x')
@@ -259,19 +478,15 @@ def mk_lb_rules():
     update(t, 'SY', 'HL', 'x')
 
     # LB22:
-    update(t, ['AL', 'HL'], 'IN', 'x')
-    update(t, 'EX', 'IN', 'x')
-    update(t, ['ID', 'EB', 'EM'], 'IN', 'x')
-    update(t, 'IN', 'IN', 'x')
-    update(t, 'NU', 'IN', 'x')
+    update(t, Any, 'IN', 'x')
 
     # LB23:
     update(t, ['AL', 'HL'], 'NU', 'x')
     update(t, 'NU', ['AL', 'HL'], 'x')
 
     # LB23a:
-    update(t, 'PR', ['ID', 'EB', 'EM'], 'x')
-    update(t, ['ID', 'EB', 'EM'], 'PO', 'x')
+    update(t, 'PR', ['ID', 'EB', 'EM', 'EPU'], 'x')
+    update(t, ['ID', 'EB', 'EM', 'EPU'], 'PO', 'x')
 
     # LB24:
     update(t, 'PR', ['AL', 'HL'], 'x')
@@ -282,13 +497,13 @@ def mk_lb_rules():
     # LB25:
     update(t, 'CL', 'PO', 'x')
     update(t, 'CP', 'PO', 'x')
-    update(t, 'CL', 'PP', 'x')
+    update(t, 'CL', 'PR', 'x')
     update(t, 'CP', 'PR', 'x')
     update(t, 'NU', 'PO', 'x')
     update(t, 'NU', 'PR', 'x')
-    update(t, 'PO', 'OP', 'x')
+    update(t, 'PO', ['OP', 'OPW'], 'x')
     update(t, 'PO', 'NU', 'x')
-    update(t, 'PR', 'OP', 'x')
+    update(t, 'PR', ['OP', 'OPW'], 'x')
     update(t, 'PR', 'NU', 'x')
     update(t, 'HY', 'NU', 'x')
     update(t, 'IS', 'NU', 'x')
@@ -311,7 +526,7 @@ def mk_lb_rules():
     # LB29:
     update(t, 'IS', ['AL', 'HL'], 'x')
 
-    # LB30:
+    # LB30: not OPW, which is the OP this excludes
     update(t, ['AL', 'HL', 'NU'], 'OP', 'x')
     update(t, 'CP', ['AL', 'HL', 'NU'], 'x')
 
@@ -321,19 +536,20 @@ def mk_lb_rules():
     update(t, 'RI+RI', Any, '_')
 
     # LB30b:
-    update(t, 'EB', 'EM', 'x')
+    update(t, ['EB', 'EPU'], 'EM', 'x')
 
     # LB31:
     update_both(t, ts, Any, Any, '_')
 
     # state machine construction
-    # states [0..43) correspond to LB class of previous ch
-    # state 43 is 'HL+HY'
-    # state 44 is 'HL+BA'
-    # state 45 is 'RI+RI'
-    # states [46..89) correspond to LB class (SP+)
+    # states [0..46) correspond to LB class of previous ch
+    # state 46 is 'HL+HY'
+    # state 47 is 'HL+BA'
+    # state 48 is 'RI+RI'
+    # states [49..95) correspond to LB class (SP+)
+    # add_zwj_states adds more, for after ZWJ
     # result is new state on bottom (LB of right ch), + 0x80 if break + 0x40 if hard
-    # (note that only states 0..43 need be represented if break)
+    # (note that only states 0..46 need be represented if break)
     n = len(linebreak_assignments)
     nspecial = 3
     nstates = n * 2 + nspecial
@@ -345,18 +561,20 @@ def mk_lb_rules():
         L = Any[left]
         if L == 'CM':
             L = 'AL'  # handling for LB10
-        L = resolve_ambig(L)
+        L = resolve_ambig(L, strictness)
         for right in range(n):
             R = linebreak_assignments[right]
-            R = resolve_ambig(R)
+            R = resolve_ambig(R, strictness)
             r_with_cm = right
             l_with_cm = left
             if R in ['CM', 'ZWJ'] and L in ['BK', 'CR', 'LF', 'NL', 'SP', 'ZW']:
-                # handling for LB10
-                r_with_cm = 2  # AL
+                # handling for LB10; the state after ZWJ is replaced by
+                # add_zwj_states
+                if R == 'CM':
+                    r_with_cm = 2  # AL
                 bk = t[L + '|' + 'AL']
-            elif L == 'ZWJ' and R not in ['ID', 'EB', 'EM']:
-                #handling for LB10
+            elif L == 'ZWJ':
+                # handling for LB10, as above
                 l_with_cm = 2  # AL
                 bk = t['AL' + '|' + R]
             else:
@@ -381,7 +599,7 @@ def mk_lb_rules():
                 state = n + 2
             else:
                 state = flags + r_with_cm
-            #print '//', L, R, bk, state
+            #print('//', L, R, bk, state)
             sm[left][right] = state
 
             if left < n:
@@ -389,27 +607,463 @@ def mk_lb_rules():
                 bk = ts[L + '|' + R]
                 flags = bk_to_flags[bk]
                 sm[left + n + nspecial][right] = flags + r_with_cm
+    return sm
+
+def lb_state_name(state):
+    n = len(linebreak_assignments)
+    nspecial = 3
+    Any = linebreak_assignments + ['HL+HY', 'HL+BA', 'RI+RI']
+    if state < n + nspecial:
+        return Any[state]
+    else:
+        return 'SP+ ' + Any[state - (n + nspecial)]
+
+def gen_state_machine(name, sm, state_names=None, cfg=None):
+    n = len(linebreak_assignments)
+    nstates = len(sm)
     nunique = len(set(str(line) for line in sm))
-    print '//', nunique, 'unique states'
-    print 'pub const N_LINEBREAK_CATEGORIES: usize = %d;' % n
-    print
-    print '#[rustfmt::skip]'
-    print 'pub const LINEBREAK_STATE_MACHINE: [u8; %d] = [' % (nstates * n)
+    print('//', nunique, 'unique states')
+    if cfg:
+        print(cfg)
+    print('#[rustfmt::skip]')
+    print('pub const %s: [u8; %d] = [' % (name, nstates * n))
     # TODO: dedup
     for state in range(nstates):
-        if state < n + nspecial:
-            statename = Any[state]
+        if state_names:
+            statename = state_names[state]
         else:
-            statename = 'SP+ ' + Any[state - (n + nspecial)]
-        print '    // state %d: %s' % (state, statename)
+            statename = lb_state_name(state)
+        print('    // state %d: %s' % (state, statename))
         gen_data(sm[state])
-    print '];'
+    print('];')
+
+def mk_resume_states(sm, class_state=None):
+    n = len(linebreak_assignments)
+    class_state = class_state or list(range(n))
+    resume = [None] * n
+    for state in range(len(sm)):
+        for right in range(n):
+            new = sm[state][right]
+            if new & 0x80:
+                if resume[right] is None:
+                    resume[right] = new & 0x3f
+                elif resume[right] != new & 0x3f:
+                    resume[right] = 0xff
+    return [class_state[right] if r is None else r for (right, r) in enumerate(resume)]
+
+# The classes whose states are the most common in text, in roughly
+# decreasing order: ASCII letters, digits, spaces and punctuation, then
+# ideographs and combining marks.
+lb_hot_classes = ['AL', 'NU', 'SP', 'BA', 'IS', 'CL', 'HY', 'OP', 'QU', 'EX',
+'SY', 'LF', 'ID', 'CM', 'PO', 'PR']
+
+def lb_target(new):
+    return new & 0x3f if new & 0x80 else new
+
+def lb_flags(new):
+    return new & 0xc0 if new & 0x80 else 0
+
+def partition_lb_states(machines):
+    # Moore's partition refinement, jointly over the tailorings so that they
+    # keep sharing state numbers. Two states are equivalent if every class
+    # takes them to equivalent states, with the same break flags.
+    n = len(linebreak_assignments)
+    nstates = len(machines[0])
+    part = [0] * nstates
+    nblocks = 1
+    while True:
+        keys = {}
+        new_part = []
+        for state in range(nstates):
+            key = (part[state],) + tuple((lb_flags(sm[state][c]), part[lb_target(sm[state][c])])
+                for sm in machines for c in range(n))
+            new_part.append(keys.setdefault(key, len(keys)))
+        part = new_part
+        if len(keys) == nblocks:
+            return part
+        nblocks = len(keys)
+
+def add_zwj_states(machines, names):
+    # LB8a: there is no break after ZWJ. As LB9 treats X ZWJ as X, the state
+    # after it is X's, except that the next code point never breaks, so a
+    # state is added for each X which ZWJ follows. Equivalent states share
+    # one. The ZWJ state itself, for a ZWJ which LB10 treats as AL, becomes
+    # the one for AL.
+    zwj = inv_lb_assigments['ZWJ']
+    cm = inv_lb_assigments['CM']
+    al = inv_lb_assigments['AL']
+    nstates = len(machines[0])
+    part = partition_lb_states(machines)
+    zwj_state = {part[al]: zwj}
+    rep = {part[al]: al}
+    for state in range(nstates):
+        absorbs = machines[0][state][zwj] == state
+        assert all((sm[state][zwj] == state) == absorbs for sm in machines)
+        if state == zwj or not absorbs:
+            continue
+        if part[state] not in zwj_state:
+            zwj_state[part[state]] = len(names)
+            rep[part[state]] = state
+            names.append(names[state] + ' ZWJ')
+        for sm in machines:
+            sm[state][zwj] = zwj_state[part[state]]
+    names[zwj] = 'ZWJ, AL ZWJ'
+    for sm in machines:
+        sm.extend([None] * (len(names) - nstates))
+        for (block, new_state) in zwj_state.items():
+            row = [lb_target(new) for new in sm[rep[block]]]
+            # X ZWJ CM is X, and may break before the next code point.
+            row[cm] = rep[block]
+            sm[new_state] = row
+
+def minimize_lb_states(machines, state_names):
+    n = len(linebreak_assignments)
+    nstates = len(machines[0])
+    part = partition_lb_states(machines)
+
+    # Number the blocks of the hot states first, so that their rows share as
+    # few cache lines as possible, then the rest in their original order.
+    order = [inv_lb_assigments[c] for c in lb_hot_classes] + list(range(nstates))
+    number = {}
+    for state in order:
+        number.setdefault(part[state], len(number))
+    renumber = [number[part[state]] for state in range(nstates)]
+    # States after a break are numbered in 6 bits, and the rest in 7.
+    assert len(number) <= 0x80
+    assert all(renumber[lb_target(new)] < 0x40 for sm in machines for row in sm for new in row
+        if new & 0x80)
+
+    names = [[] for _ in number]
+    for state in range(nstates):
+        names[renumber[state]].append(state_names[state])
+    reps = [None] * len(number)
+    for state in reversed(range(nstates)):
+        reps[renumber[state]] = state
+    def remap(new):
+        return lb_flags(new) | renumber[lb_target(new)]
+    compact = [[[remap(new) for new in sm[state]] for state in reps] for sm in machines]
+    return (renumber, [', '.join(ns) for ns in names], compact)
+
+def mk_lb_tables():
+    n = len(linebreak_assignments)
+    machines = [mk_lb_rules(strictness) for (strictness, _) in strictnesses]
+    state_names = [lb_state_name(state) for state in range(len(machines[0]))]
+    add_zwj_states(machines, state_names)
+    assert len(state_names) <= 0x80
+    (renumber, names, compact) = minimize_lb_states(machines, state_names)
+    # The state machines are generated in two layouts. In the default one,
+    # the states are numbered as in mk_lb_rules, so the state after a code
+    # point that doesn't depend on the ones before it is its class. The
+    # compact one merges equivalent states and renumbers them, hot states
+    # first, so the state after such a code point is LINEBREAK_CLASS_STATE.
+    cfg = '#[cfg(not(feature = "compact_lb_tables"))]'
+    compact_cfg = '#[cfg(feature = "compact_lb_tables")]'
+    print()
+    print('pub const N_LINEBREAK_CATEGORIES: usize = %d;' % n)
+    print(cfg)
+    print('pub const N_LINEBREAK_STATES: usize = %d;' % len(machines[0]))
+    print(compact_cfg)
+    print('pub const N_LINEBREAK_STATES: usize = %d;' % len(compact[0]))
+    for ((strictness, suffix), sm) in zip(strictnesses, machines):
+        print()
+        print('// The state machine for lb=%s' % strictness)
+        gen_state_machine('LINEBREAK_STATE_MACHINE' + suffix, sm, state_names, cfg=cfg)
+    for ((strictness, suffix), sm) in zip(strictnesses, compact):
+        print()
+        print('// The compact state machine for lb=%s' % strictness)
+        gen_state_machine('LINEBREAK_STATE_MACHINE' + suffix, sm, names, cfg=compact_cfg)
+    gen_table('LINEBREAK_CLASS_STATE', 'u8', renumber[:n], cfg=compact_cfg)
+
+    # The state following a break mostly depends only on the class of the
+    # code point after it, so an iterator can resume at a known break. Where
+    # it also depends on the state before the break (CM and ZWJ after spaces)
+    # the entry is 0xff. The tailorings share the states, and this table.
+    resume = mk_resume_states(machines[0])
+    assert all(mk_resume_states(sm) == resume for sm in machines)
+    gen_table('LINEBREAK_RESUME_STATE', 'u8', resume, cfg=cfg)
+    compact_resume = mk_resume_states(compact[0], renumber[:n])
+    assert all(mk_resume_states(sm, renumber[:n]) == compact_resume for sm in compact)
+    gen_table('LINEBREAK_RESUME_STATE', 'u8', compact_resume, cfg=compact_cfg)
+
+# UAX #29 segmentation: grapheme clusters and words. As for line breaking,
+# each is a class per code point, in a trie indexed by utf-8 bytes, and a
+# state machine over those classes.
+
+grapheme_assignments = ['Other', 'CR', 'LF', 'Control', 'Extend', 'ZWJ',
+'Regional_Indicator', 'Prepend', 'SpacingMark', 'L', 'V', 'T', 'LV', 'LVT',
+'Extended_Pictographic']
+
+# ALetter_ExtPict is for the few code points which are both ALetter and
+# Extended_Pictographic, such as U+24C2; Extended_Pictographic is otherwise
+# Other in both properties.
+word_assignments = ['Other', 'CR', 'LF', 'Newline', 'Extend', 'ZWJ',
+'Regional_Indicator', 'Format', 'Katakana', 'Hebrew_Letter', 'ALetter',
+'Single_Quote', 'Double_Quote', 'MidNumLet', 'MidLetter', 'MidNum', 'Numeric',
+'ExtendNumLet', 'WSegSpace', 'Extended_Pictographic', 'ALetter_ExtPict']
+
+# As in CLDR's root locale, and so ICU, colons don't join letters into words,
+# although their Word_Break is MidLetter.
+cldr_not_midletter = [0x3A, 0xFE55, 0xFF1A]
+
+def load_break_property(datadir, fn):
+    f = open_ucd(datadir, fn)
+    prop = ['Other'] * 0x110000
+    version = None
+    for line in f:
+        if line.startswith('#'):
+            if line.startswith('# ' + fn.split('.')[0]):
+                version = file_version(line)
+                print("// and from %s" % line.split('#', 1)[1].strip())
+            continue
+        s = line.split('#', 1)[0].split(';')
+        if len(s) == 2:
+            t = s[0].strip().split('..')
+            for cp in range(int(t[0], 16), int(t[-1], 16) + 1):
+                prop[cp] = s[1].strip()
+    check_version(fn, version)
+    return prop
+
+def gen_utf8_trie(prefix, data, cfg=None):
+    # A trie indexed by the bytes of the utf-8 encoding, as for PROPS.
+    gen_table(prefix + '_1_2', 'u8', data[0:0x800])
+    (root3, child3) = compute_trie(data[0x800:0x10000], 0x40)
+    assert len(child3) // 0x40 <= 256
+    gen_table(prefix + '_3_ROOT', 'u8', [255] * 32 + root3, cfg=cfg)
+    gen_table(prefix + '_3_CHILD', 'u8', child3, cfg=cfg)
+    (root4, mid4, leaves4) = compute_trie2(data[0x10000:], 0x40, 0x40)
+    assert len(mid4) // 0x40 <= 256 and len(leaves4) // 0x40 <= 256
+    gen_table(prefix + '_4_ROOT', 'u8', [255] * 16 + root4, cfg=cfg)
+    gen_table(prefix + '_4_MID', 'u8', mid4, cfg=cfg)
+    gen_table(prefix + '_4_LEAVES', 'u8', leaves4, cfg=cfg)
+
+def mk_seg_machine(classes, start, step):
+    # Finds the states reachable from `start`, where step(state, cls)
+    # returns the flags of the transition and the new state, and numbers
+    # them in that order. Returns the states and the table.
+    states = [start]
+    index = {start: 0}
+    table = []
+    i = 0
+    while i < len(states):
+        row = []
+        for cls in classes:
+            (flags, new) = step(states[i], cls)
+            if new not in index:
+                index[new] = len(states)
+                states.append(new)
+            row.append(flags | index[new])
+        table.append(row)
+        i += 1
+    return (states, table)
+
+# A grapheme state is the class of the previous code point; whether it ends
+# ExtPict Extend* ('ep') or ExtPict Extend* ZWJ ('ep_zwj'), for GB11; and
+# whether it is a regional indicator that starts a pair, for GB12 and GB13.
+def grapheme_step(state, c):
+    (prev, ep, ri_odd) = state
+    if prev == 'sot':
+        brk = False
+    elif prev == 'CR' and c == 'LF':
+        brk = False  # GB3
+    elif prev in ('Control', 'CR', 'LF'):
+        brk = True  # GB4
+    elif c in ('Control', 'CR', 'LF'):
+        brk = True  # GB5
+    elif prev == 'L' and c in ('L', 'V', 'LV', 'LVT'):
+        brk = False  # GB6
+    elif prev in ('LV', 'V') and c in ('V', 'T'):
+        brk = False  # GB7
+    elif prev in ('LVT', 'T') and c == 'T':
+        brk = False  # GB8
+    elif c in ('Extend', 'ZWJ'):
+        brk = False  # GB9
+    elif c == 'SpacingMark':
+        brk = False  # GB9a
+    elif prev == 'Prepend':
+        brk = False  # GB9b
+    elif ep == 'ep_zwj' and c == 'Extended_Pictographic':
+        brk = False  # GB11
+    elif ri_odd and c == 'Regional_Indicator':
+        brk = False  # GB12, GB13
+    else:
+        brk = True  # GB999
+    if c == 'Extended_Pictographic' or (c == 'Extend' and ep == 'ep'):
+        new_ep = 'ep'
+    elif c == 'ZWJ' and ep == 'ep':
+        new_ep = 'ep_zwj'
+    else:
+        new_ep = None
+    new_ri_odd = c == 'Regional_Indicator' and not ri_odd
+    return (0x80 if brk else 0, (c, new_ep, new_ri_odd))
+
+def grapheme_state_name(state):
+    (prev, ep, ri_odd) = state
+    return ' '.join([prev] + ([ep] if ep else []) + (['odd'] if ri_odd else []))
+
+# Masks of the flags of a word break transition. A transition into a
+# pending (lookahead) state marks the break before the code point, which a
+# later transition confirms or, by leaving the pending state without
+# confirming it, cancels.
+WORD_BREAK = 0x100
+WORD_CONFIRM = 0x200
+WORD_MARK = 0x400
+
+AHLetter = ('ALetter', 'Hebrew_Letter', 'ALetter_ExtPict')
+MidNumLetQ = ('MidNumLet', 'Single_Quote')
+
+# A word state is the class of the previous code point, ignoring Extend,
+# Format and ZWJ as in WB4 ('sot' at the start, when nothing is ignored,
+# and 'Other' after a code point that was its own word); 'zwj' or 'wseg' if
+# the code point just before is ZWJ or WSegSpace, for WB3c and WB3d; whether
+# it is a regional indicator that starts a pair; and for WB6, WB7b and
+# WB12, which look ahead, the class before a pending break (AHLetter,
+# Hebrew_Letter or Numeric), else None. HL SQ, which doesn't break by WB7a
+# but may continue by WB7, is pending too, with nothing marked.
+def word_step(state, c):
+    (prev, raw, ri_odd, pending) = state
+    if c == 'eot':
+        return (WORD_BREAK | (WORD_CONFIRM if pending and pending[1] else 0), state)
+    ignored = c in ('Extend', 'Format', 'ZWJ')
+    new_raw = {'ZWJ': 'zwj', 'WSegSpace': 'wseg'}.get(c)
+    if pending:
+        (before, marked) = pending
+        if ignored:
+            return (0, (prev, new_raw, ri_odd, pending))  # WB4
+        if before == 'Hebrew_Letter' and prev == 'Double_Quote':
+            done = c == 'Hebrew_Letter'  # WB7c
+        elif before in AHLetter:
+            done = c in AHLetter  # WB7
+        else:
+            done = c == 'Numeric'  # WB11
+        if done:
+            return (0, (word_prev(c), new_raw, False, None))
+        # The lookahead failed, so the marked break stands, and the code
+        # point is treated as following the mid.
+        (flags, new) = word_step((prev, raw, ri_odd, None), c)
+        return ((WORD_CONFIRM if marked else 0) | flags, new)
+    new_pending = None
+    if prev == 'sot':
+        brk = False
+    elif prev == 'CR' and c == 'LF':
+        brk = False  # WB3
+    elif prev in ('CR', 'LF', 'Newline') or c in ('CR', 'LF', 'Newline'):
+        brk = True  # WB3a, WB3b
+    elif raw == 'zwj' and c in ('Extended_Pictographic', 'ALetter_ExtPict'):
+        brk = False  # WB3c
+    elif raw == 'wseg' and c == 'WSegSpace':
+        brk = False  # WB3d
+    elif ignored:
+        # WB4
+        return (0, (prev, new_raw, ri_odd, None))
+    elif prev in AHLetter and c in AHLetter:
+        brk = False  # WB5
+    elif prev == 'Hebrew_Letter' and c == 'Single_Quote':
+        brk = False  # WB7a
+        new_pending = ('Hebrew_Letter', False)
+    elif prev in AHLetter and c in ('MidLetter',) + MidNumLetQ:
+        brk = False  # WB6, provisionally
+        new_pending = ('ALetter', True)
+    elif prev == 'Hebrew_Letter' and c == 'Double_Quote':
+        brk = False  # WB7b, provisionally
+        new_pending = ('Hebrew_Letter', True)
+    elif prev == 'Numeric' and c == 'Numeric':
+        brk = False  # WB8
+    elif prev in AHLetter and c == 'Numeric':
+        brk = False  # WB9
+    elif prev == 'Numeric' and c in AHLetter:
+        brk = False  # WB10
+    elif prev == 'Numeric' and c in ('MidNum',) + MidNumLetQ:
+        brk = False  # WB12, provisionally
+        new_pending = ('Numeric', True)
+    elif prev == 'Katakana' and c == 'Katakana':
+        brk = False  # WB13
+    elif prev in AHLetter + ('Numeric', 'Katakana', 'ExtendNumLet') and c == 'ExtendNumLet':
+        brk = False  # WB13a
+    elif prev == 'ExtendNumLet' and c in AHLetter + ('Numeric', 'Katakana'):
+        brk = False  # WB13b
+    elif ri_odd and c == 'Regional_Indicator':
+        brk = False  # WB15, WB16
+    else:
+        brk = True  # WB999
+    new_ri_odd = c == 'Regional_Indicator' and not (ri_odd and not brk)
+    if brk:
+        flags = WORD_BREAK
+    elif new_pending and new_pending[1]:
+        flags = WORD_MARK
+    else:
+        flags = 0
+    # At the start, or after a newline, Extend and friends are not ignored,
+    # but are words of their own.
+    new_prev = 'Other' if ignored else word_prev(c)
+    return (flags, (new_prev, new_raw, new_ri_odd, new_pending))
+
+def word_prev(c):
+    # For the rules, ALetter_ExtPict is ALetter, and Extended_Pictographic
+    # is Other.
+    return {'ALetter_ExtPict': 'ALetter', 'Extended_Pictographic': 'Other'}.get(c, c)
+
+def word_state_name(state):
+    (prev, raw, ri_odd, pending) = state
+    name = [prev]
+    if raw:
+        name.append(raw)
+    if ri_odd:
+        name.append('odd')
+    if pending:
+        name.append('pending after %s%s' % (pending[0], '' if pending[1] else ', unmarked'))
+    return ' '.join(name)
+
+def gen_seg_machine(name, t, states, table, state_name):
+    print('#[rustfmt::skip]')
+    print('pub const %s: [%s; %d] = [' % (name, t, len(table) * len(table[0])))
+    for (i, state) in enumerate(states):
+        print('    // state %d: %s' % (i, state_name(state)))
+        gen_data(table[i])
+    print('];')
+
+def mk_segment_tables(datadir, emoji):
+    gcb = load_break_property(datadir, 'GraphemeBreakProperty.txt')
+    wb = load_break_property(datadir, 'WordBreakProperty.txt')
+    for cp in cldr_not_midletter:
+        assert wb[cp] == 'MidLetter'
+        wb[cp] = 'Other'
+    for cp in emoji['Extended_Pictographic']:
+        assert gcb[cp] == 'Other'
+        gcb[cp] = 'Extended_Pictographic'
+        assert wb[cp] in ('Other', 'ALetter')
+        wb[cp] = 'ALetter_ExtPict' if wb[cp] == 'ALetter' else 'Extended_Pictographic'
+    inv_gcb = dict((val, i) for (i, val) in enumerate(grapheme_assignments))
+    inv_wb = dict((val, i) for (i, val) in enumerate(word_assignments))
+    gen_utf8_trie('GRAPHEME', [inv_gcb[v] for v in gcb])
+    gen_utf8_trie('WORD', [inv_wb[v] for v in wb])
+
+    # A break is before the code point if bit 0x80 of the entry is set, and
+    # the rest is the new state. The start state, 0, is for the first code
+    # point of a text, or any code point after a break.
+    (states, sm) = mk_seg_machine(grapheme_assignments, ('sot', None, False), grapheme_step)
+    assert len(states) < 0x80
+    print()
+    print('pub const N_GRAPHEME_CATEGORIES: usize = %d;' % len(grapheme_assignments))
+    print('pub const N_GRAPHEME_STATES: usize = %d;' % len(states))
+    gen_seg_machine('GRAPHEME_STATE_MACHINE', 'u8', states, sm, grapheme_state_name)
+
+    # The entries are the new state in the low byte, with the WORD_* flags.
+    # The last column is for the end of the text.
+    (states, sm) = mk_seg_machine(word_assignments + ['eot'], ('sot', None, False, None), word_step)
+    assert len(states) <= 0x100
+    print()
+    print('pub const N_WORD_CATEGORIES: usize = %d;' % len(word_assignments))
+    print('pub const N_WORD_STATES: usize = %d;' % len(states))
+    print('pub const WORD_BREAK: u16 = 0x%x;' % WORD_BREAK)
+    print('pub const WORD_CONFIRM: u16 = 0x%x;' % WORD_CONFIRM)
+    print('pub const WORD_MARK: u16 = 0x%x;' % WORD_MARK)
+    gen_seg_machine('WORD_STATE_MACHINE', 'u16', states, sm, word_state_name)
 
 def main():
     datadir = sys.argv[1]
     if len(sys.argv) == 3 and sys.argv[2] == '--tests':
         mk_tests(datadir)
-    if len(sys.argv) == 3 and sys.argv[2] == '--tests-str':
+    elif len(sys.argv) == 3 and sys.argv[2] == '--tests-str':
         mk_tests(datadir, True)
     else:
         mk_tables(datadir)